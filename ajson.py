@@ -17,7 +17,7 @@ __all__ = (
 	'ERROR_PARSER_UNICODE',
 
 	'FLAGS_ALL', 'FLAGS_NONE', 'FLAG_INTEGER', 'FLAG_NUMBER_AS_STRING',
-	'FLAG_NUMBER_COMPONENTS',
+	'FLAG_NUMBER_COMPONENTS', 'FLAG_RAW_LATIN1', 'FLAG_STREAM',
 
 	'TOK_BEGIN_ARRAY', 'TOK_BEGIN_OBJECT', 'TOK_BOOLEAN', 'TOK_END', 'TOK_END_ARRAY',
 	'TOK_END_OBJECT', 'TOK_ERROR', 'TOK_INTEGER', 'TOK_NEED_DATA', 'TOK_NULL', 'TOK_NUMBER',
@@ -69,15 +69,22 @@ else:
 _Ints = tuple(_Ints)
 _Lists = (list, tuple)
 
-ENC_LATIN1 = 0
-ENC_UTF8   = 1
+ENC_LATIN1  = 0
+ENC_UTF8    = 1
+ENC_UTF16   = 2
+ENC_UTF16LE = 3
+ENC_UTF16BE = 4
+ENC_CBOR    = 5
+ENC_MSGPACK = 6
 
 FLAG_INTEGER           = 1
 FLAG_NUMBER_COMPONENTS = 2
 FLAG_NUMBER_AS_STRING  = 4
+FLAG_RAW_LATIN1        = 8
+FLAG_STREAM            = 16
 
 FLAGS_NONE = 0
-FLAGS_ALL  = FLAG_INTEGER | FLAG_NUMBER_COMPONENTS | FLAG_NUMBER_AS_STRING
+FLAGS_ALL  = FLAG_INTEGER | FLAG_NUMBER_COMPONENTS | FLAG_NUMBER_AS_STRING | FLAG_RAW_LATIN1 | FLAG_STREAM
 
 WRITER_FALG_ASCII = 1
 
@@ -115,6 +122,7 @@ ERROR_PARSER_ILLEGAL_UNICODE              = 12
 ERROR_PARSER_RANGE                        = 13
 ERROR_PARSER_UNEXPECTED_CHAR              = 14
 ERROR_PARSER_UNEXPECTED_EOF               = 15
+ERROR_BIND_TYPE                           = 16
 
 def _error_from_errno():
 	err = get_errno()
@@ -430,6 +438,10 @@ _ajson_write_string = _lib.ajson_write_string
 _ajson_write_string.argtypes = [_WriterPtr, ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_char), ctypes.c_size_t, ctypes.c_int]
 _ajson_write_string.restype  = ctypes.c_ssize_t
 
+_ajson_write_key = _lib.ajson_write_key
+_ajson_write_key.argtypes = [_WriterPtr, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t]
+_ajson_write_key.restype  = ctypes.c_ssize_t
+
 _ajson_write_begin_array = _lib.ajson_write_begin_array
 _ajson_write_begin_array.argtypes = [_WriterPtr, ctypes.c_void_p, ctypes.c_size_t]
 _ajson_write_begin_array.restype  = ctypes.c_ssize_t
@@ -454,6 +466,10 @@ _ajson_writer_get_flags = _lib.ajson_writer_get_flags
 _ajson_writer_get_flags.argtypes = [_WriterPtr]
 _ajson_writer_get_flags.restype  = ctypes.c_int
 
+_ajson_writer_register_key = _lib.ajson_writer_register_key
+_ajson_writer_register_key.argtypes = [_WriterPtr, ctypes.POINTER(ctypes.c_char), ctypes.c_size_t, ctypes.c_int]
+_ajson_writer_register_key.restype  = ctypes.c_ssize_t
+
 def _make_write_func(write_func):
 	@wraps(write_func)
 	def _write_func(self,*args):
@@ -503,6 +519,14 @@ class WriterBase(object):
 	def flags(self):
 		return _ajson_writer_get_flags(self._writer)
 
+	def register_key(self,key):
+		# the key is escaped once, key() writes it by the returned handle
+		buf    = key.encode('utf-8')
+		handle = _ajson_writer_register_key(self._writer, buf, len(buf), ENC_UTF8)
+		if handle < 0:
+			_error_from_errno()
+		return handle
+
 class Writer(WriterBase):
 	__slots__ = ()
 
@@ -510,6 +534,7 @@ class Writer(WriterBase):
 	boolean      = _make_write_func(_ajson_write_boolean)
 	number       = _make_write_func(_ajson_write_number)
 	integer      = _make_write_func(_ajson_write_integer)
+	key          = _make_write_func(_ajson_write_key)
 	begin_array  = _make_write_func(_ajson_write_begin_array)
 	end_array    = _make_write_func(_ajson_write_end_array)
 	begin_object = _make_write_func(_ajson_write_begin_object)
@@ -622,6 +647,7 @@ class FileWriter(WriterBase):
 	boolean      = _make_file_write_func(_ajson_write_boolean)
 	number       = _make_file_write_func(_ajson_write_number)
 	integer      = _make_file_write_func(_ajson_write_integer)
+	key          = _make_file_write_func(_ajson_write_key)
 	begin_array  = _make_file_write_func(_ajson_write_begin_array)
 	end_array    = _make_file_write_func(_ajson_write_end_array)
 	begin_object = _make_file_write_func(_ajson_write_begin_object)
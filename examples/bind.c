@@ -0,0 +1,124 @@
+#include "ajson.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+struct user {
+    const char *screen_name;
+    int         followers_count;
+};
+
+struct hashtag {
+    const char *text;
+};
+
+struct tweet {
+    int64_t         id;
+    const char     *text;
+    bool            favorited;
+    double          score;
+    struct user     user;
+    struct hashtag *hashtags;
+    size_t          hashtag_count;
+};
+
+struct timeline {
+    struct tweet *statuses;
+    size_t        status_count;
+};
+
+static const ajson_field user_fields[] = {
+    AJSON_FIELD(struct user, screen_name,     "screen_name",     AJSON_TYPE_STRING),
+    AJSON_FIELD(struct user, followers_count, "followers_count", AJSON_TYPE_INT)
+};
+static const ajson_struct user_struct = AJSON_STRUCT(struct user, user_fields);
+
+static const ajson_field hashtag_fields[] = {
+    AJSON_FIELD(struct hashtag, text, "text", AJSON_TYPE_STRING)
+};
+static const ajson_struct hashtag_struct = AJSON_STRUCT(struct hashtag, hashtag_fields);
+
+static const ajson_field tweet_fields[] = {
+    AJSON_FIELD       (struct tweet, id,        "id",        AJSON_TYPE_INT64),
+    AJSON_FIELD       (struct tweet, text,      "text",      AJSON_TYPE_STRING),
+    AJSON_FIELD       (struct tweet, favorited, "favorited", AJSON_TYPE_BOOLEAN),
+    AJSON_FIELD       (struct tweet, score,     "score",     AJSON_TYPE_DOUBLE),
+    AJSON_FIELD_OBJECT(struct tweet, user,      "user",      &user_struct),
+    AJSON_FIELD_ARRAY (struct tweet, hashtags, hashtag_count, "hashtags", AJSON_TYPE_OBJECT, &hashtag_struct)
+};
+static const ajson_struct tweet_struct = AJSON_STRUCT(struct tweet, tweet_fields);
+
+static const ajson_field timeline_fields[] = {
+    AJSON_FIELD_ARRAY(struct timeline, statuses, status_count, "statuses", AJSON_TYPE_OBJECT, &tweet_struct)
+};
+static const ajson_struct timeline_struct = AJSON_STRUCT(struct timeline, timeline_fields);
+
+int main(int argc, char *argv[]) {
+    FILE* fp;
+
+    if (argc > 2 || (argc == 2 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))) {
+        printf(
+                    "usage: %s [input-file]\n"
+                    "\n"
+                    "Decodes {\"statuses\": [...]} into C structs and prints them.\n",
+                    argc > 0 ? argv[0] : "bind");
+        return argc == 2 ? 0 : 1;
+    }
+
+    if (argc == 2) {
+        fp = fopen(argv[1], "rb");
+        if (!fp) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+    else {
+        fp = stdin;
+    }
+
+    ajson_parser    parser;
+    ajson_arena     arena;
+    struct timeline timeline;
+
+    if (ajson_init(&parser, AJSON_FLAG_INTEGER, AJSON_ENC_UTF8) != 0) {
+        perror("ajson_init");
+        if (argc == 2) fclose(fp);
+        return 1;
+    }
+    ajson_arena_init(&arena, 0);
+
+    int status = 0;
+    if (ajson_bind_file(&parser, &timeline_struct, &timeline, &arena, fp) != 0) {
+        if (ajson_get_error(&parser) == AJSON_ERROR_NONE) {
+            perror("ajson_bind_file");
+        }
+        else {
+            fprintf(stderr, "*** error: %s\n", ajson_error_str(ajson_get_error(&parser)));
+        }
+        status = 1;
+    }
+    else {
+        for (size_t i = 0; i < timeline.status_count; ++ i) {
+            const struct tweet *tweet = timeline.statuses + i;
+
+            printf("%" PRId64 " @%s (%d followers)%s score=%g: %s\n",
+                   tweet->id,
+                   tweet->user.screen_name ? tweet->user.screen_name : "?",
+                   tweet->user.followers_count,
+                   tweet->favorited ? " favorited" : "",
+                   tweet->score,
+                   tweet->text ? tweet->text : "");
+
+            for (size_t j = 0; j < tweet->hashtag_count; ++ j) {
+                printf("\t#%s\n", tweet->hashtags[j].text ? tweet->hashtags[j].text : "");
+            }
+        }
+    }
+
+    if (argc == 2) fclose(fp);
+    ajson_arena_destroy(&arena);
+    ajson_destroy(&parser);
+
+    return status;
+}
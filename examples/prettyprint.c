@@ -46,7 +46,8 @@ int main(int argc, char *argv[]) {
                         "\t-h, --help                 print this help message\n"
                         "\t-i, --integer              parse numbers without decimals or exponent as 64bit integers\n"
                         "\t-s, --string               parse numbers as strings (conflicts with --integer)\n"
-                        "\t-e, --encoding=ENCODING    input encoding 'UTF-8' (default) or 'LATIN-1'\n"
+                        "\t-e, --encoding=ENCODING    input encoding 'UTF-8' (default), 'LATIN-1',\n"
+                        "\t                           'UTF-16', 'UTF-16LE' or 'UTF-16BE'\n"
                         "\t-a, --ascii                produce ASCII compatible output\n"
                         "\t-I, --indent=INDENT        use INDENT as indentation (default: $'\\t')\n"
                         "\t-u, --ugly                 don't pretty print\n"
@@ -69,6 +70,15 @@ int main(int argc, char *argv[]) {
             else if (strcasecmp(optarg, "LATIN-1") == 0 || strcasecmp(optarg, "LATIN1") == 0 || strcasecmp(optarg, "ISO-8859-1") == 0 || strcasecmp(optarg, "ISO_8859-1") == 0) {
                 encoding = AJSON_ENC_LATIN1;
             }
+            else if (strcasecmp(optarg, "UTF-16") == 0 || strcasecmp(optarg, "UTF16") == 0) {
+                encoding = AJSON_ENC_UTF16;
+            }
+            else if (strcasecmp(optarg, "UTF-16LE") == 0 || strcasecmp(optarg, "UTF16LE") == 0) {
+                encoding = AJSON_ENC_UTF16LE;
+            }
+            else if (strcasecmp(optarg, "UTF-16BE") == 0 || strcasecmp(optarg, "UTF16BE") == 0) {
+                encoding = AJSON_ENC_UTF16BE;
+            }
             else {
                 fprintf(stderr, "*** unsupported encoding: %s\n", optarg);
                 return 1;
@@ -162,13 +172,7 @@ int main(int argc, char *argv[]) {
 
             case AJSON_TOK_NUMBER:
                 if (parser_flags & AJSON_FLAG_NUMBER_AS_STRING) {
-                    if (fwrite(parser.value.string.value, 1, parser.value.string.length, stdout) < parser.value.string.length) {
-                        perror("fwrite");
-                        if (optind < argc) fclose(fp);
-                        ajson_writer_destroy(&writer);
-                        ajson_destroy(&parser);
-                        return 1;
-                    }
+                    written = ajson_write_raw(&writer, outbuf, sizeof(outbuf), parser.value.string.value, parser.value.string.length);
                 }
                 else {
                     written = ajson_write_number(&writer, outbuf, sizeof(outbuf), parser.value.number);
@@ -0,0 +1,147 @@
+#include "ajson.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <inttypes.h>
+
+int main(int argc, char *argv[]) {
+    struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"select",   required_argument, 0, 's'},
+        {"value",    required_argument, 0, 'v'},
+        {"group-by", required_argument, 0, 'g'},
+        {"encoding", required_argument, 0, 'e'},
+        {0,          0,                 0,  0 }
+    };
+
+    FILE*       fp;
+    const char* select   = "";
+    const char* value    = NULL;
+    const char* group_by = NULL;
+    enum ajson_encoding encoding = AJSON_ENC_UTF8;
+    ajson_query query;
+
+    for (;;) {
+        int opt = getopt_long(argc, argv, "hs:v:g:e:", long_options, NULL);
+
+        if (opt == -1)
+            break;
+
+        switch (opt) {
+        case 'h':
+            printf(
+                        "usage: %s [options] [input-file]\n"
+                        "\n"
+                        "Counts the selected values of a JSON document or a sequence of JSON\n"
+                        "documents (e.g. NDJSON) and aggregates numbers below them. Prints one\n"
+                        "tab separated line per group: group, count, values, sum, min, max\n"
+                        "\n"
+                        "OPTIONS:\n"
+                        "\t-h, --help                 print this help message\n"
+                        "\t-s, --select=POINTER       select records using this JSON Pointer where \"*\"\n"
+                        "\t                           matches any key or index (default: every document)\n"
+                        "\t-v, --value=POINTER        aggregate numbers at this JSON Pointer relative to\n"
+                        "\t                           the selected records\n"
+                        "\t-g, --group-by=POINTER     group records by the value at this JSON Pointer\n"
+                        "\t                           relative to the selected records\n"
+                        "\t-e, --encoding=ENCODING    input encoding 'UTF-8' (default), 'LATIN-1',\n"
+                        "\t                           'UTF-16', 'UTF-16LE' or 'UTF-16BE'\n",
+                        argc > 0 ? argv[0] : "query");
+            return 0;
+
+        case 's':
+            select = optarg;
+            break;
+
+        case 'v':
+            value = optarg;
+            break;
+
+        case 'g':
+            group_by = optarg;
+            break;
+
+        case 'e':
+            if (strcasecmp(optarg, "UTF-8") == 0 || strcasecmp(optarg, "UTF8") == 0) {
+                encoding = AJSON_ENC_UTF8;
+            }
+            else if (strcasecmp(optarg, "LATIN-1") == 0 || strcasecmp(optarg, "LATIN1") == 0 || strcasecmp(optarg, "ISO-8859-1") == 0 || strcasecmp(optarg, "ISO_8859-1") == 0) {
+                encoding = AJSON_ENC_LATIN1;
+            }
+            else if (strcasecmp(optarg, "UTF-16") == 0 || strcasecmp(optarg, "UTF16") == 0) {
+                encoding = AJSON_ENC_UTF16;
+            }
+            else if (strcasecmp(optarg, "UTF-16LE") == 0 || strcasecmp(optarg, "UTF16LE") == 0) {
+                encoding = AJSON_ENC_UTF16LE;
+            }
+            else if (strcasecmp(optarg, "UTF-16BE") == 0 || strcasecmp(optarg, "UTF16BE") == 0) {
+                encoding = AJSON_ENC_UTF16BE;
+            }
+            else {
+                fprintf(stderr, "*** unsupported encoding: %s\n", optarg);
+                return 1;
+            }
+            break;
+
+        case '?':
+            fprintf(stderr, "*** unknown option: -%s\n", optarg);
+            return 1;
+        }
+    }
+
+    if (optind < argc) {
+        fp = fopen(argv[optind], "rb");
+        if (!fp) {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+    else {
+        fp = stdin;
+    }
+
+    if (ajson_query_init(&query, encoding, select, value, group_by) != 0) {
+        perror("ajson_query_init");
+        if (optind < argc) fclose(fp);
+        return 1;
+    }
+
+    int status = 0;
+    errno = 0;
+    if (ajson_query_parse_file(&query, fp) != 0) {
+        if (errno) {
+            perror("ajson_query_parse_file");
+        }
+        else {
+            fprintf(stderr, "*** parser error: %s\n", ajson_error_str(ajson_get_error(&query.parser)));
+        }
+        status = 1;
+    }
+    else {
+        for (size_t i = 0; i < ajson_query_get_group_count(&query); ++ i) {
+            const ajson_query_group *group = ajson_query_get_group(&query, i);
+
+            if (group->key) {
+                fwrite(group->key, 1, group->key_length, stdout);
+            }
+            else {
+                printf("-");
+            }
+
+            printf("\t%" PRIu64 "\t%" PRIu64, group->count, group->values);
+            if (group->values) {
+                printf("\t%.16g\t%.16g\t%.16g\n", group->sum, group->min, group->max);
+            }
+            else {
+                printf("\t-\t-\t-\n");
+            }
+        }
+    }
+
+    if (optind < argc) fclose(fp);
+    ajson_query_destroy(&query);
+
+    return status;
+}
@@ -0,0 +1,163 @@
+#include "ajson.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+struct stats {
+    size_t nulls;
+    size_t booleans;
+    size_t integers;
+    size_t numbers;
+    size_t strings;
+    size_t arrays;
+    size_t objects;
+    size_t depth;
+    size_t max_depth;
+    size_t string_bytes;
+};
+
+static int count_null(void *ctx) {
+    ++ ((struct stats*)ctx)->nulls;
+    return AJSON_CB_CONTINUE;
+}
+
+static int count_boolean(void *ctx, bool value) {
+    (void)value;
+    ++ ((struct stats*)ctx)->booleans;
+    return AJSON_CB_CONTINUE;
+}
+
+static int count_integer(void *ctx, int64_t value) {
+    (void)value;
+    ++ ((struct stats*)ctx)->integers;
+    return AJSON_CB_CONTINUE;
+}
+
+static int count_number(void *ctx, double value) {
+    (void)value;
+    ++ ((struct stats*)ctx)->numbers;
+    return AJSON_CB_CONTINUE;
+}
+
+// keys are strings too
+static int count_string(void *ctx, const char *value, size_t length) {
+    struct stats *stats = ctx;
+    (void)value;
+    ++ stats->strings;
+    stats->string_bytes += length;
+    return AJSON_CB_CONTINUE;
+}
+
+static int begin_container(struct stats *stats) {
+    if (++ stats->depth > stats->max_depth) {
+        stats->max_depth = stats->depth;
+    }
+    return AJSON_CB_CONTINUE;
+}
+
+static int begin_array(void *ctx) {
+    ++ ((struct stats*)ctx)->arrays;
+    return begin_container(ctx);
+}
+
+static int begin_object(void *ctx) {
+    ++ ((struct stats*)ctx)->objects;
+    return begin_container(ctx);
+}
+
+static int end_container(void *ctx) {
+    -- ((struct stats*)ctx)->depth;
+    return AJSON_CB_CONTINUE;
+}
+
+static int report_error(void *ctx, enum ajson_error error) {
+    (void)ctx;
+    fprintf(stderr, "*** error: %s\n", ajson_error_str(error));
+    return AJSON_CB_CONTINUE;
+}
+
+// The handlers are called directly instead of through the function pointers
+// of ajson_cb_parser, so the compiler can inline them into the token loop.
+AJSON_DEFINE_CB_PARSER(count_tokens, AJSON_FLAG_INTEGER,
+                       count_null, count_boolean, ajson_cb_ignore, count_number, ajson_cb_ignore,
+                       count_integer, count_string, begin_array, end_container, begin_object, end_container,
+                       ajson_cb_ignore, report_error)
+
+int main(int argc, char *argv[]) {
+    FILE* fp;
+
+    if (argc > 2 || (argc == 2 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))) {
+        printf(
+                    "usage: %s [input-file]\n"
+                    "\n"
+                    "Counts the values of a JSON document or a sequence of JSON documents\n"
+                    "(e.g. NDJSON) by type.\n",
+                    argc > 0 ? argv[0] : "stats");
+        return argc == 2 ? 0 : 1;
+    }
+
+    if (argc == 2) {
+        fp = fopen(argv[1], "rb");
+        if (!fp) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+    else {
+        fp = stdin;
+    }
+
+    ajson_parser parser;
+    struct stats stats;
+    char         buf[BUFSIZ];
+
+    if (ajson_init(&parser, AJSON_FLAG_INTEGER | AJSON_FLAG_STREAM, AJSON_ENC_UTF8) != 0) {
+        perror("ajson_init");
+        if (argc == 2) fclose(fp);
+        return 1;
+    }
+    memset(&stats, 0, sizeof(stats));
+
+    int status = 0;
+    for (;;) {
+        size_t count = fread(buf, 1, sizeof(buf), fp);
+
+        if (ferror(fp)) {
+            perror("fread");
+            status = 1;
+            break;
+        }
+
+        if (ajson_feed(&parser, buf, count) != 0) {
+            perror("ajson_feed");
+            status = 1;
+            break;
+        }
+
+        if (count_tokens(&parser, &stats) != 0) {
+            status = 1;
+            break;
+        }
+
+        if (count == 0) {
+            break;
+        }
+    }
+
+    if (status == 0) {
+        printf("nulls:     %zu\n", stats.nulls);
+        printf("booleans:  %zu\n", stats.booleans);
+        printf("integers:  %zu\n", stats.integers);
+        printf("numbers:   %zu\n", stats.numbers);
+        printf("strings:   %zu (%zu bytes)\n", stats.strings, stats.string_bytes);
+        printf("arrays:    %zu\n", stats.arrays);
+        printf("objects:   %zu\n", stats.objects);
+        printf("max depth: %zu\n", stats.max_depth);
+    }
+
+    if (argc == 2) fclose(fp);
+    ajson_destroy(&parser);
+
+    return status;
+}
@@ -1,9 +1,16 @@
 #include "ajson.h"
+#include "filter.h"
+#include "decoder.h"
 
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#   include <emmintrin.h>
+#   define AJSON_USE_SSE2
+#endif
+
 const char  *ajson_version()       { return AJSON_VERSION_STRING; }
 unsigned int ajson_version_major() { return AJSON_VERSION_MAJOR; }
 unsigned int ajson_version_minor() { return AJSON_VERSION_MINOR; }
@@ -79,13 +86,20 @@ const char* ajson_error_str(enum ajson_error error) {
     case AJSON_ERROR_PARSER_UNEXPECTED_EOF:
         return "unexpected end of file";
 
+    case AJSON_ERROR_BIND_TYPE:
+        return "value has the wrong type";
+
     default:
         return "unknown error";
     }
 }
 
 int ajson_init(ajson_parser *parser, int flags, enum ajson_encoding encoding) {
-    if (flags & ~AJSON_FLAGS_ALL || (flags & AJSON_FLAG_NUMBER_AS_STRING && flags & (AJSON_FLAG_INTEGER | AJSON_FLAG_NUMBER_COMPONENTS))) {
+    if (flags & ~AJSON_FLAGS_ALL || (flags & AJSON_FLAG_NUMBER_AS_STRING && flags & (AJSON_FLAG_INTEGER | AJSON_FLAG_NUMBER_COMPONENTS)) ||
+        (flags & AJSON_FLAG_RAW_LATIN1 && encoding != AJSON_ENC_LATIN1) ||
+        // binary input has no number syntax to preserve
+        (flags & (AJSON_FLAG_NUMBER_COMPONENTS | AJSON_FLAG_NUMBER_AS_STRING) && encoding >= AJSON_ENC_CBOR) ||
+        encoding < AJSON_ENC_LATIN1 || encoding > AJSON_ENC_MSGPACK) {
         errno = EINVAL;
         return -1;
     }
@@ -100,6 +114,12 @@ int ajson_init(ajson_parser *parser, int flags, enum ajson_encoding encoding) {
     }
     parser->stack_size = AJSON_STACK_SIZE;
 
+    if (encoding >= AJSON_ENC_CBOR && ajson_decoder_init(parser) != 0) {
+        free(parser->stack);
+        parser->stack = NULL;
+        return -1;
+    }
+
     return 0;
 }
 
@@ -110,6 +130,20 @@ void ajson_reset(ajson_parser *parser) {
     if (parser->stack) parser->stack[0] = 0;
     parser->stack_current = 0;
     parser->buffer_used   = 0;
+
+    parser->utf16.pending_size = 0;
+    parser->utf16.started      = false;
+
+    if (parser->decoder) {
+        ajson_decoder_reset(parser);
+    }
+
+    parser->skip           = AJSON_SKIP_NONE;
+    parser->depth          = 0;
+    parser->skip_container = 0;
+    if (parser->filter) {
+        ajson_filter_reset(parser->filter);
+    }
 }
 
 void ajson_destroy(ajson_parser *parser) {
@@ -122,6 +156,226 @@ void ajson_destroy(ajson_parser *parser) {
     parser->buffer      = NULL;
     parser->buffer_size = 0;
     parser->buffer_used = 0;
+
+    free(parser->utf16.buffer);
+    parser->utf16.buffer       = NULL;
+    parser->utf16.buffer_size  = 0;
+    parser->utf16.pending_size = 0;
+
+    ajson_decoder_destroy(parser);
+    ajson_clear_filters(parser);
+}
+
+// Transcodes UTF-16 to UTF-8 and returns the number of consumed bytes. Stops
+// before a truncated code unit or surrogate pair at the end of the input. Unpaired
+// surrogates are replaced by the byte 0xFF, which is never valid in UTF-8 and thus
+// makes the parser raise an error at the right position.
+static size_t ajson_utf16_transcode(bool big_endian, const unsigned char *input, size_t size, unsigned char *output, size_t *output_size) {
+    size_t index = 0;
+    unsigned char *out = output;
+
+#ifdef AJSON_USE_SSE2
+    const __m128i non_ascii = _mm_set1_epi16((short)0xFF80);
+    const __m128i zero      = _mm_setzero_si128();
+
+    // end of a block with non-ASCII code units that is left to the scalar code
+    size_t scalar_end = 0;
+#endif
+
+    while (index + 1 < size) {
+#ifdef AJSON_USE_SSE2
+        if (index >= scalar_end && index + 16 <= size) {
+            __m128i units = _mm_loadu_si128((const __m128i*)(input + index));
+            if (big_endian) {
+                units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+            }
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, non_ascii), zero)) == 0xFFFF) {
+                // 8 ASCII code units
+                _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(units, units));
+                out   += 8;
+                index += 16;
+                continue;
+            }
+
+            scalar_end = index + 16;
+        }
+#endif
+
+        uint32_t unit1 = big_endian ?
+            ((uint32_t)input[index] << 8) | input[index + 1] :
+            ((uint32_t)input[index + 1] << 8) | input[index];
+
+        if (unit1 < 0x80) {
+            *out ++ = unit1;
+            index += 2;
+        }
+        else if (unit1 < 0x800) {
+            *out ++ = (unit1 >> 6) + 0xC0;
+            *out ++ = (unit1 & 0x3F) + 0x80;
+            index += 2;
+        }
+        else if (unit1 < 0xD800 || unit1 > 0xDFFF) {
+            *out ++ = (unit1 >> 12) + 0xE0;
+            *out ++ = ((unit1 >> 6) & 0x3F) + 0x80;
+            *out ++ = (unit1 & 0x3F) + 0x80;
+            index += 2;
+        }
+        else if (unit1 <= 0xDBFF) {
+            if (index + 3 >= size) {
+                // surrogate pair is continued in the next chunk
+                break;
+            }
+
+            uint32_t unit2 = big_endian ?
+                ((uint32_t)input[index + 2] << 8) | input[index + 3] :
+                ((uint32_t)input[index + 3] << 8) | input[index + 2];
+
+            if (unit2 < 0xDC00 || unit2 > 0xDFFF) {
+                *out ++ = 0xFF;
+                index += 2;
+            }
+            else {
+                uint32_t codepoint = (unit1 << 10) + unit2 - 0x35FDC00;
+                *out ++ = (codepoint >> 18) + 0xF0;
+                *out ++ = ((codepoint >> 12) & 0x3F) + 0x80;
+                *out ++ = ((codepoint >> 6) & 0x3F) + 0x80;
+                *out ++ = (codepoint & 0x3F) + 0x80;
+                index += 4;
+            }
+        }
+        else {
+            // unexpected low surrogate
+            *out ++ = 0xFF;
+            index += 2;
+        }
+    }
+
+    *output_size = out - output;
+    return index;
+}
+
+// A chunk size of 0 signals the end of the input to the parser. If a chunk only
+// contained a BOM or an incomplete code unit, pretend that a chunk of one byte was
+// fed and that it is already consumed, so that the parser just asks for more data.
+static inline void ajson_feed_nothing(ajson_parser *parser) {
+    parser->input         = "";
+    parser->input_size    = 1;
+    parser->input_current = 1;
+}
+
+static int ajson_feed_utf16(ajson_parser *parser, const unsigned char *data, size_t size) {
+    if (size == 0) {
+        if (parser->utf16.pending_size > 0) {
+            // odd number of bytes or truncated surrogate pair
+            parser->utf16.pending_size = 0;
+            parser->input      = "\xFF";
+            parser->input_size = 1;
+        }
+        else {
+            parser->input      = NULL;
+            parser->input_size = 0;
+        }
+        return 0;
+    }
+
+    if (!parser->utf16.started) {
+        if (parser->utf16.pending_size + size < 2) {
+            parser->utf16.pending[parser->utf16.pending_size ++] = *data;
+            ajson_feed_nothing(parser);
+            return 0;
+        }
+
+        unsigned char byte1 = parser->utf16.pending_size > 0 ? parser->utf16.pending[0] : data[0];
+        unsigned char byte2 = parser->utf16.pending_size > 0 ? data[0] : data[1];
+        bool bom = false;
+
+        if (byte1 == 0xFE && byte2 == 0xFF) {
+            bom = parser->encoding != AJSON_ENC_UTF16LE;
+            parser->utf16.big_endian = true;
+        }
+        else if (byte1 == 0xFF && byte2 == 0xFE) {
+            bom = parser->encoding != AJSON_ENC_UTF16BE;
+            parser->utf16.big_endian = false;
+        }
+        else {
+            // The first character of a JSON document is always ASCII, so the
+            // position of the null byte tells the byte order.
+            parser->utf16.big_endian = byte1 == 0 || byte2 != 0;
+        }
+
+        if (parser->encoding != AJSON_ENC_UTF16) {
+            parser->utf16.big_endian = parser->encoding == AJSON_ENC_UTF16BE;
+        }
+
+        parser->utf16.started = true;
+
+        if (bom) {
+            data += 2 - parser->utf16.pending_size;
+            size -= 2 - parser->utf16.pending_size;
+            parser->utf16.pending_size = 0;
+
+            if (size == 0) {
+                ajson_feed_nothing(parser);
+                return 0;
+            }
+        }
+    }
+
+    size_t pending_size = parser->utf16.pending_size;
+    size_t needed = (pending_size + size) / 2 * 3 + 4;
+    if (needed > parser->utf16.buffer_size) {
+        char *buffer = realloc(parser->utf16.buffer, needed);
+        if (!buffer) {
+            return -1;
+        }
+        parser->utf16.buffer      = buffer;
+        parser->utf16.buffer_size = needed;
+    }
+
+    unsigned char *out = (unsigned char*)parser->utf16.buffer;
+    size_t out_size = 0;
+
+    if (pending_size > 0) {
+        // stitch together the code unit or surrogate pair that was split between chunks
+        unsigned char stitch[7];
+        size_t count = size < 4 ? size : 4;
+        memcpy(stitch, parser->utf16.pending, pending_size);
+        memcpy(stitch + pending_size, data, count);
+
+        size_t consumed = ajson_utf16_transcode(parser->utf16.big_endian, stitch, pending_size + count, out, &out_size);
+        out += out_size;
+
+        if (consumed < pending_size) {
+            // only possible if the whole chunk is in stitch
+            parser->utf16.pending_size = pending_size + count - consumed;
+            memcpy(parser->utf16.pending, stitch + consumed, parser->utf16.pending_size);
+            data += count;
+            size  = 0;
+        }
+        else {
+            parser->utf16.pending_size = 0;
+            data += consumed - pending_size;
+            size -= consumed - pending_size;
+        }
+    }
+
+    size_t consumed = ajson_utf16_transcode(parser->utf16.big_endian, data, size, out, &out_size);
+    out += out_size;
+
+    if (consumed < size) {
+        parser->utf16.pending_size = size - consumed;
+        memcpy(parser->utf16.pending, data + consumed, parser->utf16.pending_size);
+    }
+
+    if (out == (unsigned char*)parser->utf16.buffer) {
+        ajson_feed_nothing(parser);
+    }
+    else {
+        parser->input      = parser->utf16.buffer;
+        parser->input_size = out - (unsigned char*)parser->utf16.buffer;
+    }
+    return 0;
 }
 
 int ajson_feed(ajson_parser *parser, const void *buffer, size_t size) {
@@ -129,9 +383,14 @@ int ajson_feed(ajson_parser *parser, const void *buffer, size_t size) {
         errno = ENOBUFS;
         return -1;
     }
+    parser->input_current = 0;
+
+    if (parser->encoding >= AJSON_ENC_UTF16 && parser->encoding <= AJSON_ENC_UTF16BE) {
+        return ajson_feed_utf16(parser, buffer, size);
+    }
+
     parser->input         = buffer;
     parser->input_size    = size;
-    parser->input_current = 0;
     return 0;
 }
 
@@ -3,9 +3,11 @@
 #pragma once
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <errno.h>
 
 #include "config.h"
 #include "export.h"
@@ -17,13 +19,16 @@ extern "C" {
 #define AJSON_VERSION_CHECK() (ajson_version_major() == AJSON_VERSION_MAJOR && ajson_version_minor() >= AJSON_VERSION_MINOR)
 
 #define AJSON_STACK_SIZE 64 // initial stack size
+#define AJSON_FILTER_MAX 64 // maximum number of filters per parser
 
 #define AJSON_FLAG_INTEGER           1 // parse numbers with no "." or exponent as int64_t
 #define AJSON_FLAG_NUMBER_COMPONENTS 2 // don't combine numbers into doubles, but return their integer, decimal, and exponent components
 #define AJSON_FLAG_NUMBER_AS_STRING  4 // don't convert numbers into doubles, but instead return it as a strings
+#define AJSON_FLAG_RAW_LATIN1        8 // don't transcode Latin-1 strings to UTF-8, but return them as they are
+#define AJSON_FLAG_STREAM           16 // parse a sequence of whitespace separated values (e.g. NDJSON)
 
 #define AJSON_FLAGS_NONE 0
-#define AJSON_FLAGS_ALL  (AJSON_FLAG_INTEGER | AJSON_FLAG_NUMBER_COMPONENTS | AJSON_FLAG_NUMBER_AS_STRING)
+#define AJSON_FLAGS_ALL  (AJSON_FLAG_INTEGER | AJSON_FLAG_NUMBER_COMPONENTS | AJSON_FLAG_NUMBER_AS_STRING | AJSON_FLAG_RAW_LATIN1 | AJSON_FLAG_STREAM)
 
 #define AJSON_WRITER_FLAG_ASCII 1 // writer ASCII compatible output (use \u#### escapes)
 
@@ -32,7 +37,12 @@ extern "C" {
 
 enum ajson_encoding {
     AJSON_ENC_LATIN1,
-    AJSON_ENC_UTF8
+    AJSON_ENC_UTF8,
+    AJSON_ENC_UTF16,   // byte order is detected from BOM or the first character
+    AJSON_ENC_UTF16LE,
+    AJSON_ENC_UTF16BE,
+    AJSON_ENC_CBOR,    // RFC 8949 binary input
+    AJSON_ENC_MSGPACK  // MessagePack binary input
 };
 
 enum ajson_token {
@@ -66,9 +76,13 @@ enum ajson_error {
     AJSON_ERROR_PARSER_ILLEGAL_UNICODE,
     AJSON_ERROR_PARSER_RANGE,
     AJSON_ERROR_PARSER_UNEXPECTED_CHAR,
-    AJSON_ERROR_PARSER_UNEXPECTED_EOF
+    AJSON_ERROR_PARSER_UNEXPECTED_EOF,
+    AJSON_ERROR_BIND_TYPE
 };
 
+struct ajson_filter_s;
+struct ajson_decoder_s;
+
 struct ajson_parser_s {
     int                 flags;           //!< Parser flags.
     enum ajson_encoding encoding;        //!< Input encoding.
@@ -81,6 +95,20 @@ struct ajson_parser_s {
     char               *buffer;          //!< @private
     size_t              buffer_size;     //!< @private
     size_t              buffer_used;     //!< @private
+    struct {
+        char           *buffer;          //!< @private
+        size_t          buffer_size;     //!< @private
+        unsigned char   pending[3];      //!< @private
+        unsigned char   pending_size;    //!< @private
+        bool            started;         //!< @private
+        bool            big_endian;      //!< @private
+    } utf16;                             //!< @private
+    int                 skip;            //!< @private
+    size_t              skip_depth;      //!< @private
+    size_t              depth;           //!< @private
+    size_t              skip_container;  //!< @private
+    struct ajson_filter_s *filter;       //!< @private
+    struct ajson_decoder_s *decoder;     //!< @private
     union {
         bool          boolean;           //!< Parsed boolean value.
         double        number;            //!< Parsed number.
@@ -124,6 +152,12 @@ AJSON_EXPORT void             ajson_reset     (ajson_parser *parser);
 AJSON_EXPORT void             ajson_destroy   (ajson_parser *parser);
 AJSON_EXPORT int              ajson_feed      (ajson_parser *parser, const void *buffer, size_t size);
 AJSON_EXPORT enum ajson_token ajson_next_token(ajson_parser *parser);
+AJSON_EXPORT void             ajson_skip_value(ajson_parser *parser);
+AJSON_EXPORT void             ajson_skip_container(ajson_parser *parser);
+
+AJSON_EXPORT int      ajson_add_filter        (ajson_parser *parser, const char *pattern);
+AJSON_EXPORT void     ajson_clear_filters     (ajson_parser *parser);
+AJSON_EXPORT uint64_t ajson_get_filter_matches(const ajson_parser *parser);
 
 AJSON_EXPORT ajson_parser *ajson_alloc(int flags, enum ajson_encoding encoding);
 AJSON_EXPORT void          ajson_free (ajson_parser *parser);
@@ -150,6 +184,10 @@ AJSON_EXPORT size_t           ajson_get_error_lineno  (const ajson_parser *parse
 
 AJSON_EXPORT const char* ajson_error_str(enum ajson_error error);
 
+#define AJSON_CB_CONTINUE 0 // callback return value: go on parsing
+#define AJSON_CB_STOP     1 // callback return value: stop parsing, the parse function returns 1
+#define AJSON_CB_SKIP     2 // callback return value: skip the rest of the current array or object
+
 typedef int (*ajson_null_func)            (void *ctx);
 typedef int (*ajson_boolean_func)         (void *ctx, bool        value);
 typedef int (*ajson_number_func)          (void *ctx, double      value);
@@ -184,21 +222,399 @@ struct ajson_cb_parser_s {
 
 typedef struct ajson_cb_parser_s ajson_cb_parser;
 
-AJSON_EXPORT int ajson_cb_parse_fd  (ajson_cb_parser *parser, int fd);
-AJSON_EXPORT int ajson_cb_parse_file(ajson_cb_parser *parser, FILE* stream);
-AJSON_EXPORT int ajson_cb_parse_buf (ajson_cb_parser *parser, const void* buffer, size_t size);
-AJSON_EXPORT int ajson_cb_dispatch  (ajson_cb_parser *parser);
+AJSON_EXPORT int ajson_cb_parse_fd          (ajson_cb_parser *parser, int fd);
+AJSON_EXPORT int ajson_cb_parse_file        (ajson_cb_parser *parser, FILE* stream);
+AJSON_EXPORT int ajson_cb_parse_fd_size     (ajson_cb_parser *parser, int fd, size_t buffer_size);
+AJSON_EXPORT int ajson_cb_parse_file_size   (ajson_cb_parser *parser, FILE* stream, size_t buffer_size);
+AJSON_EXPORT int ajson_cb_parse_path        (ajson_cb_parser *parser, const char *filename);
+AJSON_EXPORT int ajson_cb_parse_fd_pipelined(ajson_cb_parser *parser, int fd, size_t buffer_size, size_t buffer_count);
+AJSON_EXPORT int ajson_cb_parse_buf         (ajson_cb_parser *parser, const void* buffer, size_t size);
+AJSON_EXPORT int ajson_cb_dispatch          (ajson_cb_parser *parser);
+
+// Does nothing. Use it for tokens without handler in AJSON_DEFINE_CB_PARSER().
+static inline int ajson_cb_ignore(void *ctx, ...) {
+    (void)ctx;
+    return AJSON_CB_CONTINUE;
+}
+
+// Defines static int NAME(ajson_parser *parser, void *ctx), which works like
+// ajson_cb_dispatch(), but calls the given handlers directly and only contains
+// the number handling selected by FLAGS. Expand it at file scope without a
+// trailing semicolon. It sets errno, which this header includes <errno.h> for.
+#define AJSON_DEFINE_CB_PARSER(NAME, FLAGS, NULL_FUNC, BOOLEAN_FUNC, NUMBER_AS_STRING_FUNC, NUMBER_FUNC, COMPONENTS_FUNC, \
+                               INTEGER_FUNC, STRING_FUNC, BEGIN_ARRAY_FUNC, END_ARRAY_FUNC, BEGIN_OBJECT_FUNC, END_OBJECT_FUNC, \
+                               END_FUNC, ERROR_FUNC) \
+    static int NAME(ajson_parser *parser, void *ctx) { \
+        if ((parser->flags ^ (FLAGS)) & (AJSON_FLAG_NUMBER_AS_STRING | AJSON_FLAG_NUMBER_COMPONENTS)) { \
+            errno = EINVAL; \
+            return -1; \
+        } \
+        for (;;) { \
+            int result = AJSON_CB_CONTINUE; \
+            switch (ajson_next_token(parser)) { \
+            case AJSON_TOK_NULL:         result = NULL_FUNC(ctx); break; \
+            case AJSON_TOK_BOOLEAN:      result = BOOLEAN_FUNC(ctx, parser->value.boolean); break; \
+            case AJSON_TOK_INTEGER:      result = INTEGER_FUNC(ctx, parser->value.integer); break; \
+            case AJSON_TOK_STRING:       result = STRING_FUNC(ctx, parser->value.string.value, parser->value.string.length); break; \
+            case AJSON_TOK_BEGIN_ARRAY:  result = BEGIN_ARRAY_FUNC(ctx); break; \
+            case AJSON_TOK_END_ARRAY:    result = END_ARRAY_FUNC(ctx); break; \
+            case AJSON_TOK_BEGIN_OBJECT: result = BEGIN_OBJECT_FUNC(ctx); break; \
+            case AJSON_TOK_END_OBJECT:   result = END_OBJECT_FUNC(ctx); break; \
+            case AJSON_TOK_NUMBER: \
+                if ((FLAGS) & AJSON_FLAG_NUMBER_AS_STRING) { \
+                    result = NUMBER_AS_STRING_FUNC(ctx, parser->value.string.value); \
+                } \
+                else if ((FLAGS) & AJSON_FLAG_NUMBER_COMPONENTS) { \
+                    result = COMPONENTS_FUNC(ctx, \
+                        parser->value.components.positive, \
+                        parser->value.components.integer, \
+                        parser->value.components.decimal, \
+                        parser->value.components.decimal_places, \
+                        parser->value.components.exponent_positive, \
+                        parser->value.components.exponent); \
+                } \
+                else { \
+                    result = NUMBER_FUNC(ctx, parser->value.number); \
+                } \
+                break; \
+            case AJSON_TOK_END: \
+                END_FUNC(ctx); \
+                return 0; \
+            case AJSON_TOK_ERROR: \
+                ERROR_FUNC(ctx, parser->value.error.error); \
+                return -1; \
+            case AJSON_TOK_NEED_DATA: \
+                return 0; \
+            } \
+            if (result == AJSON_CB_STOP) { \
+                return 1; \
+            } \
+            else if (result == AJSON_CB_SKIP) { \
+                ajson_skip_container(parser); \
+            } \
+        } \
+    }
+
+struct ajson_query_group_s {
+    const char      *key;        //!< Group value or @c NULL for records without a scalar group value.
+    size_t           key_length; //!< Length of #key.
+    enum ajson_token key_type;   //!< Token type of the group value.
+    uint64_t         count;      //!< Number of selected records.
+    uint64_t         values;     //!< Number of numeric values.
+    double           sum;        //!< Sum of numeric values.
+    double           min;        //!< Smallest numeric value.
+    double           max;        //!< Biggest numeric value.
+};
+
+typedef struct ajson_query_group_s ajson_query_group;
+
+struct ajson_query_s {
+    ajson_parser       parser;          //!< Token parser.
+    uint64_t           value_mask;      //!< @private
+    uint64_t           group_mask;      //!< @private
+    bool               in_record;       //!< @private
+    size_t             depth;           //!< @private
+    ajson_query_group  record;          //!< @private
+    char              *key_buffer;      //!< @private
+    size_t             key_buffer_size; //!< @private
+    ajson_query_group *groups;          //!< @private
+    size_t             groups_size;     //!< @private
+    size_t             groups_count;    //!< @private
+    size_t            *index;           //!< @private
+    size_t             index_size;      //!< @private
+};
+
+typedef struct ajson_query_s ajson_query;
+
+AJSON_EXPORT int  ajson_query_init   (ajson_query *query, enum ajson_encoding encoding, const char *select, const char *value, const char *group_by);
+AJSON_EXPORT void ajson_query_reset  (ajson_query *query);
+AJSON_EXPORT void ajson_query_destroy(ajson_query *query);
+
+AJSON_EXPORT int ajson_query_parse_fd  (ajson_query *query, int fd);
+AJSON_EXPORT int ajson_query_parse_file(ajson_query *query, FILE* stream);
+AJSON_EXPORT int ajson_query_parse_buf (ajson_query *query, const void* buffer, size_t size);
+AJSON_EXPORT int ajson_query_dispatch  (ajson_query *query);
+
+AJSON_EXPORT size_t                   ajson_query_get_group_count(const ajson_query *query);
+AJSON_EXPORT const ajson_query_group *ajson_query_get_group      (const ajson_query *query, size_t index);
+
+#define AJSON_ARENA_CHUNK_SIZE 16384 // default size of arena chunks
+
+struct ajson_arena_chunk_s;
+
+struct ajson_arena_s {
+    struct ajson_arena_chunk_s *chunk;      //!< @private
+    size_t                      chunk_size; //!< @private
+};
+
+typedef struct ajson_arena_s ajson_arena;
+
+AJSON_EXPORT void  ajson_arena_init   (ajson_arena *arena, size_t chunk_size);
+AJSON_EXPORT void  ajson_arena_clear  (ajson_arena *arena);
+AJSON_EXPORT void  ajson_arena_destroy(ajson_arena *arena);
+AJSON_EXPORT void *ajson_arena_alloc  (ajson_arena *arena, size_t size);
+AJSON_EXPORT char *ajson_arena_strndup(ajson_arena *arena, const char *str, size_t length);
+
+enum ajson_type {
+    AJSON_TYPE_BOOLEAN, // bool
+    AJSON_TYPE_INT,     // int
+    AJSON_TYPE_INT64,   // int64_t
+    AJSON_TYPE_DOUBLE,  // double
+    AJSON_TYPE_STRING,  // const char*, null terminated copy in the arena
+    AJSON_TYPE_OBJECT,  // embedded struct described by ajson_field::object
+    AJSON_TYPE_ARRAY    // pointer to items of ajson_field::item_type in the arena and a size_t count
+};
+
+struct ajson_struct_s;
+
+struct ajson_field_s {
+    const char                  *key;          //!< Object key.
+    enum ajson_type              type;         //!< Type of the struct member.
+    size_t                       offset;       //!< Offset of the struct member.
+    const struct ajson_struct_s *object;       //!< Description of nested structs for ::AJSON_TYPE_OBJECT or arrays of them.
+    enum ajson_type              item_type;    //!< Item type of ::AJSON_TYPE_ARRAY .
+    size_t                       count_offset; //!< Offset of the @c size_t struct member that receives the item count of ::AJSON_TYPE_ARRAY .
+};
+
+typedef struct ajson_field_s ajson_field;
+
+struct ajson_struct_s {
+    size_t             size;        //!< Size of the struct.
+    const ajson_field *fields;      //!< Fields of the struct.
+    size_t             field_count; //!< Number of fields.
+};
+
+typedef struct ajson_struct_s ajson_struct;
+
+#define AJSON_FIELD(STRUCT, MEMBER, KEY, TYPE) \
+    { (KEY), (TYPE), offsetof(STRUCT, MEMBER), NULL, AJSON_TYPE_BOOLEAN, 0 }
+
+#define AJSON_FIELD_OBJECT(STRUCT, MEMBER, KEY, OBJECT) \
+    { (KEY), AJSON_TYPE_OBJECT, offsetof(STRUCT, MEMBER), (OBJECT), AJSON_TYPE_BOOLEAN, 0 }
+
+#define AJSON_FIELD_ARRAY(STRUCT, MEMBER, COUNT_MEMBER, KEY, ITEM_TYPE, OBJECT) \
+    { (KEY), AJSON_TYPE_ARRAY, offsetof(STRUCT, MEMBER), (OBJECT), (ITEM_TYPE), offsetof(STRUCT, COUNT_MEMBER) }
+
+#define AJSON_STRUCT(STRUCT, FIELDS) \
+    { sizeof(STRUCT), (FIELDS), sizeof(FIELDS) / sizeof((FIELDS)[0]) }
+
+AJSON_EXPORT int ajson_bind_fd  (ajson_parser *parser, const ajson_struct *desc, void *target, ajson_arena *arena, int fd);
+AJSON_EXPORT int ajson_bind_file(ajson_parser *parser, const ajson_struct *desc, void *target, ajson_arena *arena, FILE* stream);
+AJSON_EXPORT int ajson_bind_buf (ajson_parser *parser, const ajson_struct *desc, void *target, ajson_arena *arena, const void* buffer, size_t size);
+
+#define AJSON_DOM_SMALL_OBJECT 16 // objects with up to this many members are searched linearly
+
+struct ajson_member_s;
+
+struct ajson_value_s {
+    enum ajson_token type; //!< ::AJSON_TOK_NULL, ::AJSON_TOK_BOOLEAN, ::AJSON_TOK_NUMBER, ::AJSON_TOK_INTEGER, ::AJSON_TOK_STRING, ::AJSON_TOK_BEGIN_ARRAY or ::AJSON_TOK_BEGIN_OBJECT.
+    union {
+        bool          boolean;                  //!< Boolean value.
+        double        number;                   //!< Number.
+        int64_t       integer;                  //!< Integer.
+        struct {
+            const char *value;                  //!< Null terminated string data.
+            size_t      length;                 //!< String length.
+        } string;                               //!< String.
+        struct {
+            const struct ajson_value_s  *items;   //!< Array items.
+            size_t                       count;   //!< Number of items.
+        } array;                                //!< Array.
+        struct {
+            const struct ajson_member_s *members; //!< Object members in input order.
+            size_t                       count;   //!< Number of members.
+            const void                  *lookup;  //!< @private
+        } object;                               //!< Object.
+    } value; //!< The value.
+};
+
+typedef struct ajson_value_s ajson_value;
+
+struct ajson_member_s {
+    const char  *key;        //!< Null terminated key.
+    size_t       key_length; //!< Key length.
+    ajson_value  value;      //!< Value.
+};
+
+typedef struct ajson_member_s ajson_member;
+
+struct ajson_dom_frame_s;
+
+struct ajson_dom_s {
+    ajson_arena              *arena;         //!< Arena for all values.
+    const ajson_value        *root;          //!< @private
+    ajson_member             *scratch;       //!< @private
+    size_t                    scratch_size;  //!< @private
+    size_t                    scratch_used;  //!< @private
+    struct ajson_dom_frame_s *stack;         //!< @private
+    size_t                    stack_size;    //!< @private
+    size_t                    stack_current; //!< @private
+};
+
+typedef struct ajson_dom_s ajson_dom;
+
+AJSON_EXPORT int  ajson_dom_init   (ajson_dom *dom, ajson_arena *arena);
+AJSON_EXPORT void ajson_dom_reset  (ajson_dom *dom);
+AJSON_EXPORT void ajson_dom_destroy(ajson_dom *dom);
+
+AJSON_EXPORT int                ajson_dom_add_token(ajson_dom *dom, ajson_parser *parser, enum ajson_token token);
+AJSON_EXPORT const ajson_value *ajson_dom_get_root (const ajson_dom *dom);
+
+AJSON_EXPORT const ajson_value *ajson_dom_parse_fd  (ajson_dom *dom, ajson_parser *parser, int fd);
+AJSON_EXPORT const ajson_value *ajson_dom_parse_file(ajson_dom *dom, ajson_parser *parser, FILE* stream);
+AJSON_EXPORT const ajson_value *ajson_dom_parse_buf (ajson_dom *dom, ajson_parser *parser, const void* buffer, size_t size);
+
+AJSON_EXPORT size_t             ajson_value_size   (const ajson_value *value);
+AJSON_EXPORT const ajson_value *ajson_value_at     (const ajson_value *array, size_t index);
+AJSON_EXPORT const ajson_value *ajson_value_get    (const ajson_value *object, const char *key);
+AJSON_EXPORT const ajson_value *ajson_value_get_key(const ajson_value *object, const char *key, size_t length);
+
+#define AJSON_BINARY_VERSION 1
+
+struct ajson_binary_value_s {
+    uint32_t type;   //!< ::ajson_token the value starts with, see ajson_value_s::type .
+    uint32_t unused; //!< @private
+    union {
+        uint64_t boolean; //!< Boolean value (0 or 1).
+        double   number;  //!< Number.
+        int64_t  integer; //!< Integer.
+        uint64_t offset;  //!< @private
+    } value; //!< The value of scalars.
+};
+
+typedef struct ajson_binary_value_s ajson_binary_value;
+
+struct ajson_binary_s {
+    const void *data;   //!< @private
+    size_t      size;   //!< @private
+    bool        mapped; //!< @private
+};
+
+typedef struct ajson_binary_s ajson_binary;
+
+AJSON_EXPORT int ajson_binary_encode  (const ajson_value *value, void **buffer, size_t *size);
+AJSON_EXPORT int ajson_binary_write_fd(const ajson_value *value, int fd);
+
+AJSON_EXPORT int                       ajson_binary_open   (ajson_binary *bin, const char *filename);
+AJSON_EXPORT int                       ajson_binary_open_fd(ajson_binary *bin, int fd);
+AJSON_EXPORT int                       ajson_binary_load   (ajson_binary *bin, const void *buffer, size_t size);
+AJSON_EXPORT void                      ajson_binary_close  (ajson_binary *bin);
+AJSON_EXPORT const ajson_binary_value *ajson_binary_root   (const ajson_binary *bin);
+
+AJSON_EXPORT size_t                    ajson_binary_size   (const ajson_binary_value *value);
+AJSON_EXPORT const char               *ajson_binary_string (const ajson_binary_value *value);
+AJSON_EXPORT const ajson_binary_value *ajson_binary_at     (const ajson_binary_value *container, size_t index);
+AJSON_EXPORT const char               *ajson_binary_key_at (const ajson_binary_value *object, size_t index, size_t *length);
+AJSON_EXPORT const ajson_binary_value *ajson_binary_get    (const ajson_binary_value *object, const char *key);
+AJSON_EXPORT const ajson_binary_value *ajson_binary_get_key(const ajson_binary_value *object, const char *key, size_t length);
+
+struct ajson_ondemand_s {
+    ajson_parser     parser;     //!< @private
+    const char      *input;      //!< @private
+    size_t           input_size; //!< @private
+    enum ajson_error error;      //!< @private
+};
+
+typedef struct ajson_ondemand_s ajson_ondemand;
+
+struct ajson_cursor_s {
+    ajson_ondemand *doc;   //!< @private
+    size_t          value; //!< @private
+    size_t          key;   //!< @private
+};
+
+typedef struct ajson_cursor_s ajson_cursor;
+
+AJSON_EXPORT int              ajson_ondemand_init     (ajson_ondemand *doc, const void *buffer, size_t size);
+AJSON_EXPORT void             ajson_ondemand_destroy  (ajson_ondemand *doc);
+AJSON_EXPORT int              ajson_ondemand_root     (ajson_ondemand *doc, ajson_cursor *root);
+AJSON_EXPORT enum ajson_error ajson_ondemand_get_error(const ajson_ondemand *doc);
+
+AJSON_EXPORT enum ajson_token ajson_cursor_type    (const ajson_cursor *cursor);
+AJSON_EXPORT int              ajson_cursor_find    (const ajson_cursor *object, const char *key, ajson_cursor *value);
+AJSON_EXPORT int              ajson_cursor_find_key(const ajson_cursor *object, const char *key, size_t length, ajson_cursor *value);
+AJSON_EXPORT int              ajson_cursor_at      (const ajson_cursor *array, size_t index, ajson_cursor *item);
+AJSON_EXPORT int              ajson_cursor_first   (const ajson_cursor *container, ajson_cursor *child);
+AJSON_EXPORT int              ajson_cursor_next    (ajson_cursor *cursor);
+
+AJSON_EXPORT int ajson_cursor_get_key    (const ajson_cursor *member, const char **key, size_t *length);
+AJSON_EXPORT int ajson_cursor_get_boolean(const ajson_cursor *cursor, bool *value);
+AJSON_EXPORT int ajson_cursor_get_number (const ajson_cursor *cursor, double *value);
+AJSON_EXPORT int ajson_cursor_get_integer(const ajson_cursor *cursor, int64_t *value);
+AJSON_EXPORT int ajson_cursor_get_string (const ajson_cursor *cursor, const char **value, size_t *length);
+
+struct ajson_schema_s;
+struct ajson_schema_node_s;
+struct ajson_validator_frame_s;
+
+typedef struct ajson_schema_s ajson_schema;
+
+enum ajson_violation {
+    AJSON_VIOLATION_NONE,
+    AJSON_VIOLATION_NOT_ALLOWED,
+    AJSON_VIOLATION_TYPE,
+    AJSON_VIOLATION_ENUM,
+    AJSON_VIOLATION_MINIMUM,
+    AJSON_VIOLATION_MAXIMUM,
+    AJSON_VIOLATION_MIN_LENGTH,
+    AJSON_VIOLATION_MAX_LENGTH,
+    AJSON_VIOLATION_MIN_ITEMS,
+    AJSON_VIOLATION_MAX_ITEMS,
+    AJSON_VIOLATION_REQUIRED,
+    AJSON_VIOLATION_ADDITIONAL_PROPERTY
+};
+
+struct ajson_validator_s {
+    const ajson_schema               *schema;        //!< Compiled schema.
+    enum ajson_violation              violation;     //!< First violation.
+    const struct ajson_schema_node_s *next;          //!< @private
+    struct ajson_validator_frame_s   *stack;         //!< @private
+    size_t                            stack_size;    //!< @private
+    size_t                            stack_current; //!< @private
+    size_t                            ignore_depth;  //!< @private
+    char                             *keys;          //!< @private
+    size_t                            keys_size;     //!< @private
+    size_t                            keys_used;     //!< @private
+    char                             *path;          //!< @private
+    size_t                            path_size;     //!< @private
+};
+
+typedef struct ajson_validator_s ajson_validator;
+
+AJSON_EXPORT ajson_schema *ajson_schema_compile(const void *buffer, size_t size);
+AJSON_EXPORT void          ajson_schema_free   (ajson_schema *schema);
+
+AJSON_EXPORT int  ajson_validator_init   (ajson_validator *validator, const ajson_schema *schema);
+AJSON_EXPORT void ajson_validator_reset  (ajson_validator *validator);
+AJSON_EXPORT void ajson_validator_destroy(ajson_validator *validator);
+
+AJSON_EXPORT int ajson_validate_token(ajson_validator *validator, ajson_parser *parser, enum ajson_token token);
+AJSON_EXPORT int ajson_validate_fd   (ajson_validator *validator, ajson_parser *parser, int fd);
+AJSON_EXPORT int ajson_validate_file (ajson_validator *validator, ajson_parser *parser, FILE* stream);
+AJSON_EXPORT int ajson_validate_buf  (ajson_validator *validator, ajson_parser *parser, const void* buffer, size_t size);
+
+AJSON_EXPORT enum ajson_violation ajson_validator_get_violation(const ajson_validator *validator);
+AJSON_EXPORT const char          *ajson_validator_get_path     (const ajson_validator *validator);
+
+AJSON_EXPORT const char *ajson_violation_str(enum ajson_violation violation);
 
 struct ajson_writer_s;
 
 typedef ssize_t (*ajson_write_func)(struct ajson_writer_s *writer, unsigned char *buffer, size_t size, size_t index);
 
+// called instead of copying a long run of string data that needs no escaping,
+// position is where the data belongs in the output buffer
+typedef int (*ajson_ref_func)(void *ctx, const unsigned char *position, const char *data, size_t size);
+
 struct ajson_writer_s {
     int              flags;               //!< Writer flags.
     const char      *indent;              //!< Indentation string.
+    int              decimals;            //!< Decimal places of numbers or -1 for the shortest representation.
     size_t           nesting_written;     //!< @private
     ajson_write_func write_func;          //!< @private
     ajson_write_func next_write_func;     //!< @private
+    ajson_ref_func   ref_func;            //!< @private
+    void            *ref_ctx;             //!< @private
     uintptr_t        state;               //!< @private
     char            *stack;               //!< @private
     size_t           stack_size;          //!< @private
@@ -207,31 +623,41 @@ struct ajson_writer_s {
         const char *string;               //!< @private
         char        character;            //!< @private
     } buffer;                             //!< @private
+    struct {
+        const void         *values;       //!< @private
+        const size_t       *lengths;      //!< @private
+        size_t              count;        //!< @private
+        size_t              index;        //!< @private
+        enum ajson_encoding encoding;     //!< @private
+        char               *delim;        //!< @private
+        size_t              delim_length; //!< @private
+        size_t              delim_size;   //!< @private
+    } array;                              //!< @private
+    char            *keys;                //!< @private
+    size_t           keys_size;           //!< @private
+    size_t           keys_used;           //!< @private
+    size_t          *key_offsets;         //!< @private
+    size_t           key_count;           //!< @private
+    size_t           key_offsets_size;    //!< @private
     union {
         bool boolean;                     //!< @private
         struct {
             double value;                 //!< @private
             size_t written;               //!< @private
-            char   buffer[32];            //!< @private
+            char   buffer[40];            //!< @private
         } number;                         //!< @private
         struct {
             union {
                 int64_t  sval;            //!< @private
                 uint64_t uval;            //!< @private
             } value;                      //!< @private
-            uint64_t div;                 //!< @private
+            char     buffer[24];          //!< @private
         } integer;                        //!< @private
         struct {
             const char         *value;    //!< @private
             const char         *end;      //!< @private
             enum ajson_encoding encoding; //!< @private
-            union {
-                size_t       count;       //!< @private
-                struct {
-                    uint16_t unit1;       //!< @private
-                    uint16_t unit2;       //!< @private
-                } utf16;                  //!< @private
-            } buffer;                     //!< @private
+            char                esc[13];  //!< @private
         } string;                         //!< @private
     } value;                              //!< @private
 };
@@ -252,17 +678,143 @@ AJSON_EXPORT ssize_t ajson_write_integer(ajson_writer *writer, void *buffer, siz
 AJSON_EXPORT ssize_t ajson_write_string (ajson_writer *writer, void *buffer, size_t size, const char* value, size_t length, enum ajson_encoding encoding);
 AJSON_EXPORT ssize_t ajson_write_string_latin1(ajson_writer *writer, void *buffer, size_t size, const char* value);
 AJSON_EXPORT ssize_t ajson_write_string_utf8  (ajson_writer *writer, void *buffer, size_t size, const char* value);
+AJSON_EXPORT ssize_t ajson_write_raw        (ajson_writer *writer, void *buffer, size_t size, const void *fragment, size_t length);
+AJSON_EXPORT ssize_t ajson_write_key        (ajson_writer *writer, void *buffer, size_t size, size_t key);
 
 AJSON_EXPORT ssize_t ajson_write_begin_array(ajson_writer *writer, void *buffer, size_t size);
 AJSON_EXPORT ssize_t ajson_write_end_array  (ajson_writer *writer, void *buffer, size_t size);
 
+AJSON_EXPORT ssize_t ajson_write_number_array (ajson_writer *writer, void *buffer, size_t size, const double  *values, size_t count);
+AJSON_EXPORT ssize_t ajson_write_integer_array(ajson_writer *writer, void *buffer, size_t size, const int64_t *values, size_t count);
+AJSON_EXPORT ssize_t ajson_write_string_array (ajson_writer *writer, void *buffer, size_t size, const char *const *values, const size_t *lengths, size_t count, enum ajson_encoding encoding);
+
 AJSON_EXPORT ssize_t ajson_write_begin_object(ajson_writer *writer, void *buffer, size_t size);
 AJSON_EXPORT ssize_t ajson_write_end_object  (ajson_writer *writer, void *buffer, size_t size);
 
 AJSON_EXPORT ssize_t ajson_write_continue(ajson_writer *writer, void *buffer, size_t size);
 
-AJSON_EXPORT int         ajson_writer_get_flags (ajson_writer *writer);
-AJSON_EXPORT const char *ajson_writer_get_indent(ajson_writer *writer);
+AJSON_EXPORT int         ajson_writer_get_flags   (ajson_writer *writer);
+AJSON_EXPORT const char *ajson_writer_get_indent  (ajson_writer *writer);
+AJSON_EXPORT int         ajson_writer_get_decimals(ajson_writer *writer);
+
+AJSON_EXPORT int ajson_writer_set_decimals(ajson_writer *writer, int decimals);
+
+AJSON_EXPORT ssize_t ajson_writer_register_key(ajson_writer *writer, const char *key, size_t length, enum ajson_encoding encoding);
+
+#define AJSON_SINK_BUFFER_SIZE 8192 // initial size of sink buffers
+#define AJSON_SINK_REF_MIN     512  // iovec sinks reference runs of string data of at least this size
+
+struct iovec;
+struct ajson_sink_ref_s;
+
+struct ajson_sink_s {
+    ajson_writer             writer;      //!< Writer.
+    char                    *buffer;      //!< Output buffer. Holds the whole document for buffer sinks.
+    size_t                   buffer_size; //!< @private
+    size_t                   used;        //!< Number of bytes in #buffer.
+    size_t                   flushed;     //!< @private
+    int                      fd;          //!< @private
+    FILE                    *stream;      //!< @private
+    struct ajson_sink_ref_s *refs;        //!< @private
+    size_t                   refs_size;   //!< @private
+    size_t                   refs_count;  //!< @private
+    struct iovec            *iov;         //!< @private
+    size_t                   iov_size;    //!< @private
+};
+
+typedef struct ajson_sink_s ajson_sink;
+
+AJSON_EXPORT int  ajson_writer_to_buffer(ajson_sink *sink, int flags, const char *indent);
+AJSON_EXPORT int  ajson_writer_to_fd    (ajson_sink *sink, int flags, const char *indent, int fd);
+AJSON_EXPORT int  ajson_writer_to_file  (ajson_sink *sink, int flags, const char *indent, FILE *stream);
+AJSON_EXPORT int  ajson_writer_to_iovec (ajson_sink *sink, int flags, const char *indent);
+AJSON_EXPORT void ajson_sink_reset      (ajson_sink *sink);
+AJSON_EXPORT void ajson_sink_destroy    (ajson_sink *sink);
+AJSON_EXPORT int  ajson_sink_flush      (ajson_sink *sink);
+
+AJSON_EXPORT const struct iovec *ajson_sink_get_iovec(ajson_sink *sink, size_t *count);
+
+AJSON_EXPORT int ajson_sink_write_null   (ajson_sink *sink);
+AJSON_EXPORT int ajson_sink_write_boolean(ajson_sink *sink, bool        value);
+AJSON_EXPORT int ajson_sink_write_number (ajson_sink *sink, double      value);
+AJSON_EXPORT int ajson_sink_write_integer(ajson_sink *sink, int64_t     value);
+AJSON_EXPORT int ajson_sink_write_string (ajson_sink *sink, const char* value, size_t length, enum ajson_encoding encoding);
+AJSON_EXPORT int ajson_sink_write_raw    (ajson_sink *sink, const void *fragment, size_t length);
+AJSON_EXPORT int ajson_sink_write_key    (ajson_sink *sink, size_t key);
+
+AJSON_EXPORT int ajson_sink_write_number_array (ajson_sink *sink, const double  *values, size_t count);
+AJSON_EXPORT int ajson_sink_write_integer_array(ajson_sink *sink, const int64_t *values, size_t count);
+AJSON_EXPORT int ajson_sink_write_string_array (ajson_sink *sink, const char *const *values, const size_t *lengths, size_t count, enum ajson_encoding encoding);
+
+AJSON_EXPORT int ajson_sink_write_begin_array (ajson_sink *sink);
+AJSON_EXPORT int ajson_sink_write_end_array   (ajson_sink *sink);
+AJSON_EXPORT int ajson_sink_write_begin_object(ajson_sink *sink);
+AJSON_EXPORT int ajson_sink_write_end_object  (ajson_sink *sink);
+
+struct ajson_emit_s {
+    unsigned char  head[9];      //!< @private
+    unsigned char  head_size;    //!< @private
+    unsigned char  head_written; //!< @private
+    const char    *payload;      //!< @private
+    const char    *payload_end;  //!< @private
+};
+
+struct ajson_cbor_writer_s {
+    struct ajson_emit_s emit;          //!< @private
+    char               *stack;         //!< @private
+    size_t              stack_size;    //!< @private
+    size_t              stack_current; //!< @private
+};
+
+typedef struct ajson_cbor_writer_s ajson_cbor_writer;
+
+AJSON_EXPORT int  ajson_cbor_writer_init   (ajson_cbor_writer *writer);
+AJSON_EXPORT void ajson_cbor_writer_reset  (ajson_cbor_writer *writer);
+AJSON_EXPORT void ajson_cbor_writer_destroy(ajson_cbor_writer *writer);
+
+AJSON_EXPORT ssize_t ajson_cbor_write_null        (ajson_cbor_writer *writer, void *buffer, size_t size);
+AJSON_EXPORT ssize_t ajson_cbor_write_boolean     (ajson_cbor_writer *writer, void *buffer, size_t size, bool        value);
+AJSON_EXPORT ssize_t ajson_cbor_write_number      (ajson_cbor_writer *writer, void *buffer, size_t size, double      value);
+AJSON_EXPORT ssize_t ajson_cbor_write_integer     (ajson_cbor_writer *writer, void *buffer, size_t size, int64_t     value);
+AJSON_EXPORT ssize_t ajson_cbor_write_string      (ajson_cbor_writer *writer, void *buffer, size_t size, const char* value, size_t length);
+AJSON_EXPORT ssize_t ajson_cbor_write_begin_array (ajson_cbor_writer *writer, void *buffer, size_t size);
+AJSON_EXPORT ssize_t ajson_cbor_write_end_array   (ajson_cbor_writer *writer, void *buffer, size_t size);
+AJSON_EXPORT ssize_t ajson_cbor_write_begin_object(ajson_cbor_writer *writer, void *buffer, size_t size);
+AJSON_EXPORT ssize_t ajson_cbor_write_end_object  (ajson_cbor_writer *writer, void *buffer, size_t size);
+AJSON_EXPORT ssize_t ajson_cbor_write_continue    (ajson_cbor_writer *writer, void *buffer, size_t size);
+
+AJSON_EXPORT ssize_t ajson_cbor_write_token(ajson_cbor_writer *writer, void *buffer, size_t size, const ajson_parser *parser, enum ajson_token token);
+
+struct ajson_msgpack_frame_s;
+
+struct ajson_msgpack_writer_s {
+    struct ajson_emit_s           emit;             //!< @private
+    struct ajson_msgpack_frame_s *stack;            //!< @private
+    size_t                        stack_size;       //!< @private
+    size_t                        stack_current;    //!< @private
+    unsigned char                *tokens;           //!< @private
+    size_t                        tokens_size;      //!< @private
+    size_t                        tokens_used;      //!< @private
+};
+
+typedef struct ajson_msgpack_writer_s ajson_msgpack_writer;
+
+AJSON_EXPORT int  ajson_msgpack_writer_init   (ajson_msgpack_writer *writer);
+AJSON_EXPORT void ajson_msgpack_writer_reset  (ajson_msgpack_writer *writer);
+AJSON_EXPORT void ajson_msgpack_writer_destroy(ajson_msgpack_writer *writer);
+
+AJSON_EXPORT ssize_t ajson_msgpack_write_null        (ajson_msgpack_writer *writer, void *buffer, size_t size);
+AJSON_EXPORT ssize_t ajson_msgpack_write_boolean     (ajson_msgpack_writer *writer, void *buffer, size_t size, bool        value);
+AJSON_EXPORT ssize_t ajson_msgpack_write_number      (ajson_msgpack_writer *writer, void *buffer, size_t size, double      value);
+AJSON_EXPORT ssize_t ajson_msgpack_write_integer     (ajson_msgpack_writer *writer, void *buffer, size_t size, int64_t     value);
+AJSON_EXPORT ssize_t ajson_msgpack_write_string      (ajson_msgpack_writer *writer, void *buffer, size_t size, const char* value, size_t length);
+AJSON_EXPORT ssize_t ajson_msgpack_write_begin_array (ajson_msgpack_writer *writer, void *buffer, size_t size, size_t count);
+AJSON_EXPORT ssize_t ajson_msgpack_write_end_array   (ajson_msgpack_writer *writer, void *buffer, size_t size);
+AJSON_EXPORT ssize_t ajson_msgpack_write_begin_object(ajson_msgpack_writer *writer, void *buffer, size_t size, size_t count);
+AJSON_EXPORT ssize_t ajson_msgpack_write_end_object  (ajson_msgpack_writer *writer, void *buffer, size_t size);
+AJSON_EXPORT ssize_t ajson_msgpack_write_continue    (ajson_msgpack_writer *writer, void *buffer, size_t size);
+
+AJSON_EXPORT ssize_t ajson_msgpack_write_token(ajson_msgpack_writer *writer, void *buffer, size_t size, const ajson_parser *parser, enum ajson_token token);
 
 AJSON_EXPORT int ajson_decode_utf8(const unsigned char buffer[], size_t size, uint32_t *codepoint);
 
@@ -0,0 +1,454 @@
+#ifndef AJSON_HPP__
+#define AJSON_HPP__
+#pragma once
+
+// Header-only C++17 wrapper around the C API. The classes own the C objects and
+// expose strings as std::string_view that refer to the parser's buffer, so they
+// are only valid until the next token is parsed.
+
+#include <cerrno>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine)
+#   include <coroutine>
+#   define AJSON_HAS_COROUTINES
+#endif
+
+#include "ajson.h"
+
+namespace ajson {
+
+typedef std::remove_reference_t<decltype(std::declval<ajson_parser>().value.components)> components;
+
+class parser {
+public:
+    explicit parser(int flags = AJSON_FLAGS_NONE, enum ajson_encoding encoding = AJSON_ENC_UTF8) {
+        if (ajson_init(&m_parser, flags, encoding) != 0) {
+            throw std::system_error(errno, std::generic_category(), "ajson_init");
+        }
+    }
+
+    ~parser() { ajson_destroy(&m_parser); }
+
+    // the C object may not be moved once it holds data
+    parser(const parser&) = delete;
+    parser& operator=(const parser&) = delete;
+
+    void reset() { ajson_reset(&m_parser); }
+
+    int feed(const void *buffer, size_t size) { return ajson_feed(&m_parser, buffer, size); }
+    int feed(std::string_view data) { return ajson_feed(&m_parser, data.data(), data.size()); }
+    int feed_eof() { return ajson_feed(&m_parser, "", 0); }
+
+    enum ajson_token next_token()     { return ajson_next_token(&m_parser); }
+    void             skip_value()     { ajson_skip_value(&m_parser); }
+    void             skip_container() { ajson_skip_container(&m_parser); }
+
+    int      add_filter(const char *pattern) { return ajson_add_filter(&m_parser, pattern); }
+    void     clear_filters()                 { ajson_clear_filters(&m_parser); }
+    uint64_t filter_matches() const          { return ajson_get_filter_matches(&m_parser); }
+
+    int flags() const { return m_parser.flags; }
+
+    bool    boolean() const { return m_parser.value.boolean; }
+    double  number()  const { return m_parser.value.number; }
+    int64_t integer() const { return m_parser.value.integer; }
+
+    // AJSON_TOK_STRING, or AJSON_TOK_NUMBER with AJSON_FLAG_NUMBER_AS_STRING
+    std::string_view string() const {
+        return std::string_view(m_parser.value.string.value, m_parser.value.string.length);
+    }
+
+    const ajson::components& number_components() const { return m_parser.value.components; }
+
+    enum ajson_error error() const { return m_parser.value.error.error; }
+
+    ajson_parser       *get()       { return &m_parser; }
+    const ajson_parser *get() const { return &m_parser; }
+
+private:
+    ajson_parser m_parser;
+};
+
+// Base class of visitors for parse(). It ignores all tokens, so a visitor only
+// defines the methods for the tokens it handles. Methods may return void or one
+// of AJSON_CB_CONTINUE, AJSON_CB_STOP and AJSON_CB_SKIP.
+struct visitor {
+    int null()                                { return AJSON_CB_CONTINUE; }
+    int boolean(bool)                         { return AJSON_CB_CONTINUE; }
+    int number(double)                        { return AJSON_CB_CONTINUE; }
+    int number_string(std::string_view)       { return AJSON_CB_CONTINUE; }
+    int number_components(const components&)  { return AJSON_CB_CONTINUE; }
+    int integer(int64_t)                      { return AJSON_CB_CONTINUE; }
+    int string(std::string_view)              { return AJSON_CB_CONTINUE; }
+    int begin_array()                         { return AJSON_CB_CONTINUE; }
+    int end_array()                           { return AJSON_CB_CONTINUE; }
+    int begin_object()                        { return AJSON_CB_CONTINUE; }
+    int end_object()                          { return AJSON_CB_CONTINUE; }
+    void end()                                {}
+    void error(enum ajson_error)               {}
+};
+
+namespace detail {
+
+template<typename Func>
+inline int visit(Func&& func) {
+    if constexpr (std::is_void_v<decltype(func())>) {
+        func();
+        return AJSON_CB_CONTINUE;
+    }
+    else {
+        return func();
+    }
+}
+
+}
+
+// Works like ajson_cb_dispatch() on the data fed to the parser so far, but calls
+// the methods of the visitor directly, so they can be inlined.
+// Returns 0 if all data was consumed or the end was reached, 1 if a method
+// returned AJSON_CB_STOP and -1 on error.
+template<typename Visitor>
+int parse(parser& parser, Visitor& visitor) {
+    const ajson_parser *state = parser.get();
+
+    for (;;) {
+        int result = AJSON_CB_CONTINUE;
+
+        switch (parser.next_token()) {
+        case AJSON_TOK_NULL:
+            result = detail::visit([&] { return visitor.null(); });
+            break;
+
+        case AJSON_TOK_BOOLEAN:
+            result = detail::visit([&] { return visitor.boolean(state->value.boolean); });
+            break;
+
+        case AJSON_TOK_NUMBER:
+            if (state->flags & AJSON_FLAG_NUMBER_AS_STRING) {
+                result = detail::visit([&] { return visitor.number_string(parser.string()); });
+            }
+            else if (state->flags & AJSON_FLAG_NUMBER_COMPONENTS) {
+                result = detail::visit([&] { return visitor.number_components(state->value.components); });
+            }
+            else {
+                result = detail::visit([&] { return visitor.number(state->value.number); });
+            }
+            break;
+
+        case AJSON_TOK_INTEGER:
+            result = detail::visit([&] { return visitor.integer(state->value.integer); });
+            break;
+
+        case AJSON_TOK_STRING:
+            result = detail::visit([&] { return visitor.string(parser.string()); });
+            break;
+
+        case AJSON_TOK_BEGIN_ARRAY:
+            result = detail::visit([&] { return visitor.begin_array(); });
+            break;
+
+        case AJSON_TOK_END_ARRAY:
+            result = detail::visit([&] { return visitor.end_array(); });
+            break;
+
+        case AJSON_TOK_BEGIN_OBJECT:
+            result = detail::visit([&] { return visitor.begin_object(); });
+            break;
+
+        case AJSON_TOK_END_OBJECT:
+            result = detail::visit([&] { return visitor.end_object(); });
+            break;
+
+        case AJSON_TOK_END:
+            visitor.end();
+            return 0;
+
+        case AJSON_TOK_ERROR:
+            visitor.error(state->value.error.error);
+            return -1;
+
+        case AJSON_TOK_NEED_DATA:
+            return 0;
+        }
+
+        if (result == AJSON_CB_STOP) {
+            return 1;
+        }
+        else if (result == AJSON_CB_SKIP) {
+            parser.skip_container();
+        }
+    }
+}
+
+// Parses a complete document.
+template<typename Visitor>
+int parse(parser& parser, Visitor& visitor, std::string_view document) {
+    if (parser.feed(document) != 0) {
+        return -1;
+    }
+
+    int status = parse(parser, visitor);
+    if (status != 0) {
+        return status;
+    }
+
+    if (parser.feed_eof() != 0) {
+        return -1;
+    }
+
+    return parse(parser, visitor);
+}
+
+class writer {
+public:
+    explicit writer(int flags = AJSON_WRITER_FLAGS_NONE, const char *indent = nullptr) {
+        if (ajson_writer_init(&m_writer, flags, indent) != 0) {
+            throw std::system_error(errno, std::generic_category(), "ajson_writer_init");
+        }
+    }
+
+    ~writer() { ajson_writer_destroy(&m_writer); }
+
+    writer(const writer&) = delete;
+    writer& operator=(const writer&) = delete;
+
+    void reset() { ajson_writer_reset(&m_writer); }
+
+    int set_decimals(int decimals) { return ajson_writer_set_decimals(&m_writer, decimals); }
+
+    // handle for write_key(), -1 on error (errno is set)
+    ssize_t register_key(std::string_view key, enum ajson_encoding encoding = AJSON_ENC_UTF8) {
+        return ajson_writer_register_key(&m_writer, key.data(), key.size(), encoding);
+    }
+
+    ssize_t write_null   (void *buffer, size_t size)                { return ajson_write_null   (&m_writer, buffer, size); }
+    ssize_t write_boolean(void *buffer, size_t size, bool    value) { return ajson_write_boolean(&m_writer, buffer, size, value); }
+    ssize_t write_number (void *buffer, size_t size, double  value) { return ajson_write_number (&m_writer, buffer, size, value); }
+    ssize_t write_integer(void *buffer, size_t size, int64_t value) { return ajson_write_integer(&m_writer, buffer, size, value); }
+
+    ssize_t write_string(void *buffer, size_t size, std::string_view value, enum ajson_encoding encoding = AJSON_ENC_UTF8) {
+        return ajson_write_string(&m_writer, buffer, size, value.data(), value.size(), encoding);
+    }
+
+    ssize_t write_raw(void *buffer, size_t size, std::string_view fragment) {
+        return ajson_write_raw(&m_writer, buffer, size, fragment.data(), fragment.size());
+    }
+
+    ssize_t write_key(void *buffer, size_t size, size_t key) { return ajson_write_key(&m_writer, buffer, size, key); }
+
+    ssize_t write_begin_array (void *buffer, size_t size) { return ajson_write_begin_array (&m_writer, buffer, size); }
+    ssize_t write_end_array   (void *buffer, size_t size) { return ajson_write_end_array   (&m_writer, buffer, size); }
+    ssize_t write_begin_object(void *buffer, size_t size) { return ajson_write_begin_object(&m_writer, buffer, size); }
+    ssize_t write_end_object  (void *buffer, size_t size) { return ajson_write_end_object  (&m_writer, buffer, size); }
+
+    ssize_t write_number_array (void *buffer, size_t size, const double  *values, size_t count) { return ajson_write_number_array (&m_writer, buffer, size, values, count); }
+    ssize_t write_integer_array(void *buffer, size_t size, const int64_t *values, size_t count) { return ajson_write_integer_array(&m_writer, buffer, size, values, count); }
+
+    ssize_t write_string_array(void *buffer, size_t size, const char *const *values, const size_t *lengths, size_t count, enum ajson_encoding encoding = AJSON_ENC_UTF8) {
+        return ajson_write_string_array(&m_writer, buffer, size, values, lengths, count, encoding);
+    }
+
+    ssize_t write_continue(void *buffer, size_t size) { return ajson_write_continue(&m_writer, buffer, size); }
+
+    int         flags()    { return ajson_writer_get_flags(&m_writer); }
+    const char *indent()   { return ajson_writer_get_indent(&m_writer); }
+    int         decimals() { return ajson_writer_get_decimals(&m_writer); }
+
+    ajson_writer       *get()       { return &m_writer; }
+    const ajson_writer *get() const { return &m_writer; }
+
+private:
+    ajson_writer m_writer;
+};
+
+#ifdef AJSON_HAS_COROUTINES
+// C++20 coroutine adapters. A coroutine that awaits a token or a write is
+// suspended until the I/O layer fed more data or drained the output buffer.
+// After starting or resuming such a coroutine the I/O layer checks waiting() to
+// see whether it has to read or write before the coroutine can continue.
+// Nothing is allocated, the coroutine type is up to the caller.
+
+class token_stream {
+public:
+    explicit token_stream(ajson::parser& parser) : m_parser(parser), m_token(AJSON_TOK_NEED_DATA), m_fed(false) {}
+
+    token_stream(const token_stream&) = delete;
+    token_stream& operator=(const token_stream&) = delete;
+
+    class awaiter {
+    public:
+        explicit awaiter(token_stream& stream) : m_stream(stream) {}
+
+        bool await_ready() {
+            if (!m_stream.m_fed) {
+                // the parser takes a missing chunk as the end of the input
+                return false;
+            }
+            m_stream.m_token = m_stream.m_parser.next_token();
+            return m_stream.m_token != AJSON_TOK_NEED_DATA;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) { m_stream.m_waiting = handle; }
+
+        enum ajson_token await_resume() const { return m_stream.m_token; }
+
+    private:
+        token_stream& m_stream;
+    };
+
+    // co_await next() gives the next token, never AJSON_TOK_NEED_DATA
+    awaiter next() { return awaiter(*this); }
+
+    ajson::parser& parser() { return m_parser; }
+
+    // a coroutine waits for data
+    bool waiting() const { return static_cast<bool>(m_waiting); }
+
+    // Feeds data and resumes the waiting coroutine once it completes a token.
+    // The coroutine runs until it waits again, so the data is consumed when this
+    // returns, unless the coroutine stopped pulling tokens.
+    int feed(const void *buffer, size_t size) {
+        if (m_parser.feed(buffer, size) != 0) {
+            return -1;
+        }
+        m_fed = true;
+        resume();
+        return 0;
+    }
+
+    int feed(std::string_view data) { return feed(data.data(), data.size()); }
+    int feed_eof() { return feed("", 0); }
+
+private:
+    void resume() {
+        if (m_waiting) {
+            m_token = m_parser.next_token();
+            if (m_token != AJSON_TOK_NEED_DATA) {
+                std::coroutine_handle<> handle = m_waiting;
+                m_waiting = nullptr;
+                handle.resume();
+            }
+        }
+    }
+
+    ajson::parser&          m_parser;
+    enum ajson_token        m_token;
+    bool                    m_fed;
+    std::coroutine_handle<> m_waiting;
+};
+
+// Writes into a caller supplied buffer. A write that fills the buffer suspends
+// the coroutine until the I/O layer wrote data() and called drained(), which
+// continues the write with ajson_write_continue().
+class writer_sink {
+public:
+    writer_sink(ajson::writer& writer, void *buffer, size_t size) :
+        m_writer(writer), m_buffer(static_cast<char*>(buffer)), m_size(size), m_used(0),
+        m_continue(false), m_error(false) {}
+
+    writer_sink(const writer_sink&) = delete;
+    writer_sink& operator=(const writer_sink&) = delete;
+
+    class awaiter {
+    public:
+        awaiter(writer_sink& sink, bool ready) : m_sink(sink), m_ready(ready) {}
+
+        bool await_ready() const { return m_ready; }
+        void await_suspend(std::coroutine_handle<> handle) { m_sink.m_waiting = handle; }
+
+        // 0 on success, -1 on error (errno is set)
+        int await_resume() const { return m_sink.m_error ? -1 : 0; }
+
+    private:
+        writer_sink& m_sink;
+        bool         m_ready;
+    };
+
+    awaiter write_null()                 { return wrote(ajson_write_null   (m_writer.get(), free_space(), free_size())); }
+    awaiter write_boolean(bool    value) { return wrote(ajson_write_boolean(m_writer.get(), free_space(), free_size(), value)); }
+    awaiter write_number (double  value) { return wrote(ajson_write_number (m_writer.get(), free_space(), free_size(), value)); }
+    awaiter write_integer(int64_t value) { return wrote(ajson_write_integer(m_writer.get(), free_space(), free_size(), value)); }
+
+    awaiter write_string(std::string_view value, enum ajson_encoding encoding = AJSON_ENC_UTF8) {
+        return wrote(ajson_write_string(m_writer.get(), free_space(), free_size(), value.data(), value.size(), encoding));
+    }
+
+    awaiter write_raw(std::string_view fragment) {
+        return wrote(ajson_write_raw(m_writer.get(), free_space(), free_size(), fragment.data(), fragment.size()));
+    }
+
+    awaiter write_key(size_t key) { return wrote(ajson_write_key(m_writer.get(), free_space(), free_size(), key)); }
+
+    awaiter write_begin_array () { return wrote(ajson_write_begin_array (m_writer.get(), free_space(), free_size())); }
+    awaiter write_end_array   () { return wrote(ajson_write_end_array   (m_writer.get(), free_space(), free_size())); }
+    awaiter write_begin_object() { return wrote(ajson_write_begin_object(m_writer.get(), free_space(), free_size())); }
+    awaiter write_end_object  () { return wrote(ajson_write_end_object  (m_writer.get(), free_space(), free_size())); }
+
+    // waits until all buffered output was drained
+    awaiter flush() { return awaiter(*this, m_error || m_used == 0); }
+
+    // a coroutine waits for the buffer to be drained
+    bool waiting() const { return static_cast<bool>(m_waiting); }
+
+    const char *data() const { return m_buffer; }
+    size_t      size() const { return m_used; }
+
+    // Called by the I/O layer after data() was written. Resumes the waiting
+    // coroutine unless the continued write filled the buffer again.
+    void drained() {
+        m_used = 0;
+
+        if (m_continue) {
+            ssize_t count = ajson_write_continue(m_writer.get(), m_buffer, m_size);
+            if (count < 0) {
+                m_error = true;
+            }
+            else {
+                m_used = static_cast<size_t>(count);
+                if (m_used == m_size) {
+                    return;
+                }
+            }
+            m_continue = false;
+        }
+
+        if (m_waiting) {
+            std::coroutine_handle<> handle = m_waiting;
+            m_waiting = nullptr;
+            handle.resume();
+        }
+    }
+
+private:
+    char  *free_space() const { return m_buffer + m_used; }
+    size_t free_size()  const { return m_size - m_used; }
+
+    awaiter wrote(ssize_t count) {
+        if (count < 0) {
+            m_error = true;
+            return awaiter(*this, true);
+        }
+
+        // a full buffer might not hold all of the value
+        m_used += static_cast<size_t>(count);
+        m_continue = m_used == m_size;
+        return awaiter(*this, !m_continue);
+    }
+
+    ajson::writer&          m_writer;
+    char                   *m_buffer;
+    size_t                  m_size;
+    size_t                  m_used;
+    bool                    m_continue;
+    bool                    m_error;
+    std::coroutine_handle<> m_waiting;
+};
+#endif
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "ajson.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#define AJSON_ARENA_ALIGN 16
+
+struct ajson_arena_chunk_s {
+    struct ajson_arena_chunk_s *next;
+    size_t                      size;
+    size_t                      used;
+};
+
+// chunk data starts after the aligned header
+#define AJSON_ARENA_HEADER_SIZE \
+    ((sizeof(struct ajson_arena_chunk_s) + AJSON_ARENA_ALIGN - 1) & ~(size_t)(AJSON_ARENA_ALIGN - 1))
+
+#define AJSON_ARENA_DATA(CHUNK) ((char*)(CHUNK) + AJSON_ARENA_HEADER_SIZE)
+
+void ajson_arena_init(ajson_arena *arena, size_t chunk_size) {
+    arena->chunk      = NULL;
+    arena->chunk_size = chunk_size ? chunk_size : AJSON_ARENA_CHUNK_SIZE;
+}
+
+void ajson_arena_clear(ajson_arena *arena) {
+    struct ajson_arena_chunk_s *chunk = arena->chunk;
+
+    // keep the last chunk if it is a regular one so it can be reused
+    if (chunk && chunk->size == arena->chunk_size) {
+        chunk->used = 0;
+        chunk = chunk->next;
+        arena->chunk->next = NULL;
+    }
+    else {
+        arena->chunk = NULL;
+    }
+
+    while (chunk) {
+        struct ajson_arena_chunk_s *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void ajson_arena_destroy(ajson_arena *arena) {
+    ajson_arena_clear(arena);
+    free(arena->chunk);
+    arena->chunk = NULL;
+}
+
+void *ajson_arena_alloc(ajson_arena *arena, size_t size) {
+    struct ajson_arena_chunk_s *chunk = arena->chunk;
+
+    if (size > SIZE_MAX - AJSON_ARENA_HEADER_SIZE - AJSON_ARENA_ALIGN) {
+        return NULL;
+    }
+    size = (size + AJSON_ARENA_ALIGN - 1) & ~(size_t)(AJSON_ARENA_ALIGN - 1);
+
+    if (chunk && chunk->size - chunk->used >= size) {
+        void *ptr = AJSON_ARENA_DATA(chunk) + chunk->used;
+        chunk->used += size;
+        return ptr;
+    }
+
+    if (size > arena->chunk_size / 4) {
+        // big allocations get a chunk of their own behind the current one, so
+        // the space left in the current chunk is not wasted
+        struct ajson_arena_chunk_s *big = malloc(AJSON_ARENA_HEADER_SIZE + size);
+        if (big == NULL) {
+            return NULL;
+        }
+        big->size = big->used = size;
+        if (chunk) {
+            big->next   = chunk->next;
+            chunk->next = big;
+        }
+        else {
+            big->next    = NULL;
+            arena->chunk = big;
+        }
+        return AJSON_ARENA_DATA(big);
+    }
+
+    struct ajson_arena_chunk_s *next = malloc(AJSON_ARENA_HEADER_SIZE + arena->chunk_size);
+    if (next == NULL) {
+        return NULL;
+    }
+    next->next   = chunk;
+    next->size   = arena->chunk_size;
+    next->used   = size;
+    arena->chunk = next;
+
+    return AJSON_ARENA_DATA(next);
+}
+
+char *ajson_arena_strndup(ajson_arena *arena, const char *str, size_t length) {
+    if (length == SIZE_MAX) {
+        return NULL;
+    }
+
+    char *copy = ajson_arena_alloc(arena, length + 1);
+    if (copy) {
+        memcpy(copy, str, length);
+        copy[length] = 0;
+    }
+
+    return copy;
+}
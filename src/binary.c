@@ -0,0 +1,584 @@
+#include "ajson.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// File layout (host byte order, everything 8 byte aligned):
+//
+//   header:  "AJSONBIN", uint32 version, uint32 byte order mark, uint64 file size,
+//            root value
+//   value:   uint32 type, uint32 unused, 8 byte scalar or offset of the data
+//            relative to the value itself
+//   string:  uint64 length, bytes, '\0'
+//   array:   uint64 count, value[count]
+//   object:  uint64 count, member[count] in input order,
+//            uint32 index[count] of the members sorted by key (length, bytes)
+//   member:  uint64 offset of key string relative to the member, value
+//
+// Because all offsets are relative the file can be mapped at any address.
+
+#define AJSON_BINARY_MAGIC      "AJSONBIN"
+#define AJSON_BINARY_BYTE_ORDER UINT32_C(0x01020304)
+#define AJSON_BINARY_ALIGN(SIZE) (((SIZE) + 7) & ~(size_t)7)
+
+struct ajson_binary_header_s {
+    char               magic[8];
+    uint32_t           version;
+    uint32_t           byte_order;
+    uint64_t           size;
+    ajson_binary_value root;
+};
+
+struct ajson_binary_member_s {
+    uint64_t           key;
+    ajson_binary_value value;
+};
+
+struct ajson_binary_sort_s {
+    const char *key;
+    size_t      length;
+    uint32_t    index;
+};
+
+struct ajson_binary_encoder_s {
+    char  *data;
+    size_t used;
+};
+
+static inline const char *ajson_binary_data(const void *base, uint64_t offset) {
+    return (const char *)base + offset;
+}
+
+static inline size_t ajson_binary_string_size(size_t length) {
+    return AJSON_BINARY_ALIGN(sizeof(uint64_t) + length + 1);
+}
+
+static inline size_t ajson_binary_object_size(size_t count) {
+    return sizeof(uint64_t) + count * sizeof(struct ajson_binary_member_s) + AJSON_BINARY_ALIGN(count * sizeof(uint32_t));
+}
+
+static int ajson_binary_key_compare(const char *key1, size_t length1, const char *key2, size_t length2) {
+    if (length1 != length2) {
+        return length1 < length2 ? -1 : 1;
+    }
+    return memcmp(key1, key2, length1);
+}
+
+static int ajson_binary_sort_compare(const void *ptr1, const void *ptr2) {
+    const struct ajson_binary_sort_s *sort1 = ptr1;
+    const struct ajson_binary_sort_s *sort2 = ptr2;
+
+    int cmp = ajson_binary_key_compare(sort1->key, sort1->length, sort2->key, sort2->length);
+    if (cmp != 0) {
+        return cmp;
+    }
+
+    // duplicate keys: the first one is found
+    return sort1->index < sort2->index ? -1 : sort1->index > sort2->index;
+}
+
+// ========== Encoder ==========
+
+// Both passes walk the tree with a stack on the heap, so the nesting depth is
+// only limited by memory (like for the DOM the value was built with).
+struct ajson_binary_frame_s {
+    const ajson_value *value; // array or object
+    size_t             data;  // offset of its data in the output
+    size_t             index; // next item
+};
+
+struct ajson_binary_stack_s {
+    struct ajson_binary_frame_s *frames;
+    size_t                       size;
+    size_t                       current;
+};
+
+static int ajson_binary_push(struct ajson_binary_stack_s *stack, const ajson_value *value, size_t data) {
+    if (stack->current == stack->size) {
+        size_t newsize = stack->size ? stack->size * 2 : AJSON_STACK_SIZE;
+        struct ajson_binary_frame_s *newframes = newsize > SIZE_MAX / sizeof(struct ajson_binary_frame_s) ? NULL :
+            realloc(stack->frames, newsize * sizeof(struct ajson_binary_frame_s));
+
+        if (newframes == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        stack->frames = newframes;
+        stack->size   = newsize;
+    }
+
+    struct ajson_binary_frame_s *frame = stack->frames + stack->current ++;
+    frame->value = value;
+    frame->data  = data;
+    frame->index = 0;
+
+    return 0;
+}
+
+static inline bool ajson_binary_is_container(const ajson_value *value) {
+    return value->type == AJSON_TOK_BEGIN_ARRAY || value->type == AJSON_TOK_BEGIN_OBJECT;
+}
+
+static inline size_t ajson_binary_count(const ajson_value *container) {
+    return container->type == AJSON_TOK_BEGIN_ARRAY ? container->value.array.count : container->value.object.count;
+}
+
+// size of the data of the value itself, without the data of its items
+static size_t ajson_binary_node_size(const ajson_value *value) {
+    switch (value->type) {
+    case AJSON_TOK_STRING:
+        return ajson_binary_string_size(value->value.string.length);
+
+    case AJSON_TOK_BEGIN_ARRAY:
+        return sizeof(uint64_t) + value->value.array.count * sizeof(ajson_binary_value);
+
+    case AJSON_TOK_BEGIN_OBJECT:
+        return ajson_binary_object_size(value->value.object.count);
+
+    default:
+        return 0;
+    }
+}
+
+static int ajson_binary_data_size(struct ajson_binary_stack_s *stack, const ajson_value *root, size_t *total) {
+    size_t size = ajson_binary_node_size(root);
+
+    stack->current = 0;
+    if (ajson_binary_is_container(root) && ajson_binary_push(stack, root, 0) != 0) {
+        return -1;
+    }
+
+    while (stack->current > 0) {
+        struct ajson_binary_frame_s *frame = stack->frames + stack->current - 1;
+        const ajson_value *container = frame->value;
+
+        if (frame->index == ajson_binary_count(container)) {
+            -- stack->current;
+            continue;
+        }
+
+        const ajson_value *item;
+        if (container->type == AJSON_TOK_BEGIN_ARRAY) {
+            item = container->value.array.items + frame->index;
+        }
+        else {
+            const ajson_member *member = container->value.object.members + frame->index;
+            size += ajson_binary_string_size(member->key_length);
+            item = &member->value;
+        }
+        ++ frame->index;
+
+        size += ajson_binary_node_size(item);
+        if (ajson_binary_is_container(item) && ajson_binary_push(stack, item, 0) != 0) {
+            return -1;
+        }
+    }
+
+    *total = size;
+    return 0;
+}
+
+static uint64_t ajson_binary_put_string(struct ajson_binary_encoder_s *encoder, const char *string, size_t length) {
+    size_t offset = encoder->used;
+    uint64_t length64 = length;
+
+    memcpy(encoder->data + offset, &length64, sizeof(length64));
+    memcpy(encoder->data + offset + sizeof(length64), string, length);
+    encoder->used += ajson_binary_string_size(length);
+
+    return offset;
+}
+
+// Writes the value at offset. The data of arrays and objects is reserved (and the
+// key index of objects is written), its offset is returned in *data and the items
+// are written by the caller.
+static int ajson_binary_put_node(struct ajson_binary_encoder_s *encoder, size_t offset, const ajson_value *value, size_t *data) {
+    ajson_binary_value *node = (ajson_binary_value *)(encoder->data + offset);
+
+    node->type = value->type;
+
+    switch (value->type) {
+    case AJSON_TOK_BOOLEAN:
+        node->value.boolean = value->value.boolean;
+        break;
+
+    case AJSON_TOK_NUMBER:
+        node->value.number = value->value.number;
+        break;
+
+    case AJSON_TOK_INTEGER:
+        node->value.integer = value->value.integer;
+        break;
+
+    case AJSON_TOK_STRING:
+        *data = ajson_binary_put_string(encoder, value->value.string.value, value->value.string.length);
+        node->value.offset = *data - offset;
+        break;
+
+    case AJSON_TOK_BEGIN_ARRAY:
+    {
+        const size_t count = value->value.array.count;
+
+        *data = encoder->used;
+        encoder->used += sizeof(uint64_t) + count * sizeof(ajson_binary_value);
+        node->value.offset = *data - offset;
+        *(uint64_t *)(encoder->data + *data) = count;
+        break;
+    }
+    case AJSON_TOK_BEGIN_OBJECT:
+    {
+        const size_t count = value->value.object.count;
+
+        if (count > UINT32_MAX) {
+            errno = EOVERFLOW;
+            return -1;
+        }
+
+        *data = encoder->used;
+        encoder->used += ajson_binary_object_size(count);
+        node->value.offset = *data - offset;
+        *(uint64_t *)(encoder->data + *data) = count;
+
+        uint32_t *index = (uint32_t *)(encoder->data + *data + sizeof(uint64_t) + count * sizeof(struct ajson_binary_member_s));
+
+        if (count > 0) {
+            struct ajson_binary_sort_s *sort = malloc(count * sizeof(struct ajson_binary_sort_s));
+            if (sort == NULL) {
+                return -1;
+            }
+
+            for (size_t i = 0; i < count; ++ i) {
+                sort[i].key    = value->value.object.members[i].key;
+                sort[i].length = value->value.object.members[i].key_length;
+                sort[i].index  = i;
+            }
+            qsort(sort, count, sizeof(struct ajson_binary_sort_s), ajson_binary_sort_compare);
+
+            for (size_t i = 0; i < count; ++ i) {
+                index[i] = sort[i].index;
+            }
+            free(sort);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+// Writes the items of a container before its next sibling, so the data is laid
+// out in document order.
+static int ajson_binary_put(struct ajson_binary_encoder_s *encoder, struct ajson_binary_stack_s *stack, size_t offset, const ajson_value *root) {
+    size_t data = 0;
+
+    stack->current = 0;
+    if (ajson_binary_put_node(encoder, offset, root, &data) != 0 ||
+        (ajson_binary_is_container(root) && ajson_binary_push(stack, root, data) != 0)) {
+        return -1;
+    }
+
+    while (stack->current > 0) {
+        struct ajson_binary_frame_s *frame = stack->frames + stack->current - 1;
+        const ajson_value *container = frame->value;
+
+        if (frame->index == ajson_binary_count(container)) {
+            -- stack->current;
+            continue;
+        }
+
+        const size_t i = frame->index ++;
+        const ajson_value *item;
+        size_t slot;
+
+        if (container->type == AJSON_TOK_BEGIN_ARRAY) {
+            item = container->value.array.items + i;
+            slot = frame->data + sizeof(uint64_t) + i * sizeof(ajson_binary_value);
+        }
+        else {
+            const ajson_member *member = container->value.object.members + i;
+            const size_t entry = frame->data + sizeof(uint64_t) + i * sizeof(struct ajson_binary_member_s);
+            const uint64_t key = ajson_binary_put_string(encoder, member->key, member->key_length);
+
+            ((struct ajson_binary_member_s *)(encoder->data + entry))->key = key - entry;
+
+            item = &member->value;
+            slot = entry + offsetof(struct ajson_binary_member_s, value);
+        }
+
+        if (ajson_binary_put_node(encoder, slot, item, &data) != 0 ||
+            (ajson_binary_is_container(item) && ajson_binary_push(stack, item, data) != 0)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int ajson_binary_encode(const ajson_value *value, void **buffer, size_t *size) {
+    if (value == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct ajson_binary_encoder_s encoder;
+    struct ajson_binary_stack_s   stack = { NULL, 0, 0 };
+    size_t                        total = 0;
+
+    if (ajson_binary_data_size(&stack, value, &total) != 0) {
+        free(stack.frames);
+        return -1;
+    }
+    total += sizeof(struct ajson_binary_header_s);
+
+    // zeroed, so padding is deterministic
+    encoder.data = calloc(1, total);
+    encoder.used = sizeof(struct ajson_binary_header_s);
+
+    if (encoder.data == NULL) {
+        free(stack.frames);
+        return -1;
+    }
+
+    struct ajson_binary_header_s *header = (struct ajson_binary_header_s *)encoder.data;
+    memcpy(header->magic, AJSON_BINARY_MAGIC, sizeof(header->magic));
+    header->version    = AJSON_BINARY_VERSION;
+    header->byte_order = AJSON_BINARY_BYTE_ORDER;
+    header->size       = total;
+
+    if (ajson_binary_put(&encoder, &stack, offsetof(struct ajson_binary_header_s, root), value) != 0) {
+        int errnum = errno;
+        free(stack.frames);
+        free(encoder.data);
+        errno = errnum;
+        return -1;
+    }
+    free(stack.frames);
+
+    *buffer = encoder.data;
+    *size   = total;
+
+    return 0;
+}
+
+int ajson_binary_write_fd(const ajson_value *value, int fd) {
+    void  *buffer = NULL;
+    size_t size   = 0;
+
+    if (ajson_binary_encode(value, &buffer, &size) != 0) {
+        return -1;
+    }
+
+    const char *ptr = buffer;
+    while (size > 0) {
+        ssize_t count = write(fd, ptr, size);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            free(buffer);
+            return -1;
+        }
+        ptr  += count;
+        size -= (size_t)count;
+    }
+
+    free(buffer);
+    return 0;
+}
+
+// ========== Loader ==========
+
+int ajson_binary_load(ajson_binary *bin, const void *buffer, size_t size) {
+    const struct ajson_binary_header_s *header = buffer;
+
+    if (buffer == NULL || ((uintptr_t)buffer & 7) != 0 ||
+        size < sizeof(struct ajson_binary_header_s) ||
+        memcmp(header->magic, AJSON_BINARY_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version    != AJSON_BINARY_VERSION ||
+        header->byte_order != AJSON_BINARY_BYTE_ORDER ||
+        header->size       != size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    bin->data   = buffer;
+    bin->size   = size;
+    bin->mapped = false;
+
+    return 0;
+}
+
+int ajson_binary_open_fd(ajson_binary *bin, int fd) {
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+
+    if (st.st_size < (off_t)sizeof(struct ajson_binary_header_s) || (uint64_t)st.st_size > SIZE_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const size_t size = (size_t)st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+
+    if (ajson_binary_load(bin, data, size) != 0) {
+        munmap(data, size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    bin->mapped = true;
+
+    return 0;
+}
+
+int ajson_binary_open(ajson_binary *bin, const char *filename) {
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    int status = ajson_binary_open_fd(bin, fd);
+    int errnum = errno;
+
+    // the mapping stays valid
+    close(fd);
+    errno = errnum;
+
+    return status;
+}
+
+void ajson_binary_close(ajson_binary *bin) {
+    if (bin->mapped) {
+        munmap((void *)bin->data, bin->size);
+    }
+
+    bin->data   = NULL;
+    bin->size   = 0;
+    bin->mapped = false;
+}
+
+const ajson_binary_value *ajson_binary_root(const ajson_binary *bin) {
+    if (bin->data == NULL) {
+        return NULL;
+    }
+
+    return &((const struct ajson_binary_header_s *)bin->data)->root;
+}
+
+// ========== Access ==========
+
+size_t ajson_binary_size(const ajson_binary_value *value) {
+    if (value == NULL) {
+        return 0;
+    }
+
+    switch (value->type) {
+    case AJSON_TOK_STRING:
+    case AJSON_TOK_BEGIN_ARRAY:
+    case AJSON_TOK_BEGIN_OBJECT:
+        return *(const uint64_t *)ajson_binary_data(value, value->value.offset);
+
+    default:
+        return 0;
+    }
+}
+
+const char *ajson_binary_string(const ajson_binary_value *value) {
+    if (value == NULL || value->type != AJSON_TOK_STRING) {
+        return NULL;
+    }
+
+    return ajson_binary_data(value, value->value.offset) + sizeof(uint64_t);
+}
+
+const ajson_binary_value *ajson_binary_at(const ajson_binary_value *container, size_t index) {
+    if (container == NULL || index >= ajson_binary_size(container)) {
+        return NULL;
+    }
+
+    const char *data = ajson_binary_data(container, container->value.offset) + sizeof(uint64_t);
+
+    switch (container->type) {
+    case AJSON_TOK_BEGIN_ARRAY:
+        return (const ajson_binary_value *)data + index;
+
+    case AJSON_TOK_BEGIN_OBJECT:
+        return &((const struct ajson_binary_member_s *)data)[index].value;
+
+    default:
+        return NULL;
+    }
+}
+
+const char *ajson_binary_key_at(const ajson_binary_value *object, size_t index, size_t *length) {
+    if (object == NULL || object->type != AJSON_TOK_BEGIN_OBJECT || index >= ajson_binary_size(object)) {
+        return NULL;
+    }
+
+    const struct ajson_binary_member_s *member =
+        (const struct ajson_binary_member_s *)(ajson_binary_data(object, object->value.offset) + sizeof(uint64_t)) + index;
+    const char *key = ajson_binary_data(member, member->key);
+
+    if (length) {
+        *length = *(const uint64_t *)key;
+    }
+
+    return key + sizeof(uint64_t);
+}
+
+const ajson_binary_value *ajson_binary_get(const ajson_binary_value *object, const char *key) {
+    return ajson_binary_get_key(object, key, strlen(key));
+}
+
+const ajson_binary_value *ajson_binary_get_key(const ajson_binary_value *object, const char *key, size_t length) {
+    if (object == NULL || object->type != AJSON_TOK_BEGIN_OBJECT) {
+        return NULL;
+    }
+
+    const char *data = ajson_binary_data(object, object->value.offset);
+    const size_t count = *(const uint64_t *)data;
+    const struct ajson_binary_member_s *members = (const struct ajson_binary_member_s *)(data + sizeof(uint64_t));
+    const uint32_t *index = (const uint32_t *)(members + count);
+
+    // lower bound, so the first of duplicate keys is found
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const struct ajson_binary_member_s *member = members + index[mid];
+        const char *member_key = ajson_binary_data(member, member->key);
+
+        if (ajson_binary_key_compare(member_key + sizeof(uint64_t), *(const uint64_t *)member_key, key, length) < 0) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    if (low < count) {
+        const struct ajson_binary_member_s *member = members + index[low];
+        const char *member_key = ajson_binary_data(member, member->key);
+
+        if (ajson_binary_key_compare(member_key + sizeof(uint64_t), *(const uint64_t *)member_key, key, length) == 0) {
+            return &member->value;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,291 @@
+#include "ajson.h"
+#include "input.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+struct ajson_bind_s {
+    struct ajson_input_s input;
+    ajson_arena         *arena;
+};
+
+// Returns the next token and reads more input when needed. I/O errors are
+// returned as AJSON_TOK_NEED_DATA.
+static enum ajson_token ajson_bind_next(struct ajson_bind_s *bind) {
+    for (;;) {
+        enum ajson_token token = ajson_next_token(bind->input.parser);
+
+        if (token != AJSON_TOK_NEED_DATA || ajson_input_read(&bind->input) != 0) {
+            return token;
+        }
+    }
+}
+
+static size_t ajson_bind_type_size(enum ajson_type type, const ajson_struct *object) {
+    switch (type) {
+    case AJSON_TYPE_BOOLEAN: return sizeof(bool);
+    case AJSON_TYPE_INT:     return sizeof(int);
+    case AJSON_TYPE_INT64:   return sizeof(int64_t);
+    case AJSON_TYPE_DOUBLE:  return sizeof(double);
+    case AJSON_TYPE_STRING:  return sizeof(const char*);
+    case AJSON_TYPE_OBJECT:  return object ? object->size : 0;
+    default:                 return 0;
+    }
+}
+
+static int ajson_bind_object(struct ajson_bind_s *bind, const ajson_struct *desc, void *target);
+
+// Binds a value of any type but AJSON_TYPE_ARRAY. The first token of the value
+// was already read.
+static int ajson_bind_value(struct ajson_bind_s *bind, enum ajson_type type, const ajson_struct *object, void *target, enum ajson_token token) {
+    ajson_parser *parser = bind->input.parser;
+
+    if (token == AJSON_TOK_NULL) {
+        // keep the default
+        return 0;
+    }
+
+    switch (type) {
+    case AJSON_TYPE_BOOLEAN:
+        if (token == AJSON_TOK_BOOLEAN) {
+            *(bool*)target = parser->value.boolean;
+            return 0;
+        }
+        break;
+
+    case AJSON_TYPE_INT:
+    case AJSON_TYPE_INT64:
+    {
+        int64_t value;
+        if (token == AJSON_TOK_INTEGER) {
+            value = parser->value.integer;
+        }
+        else if (token == AJSON_TOK_NUMBER) {
+            double number = parser->value.number;
+            if (!(number >= -9223372036854775808.0 && number < 9223372036854775808.0) || (double)(int64_t)number != number) {
+                break;
+            }
+            value = (int64_t)number;
+        }
+        else {
+            break;
+        }
+
+        if (type == AJSON_TYPE_INT64) {
+            *(int64_t*)target = value;
+        }
+        else if (value < INT_MIN || value > INT_MAX) {
+            AJSON_SET_ERROR(parser, AJSON_ERROR_PARSER_RANGE);
+            return -1;
+        }
+        else {
+            *(int*)target = (int)value;
+        }
+        return 0;
+    }
+    case AJSON_TYPE_DOUBLE:
+        if (token == AJSON_TOK_NUMBER) {
+            *(double*)target = parser->value.number;
+            return 0;
+        }
+        else if (token == AJSON_TOK_INTEGER) {
+            *(double*)target = (double)parser->value.integer;
+            return 0;
+        }
+        break;
+
+    case AJSON_TYPE_STRING:
+        if (token == AJSON_TOK_STRING) {
+            char *copy = ajson_arena_strndup(bind->arena, parser->value.string.value, parser->value.string.length);
+            if (copy == NULL) {
+                AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+                return -1;
+            }
+            *(const char**)target = copy;
+            return 0;
+        }
+        break;
+
+    case AJSON_TYPE_OBJECT:
+        if (token == AJSON_TOK_BEGIN_OBJECT && object) {
+            return ajson_bind_object(bind, object, target);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if (token != AJSON_TOK_ERROR && token != AJSON_TOK_NEED_DATA) {
+        AJSON_SET_ERROR(parser, AJSON_ERROR_BIND_TYPE);
+    }
+    return -1;
+}
+
+static int ajson_bind_array(struct ajson_bind_s *bind, const ajson_field *field, void *target, enum ajson_token token) {
+    ajson_parser *parser = bind->input.parser;
+
+    if (token == AJSON_TOK_NULL) {
+        return 0;
+    }
+
+    const size_t item_size = ajson_bind_type_size(field->item_type, field->object);
+    if (token != AJSON_TOK_BEGIN_ARRAY || item_size == 0) {
+        if (token != AJSON_TOK_ERROR && token != AJSON_TOK_NEED_DATA) {
+            AJSON_SET_ERROR(parser, AJSON_ERROR_BIND_TYPE);
+        }
+        return -1;
+    }
+
+    // The number of items is only known at the end, so collect them in a
+    // temporary buffer before they are copied into the arena.
+    char  *items    = NULL;
+    size_t count    = 0;
+    size_t capacity = 0;
+
+    for (;;) {
+        token = ajson_bind_next(bind);
+
+        if (token == AJSON_TOK_END_ARRAY) {
+            break;
+        }
+
+        if (count == capacity) {
+            size_t newcapacity = capacity ? capacity * 2 : 8;
+            char  *newitems = newcapacity > SIZE_MAX / item_size ? NULL : realloc(items, newcapacity * item_size);
+            if (newitems == NULL) {
+                free(items);
+                AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+                return -1;
+            }
+            items    = newitems;
+            capacity = newcapacity;
+        }
+
+        char *item = items + count * item_size;
+        memset(item, 0, item_size);
+
+        if (ajson_bind_value(bind, field->item_type, field->object, item, token) != 0) {
+            free(items);
+            return -1;
+        }
+        ++ count;
+    }
+
+    void *copy = NULL;
+    if (count) {
+        copy = ajson_arena_alloc(bind->arena, count * item_size);
+        if (copy == NULL) {
+            free(items);
+            AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+            return -1;
+        }
+        memcpy(copy, items, count * item_size);
+    }
+    free(items);
+
+    *(void**)((char*)target + field->offset) = copy;
+    *(size_t*)((char*)target + field->count_offset) = count;
+
+    return 0;
+}
+
+static int ajson_bind_object(struct ajson_bind_s *bind, const ajson_struct *desc, void *target) {
+    ajson_parser *parser = bind->input.parser;
+
+    for (;;) {
+        enum ajson_token token = ajson_bind_next(bind);
+
+        if (token == AJSON_TOK_END_OBJECT) {
+            return 0;
+        }
+        else if (token != AJSON_TOK_STRING) {
+            return -1;
+        }
+
+        const char  *key    = parser->value.string.value;
+        const size_t length = parser->value.string.length;
+        const ajson_field *field = NULL;
+
+        for (size_t i = 0; i < desc->field_count; ++ i) {
+            const ajson_field *candidate = desc->fields + i;
+            if (strlen(candidate->key) == length && memcmp(candidate->key, key, length) == 0) {
+                field = candidate;
+                break;
+            }
+        }
+
+        if (field == NULL) {
+            // unknown keys are skipped by the tokenizer
+            ajson_skip_value(parser);
+            continue;
+        }
+
+        token = ajson_bind_next(bind);
+
+        int status = field->type == AJSON_TYPE_ARRAY ?
+            ajson_bind_array(bind, field, target, token) :
+            ajson_bind_value(bind, field->type, field->object, (char*)target + field->offset, token);
+
+        if (status != 0) {
+            return -1;
+        }
+    }
+}
+
+static int ajson_bind(struct ajson_bind_s *bind, const ajson_struct *desc, void *target) {
+    ajson_parser *parser = bind->input.parser;
+
+    if (parser->flags & (AJSON_FLAG_NUMBER_AS_STRING | AJSON_FLAG_NUMBER_COMPONENTS) || parser->filter) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(target, 0, desc->size);
+
+    if (ajson_input_begin(&bind->input) != 0) {
+        return -1;
+    }
+
+    enum ajson_token token = ajson_bind_next(bind);
+    if (ajson_bind_value(bind, AJSON_TYPE_OBJECT, desc, target, token) != 0) {
+        return -1;
+    }
+
+    token = ajson_bind_next(bind);
+    if (token == AJSON_TOK_END) {
+        return 0;
+    }
+    else if (token != AJSON_TOK_ERROR && token != AJSON_TOK_NEED_DATA) {
+        AJSON_SET_ERROR(parser, AJSON_ERROR_PARSER_UNEXPECTED_CHAR);
+    }
+
+    return -1;
+}
+
+int ajson_bind_fd(ajson_parser *parser, const ajson_struct *desc, void *target, ajson_arena *arena, int fd) {
+    char buf[BUFSIZ];
+    struct ajson_bind_s bind = { { parser, fd, NULL, buf }, arena };
+
+    return ajson_bind(&bind, desc, target);
+}
+
+int ajson_bind_file(ajson_parser *parser, const ajson_struct *desc, void *target, ajson_arena *arena, FILE* stream) {
+    char buf[BUFSIZ];
+    struct ajson_bind_s bind = { { parser, -1, stream, buf }, arena };
+
+    return ajson_bind(&bind, desc, target);
+}
+
+int ajson_bind_buf(ajson_parser *parser, const ajson_struct *desc, void *target, ajson_arena *arena, const void* buffer, size_t size) {
+    // the whole document is fed at once, so NEED_DATA means end of input
+    struct ajson_bind_s bind = { { parser, -1, NULL, NULL }, arena };
+
+    if (ajson_feed(parser, buffer, size) != 0) {
+        return -1;
+    }
+
+    return ajson_bind(&bind, desc, target);
+}
@@ -1,72 +1,85 @@
 #include "ajson.h"
 
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef AJSON_USE_PTHREADS
+#   include <pthread.h>
+#   include <poll.h>
+#endif
 
 int ajson_cb_dispatch(ajson_cb_parser *parser) {
     for (;;) {
         enum ajson_token token = ajson_next_token(&parser->parser);
+        int result = AJSON_CB_CONTINUE;
 
         switch (token) {
         case AJSON_TOK_NULL:
             if (parser->null_func)
-                parser->null_func(parser->ctx);
+                result = parser->null_func(parser->ctx);
             break;
 
         case AJSON_TOK_BOOLEAN:
             if (parser->boolean_func)
-                parser->boolean_func(parser->ctx, parser->parser.value.boolean);
+                result = parser->boolean_func(parser->ctx, parser->parser.value.boolean);
             break;
 
         case AJSON_TOK_NUMBER:
             if (parser->parser.flags & AJSON_FLAG_NUMBER_AS_STRING) {
                 if (parser->number_as_string_func) {
-                    parser->number_as_string_func(parser->ctx, parser->parser.value.string.value);
+                    result = parser->number_as_string_func(parser->ctx, parser->parser.value.string.value);
                 }
             }
             else if (parser->parser.flags & AJSON_FLAG_NUMBER_COMPONENTS) {
                 if (parser->components_func)
-                    parser->components_func(parser->ctx,
-                                            parser->parser.value.components.positive,
-                                            parser->parser.value.components.integer,
-                                            parser->parser.value.components.decimal,
-                                            parser->parser.value.components.decimal_places,
-                                            parser->parser.value.components.exponent_positive,
-                                            parser->parser.value.components.exponent);
+                    result = parser->components_func(parser->ctx,
+                                                     parser->parser.value.components.positive,
+                                                     parser->parser.value.components.integer,
+                                                     parser->parser.value.components.decimal,
+                                                     parser->parser.value.components.decimal_places,
+                                                     parser->parser.value.components.exponent_positive,
+                                                     parser->parser.value.components.exponent);
             }
             else {
                 if (parser->number_func)
-                    parser->number_func(parser->ctx, parser->parser.value.number);
+                    result = parser->number_func(parser->ctx, parser->parser.value.number);
             }
             break;
 
         case AJSON_TOK_INTEGER:
             if (parser->integer_func)
-                parser->integer_func(parser->ctx, parser->parser.value.integer);
+                result = parser->integer_func(parser->ctx, parser->parser.value.integer);
             break;
 
         case AJSON_TOK_STRING:
             if (parser->string_func)
-                parser->string_func(parser->ctx, parser->parser.value.string.value, parser->parser.value.string.length);
+                result = parser->string_func(parser->ctx, parser->parser.value.string.value, parser->parser.value.string.length);
             break;
 
         case AJSON_TOK_BEGIN_ARRAY:
             if (parser->begin_array_func)
-                parser->begin_array_func(parser->ctx);
+                result = parser->begin_array_func(parser->ctx);
             break;
 
         case AJSON_TOK_END_ARRAY:
             if (parser->end_array_func)
-                parser->end_array_func(parser->ctx);
+                result = parser->end_array_func(parser->ctx);
             break;
 
         case AJSON_TOK_BEGIN_OBJECT:
             if (parser->begin_object_func)
-                parser->begin_object_func(parser->ctx);
+                result = parser->begin_object_func(parser->ctx);
             break;
 
         case AJSON_TOK_END_OBJECT:
             if (parser->end_object_func)
-                parser->end_object_func(parser->ctx);
+                result = parser->end_object_func(parser->ctx);
             break;
 
         case AJSON_TOK_END:
@@ -82,19 +95,49 @@ int ajson_cb_dispatch(ajson_cb_parser *parser) {
         case AJSON_TOK_NEED_DATA:
             return 0;
         }
+
+        if (result == AJSON_CB_STOP) {
+            return 1;
+        }
+        else if (result == AJSON_CB_SKIP) {
+            ajson_skip_container(&parser->parser);
+        }
     }
 }
 
-int ajson_cb_parse_fd(ajson_cb_parser *parser, int fd) {
-    char buf[BUFSIZ];
+static int ajson_cb_read_fd(ajson_cb_parser *parser, int fd, char *buf, size_t size) {
+    for (;;) {
+        ssize_t count = read(fd, buf, size);
+
+        if (count < 0 || ajson_feed(&parser->parser, buf, count) != 0) {
+            return -1;
+        }
+
+        int status = ajson_cb_dispatch(parser);
+        if (status != 0) {
+            return status;
+        }
 
+        if (count == 0)
+            break;
+    }
+
+    return 0;
+}
+
+static int ajson_cb_read_file(ajson_cb_parser *parser, FILE* stream, char *buf, size_t size) {
     for (;;) {
-        ssize_t count = read(fd, buf, sizeof(buf));
+        size_t count = fread(buf, 1, size, stream);
 
-        if (count < 0 || ajson_feed(&parser->parser, buf, count) != 0 || ajson_cb_dispatch(parser) != 0) {
+        if (ferror(stream) || ajson_feed(&parser->parser, buf, count) != 0) {
             return -1;
         }
 
+        int status = ajson_cb_dispatch(parser);
+        if (status != 0) {
+            return status;
+        }
+
         if (count == 0)
             break;
     }
@@ -102,23 +145,319 @@ int ajson_cb_parse_fd(ajson_cb_parser *parser, int fd) {
     return 0;
 }
 
+int ajson_cb_parse_fd(ajson_cb_parser *parser, int fd) {
+    char buf[BUFSIZ];
+    return ajson_cb_read_fd(parser, fd, buf, sizeof(buf));
+}
+
 int ajson_cb_parse_file(ajson_cb_parser *parser, FILE* stream) {
     char buf[BUFSIZ];
+    return ajson_cb_read_file(parser, stream, buf, sizeof(buf));
+}
+
+int ajson_cb_parse_fd_size(ajson_cb_parser *parser, int fd, size_t buffer_size) {
+    if (buffer_size == 0 || buffer_size > SSIZE_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    char *buf = malloc(buffer_size);
+    if (!buf) {
+        return -1;
+    }
+
+    int status = ajson_cb_read_fd(parser, fd, buf, buffer_size);
+    free(buf);
+
+    return status;
+}
+
+int ajson_cb_parse_file_size(ajson_cb_parser *parser, FILE* stream, size_t buffer_size) {
+    if (buffer_size == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    char *buf = malloc(buffer_size);
+    if (!buf) {
+        return -1;
+    }
+
+    int status = ajson_cb_read_file(parser, stream, buf, buffer_size);
+    free(buf);
+
+    return status;
+}
+
+int ajson_cb_parse_path(ajson_cb_parser *parser, const char *filename) {
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    int status;
+
+    if (fstat(fd, &st) != 0) {
+        status = -1;
+    }
+    else if (!S_ISREG(st.st_mode) || st.st_size == 0 || (uint64_t)st.st_size > SIZE_MAX) {
+        // pipes, devices and empty files can't be mapped
+        status = ajson_cb_parse_fd(parser, fd);
+    }
+    else {
+        const size_t size = (size_t)st.st_size;
+        void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED) {
+            status = ajson_cb_parse_fd(parser, fd);
+        }
+        else {
+            // only a hint, the file is read once from start to end
+            madvise(data, size, MADV_SEQUENTIAL);
+
+            status = ajson_cb_parse_buf(parser, data, size);
+            if (status == 0) {
+                // end of input
+                status = ajson_cb_parse_buf(parser, data, 0);
+            }
+
+            int errnum = errno;
+            munmap(data, size);
+            errno = errnum;
+        }
+    }
+
+    int errnum = errno;
+    close(fd);
+    errno = errnum;
+
+    return status;
+}
+
+#ifdef AJSON_USE_PTHREADS
+// A reader thread fills a ring of buffers while the calling thread parses them.
+// A buffer can be refilled as soon as ajson_cb_dispatch() asked for more data,
+// because the parser never refers to input it has consumed. The reader only
+// calls read() once poll() reported input, so a parser that stops early can
+// wake it up through a pipe even when the writer of fd stays open.
+struct ajson_cb_pipeline {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int             fd;
+    int             wake[2];  // written to when the parser stops
+    char           *data;
+    size_t          buffer_size;
+    size_t          buffer_count;
+    ssize_t        *counts;   // bytes read into each buffer
+    size_t          filled;   // buffers read so far
+    size_t          consumed; // buffers parsed so far
+    int             errnum;   // read error or 0
+    bool            done;     // the reader stopped
+    bool            stop;     // the parser stopped
+};
+
+// Returns 1 if fd is readable, 0 if the parser stopped, -1 on error.
+static int ajson_cb_poll(struct ajson_cb_pipeline *pipeline) {
+    struct pollfd fds[2] = {
+        { pipeline->fd,      POLLIN, 0 },
+        { pipeline->wake[0], POLLIN, 0 }
+    };
 
     for (;;) {
-        size_t count = fread(buf, 1, sizeof(buf), stream);
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
 
-        if (ferror(stream) || ajson_feed(&parser->parser, buf, count) != 0 || ajson_cb_dispatch(parser) != 0) {
+        if (fds[1].revents) {
+            return 0;
+        }
+
+        if (fds[0].revents & POLLNVAL) {
+            errno = EBADF;
             return -1;
         }
 
-        if (count == 0)
+        // POLLHUP and POLLERR are reported by read()
+        return 1;
+    }
+}
+
+static void *ajson_cb_reader(void *arg) {
+    struct ajson_cb_pipeline *pipeline = arg;
+
+    pthread_mutex_lock(&pipeline->mutex);
+    for (;;) {
+        while (!pipeline->stop && pipeline->filled - pipeline->consumed == pipeline->buffer_count) {
+            pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+        }
+
+        if (pipeline->stop) {
+            break;
+        }
+
+        const size_t slot = pipeline->filled % pipeline->buffer_count;
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        const int ready = ajson_cb_poll(pipeline);
+        ssize_t count = -1;
+        if (ready > 0) {
+            do {
+                count = read(pipeline->fd, pipeline->data + slot * pipeline->buffer_size, pipeline->buffer_size);
+            } while (count < 0 && errno == EINTR);
+        }
+        const int errnum = errno;
+
+        pthread_mutex_lock(&pipeline->mutex);
+        if (ready == 0) {
+            break;
+        }
+        else if (count < 0) {
+            pipeline->errnum = errnum;
             break;
+        }
+
+        pipeline->counts[slot] = count;
+        ++ pipeline->filled;
+        pthread_cond_broadcast(&pipeline->cond);
+
+        if (count == 0) {
+            break;
+        }
     }
 
-    return 0;
+    pipeline->done = true;
+    pthread_cond_broadcast(&pipeline->cond);
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    return NULL;
+}
+
+int ajson_cb_parse_fd_pipelined(ajson_cb_parser *parser, int fd, size_t buffer_size, size_t buffer_count) {
+    if (buffer_size == 0 || buffer_size > SSIZE_MAX || buffer_count < 2 || buffer_count > SIZE_MAX / buffer_size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct ajson_cb_pipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.fd           = fd;
+    pipeline.buffer_size  = buffer_size;
+    pipeline.buffer_count = buffer_count;
+    pipeline.data         = malloc(buffer_size * buffer_count);
+    pipeline.counts       = calloc(buffer_count, sizeof(ssize_t));
+
+    if (!pipeline.data || !pipeline.counts) {
+        free(pipeline.data);
+        free(pipeline.counts);
+        return -1;
+    }
+
+    if (pipe(pipeline.wake) != 0) {
+        free(pipeline.data);
+        free(pipeline.counts);
+        return -1;
+    }
+    fcntl(pipeline.wake[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipeline.wake[1], F_SETFD, FD_CLOEXEC);
+
+    int errnum = pthread_mutex_init(&pipeline.mutex, NULL);
+    if (errnum == 0) {
+        errnum = pthread_cond_init(&pipeline.cond, NULL);
+        if (errnum != 0) {
+            pthread_mutex_destroy(&pipeline.mutex);
+        }
+    }
+
+    pthread_t reader;
+    if (errnum == 0) {
+        errnum = pthread_create(&reader, NULL, ajson_cb_reader, &pipeline);
+        if (errnum != 0) {
+            pthread_cond_destroy(&pipeline.cond);
+            pthread_mutex_destroy(&pipeline.mutex);
+        }
+    }
+
+    if (errnum != 0) {
+        close(pipeline.wake[0]);
+        close(pipeline.wake[1]);
+        free(pipeline.data);
+        free(pipeline.counts);
+        errno = errnum;
+        return -1;
+    }
+
+    int status = 0;
+    pthread_mutex_lock(&pipeline.mutex);
+    for (;;) {
+        while (!pipeline.done && pipeline.filled == pipeline.consumed) {
+            pthread_cond_wait(&pipeline.cond, &pipeline.mutex);
+        }
+
+        if (pipeline.filled == pipeline.consumed) {
+            // the reader failed
+            errnum = pipeline.errnum;
+            status = -1;
+            break;
+        }
+
+        const size_t  slot  = pipeline.consumed % buffer_count;
+        const ssize_t count = pipeline.counts[slot];
+        pthread_mutex_unlock(&pipeline.mutex);
+
+        if (ajson_feed(&parser->parser, pipeline.data + slot * buffer_size, count) != 0) {
+            status = -1;
+        }
+        else {
+            status = ajson_cb_dispatch(parser);
+        }
+        errnum = errno;
+
+        pthread_mutex_lock(&pipeline.mutex);
+        ++ pipeline.consumed;
+        pthread_cond_broadcast(&pipeline.cond);
+
+        if (status != 0 || count == 0) {
+            break;
+        }
+    }
+
+    pipeline.stop = true;
+    pthread_cond_broadcast(&pipeline.cond);
+    pthread_mutex_unlock(&pipeline.mutex);
+
+    // wakes up a reader that waits for input, the pipe can't be full
+    while (write(pipeline.wake[1], "", 1) < 0 && errno == EINTR);
+
+    pthread_join(reader, NULL);
+    pthread_cond_destroy(&pipeline.cond);
+    pthread_mutex_destroy(&pipeline.mutex);
+    close(pipeline.wake[0]);
+    close(pipeline.wake[1]);
+    free(pipeline.data);
+    free(pipeline.counts);
+
+    if (status < 0) {
+        errno = errnum;
+    }
+
+    return status;
+}
+#else
+int ajson_cb_parse_fd_pipelined(ajson_cb_parser *parser, int fd, size_t buffer_size, size_t buffer_count) {
+    if (buffer_count < 2) {
+        errno = EINVAL;
+        return -1;
+    }
 
+    // no threads, so reading and parsing alternate
+    return ajson_cb_parse_fd_size(parser, fd, buffer_size);
 }
+#endif
 
 int ajson_cb_parse_buf(ajson_cb_parser *parser, const void* buffer, size_t size) {
     if (ajson_feed(&parser->parser, buffer, size) != 0) {
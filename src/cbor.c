@@ -0,0 +1,412 @@
+#include "ajson.h"
+#include "emit.h"
+#include "decoder.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+
+// major types
+#define AJSON_CBOR_UINT   0
+#define AJSON_CBOR_NINT   1
+#define AJSON_CBOR_BYTES  2
+#define AJSON_CBOR_TEXT   3
+#define AJSON_CBOR_ARRAY  4
+#define AJSON_CBOR_MAP    5
+#define AJSON_CBOR_TAG    6
+#define AJSON_CBOR_SIMPLE 7
+
+#define AJSON_CBOR_FALSE      0xf4
+#define AJSON_CBOR_TRUE       0xf5
+#define AJSON_CBOR_NULL       0xf6
+#define AJSON_CBOR_UNDEFINED  0xf7
+#define AJSON_CBOR_SIMPLE8    0xf8
+#define AJSON_CBOR_FLOAT16    0xf9
+#define AJSON_CBOR_FLOAT32    0xfa
+#define AJSON_CBOR_FLOAT64    0xfb
+#define AJSON_CBOR_BREAK      0xff
+#define AJSON_CBOR_INDEFINITE 31
+
+// ========== Writer ==========
+
+// Containers are written with indefinite length, so they can be streamed.
+// Stack entries: 'a' array, 'k' object expecting a key, 'v' object expecting a value.
+
+static void ajson_cbor_head(struct ajson_emit_s *emit, unsigned int major, uint64_t value) {
+    const unsigned char type = (unsigned char)(major << 5);
+
+    if (value < 24) {
+        ajson_emit_head(emit, type | (unsigned char)value, 0, 0);
+    }
+    else if (value <= UINT8_MAX) {
+        ajson_emit_head(emit, type | 24, value, 1);
+    }
+    else if (value <= UINT16_MAX) {
+        ajson_emit_head(emit, type | 25, value, 2);
+    }
+    else if (value <= UINT32_MAX) {
+        ajson_emit_head(emit, type | 26, value, 4);
+    }
+    else {
+        ajson_emit_head(emit, type | 27, value, 8);
+    }
+}
+
+static int ajson_cbor_writer_push(ajson_cbor_writer *writer, char type) {
+    if (writer->stack_size == writer->stack_current + 1) {
+        size_t newsize = writer->stack_size + AJSON_STACK_SIZE;
+        char *stack = realloc(writer->stack, newsize);
+
+        if (!stack) {
+            return -1;
+        }
+
+        writer->stack      = stack;
+        writer->stack_size = newsize;
+    }
+
+    writer->stack[++ writer->stack_current] = type;
+    return 0;
+}
+
+// Checks if a value (or key) may be written here and prepares the next item.
+static int ajson_cbor_writer_value(ajson_cbor_writer *writer, size_t size, bool key) {
+    if (size == 0 || size > SSIZE_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    char *top = writer->stack + writer->stack_current;
+    if (*top == 'k') {
+        if (!key) {
+            errno = EINVAL;
+            return -1;
+        }
+        *top = 'v';
+    }
+    else if (*top == 'v') {
+        *top = 'k';
+    }
+
+    ajson_emit_begin(&writer->emit);
+    return 0;
+}
+
+int ajson_cbor_writer_init(ajson_cbor_writer *writer) {
+    memset(writer, 0, sizeof(ajson_cbor_writer));
+    writer->stack = calloc(AJSON_STACK_SIZE, 1);
+
+    if (!writer->stack) {
+        return -1;
+    }
+
+    writer->stack_size = AJSON_STACK_SIZE;
+    return 0;
+}
+
+void ajson_cbor_writer_reset(ajson_cbor_writer *writer) {
+    ajson_emit_begin(&writer->emit);
+    writer->stack_current = 0;
+}
+
+void ajson_cbor_writer_destroy(ajson_cbor_writer *writer) {
+    free(writer->stack);
+    writer->stack         = NULL;
+    writer->stack_size    = 0;
+    writer->stack_current = 0;
+}
+
+ssize_t ajson_cbor_write_null(ajson_cbor_writer *writer, void *buffer, size_t size) {
+    if (ajson_cbor_writer_value(writer, size, false) != 0) {
+        return -1;
+    }
+    ajson_emit_head(&writer->emit, AJSON_CBOR_NULL, 0, 0);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_cbor_write_boolean(ajson_cbor_writer *writer, void *buffer, size_t size, bool value) {
+    if (ajson_cbor_writer_value(writer, size, false) != 0) {
+        return -1;
+    }
+    ajson_emit_head(&writer->emit, value ? AJSON_CBOR_TRUE : AJSON_CBOR_FALSE, 0, 0);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_cbor_write_number(ajson_cbor_writer *writer, void *buffer, size_t size, double value) {
+    if (ajson_cbor_writer_value(writer, size, false) != 0) {
+        return -1;
+    }
+
+    // single precision if that is exact
+    if (value >= -FLT_MAX && value <= FLT_MAX && (double)(float)value == value) {
+        float    number = (float)value;
+        uint32_t bits;
+        memcpy(&bits, &number, sizeof(bits));
+        ajson_emit_head(&writer->emit, AJSON_CBOR_FLOAT32, bits, 4);
+    }
+    else {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        ajson_emit_head(&writer->emit, AJSON_CBOR_FLOAT64, bits, 8);
+    }
+
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_cbor_write_integer(ajson_cbor_writer *writer, void *buffer, size_t size, int64_t value) {
+    if (ajson_cbor_writer_value(writer, size, false) != 0) {
+        return -1;
+    }
+
+    if (value < 0) {
+        // -1 - value without overflow
+        ajson_cbor_head(&writer->emit, AJSON_CBOR_NINT, ~(uint64_t)value);
+    }
+    else {
+        ajson_cbor_head(&writer->emit, AJSON_CBOR_UINT, (uint64_t)value);
+    }
+
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_cbor_write_string(ajson_cbor_writer *writer, void *buffer, size_t size, const char* value, size_t length) {
+    if (!value) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (ajson_cbor_writer_value(writer, size, true) != 0) {
+        return -1;
+    }
+
+    ajson_cbor_head(&writer->emit, AJSON_CBOR_TEXT, length);
+    writer->emit.payload     = value;
+    writer->emit.payload_end = value + length;
+
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_cbor_write_begin_array(ajson_cbor_writer *writer, void *buffer, size_t size) {
+    if (ajson_cbor_writer_value(writer, size, false) != 0 || ajson_cbor_writer_push(writer, 'a') != 0) {
+        return -1;
+    }
+    ajson_emit_head(&writer->emit, (AJSON_CBOR_ARRAY << 5) | AJSON_CBOR_INDEFINITE, 0, 0);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_cbor_write_end_array(ajson_cbor_writer *writer, void *buffer, size_t size) {
+    if (size == 0 || size > SSIZE_MAX || writer->stack[writer->stack_current] != 'a') {
+        errno = EINVAL;
+        return -1;
+    }
+    -- writer->stack_current;
+
+    ajson_emit_begin(&writer->emit);
+    ajson_emit_head(&writer->emit, AJSON_CBOR_BREAK, 0, 0);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_cbor_write_begin_object(ajson_cbor_writer *writer, void *buffer, size_t size) {
+    if (ajson_cbor_writer_value(writer, size, false) != 0 || ajson_cbor_writer_push(writer, 'k') != 0) {
+        return -1;
+    }
+    ajson_emit_head(&writer->emit, (AJSON_CBOR_MAP << 5) | AJSON_CBOR_INDEFINITE, 0, 0);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_cbor_write_end_object(ajson_cbor_writer *writer, void *buffer, size_t size) {
+    if (size == 0 || size > SSIZE_MAX || writer->stack[writer->stack_current] != 'k') {
+        errno = EINVAL;
+        return -1;
+    }
+    -- writer->stack_current;
+
+    ajson_emit_begin(&writer->emit);
+    ajson_emit_head(&writer->emit, AJSON_CBOR_BREAK, 0, 0);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_cbor_write_continue(ajson_cbor_writer *writer, void *buffer, size_t size) {
+    if (size == 0 || size > SSIZE_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_cbor_write_token(ajson_cbor_writer *writer, void *buffer, size_t size, const ajson_parser *parser, enum ajson_token token) {
+    if (parser->flags & (AJSON_FLAG_NUMBER_AS_STRING | AJSON_FLAG_NUMBER_COMPONENTS | AJSON_FLAG_RAW_LATIN1)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    switch (token) {
+    case AJSON_TOK_NULL:
+        return ajson_cbor_write_null(writer, buffer, size);
+
+    case AJSON_TOK_BOOLEAN:
+        return ajson_cbor_write_boolean(writer, buffer, size, parser->value.boolean);
+
+    case AJSON_TOK_NUMBER:
+        return ajson_cbor_write_number(writer, buffer, size, parser->value.number);
+
+    case AJSON_TOK_INTEGER:
+        return ajson_cbor_write_integer(writer, buffer, size, parser->value.integer);
+
+    case AJSON_TOK_STRING:
+        return ajson_cbor_write_string(writer, buffer, size, parser->value.string.value, parser->value.string.length);
+
+    case AJSON_TOK_BEGIN_ARRAY:
+        return ajson_cbor_write_begin_array(writer, buffer, size);
+
+    case AJSON_TOK_END_ARRAY:
+        return ajson_cbor_write_end_array(writer, buffer, size);
+
+    case AJSON_TOK_BEGIN_OBJECT:
+        return ajson_cbor_write_begin_object(writer, buffer, size);
+
+    case AJSON_TOK_END_OBJECT:
+        return ajson_cbor_write_end_object(writer, buffer, size);
+
+    case AJSON_TOK_END:
+    case AJSON_TOK_NEED_DATA:
+        return 0;
+
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+// ========== Reader ==========
+
+size_t ajson_cbor_head_length(unsigned char byte) {
+    switch (byte & 31) {
+    case 24: return 2;
+    case 25: return 3;
+    case 26: return 5;
+    case 27: return 9;
+    default: return 1;
+    }
+}
+
+static double ajson_cbor_half(uint16_t bits) {
+    const int exponent = (bits >> 10) & 31;
+    const int mantissa = bits & 0x3ff;
+    double value;
+
+    if (exponent == 0) {
+        // subnormal
+        value = ldexp(mantissa, -24);
+    }
+    else if (exponent != 31) {
+        value = ldexp(mantissa + 1024, exponent - 25);
+    }
+    else {
+        value = mantissa == 0 ? INFINITY : NAN;
+    }
+
+    return bits & 0x8000 ? -value : value;
+}
+
+void ajson_cbor_read_item(const unsigned char *head, struct ajson_item *item) {
+    const unsigned int major = head[0] >> 5;
+    const unsigned int info  = head[0] & 31;
+    const uint64_t argument  = info < 24 ? info : ajson_decode_uint(head + 1, ajson_cbor_head_length(head[0]) - 1);
+
+    item->indefinite = info == AJSON_CBOR_INDEFINITE;
+
+    if (info >= 28 && info < AJSON_CBOR_INDEFINITE) {
+        item->type = AJSON_ITEM_INVALID;
+        return;
+    }
+
+    switch (major) {
+    case AJSON_CBOR_UINT:
+    case AJSON_CBOR_NINT:
+        if (item->indefinite) {
+            item->type = AJSON_ITEM_INVALID;
+        }
+        else if (argument <= INT64_MAX) {
+            item->type = AJSON_ITEM_INTEGER;
+            // -1 - argument without overflow
+            item->value.integer = major == AJSON_CBOR_UINT ? (int64_t)argument : (int64_t)~argument;
+        }
+        else {
+            item->type = AJSON_ITEM_NUMBER;
+            item->value.number = major == AJSON_CBOR_UINT ? (double)argument : -1.0 - (double)argument;
+        }
+        break;
+
+    case AJSON_CBOR_TEXT:
+        item->type = AJSON_ITEM_STRING;
+        item->value.count = argument;
+        break;
+
+    case AJSON_CBOR_ARRAY:
+        item->type = AJSON_ITEM_ARRAY;
+        item->value.count = argument;
+        break;
+
+    case AJSON_CBOR_MAP:
+        item->type = AJSON_ITEM_OBJECT;
+        item->value.count = argument;
+        break;
+
+    case AJSON_CBOR_TAG:
+        item->type = item->indefinite ? AJSON_ITEM_INVALID : AJSON_ITEM_TAG;
+        break;
+
+    case AJSON_CBOR_SIMPLE:
+        switch (head[0]) {
+        case AJSON_CBOR_FALSE:
+        case AJSON_CBOR_TRUE:
+            item->type = AJSON_ITEM_BOOLEAN;
+            item->value.boolean = head[0] == AJSON_CBOR_TRUE;
+            break;
+
+        case AJSON_CBOR_NULL:
+        case AJSON_CBOR_UNDEFINED:
+            item->type = AJSON_ITEM_NULL;
+            break;
+
+        case AJSON_CBOR_FLOAT16:
+            item->type = AJSON_ITEM_NUMBER;
+            item->value.number = ajson_cbor_half((uint16_t)argument);
+            break;
+
+        case AJSON_CBOR_FLOAT32:
+        {
+            uint32_t bits = (uint32_t)argument;
+            float    number;
+            memcpy(&number, &bits, sizeof(number));
+            item->type = AJSON_ITEM_NUMBER;
+            item->value.number = number;
+            break;
+        }
+        case AJSON_CBOR_FLOAT64:
+            item->type = AJSON_ITEM_NUMBER;
+            memcpy(&item->value.number, &argument, sizeof(item->value.number));
+            break;
+
+        case AJSON_CBOR_BREAK:
+            item->type = AJSON_ITEM_BREAK;
+            break;
+
+        default:
+            // two byte encodings of the simple values 0 to 31 are not well-formed
+            item->type = head[0] == AJSON_CBOR_SIMPLE8 && argument < 32 ? AJSON_ITEM_INVALID : AJSON_ITEM_UNSUPPORTED;
+            break;
+        }
+        break;
+
+    case AJSON_CBOR_BYTES:
+    default:
+        // byte strings have no JSON equivalent
+        item->type = AJSON_ITEM_UNSUPPORTED;
+        break;
+    }
+}
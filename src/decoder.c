@@ -0,0 +1,399 @@
+#include "ajson.h"
+#include "filter.h"
+#include "decoder.h"
+#include "error.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <float.h>
+
+#define RAISE_ERROR(ERR) { \
+    parser->input_current = index; \
+    AJSON_SET_ERROR(parser, ERR); \
+    decoder->state = AJSON_DECODER_ERROR; \
+    return AJSON_TOK_ERROR; \
+}
+
+int ajson_decoder_init(ajson_parser *parser) {
+    struct ajson_decoder_s *decoder = calloc(1, sizeof(struct ajson_decoder_s));
+
+    if (!decoder) {
+        return -1;
+    }
+
+    decoder->stack = calloc(AJSON_STACK_SIZE, sizeof(struct ajson_decoder_frame));
+    if (!decoder->stack) {
+        free(decoder);
+        return -1;
+    }
+    decoder->stack_size = AJSON_STACK_SIZE;
+
+    if (parser->encoding == AJSON_ENC_CBOR) {
+        decoder->head_length = ajson_cbor_head_length;
+        decoder->read_item   = ajson_cbor_read_item;
+    }
+    else {
+        decoder->head_length = ajson_msgpack_head_length;
+        decoder->read_item   = ajson_msgpack_read_item;
+    }
+
+    parser->decoder = decoder;
+    return 0;
+}
+
+void ajson_decoder_reset(ajson_parser *parser) {
+    struct ajson_decoder_s *decoder = parser->decoder;
+
+    decoder->state     = AJSON_DECODER_VALUE;
+    decoder->head_size = 0;
+    decoder->remaining = 0;
+    decoder->chunked   = false;
+    decoder->done      = false;
+    decoder->skipping  = false;
+    decoder->announced = false;
+    decoder->depth     = 0;
+}
+
+void ajson_decoder_destroy(ajson_parser *parser) {
+    if (parser->decoder) {
+        free(parser->decoder->stack);
+        free(parser->decoder);
+        parser->decoder = NULL;
+    }
+}
+
+static inline int ajson_decoder_append(ajson_parser *parser, const unsigned char *data, size_t size) {
+    // one more byte for the terminating null
+    size_t needed = parser->buffer_used + size + 1;
+    if (needed <= parser->buffer_used) {
+        AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+        return -1;
+    }
+
+    if (parser->buffer_size < needed) {
+        size_t newsize = needed - (needed % BUFSIZ);
+        if (newsize < needed) {
+            newsize += BUFSIZ;
+        }
+        char *buffer = realloc(parser->buffer, newsize);
+        if (buffer == NULL) {
+            AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+            return -1;
+        }
+        parser->buffer = buffer;
+        parser->buffer_size = newsize;
+    }
+
+    memcpy(parser->buffer + parser->buffer_used, data, size);
+    parser->buffer_used += size;
+    return 0;
+}
+
+static inline bool ajson_decoder_valid_utf8(const unsigned char *data, size_t size) {
+    size_t index = 0;
+
+    while (index < size) {
+        if (data[index] < 0x80) {
+            ++ index;
+        }
+        else {
+            int count = ajson_decode_utf8(data + index, size - index, NULL);
+            if (count <= 0) {
+                return false;
+            }
+            index += count;
+        }
+    }
+
+    return true;
+}
+
+static inline int ajson_decoder_push(struct ajson_decoder_s *decoder, const struct ajson_item *item) {
+    if (decoder->depth == decoder->stack_size) {
+        size_t newsize = decoder->stack_size + AJSON_STACK_SIZE;
+        struct ajson_decoder_frame *stack = realloc(decoder->stack, newsize * sizeof(struct ajson_decoder_frame));
+
+        if (!stack) {
+            return -1;
+        }
+
+        decoder->stack      = stack;
+        decoder->stack_size = newsize;
+    }
+
+    struct ajson_decoder_frame *frame = decoder->stack + decoder->depth ++;
+    frame->object     = item->type == AJSON_ITEM_OBJECT;
+    frame->indefinite = item->indefinite;
+    frame->remaining  = frame->object ? item->value.count * 2 : item->value.count;
+    frame->key        = frame->object;
+    return 0;
+}
+
+enum ajson_token ajson_decode(ajson_parser *parser) {
+    struct ajson_decoder_s *decoder = parser->decoder;
+    const unsigned char *input = (const unsigned char*)parser->input;
+    const size_t size = parser->input_size;
+    size_t index = parser->input_current;
+    enum ajson_token token;
+
+    if (decoder->state == AJSON_DECODER_ERROR) {
+        // An error happened earlier. This parser needs to be reset to be usable again.
+        RAISE_ERROR(AJSON_ERROR_PARSER_STATE);
+    }
+
+    for (;;) {
+        struct ajson_decoder_frame *frame = decoder->depth ? decoder->stack + decoder->depth - 1 : NULL;
+
+        if (decoder->state == AJSON_DECODER_STRING) {
+            /* ==== string data ================================================================================== */
+            if (decoder->remaining > 0) {
+                if (index == size) {
+                    if (size == 0) {
+                        RAISE_ERROR(AJSON_ERROR_PARSER_UNEXPECTED_EOF);
+                    }
+                    parser->input_current = index;
+                    return AJSON_TOK_NEED_DATA;
+                }
+
+                size_t count = size - index;
+                if (count > decoder->remaining) {
+                    count = (size_t)decoder->remaining;
+                }
+
+                // skipped strings are neither buffered nor validated
+                if (!decoder->skipping && ajson_decoder_append(parser, input + index, count) != 0) {
+                    parser->input_current = index;
+                    decoder->state = AJSON_DECODER_ERROR;
+                    return AJSON_TOK_ERROR;
+                }
+
+                index += count;
+                decoder->remaining -= count;
+                continue;
+            }
+
+            if (decoder->chunked) {
+                decoder->state = AJSON_DECODER_CHUNK;
+                continue;
+            }
+
+            decoder->state = AJSON_DECODER_VALUE;
+            if (!decoder->skipping) {
+                if (!ajson_decoder_valid_utf8((const unsigned char*)parser->buffer, parser->buffer_used)) {
+                    RAISE_ERROR(AJSON_ERROR_PARSER_ILLEGAL_UNICODE);
+                }
+                // makes room for the terminating null (empty strings)
+                if (ajson_decoder_append(parser, (const unsigned char*)"", 0) != 0) {
+                    parser->input_current = index;
+                    decoder->state = AJSON_DECODER_ERROR;
+                    return AJSON_TOK_ERROR;
+                }
+                parser->buffer[parser->buffer_used] = 0;
+                parser->value.string.value  = parser->buffer;
+                parser->value.string.length = parser->buffer_used;
+            }
+            token = AJSON_TOK_STRING;
+            goto value_done;
+        }
+
+        if (decoder->state == AJSON_DECODER_VALUE) {
+            if (frame && !frame->indefinite && frame->remaining == 0) {
+                token = frame->object ? AJSON_TOK_END_OBJECT : AJSON_TOK_END_ARRAY;
+                -- decoder->depth;
+                parser->skip = AJSON_SKIP_NONE;
+                goto value_done;
+            }
+
+            if (!frame && decoder->head_size == 0) {
+                if (decoder->done) {
+                    // nothing may follow the root value
+                    if (index < size) {
+                        RAISE_ERROR(AJSON_ERROR_PARSER_UNEXPECTED_CHAR);
+                    }
+                    if (size == 0) {
+                        parser->input_current = index;
+                        return AJSON_TOK_END;
+                    }
+                }
+                else if (size == 0 && parser->flags & AJSON_FLAG_STREAM) {
+                    // any number of values, END is only returned at the end of the input
+                    parser->input_current = index;
+                    return AJSON_TOK_END;
+                }
+            }
+        }
+
+        /* ==== item head ======================================================================================== */
+        if (decoder->head_size == 0) {
+            if (index == size) {
+                if (size == 0) {
+                    RAISE_ERROR(AJSON_ERROR_PARSER_UNEXPECTED_EOF);
+                }
+                parser->input_current = index;
+                return AJSON_TOK_NEED_DATA;
+            }
+            decoder->head[0]     = input[index ++];
+            decoder->head_size   = 1;
+            decoder->head_needed = (unsigned char)decoder->head_length(decoder->head[0]);
+        }
+
+        while (decoder->head_size < decoder->head_needed) {
+            if (index == size) {
+                if (size == 0) {
+                    RAISE_ERROR(AJSON_ERROR_PARSER_UNEXPECTED_EOF);
+                }
+                parser->input_current = index;
+                return AJSON_TOK_NEED_DATA;
+            }
+            decoder->head[decoder->head_size ++] = input[index ++];
+        }
+
+        struct ajson_item item;
+        decoder->read_item(decoder->head, &item);
+
+        if (item.type == AJSON_ITEM_INVALID || item.type == AJSON_ITEM_UNSUPPORTED) {
+            RAISE_ERROR(AJSON_ERROR_PARSER_UNEXPECTED_CHAR);
+        }
+
+        if (decoder->state == AJSON_DECODER_CHUNK) {
+            // a chunked string consists of definite length strings up to a break
+            decoder->head_size = 0;
+            if (item.type == AJSON_ITEM_BREAK) {
+                decoder->chunked = false;
+            }
+            else if (item.type != AJSON_ITEM_STRING || item.indefinite) {
+                RAISE_ERROR(AJSON_ERROR_PARSER_UNEXPECTED_CHAR);
+            }
+            else {
+                decoder->remaining = item.value.count;
+            }
+            decoder->state = AJSON_DECODER_STRING;
+            continue;
+        }
+
+        if (item.type == AJSON_ITEM_TAG) {
+            decoder->head_size = 0;
+            continue;
+        }
+
+        if (item.type == AJSON_ITEM_BREAK) {
+            if (!frame || !frame->indefinite || (frame->object && !frame->key)) {
+                RAISE_ERROR(AJSON_ERROR_PARSER_UNEXPECTED_CHAR);
+            }
+            decoder->head_size = 0;
+            token = frame->object ? AJSON_TOK_END_OBJECT : AJSON_TOK_END_ARRAY;
+            -- decoder->depth;
+            parser->skip = AJSON_SKIP_NONE;
+            goto value_done;
+        }
+
+        if (frame && frame->object && frame->key) {
+            if (item.type != AJSON_ITEM_STRING) {
+                RAISE_ERROR(AJSON_ERROR_PARSER_EXPECTED_STRING);
+            }
+        }
+        else if (!decoder->skipping) {
+            if (parser->skip == AJSON_SKIP_SCALAR && !decoder->announced && (item.type == AJSON_ITEM_ARRAY || item.type == AJSON_ITEM_OBJECT)) {
+                // let the caller know before the container is entered, the head is kept
+                parser->skip = AJSON_SKIP_NONE;
+                parser->input_current = index;
+                decoder->announced = true;
+                return AJSON_TOK_CONTAINER;
+            }
+
+            // only ajson_skip_value() can still skip an announced container
+            if (decoder->announced && parser->skip != AJSON_SKIP_VALUE) {
+                parser->skip = AJSON_SKIP_NONE;
+            }
+
+            if (parser->skip != AJSON_SKIP_NONE) {
+                // The skipped value is decoded as usual, but no tokens are returned.
+                parser->skip        = AJSON_SKIP_NONE;
+                decoder->skipping   = true;
+                decoder->skip_depth = decoder->depth;
+            }
+        }
+
+        decoder->announced = false;
+        decoder->head_size = 0;
+
+        switch (item.type) {
+        case AJSON_ITEM_NULL:
+            token = AJSON_TOK_NULL;
+            break;
+
+        case AJSON_ITEM_BOOLEAN:
+            parser->value.boolean = item.value.boolean;
+            token = AJSON_TOK_BOOLEAN;
+            break;
+
+        case AJSON_ITEM_INTEGER:
+            if (parser->flags & AJSON_FLAG_INTEGER) {
+                parser->value.integer = item.value.integer;
+                token = AJSON_TOK_INTEGER;
+            }
+            else {
+                parser->value.number = (double)item.value.integer;
+                token = AJSON_TOK_NUMBER;
+            }
+            break;
+
+        case AJSON_ITEM_NUMBER:
+            if (!(item.value.number >= -DBL_MAX && item.value.number <= DBL_MAX)) {
+                // JSON has no NaN or infinity
+                RAISE_ERROR(AJSON_ERROR_PARSER_RANGE);
+            }
+            parser->value.number = item.value.number;
+            token = AJSON_TOK_NUMBER;
+            break;
+
+        case AJSON_ITEM_STRING:
+            parser->buffer_used = 0;
+            decoder->chunked    = item.indefinite;
+            decoder->remaining  = item.indefinite ? 0 : item.value.count;
+            decoder->state      = AJSON_DECODER_STRING;
+            continue;
+
+        case AJSON_ITEM_ARRAY:
+        case AJSON_ITEM_OBJECT:
+            if (item.type == AJSON_ITEM_OBJECT && item.value.count > UINT64_MAX / 2) {
+                RAISE_ERROR(AJSON_ERROR_PARSER_RANGE);
+            }
+            if (ajson_decoder_push(decoder, &item) != 0) {
+                RAISE_ERROR(AJSON_ERROR_MEMORY);
+            }
+            token = item.type == AJSON_ITEM_OBJECT ? AJSON_TOK_BEGIN_OBJECT : AJSON_TOK_BEGIN_ARRAY;
+            goto emit;
+
+        default:
+            RAISE_ERROR(AJSON_ERROR_PARSER_UNEXPECTED_CHAR);
+        }
+
+    value_done:
+        if (decoder->depth > 0) {
+            frame = decoder->stack + decoder->depth - 1;
+            if (!frame->indefinite) {
+                -- frame->remaining;
+            }
+            if (frame->object) {
+                frame->key = !frame->key;
+            }
+        }
+        else {
+            decoder->done = !(parser->flags & AJSON_FLAG_STREAM);
+        }
+
+    emit:
+        if (decoder->skipping) {
+            if (decoder->depth != decoder->skip_depth || token == AJSON_TOK_BEGIN_ARRAY || token == AJSON_TOK_BEGIN_OBJECT) {
+                continue;
+            }
+            decoder->skipping = false;
+            token = AJSON_TOK_SKIPPED;
+        }
+
+        parser->input_current = index;
+        return token;
+    }
+}
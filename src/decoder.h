@@ -0,0 +1,100 @@
+#ifndef DECODER_H__
+#define DECODER_H__
+#pragma once
+
+#include "ajson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Incremental decoder of binary input (CBOR, MessagePack) that produces the same
+// tokens as the JSON tokenizer. The formats only differ in how an item head is
+// encoded, so they provide two functions to split and interpret heads and the
+// rest (chunking, nesting, skipping) is shared.
+
+#define AJSON_DECODER_HEAD_MAX 9
+
+enum ajson_item_type {
+    AJSON_ITEM_NULL,
+    AJSON_ITEM_BOOLEAN,
+    AJSON_ITEM_INTEGER,
+    AJSON_ITEM_NUMBER,
+    AJSON_ITEM_STRING,
+    AJSON_ITEM_ARRAY,
+    AJSON_ITEM_OBJECT,
+    AJSON_ITEM_BREAK,          // end of an indefinite length item
+    AJSON_ITEM_TAG,            // ignored, the tagged item follows
+    AJSON_ITEM_INVALID,        // reserved or malformed
+    AJSON_ITEM_UNSUPPORTED     // well-formed, but has no JSON equivalent
+};
+
+struct ajson_item {
+    enum ajson_item_type type;
+    bool                 indefinite; // CBOR string or container of indefinite length
+    union {
+        bool     boolean;
+        int64_t  integer;
+        double   number;
+        uint64_t count;   // string length, number of array items or object members
+    } value;
+};
+
+struct ajson_decoder_frame {
+    uint64_t remaining;   // keys and values left in a definite length container
+    bool     indefinite;
+    bool     object;
+    bool     key;         // an object key comes next
+};
+
+enum ajson_decoder_state {
+    AJSON_DECODER_VALUE,  // next item
+    AJSON_DECODER_STRING, // string data
+    AJSON_DECODER_CHUNK,  // next chunk of a chunked string
+    AJSON_DECODER_ERROR
+};
+
+struct ajson_decoder_s {
+    enum ajson_decoder_state    state;
+    size_t                    (*head_length)(unsigned char byte);
+    void                      (*read_item)(const unsigned char *head, struct ajson_item *item);
+    unsigned char               head[AJSON_DECODER_HEAD_MAX];
+    unsigned char               head_size;   // bytes of head read so far
+    unsigned char               head_needed;
+    uint64_t                    remaining;   // string data left in the current chunk
+    bool                        chunked;
+    bool                        done;        // the root value is complete
+    bool                        skipping;
+    bool                        announced;   // AJSON_TOK_CONTAINER was returned for the current head
+    size_t                      skip_depth;  // depth of the skipped value
+    struct ajson_decoder_frame *stack;
+    size_t                      stack_size;
+    size_t                      depth;
+};
+
+// big endian
+static inline uint64_t ajson_decode_uint(const unsigned char *data, size_t width) {
+    uint64_t value = 0;
+    for (size_t index = 0; index < width; ++ index) {
+        value = (value << 8) | data[index];
+    }
+    return value;
+}
+
+// total size of the head that starts with byte
+size_t ajson_cbor_head_length(unsigned char byte);
+void   ajson_cbor_read_item  (const unsigned char *head, struct ajson_item *item);
+
+size_t ajson_msgpack_head_length(unsigned char byte);
+void   ajson_msgpack_read_item  (const unsigned char *head, struct ajson_item *item);
+
+int              ajson_decoder_init   (ajson_parser *parser);
+void             ajson_decoder_reset  (ajson_parser *parser);
+void             ajson_decoder_destroy(ajson_parser *parser);
+enum ajson_token ajson_decode         (ajson_parser *parser);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,470 @@
+#include "ajson.h"
+#include "input.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#   include <emmintrin.h>
+#   define AJSON_USE_SSE2
+#endif
+
+struct ajson_dom_frame_s {
+    size_t start;    // first child in ajson_dom_s::scratch
+    bool   object;
+    bool   want_key;
+};
+
+static uint64_t ajson_dom_hash(const char *key, size_t length) {
+    // FNV-1a
+    uint64_t hash = UINT64_C(14695981039346656037);
+    for (size_t i = 0; i < length; ++ i) {
+        hash ^= (unsigned char)key[i];
+        hash *= UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+// small objects only store one byte of each key hash
+#define AJSON_DOM_TAG(HASH) ((unsigned char)((HASH) >> 56))
+
+static bool ajson_dom_key_equals(const ajson_member *member, const char *key, size_t length) {
+    return member->key_length == length && memcmp(member->key, key, length) == 0;
+}
+
+int ajson_dom_init(ajson_dom *dom, ajson_arena *arena) {
+    if (arena == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(dom, 0, sizeof(ajson_dom));
+    dom->arena = arena;
+
+    return 0;
+}
+
+void ajson_dom_reset(ajson_dom *dom) {
+    dom->root          = NULL;
+    dom->scratch_used  = 0;
+    dom->stack_current = 0;
+}
+
+void ajson_dom_destroy(ajson_dom *dom) {
+    free(dom->scratch);
+    free(dom->stack);
+
+    dom->root          = NULL;
+    dom->scratch       = NULL;
+    dom->scratch_size  = 0;
+    dom->scratch_used  = 0;
+    dom->stack         = NULL;
+    dom->stack_size    = 0;
+    dom->stack_current = 0;
+}
+
+const ajson_value *ajson_dom_get_root(const ajson_dom *dom) {
+    return dom->stack_current == 0 ? dom->root : NULL;
+}
+
+// Children are collected on the scratch stack until their container ends,
+// because only then the size of the contiguous child array is known.
+static ajson_member *ajson_dom_push_child(ajson_dom *dom, ajson_parser *parser) {
+    if (dom->scratch_used == dom->scratch_size) {
+        size_t newsize = dom->scratch_size ? dom->scratch_size * 2 : AJSON_STACK_SIZE;
+        ajson_member *newscratch = newsize > SIZE_MAX / sizeof(ajson_member) ? NULL :
+            realloc(dom->scratch, newsize * sizeof(ajson_member));
+
+        if (newscratch == NULL) {
+            AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+            return NULL;
+        }
+
+        dom->scratch      = newscratch;
+        dom->scratch_size = newsize;
+    }
+
+    return dom->scratch + dom->scratch_used ++;
+}
+
+static int ajson_dom_push_frame(ajson_dom *dom, ajson_parser *parser, bool object) {
+    if (dom->stack_current == dom->stack_size) {
+        size_t newsize = dom->stack_size ? dom->stack_size * 2 : AJSON_STACK_SIZE;
+        struct ajson_dom_frame_s *newstack = newsize > SIZE_MAX / sizeof(struct ajson_dom_frame_s) ? NULL :
+            realloc(dom->stack, newsize * sizeof(struct ajson_dom_frame_s));
+
+        if (newstack == NULL) {
+            AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+            return -1;
+        }
+
+        dom->stack      = newstack;
+        dom->stack_size = newsize;
+    }
+
+    struct ajson_dom_frame_s *frame = dom->stack + dom->stack_current ++;
+    frame->start    = dom->scratch_used;
+    frame->object   = object;
+    frame->want_key = true;
+
+    return 0;
+}
+
+static int ajson_dom_add_value(ajson_dom *dom, ajson_parser *parser, const ajson_value *value) {
+    if (dom->stack_current == 0) {
+        ajson_value *root = ajson_arena_alloc(dom->arena, sizeof(ajson_value));
+        if (root == NULL) {
+            AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+            return -1;
+        }
+        *root = *value;
+        dom->root = root;
+        return 0;
+    }
+
+    struct ajson_dom_frame_s *frame = dom->stack + dom->stack_current - 1;
+
+    if (frame->object) {
+        // the key was already pushed
+        dom->scratch[dom->scratch_used - 1].value = *value;
+        frame->want_key = true;
+        return 0;
+    }
+
+    ajson_member *child = ajson_dom_push_child(dom, parser);
+    if (child == NULL) {
+        return -1;
+    }
+    child->key        = NULL;
+    child->key_length = 0;
+    child->value      = *value;
+
+    return 0;
+}
+
+static const void *ajson_dom_build_lookup(ajson_dom *dom, const ajson_member *members, size_t count) {
+    if (count <= AJSON_DOM_SMALL_OBJECT) {
+        // padded, so always a whole vector can be loaded
+        unsigned char *tags = ajson_arena_alloc(dom->arena, AJSON_DOM_SMALL_OBJECT);
+        if (tags) {
+            memset(tags, 0, AJSON_DOM_SMALL_OBJECT);
+            for (size_t i = 0; i < count; ++ i) {
+                tags[i] = AJSON_DOM_TAG(ajson_dom_hash(members[i].key, members[i].key_length));
+            }
+        }
+        return tags;
+    }
+
+    if (count >= UINT32_MAX / 4) {
+        return NULL;
+    }
+
+    // open addressing with a load factor of at most 0.5
+    size_t capacity = AJSON_DOM_SMALL_OBJECT * 2;
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+
+    // the first element holds the capacity
+    uint32_t *index = ajson_arena_alloc(dom->arena, (capacity + 1) * sizeof(uint32_t));
+    if (index == NULL) {
+        return NULL;
+    }
+    memset(index, 0, (capacity + 1) * sizeof(uint32_t));
+    index[0] = (uint32_t)capacity;
+    ++ index;
+
+    for (size_t i = 0; i < count; ++ i) {
+        size_t slot = (size_t)ajson_dom_hash(members[i].key, members[i].key_length) & (capacity - 1);
+
+        for (;;) {
+            if (index[slot] == 0) {
+                index[slot] = (uint32_t)(i + 1);
+                break;
+            }
+            else if (ajson_dom_key_equals(members + index[slot] - 1, members[i].key, members[i].key_length)) {
+                // the first of duplicate keys wins
+                break;
+            }
+            slot = (slot + 1) & (capacity - 1);
+        }
+    }
+
+    return index - 1;
+}
+
+static int ajson_dom_end_container(ajson_dom *dom, ajson_parser *parser) {
+    struct ajson_dom_frame_s *frame = dom->stack + dom->stack_current - 1;
+    const ajson_member *children = dom->scratch + frame->start;
+    const size_t count = dom->scratch_used - frame->start;
+    ajson_value value;
+
+    if (frame->object) {
+        ajson_member *members = NULL;
+
+        value.type = AJSON_TOK_BEGIN_OBJECT;
+        value.value.object.lookup = NULL;
+
+        if (count) {
+            members = ajson_arena_alloc(dom->arena, count * sizeof(ajson_member));
+            if (members == NULL) {
+                AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+                return -1;
+            }
+            memcpy(members, children, count * sizeof(ajson_member));
+
+            value.value.object.lookup = ajson_dom_build_lookup(dom, members, count);
+            if (value.value.object.lookup == NULL) {
+                AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+                return -1;
+            }
+        }
+
+        value.value.object.members = members;
+        value.value.object.count   = count;
+    }
+    else {
+        ajson_value *items = NULL;
+
+        value.type = AJSON_TOK_BEGIN_ARRAY;
+
+        if (count) {
+            items = ajson_arena_alloc(dom->arena, count * sizeof(ajson_value));
+            if (items == NULL) {
+                AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+                return -1;
+            }
+            for (size_t i = 0; i < count; ++ i) {
+                items[i] = children[i].value;
+            }
+        }
+
+        value.value.array.items = items;
+        value.value.array.count = count;
+    }
+
+    dom->scratch_used = frame->start;
+    -- dom->stack_current;
+
+    return ajson_dom_add_value(dom, parser, &value);
+}
+
+int ajson_dom_add_token(ajson_dom *dom, ajson_parser *parser, enum ajson_token token) {
+    struct ajson_dom_frame_s *frame = dom->stack_current ? dom->stack + dom->stack_current - 1 : NULL;
+    ajson_value value;
+
+    value.type = token;
+
+    switch (token) {
+    case AJSON_TOK_NEED_DATA:
+    case AJSON_TOK_END:
+        return 0;
+
+    case AJSON_TOK_ERROR:
+        return -1;
+
+    case AJSON_TOK_NULL:
+        break;
+
+    case AJSON_TOK_BOOLEAN:
+        value.value.boolean = parser->value.boolean;
+        break;
+
+    case AJSON_TOK_NUMBER:
+        if (parser->flags & (AJSON_FLAG_NUMBER_AS_STRING | AJSON_FLAG_NUMBER_COMPONENTS)) {
+            errno = EINVAL;
+            return -1;
+        }
+        value.value.number = parser->value.number;
+        break;
+
+    case AJSON_TOK_INTEGER:
+        value.value.integer = parser->value.integer;
+        break;
+
+    case AJSON_TOK_STRING:
+    {
+        char *copy = ajson_arena_strndup(dom->arena, parser->value.string.value, parser->value.string.length);
+        if (copy == NULL) {
+            AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+            return -1;
+        }
+
+        if (frame && frame->object && frame->want_key) {
+            ajson_member *member = ajson_dom_push_child(dom, parser);
+            if (member == NULL) {
+                return -1;
+            }
+            member->key        = copy;
+            member->key_length = parser->value.string.length;
+            frame->want_key    = false;
+            return 0;
+        }
+
+        value.value.string.value  = copy;
+        value.value.string.length = parser->value.string.length;
+        break;
+    }
+    case AJSON_TOK_BEGIN_ARRAY:
+    case AJSON_TOK_BEGIN_OBJECT:
+        return ajson_dom_push_frame(dom, parser, token == AJSON_TOK_BEGIN_OBJECT);
+
+    case AJSON_TOK_END_ARRAY:
+    case AJSON_TOK_END_OBJECT:
+        return ajson_dom_end_container(dom, parser);
+
+    default:
+        return 0;
+    }
+
+    return ajson_dom_add_value(dom, parser, &value);
+}
+
+// ========== Input Loops ==========
+
+struct ajson_dom_input_s {
+    struct ajson_input_s input;
+    ajson_dom           *dom;
+};
+
+static const ajson_value *ajson_dom_parse(struct ajson_dom_input_s *input) {
+    ajson_parser *parser = input->input.parser;
+
+    if (parser->flags & (AJSON_FLAG_NUMBER_AS_STRING | AJSON_FLAG_NUMBER_COMPONENTS | AJSON_FLAG_STREAM)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ajson_dom_reset(input->dom);
+
+    if (ajson_input_begin(&input->input) != 0) {
+        return NULL;
+    }
+
+    for (;;) {
+        enum ajson_token token = ajson_next_token(parser);
+
+        if (token == AJSON_TOK_NEED_DATA) {
+            if (ajson_input_read(&input->input) != 0) {
+                return NULL;
+            }
+        }
+        else if (ajson_dom_add_token(input->dom, parser, token) != 0) {
+            return NULL;
+        }
+        else if (token == AJSON_TOK_END) {
+            return ajson_dom_get_root(input->dom);
+        }
+    }
+}
+
+const ajson_value *ajson_dom_parse_fd(ajson_dom *dom, ajson_parser *parser, int fd) {
+    char buf[BUFSIZ];
+    struct ajson_dom_input_s input = { { parser, fd, NULL, buf }, dom };
+
+    return ajson_dom_parse(&input);
+}
+
+const ajson_value *ajson_dom_parse_file(ajson_dom *dom, ajson_parser *parser, FILE* stream) {
+    char buf[BUFSIZ];
+    struct ajson_dom_input_s input = { { parser, -1, stream, buf }, dom };
+
+    return ajson_dom_parse(&input);
+}
+
+const ajson_value *ajson_dom_parse_buf(ajson_dom *dom, ajson_parser *parser, const void* buffer, size_t size) {
+    // the whole document is fed at once, so NEED_DATA means end of input
+    struct ajson_dom_input_s input = { { parser, -1, NULL, NULL }, dom };
+
+    if (ajson_feed(parser, buffer, size) != 0) {
+        return NULL;
+    }
+
+    return ajson_dom_parse(&input);
+}
+
+// ========== Access ==========
+
+size_t ajson_value_size(const ajson_value *value) {
+    if (value == NULL) {
+        return 0;
+    }
+
+    switch (value->type) {
+    case AJSON_TOK_BEGIN_ARRAY:
+        return value->value.array.count;
+
+    case AJSON_TOK_BEGIN_OBJECT:
+        return value->value.object.count;
+
+    case AJSON_TOK_STRING:
+        return value->value.string.length;
+
+    default:
+        return 0;
+    }
+}
+
+const ajson_value *ajson_value_at(const ajson_value *array, size_t index) {
+    if (array == NULL || array->type != AJSON_TOK_BEGIN_ARRAY || index >= array->value.array.count) {
+        return NULL;
+    }
+
+    return array->value.array.items + index;
+}
+
+const ajson_value *ajson_value_get(const ajson_value *object, const char *key) {
+    return ajson_value_get_key(object, key, strlen(key));
+}
+
+const ajson_value *ajson_value_get_key(const ajson_value *object, const char *key, size_t length) {
+    if (object == NULL || object->type != AJSON_TOK_BEGIN_OBJECT || object->value.object.count == 0) {
+        return NULL;
+    }
+
+    const ajson_member *members = object->value.object.members;
+    const size_t        count   = object->value.object.count;
+    const uint64_t      hash    = ajson_dom_hash(key, length);
+
+    if (count <= AJSON_DOM_SMALL_OBJECT) {
+        const unsigned char *tags = object->value.object.lookup;
+        const unsigned char  tag  = AJSON_DOM_TAG(hash);
+
+#ifdef AJSON_USE_SSE2
+        __m128i  chunk = _mm_load_si128((const __m128i*)tags);
+        unsigned mask  = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8((char)tag)));
+
+        mask &= (1u << count) - 1;
+
+        while (mask) {
+            size_t i = (size_t)__builtin_ctz(mask);
+            if (ajson_dom_key_equals(members + i, key, length)) {
+                return &members[i].value;
+            }
+            mask &= mask - 1;
+        }
+#else
+        for (size_t i = 0; i < count; ++ i) {
+            if (tags[i] == tag && ajson_dom_key_equals(members + i, key, length)) {
+                return &members[i].value;
+            }
+        }
+#endif
+        return NULL;
+    }
+
+    const uint32_t *index    = object->value.object.lookup;
+    const size_t    capacity = index[0];
+
+    ++ index;
+
+    for (size_t slot = (size_t)hash & (capacity - 1); index[slot]; slot = (slot + 1) & (capacity - 1)) {
+        const ajson_member *member = members + index[slot] - 1;
+        if (ajson_dom_key_equals(member, key, length)) {
+            return &member->value;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,676 @@
+#include "dtoa.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// Grisu3 by Florian Loitsch, "Printing Floating-Point Numbers Quickly and
+// Accurately with Integers" (2010). It either proves that its result is the
+// shortest representation closest to the value or gives up, in which case an
+// exact algorithm on big integers takes over.
+
+// floating point number f * 2^e with a 64-bit significand
+struct ajson_diyfp {
+    uint64_t f;
+    int      e;
+};
+
+struct ajson_cached_power {
+    uint64_t f;
+    int      e;
+    int      k;
+};
+
+#define AJSON_ALPHA -60
+#define AJSON_GAMMA -32
+
+#define AJSON_CACHED_POWERS_MIN_DEC_EXP -300
+#define AJSON_CACHED_POWERS_DEC_STEP      8
+
+// normalized 10^k for k = -300, -292, ..., 324, rounded to nearest
+static const struct ajson_cached_power ajson_cached_powers[] = {
+    { 0xAB70FE17C79AC6CA, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+    { 0xBE5691EF416BD60C, -1007, -284 },
+    { 0x8DD01FAD907FFC3C,  -980, -276 },
+    { 0xD3515C2831559A83,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5,  -927, -260 },
+    { 0xEA9C227723EE8BCB,  -901, -252 },
+    { 0xAECC49914078536D,  -874, -244 },
+    { 0x823C12795DB6CE57,  -847, -236 },
+    { 0xC21094364DFB5637,  -821, -228 },
+    { 0x9096EA6F3848984F,  -794, -220 },
+    { 0xD77485CB25823AC7,  -768, -212 },
+    { 0xA086CFCD97BF97F4,  -741, -204 },
+    { 0xEF340A98172AACE5,  -715, -196 },
+    { 0xB23867FB2A35B28E,  -688, -188 },
+    { 0x84C8D4DFD2C63F3B,  -661, -180 },
+    { 0xC5DD44271AD3CDBA,  -635, -172 },
+    { 0x936B9FCEBB25C996,  -608, -164 },
+    { 0xDBAC6C247D62A584,  -582, -156 },
+    { 0xA3AB66580D5FDAF6,  -555, -148 },
+    { 0xF3E2F893DEC3F126,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8,  -502, -132 },
+    { 0x87625F056C7C4A8B,  -475, -124 },
+    { 0xC9BCFF6034C13053,  -449, -116 },
+    { 0x964E858C91BA2655,  -422, -108 },
+    { 0xDFF9772470297EBD,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+    { 0xF8A95FCF88747D94,  -343,  -84 },
+    { 0xB94470938FA89BCF,  -316,  -76 },
+    { 0x8A08F0F8BF0F156B,  -289,  -68 },
+    { 0xCDB02555653131B6,  -263,  -60 },
+    { 0x993FE2C6D07B7FAC,  -236,  -52 },
+    { 0xE45C10C42A2B3B06,  -210,  -44 },
+    { 0xAA242499697392D3,  -183,  -36 },
+    { 0xFD87B5F28300CA0E,  -157,  -28 },
+    { 0xBCE5086492111AEB,  -130,  -20 },
+    { 0x8CBCCC096F5088CC,  -103,  -12 },
+    { 0xD1B71758E219652C,   -77,   -4 },
+    { 0x9C40000000000000,   -50,    4 },
+    { 0xE8D4A51000000000,   -24,   12 },
+    { 0xAD78EBC5AC620000,     3,   20 },
+    { 0x813F3978F8940984,    30,   28 },
+    { 0xC097CE7BC90715B3,    56,   36 },
+    { 0x8F7E32CE7BEA5C70,    83,   44 },
+    { 0xD5D238A4ABE98068,   109,   52 },
+    { 0x9F4F2726179A2245,   136,   60 },
+    { 0xED63A231D4C4FB27,   162,   68 },
+    { 0xB0DE65388CC8ADA8,   189,   76 },
+    { 0x83C7088E1AAB65DB,   216,   84 },
+    { 0xC45D1DF942711D9A,   242,   92 },
+    { 0x924D692CA61BE758,   269,  100 },
+    { 0xDA01EE641A708DEA,   295,  108 },
+    { 0xA26DA3999AEF774A,   322,  116 },
+    { 0xF209787BB47D6B85,   348,  124 },
+    { 0xB454E4A179DD1877,   375,  132 },
+    { 0x865B86925B9BC5C2,   402,  140 },
+    { 0xC83553C5C8965D3D,   428,  148 },
+    { 0x952AB45CFA97A0B3,   455,  156 },
+    { 0xDE469FBD99A05FE3,   481,  164 },
+    { 0xA59BC234DB398C25,   508,  172 },
+    { 0xF6C69A72A3989F5C,   534,  180 },
+    { 0xB7DCBF5354E9BECE,   561,  188 },
+    { 0x88FCF317F22241E2,   588,  196 },
+    { 0xCC20CE9BD35C78A5,   614,  204 },
+    { 0x98165AF37B2153DF,   641,  212 },
+    { 0xE2A0B5DC971F303A,   667,  220 },
+    { 0xA8D9D1535CE3B396,   694,  228 },
+    { 0xFB9B7CD9A4A7443C,   720,  236 },
+    { 0xBB764C4CA7A44410,   747,  244 },
+    { 0x8BAB8EEFB6409C1A,   774,  252 },
+    { 0xD01FEF10A657842C,   800,  260 },
+    { 0x9B10A4E5E9913129,   827,  268 },
+    { 0xE7109BFBA19C0C9D,   853,  276 },
+    { 0xAC2820D9623BF429,   880,  284 },
+    { 0x80444B5E7AA7CF85,   907,  292 },
+    { 0xBF21E44003ACDD2D,   933,  300 },
+    { 0x8E679C2F5E44FF8F,   960,  308 },
+    { 0xD433179D9C8CB841,   986,  316 },
+    { 0x9E19DB92B4E31BA9,  1013,  324 }
+};
+
+static inline struct ajson_diyfp ajson_diyfp_make(uint64_t f, int e) {
+    struct ajson_diyfp x = { f, e };
+    return x;
+}
+
+static inline struct ajson_diyfp ajson_diyfp_sub(struct ajson_diyfp x, struct ajson_diyfp y) {
+    return ajson_diyfp_make(x.f - y.f, x.e);
+}
+
+// upper 64 bits of the 128-bit product, rounded
+static inline struct ajson_diyfp ajson_diyfp_mul(struct ajson_diyfp x, struct ajson_diyfp y) {
+    const uint64_t x_lo = x.f & 0xFFFFFFFFu;
+    const uint64_t x_hi = x.f >> 32;
+    const uint64_t y_lo = y.f & 0xFFFFFFFFu;
+    const uint64_t y_hi = y.f >> 32;
+
+    const uint64_t p0 = x_lo * y_lo;
+    const uint64_t p1 = x_lo * y_hi;
+    const uint64_t p2 = x_hi * y_lo;
+    const uint64_t p3 = x_hi * y_hi;
+
+    uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+    q += UINT64_C(1) << 31;
+
+    return ajson_diyfp_make(p3 + (p1 >> 32) + (p2 >> 32) + (q >> 32), x.e + y.e + 64);
+}
+
+static inline struct ajson_diyfp ajson_diyfp_normalize(struct ajson_diyfp x) {
+    while ((x.f >> 63) == 0) {
+        x.f <<= 1;
+        x.e --;
+    }
+    return x;
+}
+
+static inline struct ajson_diyfp ajson_diyfp_normalize_to(struct ajson_diyfp x, int e) {
+    return ajson_diyfp_make(x.f << (x.e - e), e);
+}
+
+// the number and the boundaries of the interval of numbers that round to it
+static void ajson_compute_boundaries(double value, struct ajson_diyfp *minus, struct ajson_diyfp *v, struct ajson_diyfp *plus) {
+    const uint64_t hidden_bit = UINT64_C(1) << 52;
+    const int      bias       = 1023 + 52;
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint64_t fraction = bits & (hidden_bit - 1);
+    const int      exponent = (int)((bits >> 52) & 0x7FF);
+
+    struct ajson_diyfp w = exponent == 0 ?
+        ajson_diyfp_make(fraction, 1 - bias) :
+        ajson_diyfp_make(fraction + hidden_bit, exponent - bias);
+
+    // the lower boundary is closer if the fraction is 0 (except for the smallest normal number)
+    struct ajson_diyfp m_plus  = ajson_diyfp_make(2 * w.f + 1, w.e - 1);
+    struct ajson_diyfp m_minus = fraction == 0 && exponent > 1 ?
+        ajson_diyfp_make(4 * w.f - 1, w.e - 2) :
+        ajson_diyfp_make(2 * w.f - 1, w.e - 1);
+
+    *plus  = ajson_diyfp_normalize(m_plus);
+    *minus = ajson_diyfp_normalize_to(m_minus, plus->e);
+    *v     = ajson_diyfp_normalize(w);
+}
+
+// cached power c = 10^k with AJSON_ALPHA <= c.e + e + 64 <= AJSON_GAMMA
+static inline struct ajson_cached_power ajson_cached_power(int e) {
+    // ceil(log10(2^(AJSON_ALPHA - e - 1)))
+    const int f = AJSON_ALPHA - e - 1;
+    const int k = (f * 78913) / (1 << 18) + (f > 0);
+
+    const int index = (-AJSON_CACHED_POWERS_MIN_DEC_EXP + k + (AJSON_CACHED_POWERS_DEC_STEP - 1)) / AJSON_CACHED_POWERS_DEC_STEP;
+
+    return ajson_cached_powers[index];
+}
+
+// largest power of 10 <= n, n > 0
+static inline int ajson_largest_pow10(uint32_t n, uint32_t *pow10) {
+    static const uint32_t powers[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+
+    int count = 10;
+    while (count > 1 && n < powers[count - 1]) {
+        -- count;
+    }
+    *pow10 = powers[count - 1];
+
+    return count;
+}
+
+// Weeds out the candidates of the last digit that are too far from w. Returns
+// false if the rounding of the products leaves it open whether the result is
+// the shortest representation closest to the value.
+static inline bool ajson_grisu3_round(char *buffer, size_t length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k, uint64_t unit) {
+    // w lies somewhere in (dist - unit, dist + unit) below too_high
+    const uint64_t small_dist = dist - unit;
+    const uint64_t big_dist   = dist + unit;
+
+    // move the last digit down while that gets closer to the exact value
+    while (rest < small_dist && delta - rest >= ten_k &&
+           (rest + ten_k < small_dist || small_dist - rest >= rest + ten_k - small_dist)) {
+        buffer[length - 1] --;
+        rest += ten_k;
+    }
+
+    // one more step down might be closer to the exact value as well
+    if (rest < big_dist && delta - rest >= ten_k &&
+        (rest + ten_k < big_dist || big_dist - rest > rest + ten_k - big_dist)) {
+        return false;
+    }
+
+    // the result has to lie safely inside the interval
+    return 2 * unit <= rest && rest <= delta - 4 * unit;
+}
+
+// generates the shortest digits of a number in the unsafe interval (too_low, too_high)
+// close to w, too_low and too_high being one unit outside of the boundaries
+static bool ajson_grisu3_digits(char *buffer, size_t *length, int *exponent, struct ajson_diyfp minus, struct ajson_diyfp w, struct ajson_diyfp plus) {
+    uint64_t unit = 1;
+
+    const struct ajson_diyfp too_low  = ajson_diyfp_make(minus.f - unit, minus.e);
+    const struct ajson_diyfp too_high = ajson_diyfp_make(plus.f  + unit, plus.e);
+
+    uint64_t delta = ajson_diyfp_sub(too_high, too_low).f;
+    uint64_t dist  = ajson_diyfp_sub(too_high, w).f;
+
+    const struct ajson_diyfp one = ajson_diyfp_make(UINT64_C(1) << -w.e, w.e);
+
+    uint32_t p1 = (uint32_t)(too_high.f >> -one.e);
+    uint64_t p2 = too_high.f & (one.f - 1);
+
+    *length = 0;
+
+    // integral part
+    uint32_t pow10;
+    int      count = ajson_largest_pow10(p1, &pow10);
+
+    while (count > 0) {
+        buffer[(*length) ++] = (char)('0' + p1 / pow10);
+        p1 %= pow10;
+        -- count;
+
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest < delta) {
+            *exponent += count;
+            return ajson_grisu3_round(buffer, *length, dist, delta, rest, (uint64_t)pow10 << -one.e, unit);
+        }
+
+        pow10 /= 10;
+    }
+
+    // fractional part
+    int places = 0;
+    for (;;) {
+        p2 *= 10;
+        buffer[(*length) ++] = (char)('0' + (p2 >> -one.e));
+        p2 &= one.f - 1;
+        ++ places;
+
+        unit  *= 10;
+        delta *= 10;
+
+        if (p2 < delta) {
+            break;
+        }
+    }
+
+    *exponent -= places;
+
+    return ajson_grisu3_round(buffer, *length, dist * unit, delta, p2, one.f, unit);
+}
+
+// Grisu3 of value > 0: digits and exponent so that value = digits * 10^exponent.
+// Returns 0 for the about 0.5% of doubles where it can't prove the result.
+static size_t ajson_grisu3(char *buffer, int *exponent, double value) {
+    struct ajson_diyfp m_minus, v, m_plus;
+    ajson_compute_boundaries(value, &m_minus, &v, &m_plus);
+
+    const struct ajson_cached_power cached = ajson_cached_power(m_plus.e);
+    const struct ajson_diyfp c = ajson_diyfp_make(cached.f, cached.e);
+
+    const struct ajson_diyfp w       = ajson_diyfp_mul(v, c);
+    const struct ajson_diyfp w_minus = ajson_diyfp_mul(m_minus, c);
+    const struct ajson_diyfp w_plus  = ajson_diyfp_mul(m_plus, c);
+
+    size_t length;
+    *exponent = -cached.k;
+
+    if (!ajson_grisu3_digits(buffer, &length, exponent, w_minus, w, w_plus)) {
+        return 0;
+    }
+
+    return length;
+}
+
+// Exact fallback: the free-format algorithm of Steele & White and Burger & Dybvig
+// ("Printing Floating-Point Numbers Quickly and Accurately", 1996) with big
+// integers. value = r / s * 10^k and m_minus, m_plus are the distances to the
+// boundaries, all scaled by the same factor.
+
+// enough for 2^1076 * 10^324 * 10
+#define AJSON_BIGNUM_WORDS 40
+
+struct ajson_bignum {
+    uint32_t words[AJSON_BIGNUM_WORDS];
+    int      used;
+};
+
+static void ajson_bignum_set(struct ajson_bignum *x, uint64_t value) {
+    x->words[0] = (uint32_t)value;
+    x->words[1] = (uint32_t)(value >> 32);
+    x->used = x->words[1] ? 2 : x->words[0] ? 1 : 0;
+}
+
+static void ajson_bignum_mul(struct ajson_bignum *x, uint32_t factor) {
+    uint64_t carry = 0;
+
+    for (int index = 0; index < x->used; ++ index) {
+        const uint64_t product = (uint64_t)x->words[index] * factor + carry;
+        x->words[index] = (uint32_t)product;
+        carry = product >> 32;
+    }
+
+    if (carry) {
+        x->words[x->used ++] = (uint32_t)carry;
+    }
+}
+
+static void ajson_bignum_mul_pow10(struct ajson_bignum *x, int n) {
+    static const uint32_t powers[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+
+    for (; n >= 9; n -= 9) {
+        ajson_bignum_mul(x, powers[9]);
+    }
+    ajson_bignum_mul(x, powers[n]);
+}
+
+static void ajson_bignum_shift(struct ajson_bignum *x, int n) {
+    const int words = n / 32;
+    const int bits  = n % 32;
+
+    if (x->used == 0) {
+        return;
+    }
+
+    if (bits) {
+        uint32_t carry = 0;
+        for (int index = 0; index < x->used; ++ index) {
+            const uint32_t word = x->words[index];
+            x->words[index] = (word << bits) | carry;
+            carry = word >> (32 - bits);
+        }
+        if (carry) {
+            x->words[x->used ++] = carry;
+        }
+    }
+
+    if (words) {
+        memmove(x->words + words, x->words, x->used * sizeof(uint32_t));
+        memset(x->words, 0, words * sizeof(uint32_t));
+        x->used += words;
+    }
+}
+
+static int ajson_bignum_compare(const struct ajson_bignum *x, const struct ajson_bignum *y) {
+    if (x->used != y->used) {
+        return x->used < y->used ? -1 : 1;
+    }
+
+    for (int index = x->used - 1; index >= 0; -- index) {
+        if (x->words[index] != y->words[index]) {
+            return x->words[index] < y->words[index] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+static void ajson_bignum_add(struct ajson_bignum *sum, const struct ajson_bignum *x, const struct ajson_bignum *y) {
+    const int used  = x->used > y->used ? x->used : y->used;
+    uint64_t  carry = 0;
+
+    for (int index = 0; index < used; ++ index) {
+        carry += (uint64_t)(index < x->used ? x->words[index] : 0) + (index < y->used ? y->words[index] : 0);
+        sum->words[index] = (uint32_t)carry;
+        carry >>= 32;
+    }
+
+    sum->used = used;
+    if (carry) {
+        sum->words[sum->used ++] = (uint32_t)carry;
+    }
+}
+
+// x -= y, x >= y
+static void ajson_bignum_sub(struct ajson_bignum *x, const struct ajson_bignum *y) {
+    int64_t borrow = 0;
+
+    for (int index = 0; index < x->used; ++ index) {
+        borrow += (int64_t)x->words[index] - (index < y->used ? y->words[index] : 0);
+        x->words[index] = (uint32_t)borrow;
+        borrow = borrow < 0 ? -1 : 0;
+    }
+
+    while (x->used > 0 && x->words[x->used - 1] == 0) {
+        -- x->used;
+    }
+}
+
+// compares x + y with z
+static int ajson_bignum_plus_compare(const struct ajson_bignum *x, const struct ajson_bignum *y, const struct ajson_bignum *z) {
+    struct ajson_bignum sum;
+    ajson_bignum_add(&sum, x, y);
+
+    return ajson_bignum_compare(&sum, z);
+}
+
+static size_t ajson_dragon4(char *buffer, int *exponent, double value) {
+    const uint64_t hidden_bit = UINT64_C(1) << 52;
+    const int      bias       = 1023 + 52;
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint64_t fraction = bits & (hidden_bit - 1);
+    const int      biased_e = (int)((bits >> 52) & 0x7FF);
+
+    const uint64_t f = biased_e == 0 ? fraction : fraction + hidden_bit;
+    const int      e = biased_e == 0 ? 1 - bias : biased_e - bias;
+
+    // the boundaries are part of the interval if f is even (ties round to even)
+    const bool even = (f & 1) == 0;
+
+    // the lower boundary is closer if the fraction is 0 (except for the smallest normal number)
+    const bool closer = fraction == 0 && biased_e > 1;
+
+    struct ajson_bignum r, s, m_minus, m_plus;
+
+    ajson_bignum_set(&r, f);
+    ajson_bignum_set(&s, 1);
+    ajson_bignum_set(&m_minus, 1);
+
+    // r / s = 2 * value (or 4 * value), m_minus is half an ulp on that scale
+    if (e >= 0) {
+        ajson_bignum_shift(&r, e + 1 + closer);
+        ajson_bignum_shift(&s, 1 + closer);
+        ajson_bignum_shift(&m_minus, e);
+    }
+    else {
+        ajson_bignum_shift(&r, 1 + closer);
+        ajson_bignum_shift(&s, 1 + closer - e);
+    }
+
+    m_plus = m_minus;
+    if (closer) {
+        ajson_bignum_shift(&m_plus, 1);
+    }
+
+    // estimate k = ceil(log10(value)), which may be one too small
+    int bit_length = 0;
+    while (bit_length < 64 && (f >> bit_length) != 0) {
+        ++ bit_length;
+    }
+
+    int k = (int)ceil((e + bit_length - 1) * 0.30102999566398114 - 1e-10);
+
+    if (k >= 0) {
+        ajson_bignum_mul_pow10(&s, k);
+    }
+    else {
+        ajson_bignum_mul_pow10(&r,       -k);
+        ajson_bignum_mul_pow10(&m_minus, -k);
+        ajson_bignum_mul_pow10(&m_plus,  -k);
+    }
+
+    // fix the estimate so that the upper boundary is below 10^k
+    const int high = ajson_bignum_plus_compare(&r, &m_plus, &s);
+    if (even ? high >= 0 : high > 0) {
+        ajson_bignum_mul(&s, 10);
+        ++ k;
+    }
+
+    size_t length = 0;
+
+    for (;;) {
+        ajson_bignum_mul(&r,       10);
+        ajson_bignum_mul(&m_minus, 10);
+        ajson_bignum_mul(&m_plus,  10);
+
+        int digit = 0;
+        while (ajson_bignum_compare(&r, &s) >= 0) {
+            ajson_bignum_sub(&r, &s);
+            ++ digit;
+        }
+
+        const int  low_cmp   = ajson_bignum_compare(&r, &m_minus);
+        const int  high_cmp  = ajson_bignum_plus_compare(&r, &m_plus, &s);
+        const bool low_done  = even ? low_cmp <= 0 : low_cmp < 0;
+        const bool high_done = even ? high_cmp >= 0 : high_cmp > 0;
+
+        if (!low_done && !high_done) {
+            buffer[length ++] = (char)('0' + digit);
+            continue;
+        }
+
+        if (low_done && high_done) {
+            // both digits read back as value, take the closer one (the even one on a tie)
+            const int half = ajson_bignum_plus_compare(&r, &r, &s);
+            if (half > 0 || (half == 0 && (digit & 1))) {
+                ++ digit;
+            }
+        }
+        else if (high_done) {
+            ++ digit;
+        }
+
+        buffer[length ++] = (char)('0' + digit);
+        break;
+    }
+
+    *exponent = k - (int)length;
+
+    return length;
+}
+
+size_t ajson_format_double(char *buffer, double value) {
+    char *ptr = buffer;
+
+    if (signbit(value)) {
+        *ptr ++ = '-';
+        value = -value;
+    }
+
+    if (value == 0) {
+        *ptr ++ = '0';
+        return ptr - buffer;
+    }
+
+    char digits[20];
+    int  exponent;
+    int  length = (int)ajson_grisu3(digits, &exponent, value);
+
+    if (length == 0) {
+        length = (int)ajson_dragon4(digits, &exponent, value);
+    }
+
+    // position of the decimal point relative to the first digit
+    const int point = length + exponent;
+
+    if (point > -4 && point <= 17) {
+        if (point >= length) {
+            // integer
+            memcpy(ptr, digits, length);
+            memset(ptr + length, '0', point - length);
+            ptr += point;
+        }
+        else if (point > 0) {
+            memcpy(ptr, digits, point);
+            ptr[point] = '.';
+            memcpy(ptr + point + 1, digits + point, length - point);
+            ptr += length + 1;
+        }
+        else {
+            *ptr ++ = '0';
+            *ptr ++ = '.';
+            memset(ptr, '0', -point);
+            ptr += -point;
+            memcpy(ptr, digits, length);
+            ptr += length;
+        }
+    }
+    else {
+        *ptr ++ = digits[0];
+        if (length > 1) {
+            *ptr ++ = '.';
+            memcpy(ptr, digits + 1, length - 1);
+            ptr += length - 1;
+        }
+
+        int e = point - 1;
+        *ptr ++ = 'e';
+        if (e < 0) {
+            *ptr ++ = '-';
+            e = -e;
+        }
+        else {
+            *ptr ++ = '+';
+        }
+
+        if (e >= 100) {
+            *ptr ++ = (char)('0' + e / 100);
+            e %= 100;
+        }
+        *ptr ++ = (char)('0' + e / 10);
+        *ptr ++ = (char)('0' + e % 10);
+    }
+
+    return ptr - buffer;
+}
+
+size_t ajson_format_fixed(char *buffer, double value, int decimals) {
+    static const double powers[AJSON_DECIMALS_MAX + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+    };
+
+    const double magnitude = fabs(value);
+
+    // the integer part has to fit into 64 bits
+    if (!(magnitude < 18446744073709551616.0)) {
+        return ajson_format_double(buffer, value);
+    }
+
+    // both parts are exact, every double of 2^52 and above is an integer
+    const double ipart = floor(magnitude);
+    const double fpart = magnitude - ipart;
+
+    // fpart * 10^decimals is below 10^15 and rounded to at most 1/128. A
+    // product that is rounded onto a tie is decided by its rounding error.
+    const double product = fpart * powers[decimals];
+    double       scaled  = floor(product);
+    if (product - scaled > 0.5 || (product - scaled == 0.5 && fma(fpart, powers[decimals], -product) >= 0)) {
+        scaled += 1;
+    }
+
+    uint64_t integer  = (uint64_t)ipart;
+    uint64_t fraction = (uint64_t)scaled;
+    if (scaled == powers[decimals]) {
+        // ipart is below 2^52 here, so this can't wrap
+        integer += 1;
+        fraction = 0;
+    }
+
+    char *ptr = buffer;
+
+    if (value < 0 && (integer != 0 || fraction != 0)) {
+        *ptr ++ = '-';
+    }
+
+    char digits[20];
+    int  length = 0;
+    do {
+        digits[length ++] = (char)('0' + integer % 10);
+        integer /= 10;
+    } while (integer != 0);
+
+    while (length > 0) {
+        *ptr ++ = digits[-- length];
+    }
+
+    if (decimals > 0) {
+        *ptr ++ = '.';
+        for (int index = decimals; index > 0; -- index) {
+            ptr[index - 1] = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        ptr += decimals;
+    }
+
+    return ptr - buffer;
+}
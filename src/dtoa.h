@@ -0,0 +1,31 @@
+#ifndef DTOA_H__
+#define DTOA_H__
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Both need a buffer of AJSON_DTOA_BUFFER_SIZE bytes, write no terminating null
+// byte and return the number of written characters. value has to be finite.
+#define AJSON_DTOA_BUFFER_SIZE 40
+
+#define AJSON_DECIMALS_MAX 15
+
+// Shortest representation that reads back as the same double, the closest one
+// if there are several (Grisu3 with an exact fallback). Uses the layout of
+// "%.17g", except that it never writes needless digits.
+size_t ajson_format_double(char *buffer, double value);
+
+// value rounded half away from zero to decimals (0 ... AJSON_DECIMALS_MAX)
+// decimal places. Only values of 2^64 and above, whose integer part overflows,
+// are written like ajson_format_double().
+size_t ajson_format_fixed(char *buffer, double value, int decimals);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef EMIT_H__
+#define EMIT_H__
+#pragma once
+
+#include <string.h>
+
+#include "ajson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Shared output of the binary writers: every item is a short head followed by
+// an optional payload (string data), which are copied into the caller's buffer
+// as far as it fits. The rest is written by subsequent ajson_emit() calls.
+
+static inline void ajson_emit_begin(struct ajson_emit_s *emit) {
+    emit->head_size    = 0;
+    emit->head_written = 0;
+    emit->payload      = NULL;
+    emit->payload_end  = NULL;
+}
+
+// big endian
+static inline void ajson_emit_head(struct ajson_emit_s *emit, unsigned char byte, uint64_t value, unsigned int width) {
+    emit->head[emit->head_size ++] = byte;
+    for (unsigned int shift = width * 8; shift > 0; shift -= 8) {
+        emit->head[emit->head_size ++] = (unsigned char)(value >> (shift - 8));
+    }
+}
+
+static inline ssize_t ajson_emit(struct ajson_emit_s *emit, unsigned char *buffer, size_t size) {
+    size_t index = emit->head_size - emit->head_written;
+
+    if (index > size) {
+        index = size;
+    }
+    memcpy(buffer, emit->head + emit->head_written, index);
+    emit->head_written += index;
+
+    size_t count = (size_t)(emit->payload_end - emit->payload);
+    if (count > size - index) {
+        count = size - index;
+    }
+    if (count > 0) {
+        memcpy(buffer + index, emit->payload, count);
+        emit->payload += count;
+        index += count;
+    }
+
+    return (ssize_t)index;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef ERROR_H__
+#define ERROR_H__
+#pragma once
+
+#include "ajson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Records a parser error together with the C source location that raised it.
+#define AJSON_SET_ERROR(PARSER, ERR) \
+    do { \
+        (PARSER)->value.error.error    = (ERR); \
+        (PARSER)->value.error.filename = __FILE__; \
+        (PARSER)->value.error.function = __func__; \
+        (PARSER)->value.error.lineno   = __LINE__; \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,236 @@
+#include "filter.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+static void ajson_filter_pattern_free(struct ajson_filter_pattern *pattern) {
+    free(pattern->data);
+    free(pattern->segments);
+    pattern->data     = NULL;
+    pattern->segments = NULL;
+    pattern->size     = 0;
+}
+
+// Parses a JSON Pointer (RFC 6901) where the reference token "*" matches any
+// object key and any array index.
+static int ajson_filter_pattern_parse(struct ajson_filter_pattern *pattern, const char *str) {
+    size_t size = 0;
+    for (const char *ptr = str; *ptr; ++ ptr) {
+        if (*ptr == '/') {
+            ++ size;
+        }
+    }
+
+    char *data = malloc(strlen(str) + 1);
+    struct ajson_filter_segment *segments = size ? calloc(size, sizeof(struct ajson_filter_segment)) : NULL;
+
+    if (data == NULL || (size && segments == NULL)) {
+        free(data);
+        free(segments);
+        return -1;
+    }
+
+    pattern->data     = data;
+    pattern->segments = segments;
+    pattern->size     = size;
+
+    const char *in  = str;
+    char       *out = data;
+    for (size_t i = 0; i < size; ++ i) {
+        struct ajson_filter_segment *segment = segments + i;
+
+        ++ in; // '/'
+        segment->key = out;
+        while (*in && *in != '/') {
+            if (*in == '~') {
+                ++ in;
+                if (*in == '0') {
+                    *out ++ = '~';
+                }
+                else if (*in == '1') {
+                    *out ++ = '/';
+                }
+                else {
+                    ajson_filter_pattern_free(pattern);
+                    errno = EINVAL;
+                    return -1;
+                }
+                ++ in;
+            }
+            else {
+                *out ++ = *in ++;
+            }
+        }
+        segment->length   = out - segment->key;
+        segment->wildcard = segment->length == 1 && segment->key[0] == '*';
+        segment->index    = SIZE_MAX;
+
+        // array indices are decimal numbers without leading zeros
+        if (segment->length > 0 && (segment->length == 1 || segment->key[0] != '0')) {
+            size_t index = 0;
+            size_t j = 0;
+            for (; j < segment->length; ++ j) {
+                char ch = segment->key[j];
+                if (ch < '0' || ch > '9' || index > (SIZE_MAX - 1 - (ch - '0')) / 10) {
+                    break;
+                }
+                index = index * 10 + (ch - '0');
+            }
+            if (j == segment->length) {
+                segment->index = index;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int ajson_add_filter(ajson_parser *parser, const char *pattern) {
+    return ajson_filter_add(parser, pattern, false);
+}
+
+// A shallow filter reports the value it matches, but if that value is an array
+// or object only its begin and end tokens are returned.
+int ajson_filter_add(ajson_parser *parser, const char *pattern, bool shallow) {
+    if (pattern == NULL || (*pattern && *pattern != '/')) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (parser->stack_current != 0 || (parser->stack && parser->stack[0] != 0)) {
+        // already parsing
+        errno = EBUSY;
+        return -1;
+    }
+
+    struct ajson_filter_s *filter = parser->filter;
+    if (filter == NULL) {
+        filter = calloc(1, sizeof(struct ajson_filter_s));
+        if (filter == NULL) {
+            return -1;
+        }
+        parser->filter = filter;
+    }
+
+    if (filter->count == AJSON_FILTER_MAX) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    struct ajson_filter_pattern *compiled = filter->patterns + filter->count;
+    if (ajson_filter_pattern_parse(compiled, pattern) != 0) {
+        return -1;
+    }
+
+    // a container matched by a shallow filter needs a frame of its own
+    const size_t stack_size = compiled->size + shallow;
+    if (filter->stack_size < stack_size) {
+        struct ajson_filter_frame *stack = realloc(filter->stack, stack_size * sizeof(struct ajson_filter_frame));
+        if (stack == NULL) {
+            ajson_filter_pattern_free(compiled);
+            return -1;
+        }
+        filter->stack      = stack;
+        filter->stack_size = stack_size;
+    }
+
+    const uint64_t bit = UINT64_C(1) << filter->count;
+    if (shallow) {
+        filter->shallow |= bit;
+    }
+    if (compiled->size == 0) {
+        filter->root_matched |= bit;
+    }
+    else {
+        filter->root_partial |= bit;
+    }
+
+    ajson_filter_reset(filter);
+
+    return (int)(filter->count ++);
+}
+
+void ajson_clear_filters(ajson_parser *parser) {
+    if (parser->filter) {
+        ajson_filter_free(parser->filter);
+        parser->filter = NULL;
+    }
+    parser->skip = AJSON_SKIP_NONE;
+}
+
+uint64_t ajson_get_filter_matches(const ajson_parser *parser) {
+    return parser->filter ? parser->filter->matches : 0;
+}
+
+void ajson_filter_reset(struct ajson_filter_s *filter) {
+    filter->depth   = 0;
+    filter->inside  = 0;
+    filter->partial = filter->root_partial;
+    filter->matched = filter->root_matched;
+    filter->matches = 0;
+    filter->held    = false;
+    filter->resume  = false;
+}
+
+void ajson_filter_free(struct ajson_filter_s *filter) {
+    for (size_t i = 0; i < filter->count; ++ i) {
+        ajson_filter_pattern_free(filter->patterns + i);
+    }
+    free(filter->stack);
+    free(filter);
+}
+
+void ajson_filter_key(struct ajson_filter_s *filter, const char *key, size_t length) {
+    const struct ajson_filter_frame *frame = filter->stack + filter->depth - 1;
+    const size_t level = filter->depth - 1;
+    uint64_t partial = 0;
+    uint64_t matched = frame->matched & ~filter->shallow;
+
+    for (size_t i = 0; i < filter->count; ++ i) {
+        const uint64_t bit = UINT64_C(1) << i;
+        if (frame->partial & bit) {
+            const struct ajson_filter_pattern *pattern = filter->patterns + i;
+            const struct ajson_filter_segment *segment = pattern->segments + level;
+
+            if (segment->wildcard || (segment->length == length && memcmp(segment->key, key, length) == 0)) {
+                if (level + 1 == pattern->size) {
+                    matched |= bit;
+                }
+                else {
+                    partial |= bit;
+                }
+            }
+        }
+    }
+
+    filter->partial = partial;
+    filter->matched = matched;
+}
+
+void ajson_filter_index(struct ajson_filter_s *filter, size_t index) {
+    const struct ajson_filter_frame *frame = filter->stack + filter->depth - 1;
+    const size_t level = filter->depth - 1;
+    uint64_t partial = 0;
+    uint64_t matched = frame->matched & ~filter->shallow;
+
+    for (size_t i = 0; i < filter->count; ++ i) {
+        const uint64_t bit = UINT64_C(1) << i;
+        if (frame->partial & bit) {
+            const struct ajson_filter_pattern *pattern = filter->patterns + i;
+            const struct ajson_filter_segment *segment = pattern->segments + level;
+
+            if (segment->wildcard || segment->index == index) {
+                if (level + 1 == pattern->size) {
+                    matched |= bit;
+                }
+                else {
+                    partial |= bit;
+                }
+            }
+        }
+    }
+
+    filter->partial = partial;
+    filter->matched = matched;
+}
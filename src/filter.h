@@ -0,0 +1,72 @@
+#ifndef FILTER_H__
+#define FILTER_H__
+#pragma once
+
+#include "ajson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// internal tokens that are never returned by ajson_next_token()
+#define AJSON_TOK_SKIPPED   ((enum ajson_token)(AJSON_TOK_ERROR + 1)) // a value was skipped
+#define AJSON_TOK_CONTAINER ((enum ajson_token)(AJSON_TOK_ERROR + 2)) // an array or object follows
+
+enum ajson_skip {
+    AJSON_SKIP_NONE,
+    AJSON_SKIP_VALUE,  // skip the next value
+    AJSON_SKIP_SCALAR  // skip the next value if it is no array or object
+};
+
+struct ajson_filter_segment {
+    const char *key;      // unescaped reference token
+    size_t      length;
+    size_t      index;    // reference token as array index or SIZE_MAX
+    bool        wildcard;
+};
+
+struct ajson_filter_pattern {
+    char                        *data; // storage for the unescaped reference tokens
+    struct ajson_filter_segment *segments;
+    size_t                       size;
+};
+
+struct ajson_filter_frame {
+    uint64_t partial; // filters that still need to match below this container
+    uint64_t matched; // filters that matched this container or one of its parents
+    size_t   index;   // index of the current array element
+    bool     object;
+    bool     key;     // an object key comes next
+};
+
+struct ajson_filter_s {
+    struct ajson_filter_pattern patterns[AJSON_FILTER_MAX];
+    size_t                      count;
+    uint64_t                    shallow;  // filters that don't match the contents of matched containers
+    uint64_t                    root_partial;
+    uint64_t                    root_matched;
+    // Frames are only needed for containers that filters still have to
+    // descend into or that shallow filters matched, so there are never more
+    // than the longest filter has reference tokens (plus one if shallow).
+    struct ajson_filter_frame  *stack;
+    size_t                      stack_size;
+    size_t                      depth;
+    size_t                      inside;   // nesting level inside a fully matched container
+    uint64_t                    partial;  // filters that need to match below the next value
+    uint64_t                    matched;  // filters that matched the next value
+    uint64_t                    matches;  // filters whose match begins with the last token
+    bool                        held;     // a key is held back until the type of its value is known
+    bool                        resume;   // the tokenizer asked for data, possibly in the middle of a skipped value
+};
+
+int  ajson_filter_add  (ajson_parser *parser, const char *pattern, bool shallow);
+void ajson_filter_reset(struct ajson_filter_s *filter);
+void ajson_filter_free (struct ajson_filter_s *filter);
+void ajson_filter_key  (struct ajson_filter_s *filter, const char *key, size_t length);
+void ajson_filter_index(struct ajson_filter_s *filter, size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FILTER_H__
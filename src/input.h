@@ -0,0 +1,56 @@
+#ifndef INPUT_H__
+#define INPUT_H__
+#pragma once
+
+#include <unistd.h>
+
+#include "ajson.h"
+#include "error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Input of the *_fd(), *_file() and *_buf() functions of the consumers that
+// are built on top of the tokenizer (binding, validation, DOM). For *_buf()
+// the whole document is fed at once and neither fd nor stream are set.
+struct ajson_input_s {
+    ajson_parser *parser;
+    int           fd;
+    FILE         *stream;
+    char         *buffer; // BUFSIZ bytes
+};
+
+// Feeds the next chunk of input. Sets AJSON_ERROR_NONE as error so I/O errors
+// (with errno set) can be told apart from parser errors.
+static inline int ajson_input_read(struct ajson_input_s *input) {
+    ssize_t count = 0;
+
+    if (input->stream) {
+        count = fread(input->buffer, 1, BUFSIZ, input->stream);
+        if (ferror(input->stream)) {
+            count = -1;
+        }
+    }
+    else if (input->fd >= 0) {
+        count = read(input->fd, input->buffer, BUFSIZ);
+    }
+
+    if (count < 0 || ajson_feed(input->parser, input->buffer, count) != 0) {
+        AJSON_SET_ERROR(input->parser, AJSON_ERROR_NONE);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Feeds the first chunk of a file descriptor or stream.
+static inline int ajson_input_begin(struct ajson_input_s *input) {
+    return (input->stream || input->fd >= 0) ? ajson_input_read(input) : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
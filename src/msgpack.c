@@ -0,0 +1,625 @@
+#include "ajson.h"
+#include "emit.h"
+#include "decoder.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <float.h>
+
+#define AJSON_MSGPACK_NIL     0xc0
+#define AJSON_MSGPACK_UNUSED  0xc1
+#define AJSON_MSGPACK_FALSE   0xc2
+#define AJSON_MSGPACK_TRUE    0xc3
+#define AJSON_MSGPACK_FLOAT32 0xca
+#define AJSON_MSGPACK_FLOAT64 0xcb
+#define AJSON_MSGPACK_UINT8   0xcc
+#define AJSON_MSGPACK_UINT16  0xcd
+#define AJSON_MSGPACK_UINT32  0xce
+#define AJSON_MSGPACK_UINT64  0xcf
+#define AJSON_MSGPACK_INT8    0xd0
+#define AJSON_MSGPACK_INT16   0xd1
+#define AJSON_MSGPACK_INT32   0xd2
+#define AJSON_MSGPACK_INT64   0xd3
+#define AJSON_MSGPACK_STR8    0xd9
+#define AJSON_MSGPACK_STR16   0xda
+#define AJSON_MSGPACK_STR32   0xdb
+#define AJSON_MSGPACK_ARRAY16 0xdc
+#define AJSON_MSGPACK_ARRAY32 0xdd
+#define AJSON_MSGPACK_MAP16   0xde
+#define AJSON_MSGPACK_MAP32   0xdf
+
+#define AJSON_MSGPACK_FIXMAP   0x80
+#define AJSON_MSGPACK_FIXARRAY 0x90
+#define AJSON_MSGPACK_FIXSTR   0xa0
+#define AJSON_MSGPACK_NEGFIXINT 0xe0
+
+// MessagePack has no containers of indefinite length. Using the writing functions
+// directly the element count is given up front and counted down in the frames.
+// ajson_msgpack_write_token() has to count the elements itself, so it encodes
+// each top level value into writer->tokens and inserts the container heads when
+// the containers end.
+struct ajson_msgpack_frame_s {
+    uint64_t count;  // remaining elements (keys and values) or elements seen
+    size_t   offset; // start of the container content in writer->tokens
+    char     type;   // 'a' or 'o'
+};
+
+// ========== Encoding ==========
+
+static void ajson_msgpack_integer(struct ajson_emit_s *emit, int64_t value) {
+    if (value >= 0) {
+        if (value < 0x80) {
+            ajson_emit_head(emit, (unsigned char)value, 0, 0);
+        }
+        else if (value <= UINT8_MAX) {
+            ajson_emit_head(emit, AJSON_MSGPACK_UINT8, (uint64_t)value, 1);
+        }
+        else if (value <= UINT16_MAX) {
+            ajson_emit_head(emit, AJSON_MSGPACK_UINT16, (uint64_t)value, 2);
+        }
+        else if (value <= UINT32_MAX) {
+            ajson_emit_head(emit, AJSON_MSGPACK_UINT32, (uint64_t)value, 4);
+        }
+        else {
+            ajson_emit_head(emit, AJSON_MSGPACK_UINT64, (uint64_t)value, 8);
+        }
+    }
+    else if (value >= -32) {
+        // negative fixint
+        ajson_emit_head(emit, (unsigned char)value, 0, 0);
+    }
+    else if (value >= INT8_MIN) {
+        ajson_emit_head(emit, AJSON_MSGPACK_INT8, (uint64_t)value, 1);
+    }
+    else if (value >= INT16_MIN) {
+        ajson_emit_head(emit, AJSON_MSGPACK_INT16, (uint64_t)value, 2);
+    }
+    else if (value >= INT32_MIN) {
+        ajson_emit_head(emit, AJSON_MSGPACK_INT32, (uint64_t)value, 4);
+    }
+    else {
+        ajson_emit_head(emit, AJSON_MSGPACK_INT64, (uint64_t)value, 8);
+    }
+}
+
+static void ajson_msgpack_number(struct ajson_emit_s *emit, double value) {
+    // single precision if that is exact
+    if (value >= -FLT_MAX && value <= FLT_MAX && (double)(float)value == value) {
+        float    number = (float)value;
+        uint32_t bits;
+        memcpy(&bits, &number, sizeof(bits));
+        ajson_emit_head(emit, AJSON_MSGPACK_FLOAT32, bits, 4);
+    }
+    else {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        ajson_emit_head(emit, AJSON_MSGPACK_FLOAT64, bits, 8);
+    }
+}
+
+static int ajson_msgpack_string(struct ajson_emit_s *emit, const char *value, size_t length) {
+    if (length > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    if (length < 32) {
+        ajson_emit_head(emit, AJSON_MSGPACK_FIXSTR | (unsigned char)length, 0, 0);
+    }
+    else if (length <= UINT8_MAX) {
+        ajson_emit_head(emit, AJSON_MSGPACK_STR8, length, 1);
+    }
+    else if (length <= UINT16_MAX) {
+        ajson_emit_head(emit, AJSON_MSGPACK_STR16, length, 2);
+    }
+    else {
+        ajson_emit_head(emit, AJSON_MSGPACK_STR32, length, 4);
+    }
+
+    emit->payload     = value;
+    emit->payload_end = value + length;
+
+    return 0;
+}
+
+static int ajson_msgpack_container(struct ajson_emit_s *emit, bool object, size_t count) {
+    if (count > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    if (count < 16) {
+        ajson_emit_head(emit, (object ? AJSON_MSGPACK_FIXMAP : AJSON_MSGPACK_FIXARRAY) | (unsigned char)count, 0, 0);
+    }
+    else if (count <= UINT16_MAX) {
+        ajson_emit_head(emit, object ? AJSON_MSGPACK_MAP16 : AJSON_MSGPACK_ARRAY16, count, 2);
+    }
+    else {
+        ajson_emit_head(emit, object ? AJSON_MSGPACK_MAP32 : AJSON_MSGPACK_ARRAY32, count, 4);
+    }
+
+    return 0;
+}
+
+// ========== Writer ==========
+
+static int ajson_msgpack_writer_push(ajson_msgpack_writer *writer, char type, uint64_t count, size_t offset) {
+    if (writer->stack_size == writer->stack_current + 1) {
+        size_t newsize = writer->stack_size + AJSON_STACK_SIZE;
+        struct ajson_msgpack_frame_s *stack = realloc(writer->stack, newsize * sizeof(struct ajson_msgpack_frame_s));
+
+        if (!stack) {
+            return -1;
+        }
+
+        writer->stack      = stack;
+        writer->stack_size = newsize;
+    }
+
+    struct ajson_msgpack_frame_s *frame = writer->stack + (++ writer->stack_current);
+    frame->type   = type;
+    frame->count  = count;
+    frame->offset = offset;
+
+    return 0;
+}
+
+// Checks if a value (or key) may be written here and prepares the next item.
+static int ajson_msgpack_writer_value(ajson_msgpack_writer *writer, size_t size, bool key) {
+    if (size == 0 || size > SSIZE_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (writer->stack_current > 0) {
+        struct ajson_msgpack_frame_s *frame = writer->stack + writer->stack_current;
+
+        // keys are at even positions of the remaining count
+        if (frame->count == 0 || (frame->type == 'o' && frame->count % 2 == 0 && !key)) {
+            errno = EINVAL;
+            return -1;
+        }
+        -- frame->count;
+    }
+
+    ajson_emit_begin(&writer->emit);
+    return 0;
+}
+
+int ajson_msgpack_writer_init(ajson_msgpack_writer *writer) {
+    memset(writer, 0, sizeof(ajson_msgpack_writer));
+    writer->stack = calloc(AJSON_STACK_SIZE, sizeof(struct ajson_msgpack_frame_s));
+
+    if (!writer->stack) {
+        return -1;
+    }
+
+    writer->stack_size = AJSON_STACK_SIZE;
+    return 0;
+}
+
+void ajson_msgpack_writer_reset(ajson_msgpack_writer *writer) {
+    ajson_emit_begin(&writer->emit);
+    writer->stack_current = 0;
+    writer->tokens_used   = 0;
+}
+
+void ajson_msgpack_writer_destroy(ajson_msgpack_writer *writer) {
+    free(writer->stack);
+    free(writer->tokens);
+    writer->stack         = NULL;
+    writer->stack_size    = 0;
+    writer->stack_current = 0;
+    writer->tokens        = NULL;
+    writer->tokens_size   = 0;
+    writer->tokens_used   = 0;
+}
+
+ssize_t ajson_msgpack_write_null(ajson_msgpack_writer *writer, void *buffer, size_t size) {
+    if (ajson_msgpack_writer_value(writer, size, false) != 0) {
+        return -1;
+    }
+    ajson_emit_head(&writer->emit, AJSON_MSGPACK_NIL, 0, 0);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_msgpack_write_boolean(ajson_msgpack_writer *writer, void *buffer, size_t size, bool value) {
+    if (ajson_msgpack_writer_value(writer, size, false) != 0) {
+        return -1;
+    }
+    ajson_emit_head(&writer->emit, value ? AJSON_MSGPACK_TRUE : AJSON_MSGPACK_FALSE, 0, 0);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_msgpack_write_number(ajson_msgpack_writer *writer, void *buffer, size_t size, double value) {
+    if (ajson_msgpack_writer_value(writer, size, false) != 0) {
+        return -1;
+    }
+    ajson_msgpack_number(&writer->emit, value);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_msgpack_write_integer(ajson_msgpack_writer *writer, void *buffer, size_t size, int64_t value) {
+    if (ajson_msgpack_writer_value(writer, size, false) != 0) {
+        return -1;
+    }
+    ajson_msgpack_integer(&writer->emit, value);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_msgpack_write_string(ajson_msgpack_writer *writer, void *buffer, size_t size, const char* value, size_t length) {
+    if (!value) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (length > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    if (ajson_msgpack_writer_value(writer, size, true) != 0) {
+        return -1;
+    }
+    ajson_msgpack_string(&writer->emit, value, length);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_msgpack_write_begin_array(ajson_msgpack_writer *writer, void *buffer, size_t size, size_t count) {
+    if (count > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    if (ajson_msgpack_writer_value(writer, size, false) != 0 || ajson_msgpack_writer_push(writer, 'a', count, 0) != 0) {
+        return -1;
+    }
+    ajson_msgpack_container(&writer->emit, false, count);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_msgpack_write_end_array(ajson_msgpack_writer *writer, void *buffer, size_t size) {
+    const struct ajson_msgpack_frame_s *frame = writer->stack + writer->stack_current;
+
+    (void)buffer;
+    if (size == 0 || size > SSIZE_MAX || frame->type != 'a' || frame->count != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    -- writer->stack_current;
+
+    return 0;
+}
+
+ssize_t ajson_msgpack_write_begin_object(ajson_msgpack_writer *writer, void *buffer, size_t size, size_t count) {
+    if (count > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    if (ajson_msgpack_writer_value(writer, size, false) != 0 || ajson_msgpack_writer_push(writer, 'o', 2 * (uint64_t)count, 0) != 0) {
+        return -1;
+    }
+    ajson_msgpack_container(&writer->emit, true, count);
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+ssize_t ajson_msgpack_write_end_object(ajson_msgpack_writer *writer, void *buffer, size_t size) {
+    const struct ajson_msgpack_frame_s *frame = writer->stack + writer->stack_current;
+
+    (void)buffer;
+    if (size == 0 || size > SSIZE_MAX || frame->type != 'o' || frame->count != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    -- writer->stack_current;
+
+    return 0;
+}
+
+ssize_t ajson_msgpack_write_continue(ajson_msgpack_writer *writer, void *buffer, size_t size) {
+    if (size == 0 || size > SSIZE_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+// ========== Token Transcoding ==========
+
+static int ajson_msgpack_tokens_reserve(ajson_msgpack_writer *writer, size_t count) {
+    if (writer->tokens_size - writer->tokens_used < count) {
+        if (count > SIZE_MAX / 2 - writer->tokens_used) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        size_t newsize = writer->tokens_size ? writer->tokens_size : BUFSIZ;
+        while (newsize - writer->tokens_used < count) {
+            newsize *= 2;
+        }
+
+        unsigned char *tokens = realloc(writer->tokens, newsize);
+        if (!tokens) {
+            return -1;
+        }
+
+        writer->tokens      = tokens;
+        writer->tokens_size = newsize;
+    }
+
+    return 0;
+}
+
+static int ajson_msgpack_tokens_append(ajson_msgpack_writer *writer, const struct ajson_emit_s *item) {
+    const size_t length = (size_t)(item->payload_end - item->payload);
+
+    if (ajson_msgpack_tokens_reserve(writer, item->head_size + length) != 0) {
+        return -1;
+    }
+
+    memcpy(writer->tokens + writer->tokens_used, item->head, item->head_size);
+    writer->tokens_used += item->head_size;
+
+    if (length > 0) {
+        memcpy(writer->tokens + writer->tokens_used, item->payload, length);
+        writer->tokens_used += length;
+    }
+
+    return 0;
+}
+
+ssize_t ajson_msgpack_write_token(ajson_msgpack_writer *writer, void *buffer, size_t size, const ajson_parser *parser, enum ajson_token token) {
+    struct ajson_emit_s item;
+
+    if (size == 0 || size > SSIZE_MAX ||
+        (parser->flags & (AJSON_FLAG_NUMBER_AS_STRING | AJSON_FLAG_NUMBER_COMPONENTS | AJSON_FLAG_RAW_LATIN1))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (writer->stack_current == 0) {
+        // a new top level value
+        writer->tokens_used = 0;
+    }
+
+    ajson_emit_begin(&item);
+
+    switch (token) {
+    case AJSON_TOK_NULL:
+        ajson_emit_head(&item, AJSON_MSGPACK_NIL, 0, 0);
+        break;
+
+    case AJSON_TOK_BOOLEAN:
+        ajson_emit_head(&item, parser->value.boolean ? AJSON_MSGPACK_TRUE : AJSON_MSGPACK_FALSE, 0, 0);
+        break;
+
+    case AJSON_TOK_NUMBER:
+        ajson_msgpack_number(&item, parser->value.number);
+        break;
+
+    case AJSON_TOK_INTEGER:
+        ajson_msgpack_integer(&item, parser->value.integer);
+        break;
+
+    case AJSON_TOK_STRING:
+        if (ajson_msgpack_string(&item, parser->value.string.value, parser->value.string.length) != 0) {
+            return -1;
+        }
+        break;
+
+    case AJSON_TOK_BEGIN_ARRAY:
+    case AJSON_TOK_BEGIN_OBJECT:
+        if (writer->stack_current > 0) {
+            writer->stack[writer->stack_current].count += 1;
+        }
+        if (ajson_msgpack_writer_push(writer, token == AJSON_TOK_BEGIN_OBJECT ? 'o' : 'a', 0, writer->tokens_used) != 0) {
+            return -1;
+        }
+        // the head is inserted when the container ends
+        return 0;
+
+    case AJSON_TOK_END_ARRAY:
+    case AJSON_TOK_END_OBJECT:
+    {
+        const struct ajson_msgpack_frame_s *frame = writer->stack + writer->stack_current;
+        const bool object = token == AJSON_TOK_END_OBJECT;
+
+        if (writer->stack_current == 0 || frame->type != (object ? 'o' : 'a')) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        if (ajson_msgpack_container(&item, object, object ? frame->count / 2 : frame->count) != 0 ||
+            ajson_msgpack_tokens_reserve(writer, item.head_size) != 0) {
+            return -1;
+        }
+
+        unsigned char *content = writer->tokens + frame->offset;
+        memmove(content + item.head_size, content, writer->tokens_used - frame->offset);
+        memcpy(content, item.head, item.head_size);
+        writer->tokens_used += item.head_size;
+        -- writer->stack_current;
+        break;
+    }
+    case AJSON_TOK_END:
+    case AJSON_TOK_NEED_DATA:
+        return 0;
+
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (token != AJSON_TOK_END_ARRAY && token != AJSON_TOK_END_OBJECT) {
+        if (writer->stack_current > 0) {
+            writer->stack[writer->stack_current].count += 1;
+        }
+        if (ajson_msgpack_tokens_append(writer, &item) != 0) {
+            return -1;
+        }
+    }
+
+    if (writer->stack_current > 0) {
+        return 0;
+    }
+
+    // top level value is complete
+    ajson_emit_begin(&writer->emit);
+    writer->emit.payload     = (const char *)writer->tokens;
+    writer->emit.payload_end = (const char *)writer->tokens + writer->tokens_used;
+
+    return ajson_emit(&writer->emit, buffer, size);
+}
+
+// ========== Reader ==========
+
+size_t ajson_msgpack_head_length(unsigned char byte) {
+    switch (byte) {
+    case AJSON_MSGPACK_UINT8:
+    case AJSON_MSGPACK_INT8:
+    case AJSON_MSGPACK_STR8:
+        return 2;
+
+    case AJSON_MSGPACK_UINT16:
+    case AJSON_MSGPACK_INT16:
+    case AJSON_MSGPACK_STR16:
+    case AJSON_MSGPACK_ARRAY16:
+    case AJSON_MSGPACK_MAP16:
+        return 3;
+
+    case AJSON_MSGPACK_FLOAT32:
+    case AJSON_MSGPACK_UINT32:
+    case AJSON_MSGPACK_INT32:
+    case AJSON_MSGPACK_STR32:
+    case AJSON_MSGPACK_ARRAY32:
+    case AJSON_MSGPACK_MAP32:
+        return 5;
+
+    case AJSON_MSGPACK_FLOAT64:
+    case AJSON_MSGPACK_UINT64:
+    case AJSON_MSGPACK_INT64:
+        return 9;
+
+    default:
+        // bin and ext are rejected after the first byte
+        return 1;
+    }
+}
+
+void ajson_msgpack_read_item(const unsigned char *head, struct ajson_item *item) {
+    const unsigned char byte = head[0];
+    const uint64_t argument  = ajson_decode_uint(head + 1, ajson_msgpack_head_length(byte) - 1);
+
+    item->indefinite = false;
+
+    if (byte < AJSON_MSGPACK_FIXMAP) {
+        item->type = AJSON_ITEM_INTEGER;
+        item->value.integer = byte;
+    }
+    else if (byte < AJSON_MSGPACK_FIXARRAY) {
+        item->type = AJSON_ITEM_OBJECT;
+        item->value.count = byte & 0x0f;
+    }
+    else if (byte < AJSON_MSGPACK_FIXSTR) {
+        item->type = AJSON_ITEM_ARRAY;
+        item->value.count = byte & 0x0f;
+    }
+    else if (byte < AJSON_MSGPACK_NIL) {
+        item->type = AJSON_ITEM_STRING;
+        item->value.count = byte & 0x1f;
+    }
+    else if (byte >= AJSON_MSGPACK_NEGFIXINT) {
+        item->type = AJSON_ITEM_INTEGER;
+        item->value.integer = (int8_t)byte;
+    }
+    else switch (byte) {
+    case AJSON_MSGPACK_NIL:
+        item->type = AJSON_ITEM_NULL;
+        break;
+
+    case AJSON_MSGPACK_FALSE:
+    case AJSON_MSGPACK_TRUE:
+        item->type = AJSON_ITEM_BOOLEAN;
+        item->value.boolean = byte == AJSON_MSGPACK_TRUE;
+        break;
+
+    case AJSON_MSGPACK_FLOAT32:
+    {
+        uint32_t bits = (uint32_t)argument;
+        float    number;
+        memcpy(&number, &bits, sizeof(number));
+        item->type = AJSON_ITEM_NUMBER;
+        item->value.number = number;
+        break;
+    }
+    case AJSON_MSGPACK_FLOAT64:
+        item->type = AJSON_ITEM_NUMBER;
+        memcpy(&item->value.number, &argument, sizeof(item->value.number));
+        break;
+
+    case AJSON_MSGPACK_UINT8:
+    case AJSON_MSGPACK_UINT16:
+    case AJSON_MSGPACK_UINT32:
+    case AJSON_MSGPACK_UINT64:
+        if (argument <= INT64_MAX) {
+            item->type = AJSON_ITEM_INTEGER;
+            item->value.integer = (int64_t)argument;
+        }
+        else {
+            item->type = AJSON_ITEM_NUMBER;
+            item->value.number = (double)argument;
+        }
+        break;
+
+    case AJSON_MSGPACK_INT8:
+        item->type = AJSON_ITEM_INTEGER;
+        item->value.integer = (int8_t)argument;
+        break;
+
+    case AJSON_MSGPACK_INT16:
+        item->type = AJSON_ITEM_INTEGER;
+        item->value.integer = (int16_t)argument;
+        break;
+
+    case AJSON_MSGPACK_INT32:
+        item->type = AJSON_ITEM_INTEGER;
+        item->value.integer = (int32_t)argument;
+        break;
+
+    case AJSON_MSGPACK_INT64:
+        item->type = AJSON_ITEM_INTEGER;
+        item->value.integer = (int64_t)argument;
+        break;
+
+    case AJSON_MSGPACK_STR8:
+    case AJSON_MSGPACK_STR16:
+    case AJSON_MSGPACK_STR32:
+        item->type = AJSON_ITEM_STRING;
+        item->value.count = argument;
+        break;
+
+    case AJSON_MSGPACK_ARRAY16:
+    case AJSON_MSGPACK_ARRAY32:
+        item->type = AJSON_ITEM_ARRAY;
+        item->value.count = argument;
+        break;
+
+    case AJSON_MSGPACK_MAP16:
+    case AJSON_MSGPACK_MAP32:
+        item->type = AJSON_ITEM_OBJECT;
+        item->value.count = argument;
+        break;
+
+    case AJSON_MSGPACK_UNUSED:
+        item->type = AJSON_ITEM_INVALID;
+        break;
+
+    default:
+        // bin and ext have no JSON equivalent
+        item->type = AJSON_ITEM_UNSUPPORTED;
+        break;
+    }
+}
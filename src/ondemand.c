@@ -0,0 +1,522 @@
+#include "ajson.h"
+#include "scan.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define AJSON_ONDEMAND_NONE SIZE_MAX
+
+static inline bool ajson_ondemand_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool ajson_ondemand_is_scalar_char(char c) {
+    return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '-' || c == '+' || c == '.';
+}
+
+static inline size_t ajson_ondemand_skip_space(const ajson_ondemand *doc, size_t index) {
+    while (index < doc->input_size && ajson_ondemand_is_space(doc->input[index])) {
+        ++ index;
+    }
+    return index;
+}
+
+int ajson_ondemand_init(ajson_ondemand *doc, const void *buffer, size_t size) {
+    if (ajson_init(&doc->parser, AJSON_FLAG_INTEGER, AJSON_ENC_UTF8) != 0) {
+        return -1;
+    }
+
+    doc->input      = buffer;
+    doc->input_size = size;
+    doc->error      = AJSON_ERROR_NONE;
+
+    return 0;
+}
+
+void ajson_ondemand_destroy(ajson_ondemand *doc) {
+    ajson_destroy(&doc->parser);
+
+    doc->input      = NULL;
+    doc->input_size = 0;
+}
+
+enum ajson_error ajson_ondemand_get_error(const ajson_ondemand *doc) {
+    return doc->error;
+}
+
+int ajson_ondemand_root(ajson_ondemand *doc, ajson_cursor *root) {
+    size_t index = ajson_ondemand_skip_space(doc, 0);
+
+    if (index >= doc->input_size) {
+        doc->error = AJSON_ERROR_PARSER_UNEXPECTED_EOF;
+        return -1;
+    }
+
+    doc->error  = AJSON_ERROR_NONE;
+    root->doc   = doc;
+    root->value = index;
+    root->key   = AJSON_ONDEMAND_NONE;
+
+    return 0;
+}
+
+// Parses the value at index with the embedded parser. Only used for values
+// that are actually read, everything else is just skipped over.
+static enum ajson_token ajson_ondemand_read(ajson_ondemand *doc, size_t index) {
+    ajson_parser *parser = &doc->parser;
+
+    ajson_reset(parser);
+    ajson_feed(parser, doc->input + index, doc->input_size - index);
+
+    enum ajson_token token = ajson_next_token(parser);
+    if (token == AJSON_TOK_NEED_DATA) {
+        // a number at the very end of the input
+        ajson_feed(parser, NULL, 0);
+        token = ajson_next_token(parser);
+    }
+
+    if (token == AJSON_TOK_ERROR) {
+        doc->error = parser->value.error.error;
+    }
+
+    return token;
+}
+
+// Returns the index of the closing quote of the string that starts at index.
+static size_t ajson_ondemand_string_end(ajson_ondemand *doc, size_t index, bool *escaped) {
+    const char  *input = doc->input;
+    const size_t size  = doc->input_size;
+
+    ++ index;
+    for (;;) {
+        index = ajson_scan_string(input, index, size);
+
+        if (index >= size) {
+            doc->error = AJSON_ERROR_PARSER_UNEXPECTED_EOF;
+            return AJSON_ONDEMAND_NONE;
+        }
+        else if (input[index] == '"') {
+            return index;
+        }
+
+        *escaped = true;
+        index += 2;
+    }
+}
+
+// Returns the index after the value that starts at index. Like values skipped
+// by the parser, only brackets and strings are checked.
+static size_t ajson_ondemand_skip(ajson_ondemand *doc, size_t index) {
+    const char  *input = doc->input;
+    const size_t size  = doc->input_size;
+    bool         escaped;
+
+    if (index >= size) {
+        doc->error = AJSON_ERROR_PARSER_UNEXPECTED_EOF;
+        return AJSON_ONDEMAND_NONE;
+    }
+
+    char c = input[index];
+
+    if (c == '"') {
+        index = ajson_ondemand_string_end(doc, index, &escaped);
+        return index == AJSON_ONDEMAND_NONE ? index : index + 1;
+    }
+    else if (c == '[' || c == '{') {
+        size_t depth = 1;
+
+        ++ index;
+        for (;;) {
+            index = ajson_scan_structure(input, index, size);
+
+            if (index >= size) {
+                doc->error = AJSON_ERROR_PARSER_UNEXPECTED_EOF;
+                return AJSON_ONDEMAND_NONE;
+            }
+
+            c = input[index];
+            if (c == '"') {
+                index = ajson_ondemand_string_end(doc, index, &escaped);
+                if (index == AJSON_ONDEMAND_NONE) {
+                    return index;
+                }
+            }
+            else if (c == '[' || c == '{') {
+                ++ depth;
+            }
+            else if (-- depth == 0) {
+                return index + 1;
+            }
+            ++ index;
+        }
+    }
+
+    size_t start = index;
+    while (index < size && ajson_ondemand_is_scalar_char(input[index])) {
+        ++ index;
+    }
+
+    if (index == start) {
+        doc->error = AJSON_ERROR_PARSER_UNEXPECTED_CHAR;
+        return AJSON_ONDEMAND_NONE;
+    }
+
+    return index;
+}
+
+// Parses the key of the member that starts at index and returns the index of
+// its value. If key is not NULL *match tells whether the keys are equal.
+static size_t ajson_ondemand_member(ajson_ondemand *doc, size_t index, const char *key, size_t length, bool *match) {
+    const char *input = doc->input;
+    bool escaped = false;
+
+    if (index >= doc->input_size || input[index] != '"') {
+        doc->error = index >= doc->input_size ? AJSON_ERROR_PARSER_UNEXPECTED_EOF : AJSON_ERROR_PARSER_EXPECTED_STRING;
+        return AJSON_ONDEMAND_NONE;
+    }
+
+    size_t end = ajson_ondemand_string_end(doc, index, &escaped);
+    if (end == AJSON_ONDEMAND_NONE) {
+        return end;
+    }
+
+    if (key) {
+        if (!escaped) {
+            *match = end - index - 1 == length && memcmp(input + index + 1, key, length) == 0;
+        }
+        else if (ajson_ondemand_read(doc, index) == AJSON_TOK_STRING) {
+            *match = doc->parser.value.string.length == length && memcmp(doc->parser.value.string.value, key, length) == 0;
+        }
+        else {
+            return AJSON_ONDEMAND_NONE;
+        }
+    }
+
+    index = ajson_ondemand_skip_space(doc, end + 1);
+    if (index >= doc->input_size || input[index] != ':') {
+        doc->error = index >= doc->input_size ? AJSON_ERROR_PARSER_UNEXPECTED_EOF : AJSON_ERROR_PARSER_EXPECTED_COLON;
+        return AJSON_ONDEMAND_NONE;
+    }
+
+    return ajson_ondemand_skip_space(doc, index + 1);
+}
+
+// Skips the "," after a value. Returns 1 and the index of the next item if
+// there is one, 0 at the end of the container and -1 on error.
+static int ajson_ondemand_next_index(ajson_ondemand *doc, size_t *index, bool object) {
+    size_t next = ajson_ondemand_skip_space(doc, *index);
+
+    if (next >= doc->input_size) {
+        doc->error = AJSON_ERROR_PARSER_UNEXPECTED_EOF;
+        return -1;
+    }
+
+    char c = doc->input[next];
+    if (c == ',') {
+        *index = ajson_ondemand_skip_space(doc, next + 1);
+        return 1;
+    }
+    else if (c == (object ? '}' : ']')) {
+        return 0;
+    }
+
+    doc->error = object ?
+        AJSON_ERROR_PARSER_EXPECTED_COMMA_OR_OBJECT_END :
+        AJSON_ERROR_PARSER_EXPECTED_COMMA_OR_ARRAY_END;
+    return -1;
+}
+
+// Classifies the value at index by its first character.
+static enum ajson_token ajson_ondemand_peek(ajson_ondemand *doc, size_t index) {
+    if (index >= doc->input_size) {
+        doc->error = AJSON_ERROR_PARSER_UNEXPECTED_EOF;
+        return AJSON_TOK_ERROR;
+    }
+
+    char c = doc->input[index];
+    switch (c) {
+    case 'n':
+        return AJSON_TOK_NULL;
+
+    case 't':
+    case 'f':
+        return AJSON_TOK_BOOLEAN;
+
+    case '"':
+        return AJSON_TOK_STRING;
+
+    case '[':
+        return AJSON_TOK_BEGIN_ARRAY;
+
+    case '{':
+        return AJSON_TOK_BEGIN_OBJECT;
+
+    default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            return AJSON_TOK_NUMBER;
+        }
+        doc->error = AJSON_ERROR_PARSER_UNEXPECTED_CHAR;
+        return AJSON_TOK_ERROR;
+    }
+}
+
+enum ajson_token ajson_cursor_type(const ajson_cursor *cursor) {
+    ajson_ondemand *doc = cursor->doc;
+
+    doc->error = AJSON_ERROR_NONE;
+
+    enum ajson_token token = ajson_ondemand_peek(doc, cursor->value);
+    switch (token) {
+    case AJSON_TOK_NULL:
+    case AJSON_TOK_BOOLEAN:
+    case AJSON_TOK_NUMBER:
+        // short, so just parse them to tell integers and validate literals
+        return ajson_ondemand_read(doc, cursor->value);
+
+    default:
+        return token;
+    }
+}
+
+int ajson_cursor_first(const ajson_cursor *container, ajson_cursor *child) {
+    ajson_ondemand *doc = container->doc;
+    doc->error = AJSON_ERROR_NONE;
+
+    enum ajson_token type = ajson_ondemand_peek(doc, container->value);
+
+    if (type != AJSON_TOK_BEGIN_ARRAY && type != AJSON_TOK_BEGIN_OBJECT) {
+        if (type != AJSON_TOK_ERROR) {
+            doc->error = AJSON_ERROR_BIND_TYPE;
+        }
+        return -1;
+    }
+
+    const bool object = type == AJSON_TOK_BEGIN_OBJECT;
+    size_t index = ajson_ondemand_skip_space(doc, container->value + 1);
+
+    if (index >= doc->input_size) {
+        doc->error = AJSON_ERROR_PARSER_UNEXPECTED_EOF;
+        return -1;
+    }
+    else if (doc->input[index] == (object ? '}' : ']')) {
+        return -1;
+    }
+
+    child->doc = doc;
+
+    if (object) {
+        size_t value = ajson_ondemand_member(doc, index, NULL, 0, NULL);
+        if (value == AJSON_ONDEMAND_NONE) {
+            return -1;
+        }
+        child->key   = index;
+        child->value = value;
+    }
+    else {
+        child->key   = AJSON_ONDEMAND_NONE;
+        child->value = index;
+    }
+
+    return 0;
+}
+
+int ajson_cursor_next(ajson_cursor *cursor) {
+    ajson_ondemand *doc = cursor->doc;
+    const bool object = cursor->key != AJSON_ONDEMAND_NONE;
+
+    doc->error = AJSON_ERROR_NONE;
+
+    size_t index = ajson_ondemand_skip(doc, cursor->value);
+    if (index == AJSON_ONDEMAND_NONE || ajson_ondemand_next_index(doc, &index, object) != 1) {
+        return -1;
+    }
+
+    if (object) {
+        size_t value = ajson_ondemand_member(doc, index, NULL, 0, NULL);
+        if (value == AJSON_ONDEMAND_NONE) {
+            return -1;
+        }
+        cursor->key   = index;
+        cursor->value = value;
+    }
+    else {
+        cursor->value = index;
+    }
+
+    return 0;
+}
+
+int ajson_cursor_at(const ajson_cursor *array, size_t index, ajson_cursor *item) {
+    ajson_cursor cursor;
+
+    array->doc->error = AJSON_ERROR_NONE;
+
+    enum ajson_token type = ajson_ondemand_peek(array->doc, array->value);
+    if (type != AJSON_TOK_BEGIN_ARRAY) {
+        if (type != AJSON_TOK_ERROR) {
+            array->doc->error = AJSON_ERROR_BIND_TYPE;
+        }
+        return -1;
+    }
+
+    if (ajson_cursor_first(array, &cursor) != 0) {
+        return -1;
+    }
+
+    for (; index > 0; -- index) {
+        if (ajson_cursor_next(&cursor) != 0) {
+            return -1;
+        }
+    }
+
+    *item = cursor;
+    return 0;
+}
+
+int ajson_cursor_find(const ajson_cursor *object, const char *key, ajson_cursor *value) {
+    return ajson_cursor_find_key(object, key, strlen(key), value);
+}
+
+int ajson_cursor_find_key(const ajson_cursor *object, const char *key, size_t length, ajson_cursor *value) {
+    ajson_ondemand *doc = object->doc;
+
+    doc->error = AJSON_ERROR_NONE;
+
+    if (object->value >= doc->input_size || doc->input[object->value] != '{') {
+        doc->error = object->value >= doc->input_size ? AJSON_ERROR_PARSER_UNEXPECTED_EOF : AJSON_ERROR_BIND_TYPE;
+        return -1;
+    }
+
+    size_t index = ajson_ondemand_skip_space(doc, object->value + 1);
+    if (index >= doc->input_size) {
+        doc->error = AJSON_ERROR_PARSER_UNEXPECTED_EOF;
+        return -1;
+    }
+    else if (doc->input[index] == '}') {
+        return -1;
+    }
+
+    for (;;) {
+        bool match = false;
+        size_t value_index = ajson_ondemand_member(doc, index, key, length, &match);
+
+        if (value_index == AJSON_ONDEMAND_NONE) {
+            return -1;
+        }
+
+        if (match) {
+            value->doc   = doc;
+            value->key   = index;
+            value->value = value_index;
+            return 0;
+        }
+
+        index = ajson_ondemand_skip(doc, value_index);
+        if (index == AJSON_ONDEMAND_NONE || ajson_ondemand_next_index(doc, &index, true) != 1) {
+            return -1;
+        }
+    }
+}
+
+int ajson_cursor_get_key(const ajson_cursor *member, const char **key, size_t *length) {
+    ajson_ondemand *doc = member->doc;
+
+    doc->error = AJSON_ERROR_NONE;
+
+    if (member->key == AJSON_ONDEMAND_NONE) {
+        doc->error = AJSON_ERROR_BIND_TYPE;
+        return -1;
+    }
+
+    if (ajson_ondemand_read(doc, member->key) != AJSON_TOK_STRING) {
+        return -1;
+    }
+
+    *key    = doc->parser.value.string.value;
+    *length = doc->parser.value.string.length;
+
+    return 0;
+}
+
+// Reads a scalar. Sets AJSON_ERROR_BIND_TYPE if it is of another type.
+static enum ajson_token ajson_cursor_read(const ajson_cursor *cursor, enum ajson_token type1, enum ajson_token type2) {
+    ajson_ondemand *doc = cursor->doc;
+
+    doc->error = AJSON_ERROR_NONE;
+
+    enum ajson_token token = ajson_ondemand_peek(doc, cursor->value);
+    if (token == AJSON_TOK_ERROR) {
+        return token;
+    }
+
+    // don't parse containers just to find out they have the wrong type
+    if (token == AJSON_TOK_BEGIN_ARRAY || token == AJSON_TOK_BEGIN_OBJECT ||
+        (token = ajson_ondemand_read(doc, cursor->value)) == AJSON_TOK_ERROR) {
+        if (token != AJSON_TOK_ERROR) {
+            doc->error = AJSON_ERROR_BIND_TYPE;
+        }
+        return AJSON_TOK_ERROR;
+    }
+
+    if (token != type1 && token != type2) {
+        doc->error = AJSON_ERROR_BIND_TYPE;
+        return AJSON_TOK_ERROR;
+    }
+
+    return token;
+}
+
+int ajson_cursor_get_boolean(const ajson_cursor *cursor, bool *value) {
+    if (ajson_cursor_read(cursor, AJSON_TOK_BOOLEAN, AJSON_TOK_BOOLEAN) == AJSON_TOK_ERROR) {
+        return -1;
+    }
+
+    *value = cursor->doc->parser.value.boolean;
+    return 0;
+}
+
+int ajson_cursor_get_number(const ajson_cursor *cursor, double *value) {
+    enum ajson_token token = ajson_cursor_read(cursor, AJSON_TOK_NUMBER, AJSON_TOK_INTEGER);
+
+    if (token == AJSON_TOK_ERROR) {
+        return -1;
+    }
+
+    *value = token == AJSON_TOK_INTEGER ?
+        (double)cursor->doc->parser.value.integer :
+        cursor->doc->parser.value.number;
+    return 0;
+}
+
+int ajson_cursor_get_integer(const ajson_cursor *cursor, int64_t *value) {
+    enum ajson_token token = ajson_cursor_read(cursor, AJSON_TOK_NUMBER, AJSON_TOK_INTEGER);
+
+    if (token == AJSON_TOK_ERROR) {
+        return -1;
+    }
+
+    if (token == AJSON_TOK_INTEGER) {
+        *value = cursor->doc->parser.value.integer;
+        return 0;
+    }
+
+    double number = cursor->doc->parser.value.number;
+    if (!(number >= -9223372036854775808.0 && number < 9223372036854775808.0) || (double)(int64_t)number != number) {
+        cursor->doc->error = AJSON_ERROR_BIND_TYPE;
+        return -1;
+    }
+
+    *value = (int64_t)number;
+    return 0;
+}
+
+int ajson_cursor_get_string(const ajson_cursor *cursor, const char **value, size_t *length) {
+    if (ajson_cursor_read(cursor, AJSON_TOK_STRING, AJSON_TOK_STRING) == AJSON_TOK_ERROR) {
+        return -1;
+    }
+
+    *value  = cursor->doc->parser.value.string.value;
+    *length = cursor->doc->parser.value.string.length;
+    return 0;
+}
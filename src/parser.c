@@ -1,15 +1,13 @@
 #include "ajson.h"
+#include "filter.h"
+#include "scan.h"
+#include "decoder.h"
+#include "error.h"
 
 #include <inttypes.h>
 #include <math.h>
 #include <string.h>
 
-#define AJSON_SET_ERROR(PARSER, ERR) \
-    (PARSER)->value.error.error    = (ERR); \
-    (PARSER)->value.error.filename = __FILE__; \
-    (PARSER)->value.error.function = __func__; \
-    (PARSER)->value.error.lineno   = __LINE__;
-
 static inline int _ajson_push(ajson_parser *parser, uintptr_t state) {
     if (parser->stack_current + 1 == parser->stack_size) {
         size_t newsize = parser->stack_size + AJSON_STACK_SIZE;
@@ -108,7 +106,7 @@ static inline int ajson_buffer_putcp(ajson_parser *parser, uint32_t codepoint) {
     return 0;
 }
 
-static inline int ajson_buffer_append(ajson_parser *parser, void *data, size_t size) {
+static inline int ajson_buffer_append(ajson_parser *parser, const void *data, size_t size) {
     if (ajson_buffer_ensure(parser, size) != 0) {
         return -1;
     }
@@ -117,6 +115,68 @@ static inline int ajson_buffer_append(ajson_parser *parser, void *data, size_t s
     return 0;
 }
 
+// Appends Latin-1 data transcoded to UTF-8. Every byte >= 0x80 becomes exactly
+// two bytes (0xC2 or 0xC3 followed by a continuation byte), so the needed space
+// is known up front and the buffer only has to be checked once per run.
+static inline int ajson_buffer_append_latin1(ajson_parser *parser, const unsigned char *data, size_t size) {
+    if (size > SIZE_MAX / 2) {
+        AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+        return -1;
+    }
+
+    if (ajson_buffer_ensure(parser, size * 2) != 0) {
+        return -1;
+    }
+
+    unsigned char *out = (unsigned char*)parser->buffer + parser->buffer_used;
+    size_t index = 0;
+
+#ifdef AJSON_USE_SSE2
+    const __m128i cont_mask = _mm_set1_epi8((char)0xBF);
+    const __m128i lead_base = _mm_set1_epi8((char)0xC2);
+    const __m128i one       = _mm_set1_epi8(1);
+
+    for (; index + 16 <= size; index += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + index));
+        int mask = _mm_movemask_epi8(chunk);
+
+        if (mask == 0) {
+            // only ASCII
+            _mm_storeu_si128((__m128i*)out, chunk);
+            out += 16;
+        }
+        else if (mask == 0xFFFF) {
+            // no ASCII: 0xC2 | bit 6 as lead byte, the byte without bit 6 as continuation
+            __m128i lead = _mm_or_si128(lead_base, _mm_and_si128(_mm_srli_epi16(chunk, 6), one));
+            __m128i cont = _mm_and_si128(chunk, cont_mask);
+            _mm_storeu_si128((__m128i*)out,        _mm_unpacklo_epi8(lead, cont));
+            _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(lead, cont));
+            out += 32;
+        }
+        else {
+            for (size_t end = index + 16, i = index; i < end; ++ i) {
+                unsigned char ch = data[i];
+                unsigned int  hi = ch >> 7;
+                out[0] = hi ? 0xC0 | (ch >> 6) : ch;
+                out[1] = 0x80 | (ch & 0x3F);
+                out += 1 + hi;
+            }
+        }
+    }
+#endif
+
+    for (; index < size; ++ index) {
+        unsigned char ch = data[index];
+        unsigned int  hi = ch >> 7;
+        out[0] = hi ? 0xC0 | (ch >> 6) : ch;
+        out[1] = 0x80 | (ch & 0x3F);
+        out += 1 + hi;
+    }
+
+    parser->buffer_used = out - (unsigned char*)parser->buffer;
+    return 0;
+}
+
 static inline void ajson_buffer_clear(ajson_parser *parser) {
     parser->buffer_used = 0;
 }
@@ -192,6 +252,10 @@ enum ajson_named_states {
         else RQUIRE_DATA(AUTO_STATE_REF()) \
     }
 
+#define RQUIRE_DATA_OR_EOF() \
+    AUTO_STATE(); \
+    if (!AT_EOF()) RQUIRE_DATA(AUTO_STATE_REF())
+
 #define STATE_WITH_DATA(NAME) \
     STATE(NAME) \
     if (AT_EOF()) { \
@@ -244,11 +308,32 @@ enum ajson_named_states {
 #define isdigit(CH) ((CH) >= '0' && (CH) <= '9')
 #define isword(CH)  (isdigit(CH) || ((CH) >= 'A' && (CH) <= 'Z') || ((CH) >= 'a' && (CH) <= 'z') || (CH) == '_')
 
-enum ajson_token ajson_next_token(ajson_parser *parser) {
+static enum ajson_token ajson_tokenize(ajson_parser *parser) {
     BEGIN_DISPATCH;
 
-    STATE_WITH_DATA(START)
+    STATE(START)
         /* ==== start parsing ==================================================================================== */
+        if (parser->flags & AJSON_FLAG_STREAM) {
+            // any number of values, END is only returned at the end of the input
+            RQUIRE_DATA_OR_EOF();
+            for (;;) {
+                while (!AT_EOF() && isspace(CURR_CH())) {
+                    READ_NEXT_OR_EOF();
+                }
+
+                if (AT_EOF()) {
+                    DONE();
+                }
+
+                RECURSE(VALUE);
+            }
+        }
+
+        if (AT_EOF()) {
+            RAISE_ERROR(AJSON_ERROR_PARSER_UNEXPECTED_EOF);
+        }
+        else RQUIRE_DATA(STATE_REF(START))
+
         while (isspace(CURR_CH())) {
             READ_NEXT();
         }
@@ -268,6 +353,74 @@ enum ajson_token ajson_next_token(ajson_parser *parser) {
     STATE_WITH_DATA(VALUE)
         /* ==== parse value ====================================================================================== */
 
+        if (parser->skip == AJSON_SKIP_SCALAR && (CURR_CH() == '[' || CURR_CH() == '{')) {
+            // let the caller know before anything of the container is consumed
+            parser->skip = AJSON_SKIP_NONE;
+            EMIT(AJSON_TOK_CONTAINER);
+            // only ajson_skip_value() can still skip the container
+            if (parser->skip != AJSON_SKIP_VALUE) {
+                parser->skip = AJSON_SKIP_NONE;
+            }
+        }
+
+        if (parser->skip != AJSON_SKIP_NONE) {
+            /* ==== skip value =================================================================================== */
+            // Only the string and nesting structure is tracked. Nothing is
+            // buffered or converted and the skipped value is not validated.
+            parser->skip = AJSON_SKIP_NONE;
+            if (CURR_CH() == '"' || CURR_CH() == '[' || CURR_CH() == '{') {
+                parser->skip_depth = 0;
+                for (;;) {
+                    if (CURR_CH() == '"') {
+                        for (;;) {
+                            READ_NEXT();
+                            index = ajson_scan_string(input, index, size);
+                            if (index == size) {
+                                // READ_NEXT() will request the next chunk
+                                -- index;
+                            }
+                            else if (CURR_CH() == '"') {
+                                break;
+                            }
+                            else {
+                                // escaped character
+                                READ_NEXT();
+                            }
+                        }
+
+                        if (parser->skip_depth == 0) {
+                            break;
+                        }
+                    }
+                    else if ((CURR_CH() | 0x20) == '{') {
+                        ++ parser->skip_depth;
+                    }
+                    else if (-- parser->skip_depth == 0) {
+                        break;
+                    }
+
+                    for (;;) {
+                        READ_NEXT();
+                        index = ajson_scan_structure(input, index, size);
+                        if (index < size) {
+                            break;
+                        }
+                        -- index;
+                    }
+                }
+                READ_NEXT_OR_EOF();
+            }
+            else if (isword(CURR_CH()) || CURR_CH() == '-') {
+                do {
+                    READ_NEXT_OR_EOF();
+                } while (!AT_EOF() && (isword(CURR_CH()) || CURR_CH() == '-' || CURR_CH() == '+' || CURR_CH() == '.'));
+            }
+            else {
+                RAISE_ERROR(AJSON_ERROR_PARSER_UNEXPECTED_CHAR);
+            }
+            RETURN(AJSON_TOK_SKIPPED);
+        }
+
         if (CURR_CH() == 't') {
             /* ==== parse "true" ================================================================================= */
             READ_NEXT();
@@ -327,7 +480,21 @@ enum ajson_token ajson_next_token(ajson_parser *parser) {
             for (;;) {
                 READ_NEXT();
                 unsigned char ch = CURR_CH();
-                if (ch != '\\') {
+                if (parser->encoding == AJSON_ENC_LATIN1 && ch != '"' && ch != '\\') {
+                    // Latin-1 needs no validation, so copy the whole run up to the
+                    // next quote or escape sequence that is in the current chunk.
+                    size_t end = ajson_scan_string(input, index, size);
+                    int status = parser->flags & AJSON_FLAG_RAW_LATIN1 ?
+                        ajson_buffer_append(parser, input + index, end - index) :
+                        ajson_buffer_append_latin1(parser, (const unsigned char*)input + index, end - index);
+
+                    if (status != 0) {
+                        RAISE_ERROR(AJSON_ERROR_MEMORY);
+                    }
+                    // READ_NEXT() will advance to the byte after the run
+                    index = end - 1;
+                }
+                else if (ch != '\\') {
                     if (ch < 0x80) {
                         if (ch == '"') {
                             if (ajson_buffer_putc(parser, 0) != 0) {
@@ -346,7 +513,7 @@ enum ajson_token ajson_next_token(ajson_parser *parser) {
                             }
                         }
                     }
-                    else if (parser->encoding == AJSON_ENC_UTF8) {
+                    else {
                         // validate UTF-8
                         if (ch < 0xC2) {
                             // unexpected continuation or overlong 2-byte sequence
@@ -420,9 +587,6 @@ enum ajson_token ajson_next_token(ajson_parser *parser) {
                             RAISE_ERROR(AJSON_ERROR_PARSER_ILLEGAL_UNICODE);
                         }
                     }
-                    else if (ajson_buffer_putcp(parser, ch) != 0) {
-                        RAISE_ERROR(AJSON_ERROR_MEMORY);
-                    }
                 }
                 else {
                     // parse escape sequence
@@ -529,7 +693,15 @@ enum ajson_token ajson_next_token(ajson_parser *parser) {
                             codepoint = unit1;
                         }
 
-                        if (ajson_buffer_putcp(parser, codepoint) != 0) {
+                        if (parser->flags & AJSON_FLAG_RAW_LATIN1) {
+                            if (codepoint > 0xFF) {
+                                RAISE_ERROR(AJSON_ERROR_PARSER_ILLEGAL_UNICODE);
+                            }
+                            else if (ajson_buffer_putc(parser, codepoint) != 0) {
+                                RAISE_ERROR(AJSON_ERROR_MEMORY);
+                            }
+                        }
+                        else if (ajson_buffer_putcp(parser, codepoint) != 0) {
                             RAISE_ERROR(AJSON_ERROR_MEMORY);
                         }
                     }
@@ -814,6 +986,7 @@ enum ajson_token ajson_next_token(ajson_parser *parser) {
             }
 
             READ_NEXT_OR_EOF();
+            parser->skip = AJSON_SKIP_NONE;
             RETURN(AJSON_TOK_END_ARRAY);
         }
         else if (CURR_CH() == '{') {
@@ -872,6 +1045,7 @@ enum ajson_token ajson_next_token(ajson_parser *parser) {
             }
 
             READ_NEXT_OR_EOF();
+            parser->skip = AJSON_SKIP_NONE;
             RETURN(AJSON_TOK_END_OBJECT);
         }
 
@@ -887,3 +1061,191 @@ enum ajson_token ajson_next_token(ajson_parser *parser) {
 #ifdef AJSON_USE_GNUC_ADDRESS_FROM_LABEL
 #   pragma GCC diagnostic pop
 #endif
+
+// binary input is decoded into the same tokens
+static inline enum ajson_token ajson_read_token(ajson_parser *parser) {
+    if (parser->skip_container) {
+        // every value is skipped, so only keys and the end of the container are left
+        parser->skip = AJSON_SKIP_VALUE;
+    }
+    return parser->decoder ? ajson_decode(parser) : ajson_tokenize(parser);
+}
+
+static inline void ajson_filter_value_done(struct ajson_filter_s *filter) {
+    if (filter->depth == 0) {
+        filter->partial = filter->root_partial;
+        filter->matched = filter->root_matched;
+    }
+    else {
+        struct ajson_filter_frame *frame = filter->stack + filter->depth - 1;
+        if (frame->object) {
+            frame->key = true;
+        }
+        else {
+            ajson_filter_index(filter, ++ frame->index);
+        }
+    }
+}
+
+static enum ajson_token ajson_filter_next_token(ajson_parser *parser) {
+    struct ajson_filter_s *filter = parser->filter;
+    filter->matches = 0;
+
+    for (;;) {
+        enum ajson_token token;
+
+        if (filter->inside) {
+            // everything inside of a fully matched container is passed through
+            token = ajson_read_token(parser);
+            switch ((int)token) {
+            case AJSON_TOK_BEGIN_ARRAY:
+            case AJSON_TOK_BEGIN_OBJECT:
+                ++ filter->inside;
+                break;
+
+            case AJSON_TOK_END_ARRAY:
+            case AJSON_TOK_END_OBJECT:
+                if (-- filter->inside == 0) {
+                    ajson_filter_value_done(filter);
+                }
+                break;
+
+            case AJSON_TOK_SKIPPED:
+                continue;
+
+            default:
+                break;
+            }
+            return token;
+        }
+
+        struct ajson_filter_frame *frame = filter->depth ? filter->stack + filter->depth - 1 : NULL;
+        const bool key = frame && frame->key;
+
+        // A value that is being skipped already consumed the skip request,
+        // so it must not be requested again when parsing resumes.
+        if (!key && !filter->resume && parser->skip != AJSON_SKIP_VALUE) {
+            parser->skip =
+                filter->matched ? AJSON_SKIP_NONE :
+                filter->partial ? AJSON_SKIP_SCALAR :
+                AJSON_SKIP_VALUE;
+        }
+
+        token = ajson_read_token(parser);
+        filter->resume = token == AJSON_TOK_NEED_DATA;
+        switch ((int)token) {
+        case AJSON_TOK_CONTAINER:
+            if (filter->held) {
+                // the key of this container can be delivered now
+                filter->held = false;
+                return AJSON_TOK_STRING;
+            }
+            continue;
+
+        case AJSON_TOK_SKIPPED:
+            filter->held = false;
+            ajson_filter_value_done(filter);
+            continue;
+
+        case AJSON_TOK_STRING:
+            if (key) {
+                frame->key = false;
+                ajson_filter_key(filter, parser->value.string.value, parser->value.string.length);
+                if (filter->matched) {
+                    return token;
+                }
+                // Only deliver the key if its value turns out to be a
+                // container that filters can descend into.
+                filter->held = filter->partial != 0;
+                continue;
+            }
+            /* fall through */
+        case AJSON_TOK_NULL:
+        case AJSON_TOK_BOOLEAN:
+        case AJSON_TOK_NUMBER:
+        case AJSON_TOK_INTEGER:
+            filter->matches = filter->matched & ~(frame ? frame->matched : 0);
+            ajson_filter_value_done(filter);
+            return token;
+
+        case AJSON_TOK_BEGIN_ARRAY:
+        case AJSON_TOK_BEGIN_OBJECT:
+            filter->matches = filter->matched & ~(frame ? frame->matched : 0);
+            if (filter->partial == 0 && (filter->matched & ~filter->shallow)) {
+                filter->inside = 1;
+            }
+            else {
+                frame = filter->stack + filter->depth ++;
+                frame->partial = filter->partial;
+                frame->matched = filter->matched;
+                frame->index   = 0;
+                frame->object  = token == AJSON_TOK_BEGIN_OBJECT;
+                frame->key     = frame->object;
+                if (!frame->object) {
+                    ajson_filter_index(filter, 0);
+                }
+            }
+            return token;
+
+        case AJSON_TOK_END_ARRAY:
+        case AJSON_TOK_END_OBJECT:
+            -- filter->depth;
+            ajson_filter_value_done(filter);
+            return token;
+
+        default:
+            return token;
+        }
+    }
+}
+
+enum ajson_token ajson_next_token(ajson_parser *parser) {
+    for (;;) {
+        enum ajson_token token;
+
+        if (parser->filter) {
+            token = ajson_filter_next_token(parser);
+        }
+        else {
+            do {
+                token = ajson_read_token(parser);
+            } while (token == AJSON_TOK_SKIPPED);
+        }
+
+        switch (token) {
+        case AJSON_TOK_BEGIN_ARRAY:
+        case AJSON_TOK_BEGIN_OBJECT:
+            ++ parser->depth;
+            break;
+
+        case AJSON_TOK_END_ARRAY:
+        case AJSON_TOK_END_OBJECT:
+            if (parser->skip_container == parser->depth) {
+                parser->skip_container = 0;
+            }
+            -- parser->depth;
+            break;
+
+        case AJSON_TOK_STRING:
+            if (parser->skip_container) {
+                continue;
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        return token;
+    }
+}
+
+void ajson_skip_value(ajson_parser *parser) {
+    parser->skip = AJSON_SKIP_VALUE;
+}
+
+void ajson_skip_container(ajson_parser *parser) {
+    if (parser->depth > 0) {
+        parser->skip_container = parser->depth;
+    }
+}
@@ -0,0 +1,401 @@
+#include "ajson.h"
+#include "filter.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#ifndef HAVE_SNPRINTF
+#	include "snprintf.h"
+#endif
+
+#define AJSON_QUERY_SELECT_MASK 1
+
+static char *ajson_query_path(const char *select, const char *path) {
+    size_t select_length = strlen(select);
+    size_t path_length   = strlen(path);
+    char  *joined = malloc(select_length + path_length + 1);
+
+    if (joined) {
+        memcpy(joined, select, select_length);
+        memcpy(joined + select_length, path, path_length + 1);
+    }
+
+    return joined;
+}
+
+static int ajson_query_add_filter(ajson_query *query, const char *select, const char *path) {
+    if (*path && *path != '/') {
+        errno = EINVAL;
+        return -1;
+    }
+
+    char *joined = ajson_query_path(select, path);
+    if (joined == NULL) {
+        return -1;
+    }
+
+    int index = ajson_filter_add(&query->parser, joined, true);
+    free(joined);
+
+    return index;
+}
+
+int ajson_query_init(ajson_query *query, enum ajson_encoding encoding, const char *select, const char *value, const char *group_by) {
+    if (select == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(query, 0, sizeof(ajson_query));
+
+    if (ajson_init(&query->parser, AJSON_FLAG_INTEGER | AJSON_FLAG_STREAM, encoding) != 0) {
+        return -1;
+    }
+
+    if (ajson_filter_add(&query->parser, select, true) != 0) {
+        goto error;
+    }
+
+    if (value) {
+        int index = ajson_query_add_filter(query, select, value);
+        if (index < 0) {
+            goto error;
+        }
+        query->value_mask = UINT64_C(1) << index;
+    }
+
+    if (group_by) {
+        int index = ajson_query_add_filter(query, select, group_by);
+        if (index < 0) {
+            goto error;
+        }
+        query->group_mask = UINT64_C(1) << index;
+    }
+
+    return 0;
+
+error:
+    ajson_destroy(&query->parser);
+    return -1;
+}
+
+void ajson_query_reset(ajson_query *query) {
+    ajson_reset(&query->parser);
+
+    for (size_t i = 0; i < query->groups_count; ++ i) {
+        free((char*)query->groups[i].key);
+    }
+
+    if (query->index) {
+        memset(query->index, 0, query->index_size * sizeof(size_t));
+    }
+
+    query->groups_count = 0;
+    query->in_record    = false;
+    query->depth        = 0;
+}
+
+void ajson_query_destroy(ajson_query *query) {
+    ajson_query_reset(query);
+    ajson_destroy(&query->parser);
+
+    free(query->key_buffer);
+    free(query->groups);
+    free(query->index);
+
+    query->key_buffer      = NULL;
+    query->key_buffer_size = 0;
+    query->groups          = NULL;
+    query->groups_size     = 0;
+    query->index           = NULL;
+    query->index_size      = 0;
+}
+
+size_t ajson_query_get_group_count(const ajson_query *query) {
+    return query->groups_count;
+}
+
+const ajson_query_group *ajson_query_get_group(const ajson_query *query, size_t index) {
+    return index < query->groups_count ? query->groups + index : NULL;
+}
+
+static size_t ajson_query_hash(enum ajson_token key_type, const char *key, size_t length) {
+    // FNV-1a
+    uint64_t hash = UINT64_C(14695981039346656037) ^ (uint64_t)key_type;
+    for (size_t i = 0; i < length; ++ i) {
+        hash ^= (unsigned char)key[i];
+        hash *= UINT64_C(1099511628211);
+    }
+    return (size_t)hash;
+}
+
+static int ajson_query_set_key(ajson_query *query, enum ajson_token key_type, const char *key, size_t length) {
+    if (query->key_buffer_size < length + 1) {
+        char *buffer = realloc(query->key_buffer, length + 1);
+        if (buffer == NULL) {
+            return -1;
+        }
+        query->key_buffer      = buffer;
+        query->key_buffer_size = length + 1;
+    }
+
+    memcpy(query->key_buffer, key, length);
+    query->key_buffer[length] = 0;
+    query->record.key_type   = key_type;
+    query->record.key_length = length;
+
+    return 0;
+}
+
+static int ajson_query_rehash(ajson_query *query) {
+    size_t  size  = query->index_size ? query->index_size * 2 : 64;
+    size_t *index = size > SIZE_MAX / sizeof(size_t) ? NULL : calloc(size, sizeof(size_t));
+
+    if (index == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < query->groups_count; ++ i) {
+        const ajson_query_group *group = query->groups + i;
+        size_t slot = ajson_query_hash(group->key_type, group->key, group->key_length) & (size - 1);
+
+        while (index[slot]) {
+            slot = (slot + 1) & (size - 1);
+        }
+        index[slot] = i + 1;
+    }
+
+    free(query->index);
+    query->index      = index;
+    query->index_size = size;
+
+    return 0;
+}
+
+static ajson_query_group *ajson_query_lookup(ajson_query *query) {
+    const ajson_query_group *record = &query->record;
+    const char *key = record->key_type == AJSON_TOK_NEED_DATA ? NULL : query->key_buffer;
+
+    if (query->groups_count * 2 >= query->index_size && ajson_query_rehash(query) != 0) {
+        return NULL;
+    }
+
+    size_t mask = query->index_size - 1;
+    size_t slot = ajson_query_hash(record->key_type, key, record->key_length) & mask;
+
+    while (query->index[slot]) {
+        ajson_query_group *group = query->groups + query->index[slot] - 1;
+        if (group->key_type == record->key_type && group->key_length == record->key_length &&
+            (key == NULL || memcmp(group->key, key, record->key_length) == 0)) {
+            return group;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (query->groups_count == query->groups_size) {
+        size_t size = query->groups_size ? query->groups_size * 2 : 16;
+        ajson_query_group *groups = size > SIZE_MAX / sizeof(ajson_query_group) ? NULL :
+            realloc(query->groups, size * sizeof(ajson_query_group));
+
+        if (groups == NULL) {
+            return NULL;
+        }
+        query->groups      = groups;
+        query->groups_size = size;
+    }
+
+    ajson_query_group *group = query->groups + query->groups_count;
+    memset(group, 0, sizeof(ajson_query_group));
+    group->key_type   = record->key_type;
+    group->key_length = record->key_length;
+
+    if (key) {
+        char *copy = malloc(record->key_length + 1);
+        if (copy == NULL) {
+            return NULL;
+        }
+        memcpy(copy, key, record->key_length + 1);
+        group->key = copy;
+    }
+
+    query->index[slot] = ++ query->groups_count;
+
+    return group;
+}
+
+static int ajson_query_end_record(ajson_query *query) {
+    const ajson_query_group *record = &query->record;
+    ajson_query_group *group = ajson_query_lookup(query);
+
+    if (group == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (record->values) {
+        if (group->values == 0 || record->min < group->min) {
+            group->min = record->min;
+        }
+        if (group->values == 0 || record->max > group->max) {
+            group->max = record->max;
+        }
+        group->values += record->values;
+        group->sum    += record->sum;
+    }
+    ++ group->count;
+
+    query->in_record = false;
+
+    return 0;
+}
+
+static int ajson_query_token(ajson_query *query, enum ajson_token token) {
+    const ajson_parser *parser  = &query->parser;
+    const uint64_t      matches = ajson_get_filter_matches(parser);
+    ajson_query_group  *record  = &query->record;
+
+    if (matches & AJSON_QUERY_SELECT_MASK) {
+        memset(record, 0, sizeof(ajson_query_group));
+        record->key_type = AJSON_TOK_NEED_DATA;
+        query->in_record = true;
+        query->depth     = 0;
+    }
+
+    if (matches & query->value_mask && (token == AJSON_TOK_NUMBER || token == AJSON_TOK_INTEGER)) {
+        double value = token == AJSON_TOK_INTEGER ? (double)parser->value.integer : parser->value.number;
+
+        if (record->values == 0 || value < record->min) {
+            record->min = value;
+        }
+        if (record->values == 0 || value > record->max) {
+            record->max = value;
+        }
+        record->sum += value;
+        ++ record->values;
+    }
+
+    if (matches & query->group_mask && record->key_type == AJSON_TOK_NEED_DATA) {
+        // the first scalar group value of a record wins
+        char buf[32];
+        int  status = 0;
+
+        switch (token) {
+        case AJSON_TOK_STRING:
+            status = ajson_query_set_key(query, token, parser->value.string.value, parser->value.string.length);
+            break;
+
+        case AJSON_TOK_NUMBER:
+            status = ajson_query_set_key(query, token, buf, snprintf(buf, sizeof(buf), "%.16g", parser->value.number));
+            break;
+
+        case AJSON_TOK_INTEGER:
+            status = ajson_query_set_key(query, AJSON_TOK_NUMBER, buf, snprintf(buf, sizeof(buf), "%" PRId64, parser->value.integer));
+            break;
+
+        case AJSON_TOK_BOOLEAN:
+            status = parser->value.boolean ?
+                ajson_query_set_key(query, token, "true",  4) :
+                ajson_query_set_key(query, token, "false", 5);
+            break;
+
+        case AJSON_TOK_NULL:
+            status = ajson_query_set_key(query, token, "null", 4);
+            break;
+
+        default:
+            break;
+        }
+
+        if (status != 0) {
+            return -1;
+        }
+    }
+
+    if (query->in_record) {
+        switch (token) {
+        case AJSON_TOK_BEGIN_ARRAY:
+        case AJSON_TOK_BEGIN_OBJECT:
+            ++ query->depth;
+            break;
+
+        case AJSON_TOK_END_ARRAY:
+        case AJSON_TOK_END_OBJECT:
+            -- query->depth;
+            break;
+
+        default:
+            break;
+        }
+
+        if (query->depth == 0) {
+            return ajson_query_end_record(query);
+        }
+    }
+
+    return 0;
+}
+
+int ajson_query_dispatch(ajson_query *query) {
+    for (;;) {
+        enum ajson_token token = ajson_next_token(&query->parser);
+
+        switch (token) {
+        case AJSON_TOK_END:
+        case AJSON_TOK_NEED_DATA:
+            return 0;
+
+        case AJSON_TOK_ERROR:
+            return -1;
+
+        default:
+            if (ajson_query_token(query, token) != 0) {
+                return -1;
+            }
+            break;
+        }
+    }
+}
+
+int ajson_query_parse_fd(ajson_query *query, int fd) {
+    char buf[BUFSIZ];
+
+    for (;;) {
+        ssize_t count = read(fd, buf, sizeof(buf));
+
+        if (count < 0 || ajson_feed(&query->parser, buf, count) != 0 || ajson_query_dispatch(query) != 0) {
+            return -1;
+        }
+
+        if (count == 0)
+            break;
+    }
+
+    return 0;
+}
+
+int ajson_query_parse_file(ajson_query *query, FILE* stream) {
+    char buf[BUFSIZ];
+
+    for (;;) {
+        size_t count = fread(buf, 1, sizeof(buf), stream);
+
+        if (ferror(stream) || ajson_feed(&query->parser, buf, count) != 0 || ajson_query_dispatch(query) != 0) {
+            return -1;
+        }
+
+        if (count == 0)
+            break;
+    }
+
+    return 0;
+}
+
+int ajson_query_parse_buf(ajson_query *query, const void* buffer, size_t size) {
+    if (ajson_feed(&query->parser, buffer, size) != 0) {
+        return -1;
+    }
+    return ajson_query_dispatch(query);
+}
@@ -0,0 +1,119 @@
+#ifndef SCAN_H__
+#define SCAN_H__
+#pragma once
+
+#include <stddef.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#   include <emmintrin.h>
+#   ifndef AJSON_USE_SSE2
+#       define AJSON_USE_SSE2
+#   endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns the index of the first '"' or '\\' in input[index ... size - 1] or size
+// if there is none. Everything before that is string content that needs no
+// further inspection in Latin-1 mode.
+static inline size_t ajson_scan_string(const char *input, size_t index, size_t size) {
+#ifdef AJSON_USE_SSE2
+    const __m128i quote     = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    for (; index + 16 <= size; index += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(input + index));
+        int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(chunk, quote),
+            _mm_cmpeq_epi8(chunk, backslash)));
+
+        if (mask) {
+            return index + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    while (index < size && input[index] != '"' && input[index] != '\\') {
+        ++ index;
+    }
+
+    return index;
+}
+
+// Returns the index of the first '"', '[', ']', '{' or '}' in
+// input[index ... size - 1] or size if there is none. Used to skip values.
+static inline size_t ajson_scan_structure(const char *input, size_t index, size_t size) {
+#ifdef AJSON_USE_SSE2
+    // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i open  = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i bit5  = _mm_set1_epi8(0x20);
+
+    for (; index + 16 <= size; index += 16) {
+        __m128i chunk  = _mm_loadu_si128((const __m128i*)(input + index));
+        __m128i folded = _mm_or_si128(chunk, bit5);
+        int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(chunk, quote),
+            _mm_or_si128(
+                _mm_cmpeq_epi8(folded, open),
+                _mm_cmpeq_epi8(folded, close))));
+
+        if (mask) {
+            return index + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    while (index < size && input[index] != '"' && (input[index] | 0x20) != '{' && (input[index] | 0x20) != '}') {
+        ++ index;
+    }
+
+    return index;
+}
+
+// Returns the index of the first byte in input[index ... size - 1] that the
+// writer can't copy as it is: '"', '\\', control characters, DEL and non-ASCII
+// bytes. Returns size if there is none.
+static inline size_t ajson_scan_escape(const char *input, size_t index, size_t size) {
+#ifdef AJSON_USE_SSE2
+    // signed comparison, so bytes >= 0x80 are less than 0x20, too
+    const __m128i quote     = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i space     = _mm_set1_epi8(0x20);
+    const __m128i del       = _mm_set1_epi8(0x7F);
+
+    for (; index + 16 <= size; index += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(input + index));
+        int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(chunk, quote),
+                _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_or_si128(
+                _mm_cmplt_epi8(chunk, space),
+                _mm_cmpeq_epi8(chunk, del))));
+
+        if (mask) {
+            return index + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    while (index < size) {
+        unsigned char ch = input[index];
+        if (ch < 0x20 || ch >= 0x7F || ch == '"' || ch == '\\') {
+            break;
+        }
+        ++ index;
+    }
+
+    return index;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCAN_H__
@@ -0,0 +1,1252 @@
+#include "ajson.h"
+#include "input.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef HAVE_SNPRINTF
+#	include "snprintf.h"
+#endif
+
+#define AJSON_SCHEMA_NULL    0x01
+#define AJSON_SCHEMA_BOOLEAN 0x02
+#define AJSON_SCHEMA_INTEGER 0x04
+#define AJSON_SCHEMA_NUMBER  0x08
+#define AJSON_SCHEMA_STRING  0x10
+#define AJSON_SCHEMA_ARRAY   0x20
+#define AJSON_SCHEMA_OBJECT  0x40
+#define AJSON_SCHEMA_ALL     0x7F
+
+#define AJSON_SCHEMA_REQUIRED_MAX 64
+
+struct ajson_schema_property_s {
+    const char                       *key;
+    size_t                            length;
+    const struct ajson_schema_node_s *node;     // NULL if only listed in "required"
+    uint64_t                          required; // bit of the key in ajson_validator_frame_s::required or 0
+};
+
+struct ajson_schema_value_s {
+    enum ajson_token type; // AJSON_TOK_NULL, AJSON_TOK_BOOLEAN, AJSON_TOK_NUMBER or AJSON_TOK_STRING
+    bool             boolean;
+    double           number;
+    const char      *string;
+    size_t           length;
+};
+
+struct ajson_schema_node_s {
+    unsigned                               types;
+    double                                 minimum;
+    double                                 maximum;
+    double                                 exclusive_minimum;
+    double                                 exclusive_maximum;
+    size_t                                 min_length;
+    size_t                                 max_length;
+    size_t                                 min_items;
+    size_t                                 max_items;
+    const struct ajson_schema_node_s      *items;          // NULL for any
+    const struct ajson_schema_node_s      *additional;     // NULL for any
+    const struct ajson_schema_property_s  *properties;     // sorted by length and bytes
+    size_t                                 property_count;
+    const struct ajson_schema_property_s **required;       // in bit order
+    size_t                                 required_count;
+    uint64_t                               required_mask;
+    const struct ajson_schema_value_s     *values;         // "enum"
+    size_t                                 value_count;
+};
+
+struct ajson_schema_s {
+    ajson_arena                       arena;
+    const struct ajson_schema_node_s *root;
+};
+
+struct ajson_validator_frame_s {
+    const struct ajson_schema_node_s *node;
+    bool                              object;
+    bool                              want_key;
+    size_t                            count;      // number of items or keys so far
+    uint64_t                          required;   // required keys seen so far
+    size_t                            key_offset; // current key in ajson_validator_s::keys
+};
+
+#define AJSON_SCHEMA_NODE_INIT(TYPES) \
+    { (TYPES), -INFINITY, INFINITY, -INFINITY, INFINITY, 0, SIZE_MAX, 0, SIZE_MAX, NULL, NULL, NULL, 0, NULL, 0, 0, NULL, 0 }
+
+// Values matched by these aren't looked at at all, which lets the tokenizer
+// skip them. Every trivially true schema is compiled to ajson_schema_any.
+static const struct ajson_schema_node_s ajson_schema_any   = AJSON_SCHEMA_NODE_INIT(AJSON_SCHEMA_ALL);
+static const struct ajson_schema_node_s ajson_schema_false = AJSON_SCHEMA_NODE_INIT(0);
+
+static const struct {
+    const char *name;
+    unsigned    type;
+} ajson_schema_types[] = {
+    { "null",    AJSON_SCHEMA_NULL    },
+    { "boolean", AJSON_SCHEMA_BOOLEAN },
+    { "integer", AJSON_SCHEMA_INTEGER },
+    { "number",  AJSON_SCHEMA_NUMBER  },
+    { "string",  AJSON_SCHEMA_STRING  },
+    { "array",   AJSON_SCHEMA_ARRAY   },
+    { "object",  AJSON_SCHEMA_OBJECT  }
+};
+
+// keywords without influence on validation
+static const char *ajson_schema_annotations[] = {
+    "$schema", "$id", "id", "$comment", "title", "description", "default", "examples",
+    "format", "definitions", "$defs", "readOnly", "writeOnly", "deprecated",
+    "contentMediaType", "contentEncoding"
+};
+
+static int ajson_schema_compare(const char *key1, size_t length1, const char *key2, size_t length2) {
+    if (length1 != length2) {
+        return length1 < length2 ? -1 : 1;
+    }
+    return memcmp(key1, key2, length1);
+}
+
+static int ajson_schema_compare_properties(const void *a, const void *b) {
+    const struct ajson_schema_property_s *property1 = a;
+    const struct ajson_schema_property_s *property2 = b;
+
+    return ajson_schema_compare(property1->key, property1->length, property2->key, property2->length);
+}
+
+static const struct ajson_schema_property_s *ajson_schema_find(const struct ajson_schema_node_s *node, const char *key, size_t length) {
+    size_t low  = 0;
+    size_t high = node->property_count;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const struct ajson_schema_property_s *property = node->properties + mid;
+        int cmp = ajson_schema_compare(key, length, property->key, property->length);
+
+        if (cmp == 0) {
+            return property;
+        }
+        else if (cmp < 0) {
+            high = mid;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+
+    return NULL;
+}
+
+// Escapes a key as JSON Pointer segment. out needs space for 2 * length bytes.
+static size_t ajson_schema_escape(char *out, const char *key, size_t length) {
+    if (memchr(key, '~', length) == NULL && memchr(key, '/', length) == NULL) {
+        memcpy(out, key, length);
+        return length;
+    }
+
+    char *ptr = out;
+    for (size_t i = 0; i < length; ++ i) {
+        char c = key[i];
+        if (c == '~') {
+            *ptr ++ = '~';
+            *ptr ++ = '0';
+        }
+        else if (c == '/') {
+            *ptr ++ = '~';
+            *ptr ++ = '1';
+        }
+        else {
+            *ptr ++ = c;
+        }
+    }
+
+    return ptr - out;
+}
+
+static size_t ajson_schema_codepoints(const char *str, size_t length) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++ i) {
+        // don't count UTF-8 continuation bytes
+        count += ((unsigned char)str[i] & 0xC0) != 0x80;
+    }
+    return count;
+}
+
+// ========== Schema Compiler ==========
+
+struct ajson_schema_compiler_s {
+    ajson_parser  parser;
+    ajson_arena  *arena;
+    bool          eof;
+};
+
+static enum ajson_token ajson_schema_next(struct ajson_schema_compiler_s *compiler) {
+    enum ajson_token token = ajson_next_token(&compiler->parser);
+
+    // the whole schema was fed at once, so NEED_DATA means end of input
+    if (token == AJSON_TOK_NEED_DATA && !compiler->eof) {
+        compiler->eof = true;
+        if (ajson_feed(&compiler->parser, NULL, 0) != 0) {
+            return AJSON_TOK_ERROR;
+        }
+        token = ajson_next_token(&compiler->parser);
+    }
+
+    if (token == AJSON_TOK_ERROR || token == AJSON_TOK_NEED_DATA) {
+        errno = compiler->parser.value.error.error == AJSON_ERROR_MEMORY ? ENOMEM : EINVAL;
+        return AJSON_TOK_ERROR;
+    }
+
+    return token;
+}
+
+static bool ajson_schema_is_keyword(const ajson_parser *parser, const char *keyword) {
+    size_t length = strlen(keyword);
+    return parser->value.string.length == length && memcmp(parser->value.string.value, keyword, length) == 0;
+}
+
+static int ajson_schema_push(void **items, size_t *count, size_t *capacity, const void *item, size_t item_size) {
+    if (*count == *capacity) {
+        size_t newcapacity = *capacity ? *capacity * 2 : 8;
+        void  *newitems = newcapacity > SIZE_MAX / item_size ? NULL : realloc(*items, newcapacity * item_size);
+        if (newitems == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        *items    = newitems;
+        *capacity = newcapacity;
+    }
+
+    memcpy((char*)*items + *count * item_size, item, item_size);
+    ++ *count;
+
+    return 0;
+}
+
+static void *ajson_schema_copy(ajson_arena *arena, const void *items, size_t count, size_t item_size) {
+    if (count == 0) {
+        return NULL;
+    }
+
+    void *copy = ajson_arena_alloc(arena, count * item_size);
+    if (copy) {
+        memcpy(copy, items, count * item_size);
+    }
+    else {
+        errno = ENOMEM;
+    }
+
+    return copy;
+}
+
+static const char *ajson_schema_strndup(struct ajson_schema_compiler_s *compiler) {
+    const char *copy = ajson_arena_strndup(compiler->arena, compiler->parser.value.string.value, compiler->parser.value.string.length);
+    if (copy == NULL) {
+        errno = ENOMEM;
+    }
+    return copy;
+}
+
+static int ajson_schema_number(struct ajson_schema_compiler_s *compiler, double *number) {
+    if (ajson_schema_next(compiler) != AJSON_TOK_NUMBER) {
+        errno = EINVAL;
+        return -1;
+    }
+    *number = compiler->parser.value.number;
+    return 0;
+}
+
+static int ajson_schema_size(struct ajson_schema_compiler_s *compiler, size_t *size) {
+    double number;
+
+    if (ajson_schema_number(compiler, &number) != 0) {
+        return -1;
+    }
+
+    if (number < 0 || floor(number) != number) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *size = number >= (double)SIZE_MAX ? SIZE_MAX : (size_t)number;
+    return 0;
+}
+
+static int ajson_schema_type_name(struct ajson_schema_compiler_s *compiler, unsigned *types) {
+    for (size_t i = 0; i < sizeof(ajson_schema_types) / sizeof(ajson_schema_types[0]); ++ i) {
+        if (ajson_schema_is_keyword(&compiler->parser, ajson_schema_types[i].name)) {
+            *types |= ajson_schema_types[i].type;
+            return 0;
+        }
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+static int ajson_schema_type(struct ajson_schema_compiler_s *compiler, unsigned *types) {
+    enum ajson_token token = ajson_schema_next(compiler);
+
+    *types = 0;
+
+    if (token == AJSON_TOK_STRING) {
+        return ajson_schema_type_name(compiler, types);
+    }
+    else if (token != AJSON_TOK_BEGIN_ARRAY) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while ((token = ajson_schema_next(compiler)) == AJSON_TOK_STRING) {
+        if (ajson_schema_type_name(compiler, types) != 0) {
+            return -1;
+        }
+    }
+
+    if (token != AJSON_TOK_END_ARRAY) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int ajson_schema_exclusive(struct ajson_schema_compiler_s *compiler, double *number, bool *draft4) {
+    enum ajson_token token = ajson_schema_next(compiler);
+
+    if (token == AJSON_TOK_NUMBER) {
+        *number = compiler->parser.value.number;
+    }
+    else if (token == AJSON_TOK_BOOLEAN) {
+        // draft 4 modifies "minimum"/"maximum"
+        *draft4 = compiler->parser.value.boolean;
+    }
+    else {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static const struct ajson_schema_node_s *ajson_schema_compile_node(struct ajson_schema_compiler_s *compiler, enum ajson_token token);
+
+static int ajson_schema_properties(struct ajson_schema_compiler_s *compiler, struct ajson_schema_property_s **properties, size_t *count, size_t *capacity) {
+    if (ajson_schema_next(compiler) != AJSON_TOK_BEGIN_OBJECT) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (;;) {
+        enum ajson_token token = ajson_schema_next(compiler);
+
+        if (token == AJSON_TOK_END_OBJECT) {
+            return 0;
+        }
+        else if (token != AJSON_TOK_STRING) {
+            return -1;
+        }
+
+        struct ajson_schema_property_s property;
+        property.length   = compiler->parser.value.string.length;
+        property.key      = ajson_schema_strndup(compiler);
+        property.required = 0;
+
+        if (property.key == NULL) {
+            return -1;
+        }
+
+        property.node = ajson_schema_compile_node(compiler, ajson_schema_next(compiler));
+        if (property.node == NULL ||
+            ajson_schema_push((void**)properties, count, capacity, &property, sizeof(property)) != 0) {
+            return -1;
+        }
+    }
+}
+
+static int ajson_schema_required(struct ajson_schema_compiler_s *compiler, struct ajson_schema_property_s **required, size_t *count, size_t *capacity) {
+    if (ajson_schema_next(compiler) != AJSON_TOK_BEGIN_ARRAY) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (;;) {
+        enum ajson_token token = ajson_schema_next(compiler);
+
+        if (token == AJSON_TOK_END_ARRAY) {
+            return 0;
+        }
+        else if (token != AJSON_TOK_STRING) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        struct ajson_schema_property_s property;
+        property.length   = compiler->parser.value.string.length;
+        property.key      = ajson_schema_strndup(compiler);
+        property.node     = NULL;
+        property.required = 0;
+
+        if (property.key == NULL ||
+            ajson_schema_push((void**)required, count, capacity, &property, sizeof(property)) != 0) {
+            return -1;
+        }
+    }
+}
+
+static int ajson_schema_enum(struct ajson_schema_compiler_s *compiler, struct ajson_schema_value_s **values, size_t *count, size_t *capacity) {
+    if (ajson_schema_next(compiler) != AJSON_TOK_BEGIN_ARRAY) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (;;) {
+        enum ajson_token token = ajson_schema_next(compiler);
+        struct ajson_schema_value_s value;
+
+        memset(&value, 0, sizeof(value));
+        value.type = token;
+
+        switch (token) {
+        case AJSON_TOK_END_ARRAY:
+            if (*count == 0) {
+                errno = EINVAL;
+                return -1;
+            }
+            return 0;
+
+        case AJSON_TOK_NULL:
+            break;
+
+        case AJSON_TOK_BOOLEAN:
+            value.boolean = compiler->parser.value.boolean;
+            break;
+
+        case AJSON_TOK_NUMBER:
+            value.number = compiler->parser.value.number;
+            break;
+
+        case AJSON_TOK_STRING:
+            value.length = compiler->parser.value.string.length;
+            value.string = ajson_schema_strndup(compiler);
+            if (value.string == NULL) {
+                return -1;
+            }
+            break;
+
+        case AJSON_TOK_BEGIN_ARRAY:
+        case AJSON_TOK_BEGIN_OBJECT:
+            errno = ENOTSUP;
+            return -1;
+
+        default:
+            return -1;
+        }
+
+        if (ajson_schema_push((void**)values, count, capacity, &value, sizeof(value)) != 0) {
+            return -1;
+        }
+    }
+}
+
+// Merges the keys of "required" into the properties and sorts them.
+static int ajson_schema_finish(struct ajson_schema_compiler_s *compiler, struct ajson_schema_node_s *node,
+                               struct ajson_schema_property_s **properties, size_t *property_count, size_t *property_capacity,
+                               const struct ajson_schema_property_s *required, size_t required_count) {
+    const struct ajson_schema_property_s *ordered[AJSON_SCHEMA_REQUIRED_MAX];
+
+    for (size_t i = 0; i < required_count; ++ i) {
+        struct ajson_schema_property_s *property = NULL;
+
+        for (size_t j = 0; j < *property_count; ++ j) {
+            if (ajson_schema_compare((*properties)[j].key, (*properties)[j].length, required[i].key, required[i].length) == 0) {
+                property = *properties + j;
+                break;
+            }
+        }
+
+        if (property == NULL) {
+            if (ajson_schema_push((void**)properties, property_count, property_capacity, required + i, sizeof(required[i])) != 0) {
+                return -1;
+            }
+            property = *properties + *property_count - 1;
+        }
+
+        if (property->required == 0) {
+            if (node->required_count == AJSON_SCHEMA_REQUIRED_MAX) {
+                errno = ENOSPC;
+                return -1;
+            }
+            property->required = UINT64_C(1) << node->required_count;
+            node->required_mask |= property->required;
+            ++ node->required_count;
+        }
+    }
+
+    if (*property_count > 1) {
+        qsort(*properties, *property_count, sizeof(**properties), ajson_schema_compare_properties);
+    }
+
+    struct ajson_schema_property_s *copy = ajson_schema_copy(compiler->arena, *properties, *property_count, sizeof(**properties));
+    if (*property_count && copy == NULL) {
+        return -1;
+    }
+    node->properties     = copy;
+    node->property_count = *property_count;
+
+    if (node->required_count) {
+        for (size_t i = 0; i < node->property_count; ++ i) {
+            uint64_t bit = copy[i].required;
+            if (bit) {
+                size_t index = 0;
+                while (bit >>= 1) ++ index;
+                ordered[index] = copy + i;
+            }
+        }
+
+        node->required = ajson_schema_copy(compiler->arena, ordered, node->required_count, sizeof(ordered[0]));
+        if (node->required == NULL) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static bool ajson_schema_is_any(const struct ajson_schema_node_s *node) {
+    return node->types == AJSON_SCHEMA_ALL &&
+        node->minimum == -INFINITY && node->exclusive_minimum == -INFINITY &&
+        node->maximum ==  INFINITY && node->exclusive_maximum ==  INFINITY &&
+        node->min_length == 0 && node->max_length == SIZE_MAX &&
+        node->min_items  == 0 && node->max_items  == SIZE_MAX &&
+        (node->items      == NULL || node->items      == &ajson_schema_any) &&
+        (node->additional == NULL || node->additional == &ajson_schema_any) &&
+        node->property_count == 0 && node->value_count == 0;
+}
+
+static const struct ajson_schema_node_s *ajson_schema_compile_node(struct ajson_schema_compiler_s *compiler, enum ajson_token token) {
+    if (token == AJSON_TOK_BOOLEAN) {
+        return compiler->parser.value.boolean ? &ajson_schema_any : &ajson_schema_false;
+    }
+    else if (token != AJSON_TOK_BEGIN_OBJECT) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct ajson_schema_node_s      node = AJSON_SCHEMA_NODE_INIT(AJSON_SCHEMA_ALL);
+    const struct ajson_schema_node_s *result = NULL;
+    struct ajson_schema_property_s *properties = NULL;
+    size_t                          property_count = 0;
+    size_t                          property_capacity = 0;
+    struct ajson_schema_property_s *required = NULL;
+    size_t                          required_count = 0;
+    size_t                          required_capacity = 0;
+    struct ajson_schema_value_s    *values = NULL;
+    size_t                          value_count = 0;
+    size_t                          value_capacity = 0;
+    bool                            draft4_exclusive_minimum = false;
+    bool                            draft4_exclusive_maximum = false;
+    int                             status = 0;
+
+    for (;;) {
+        ajson_parser *parser = &compiler->parser;
+
+        token = ajson_schema_next(compiler);
+        if (token == AJSON_TOK_END_OBJECT) {
+            break;
+        }
+        else if (token != AJSON_TOK_STRING) {
+            goto cleanup;
+        }
+
+        if (ajson_schema_is_keyword(parser, "type")) {
+            status = ajson_schema_type(compiler, &node.types);
+        }
+        else if (ajson_schema_is_keyword(parser, "properties")) {
+            status = ajson_schema_properties(compiler, &properties, &property_count, &property_capacity);
+        }
+        else if (ajson_schema_is_keyword(parser, "required")) {
+            status = ajson_schema_required(compiler, &required, &required_count, &required_capacity);
+        }
+        else if (ajson_schema_is_keyword(parser, "additionalProperties")) {
+            node.additional = ajson_schema_compile_node(compiler, ajson_schema_next(compiler));
+            status = node.additional ? 0 : -1;
+        }
+        else if (ajson_schema_is_keyword(parser, "items")) {
+            token = ajson_schema_next(compiler);
+            if (token == AJSON_TOK_BEGIN_ARRAY) {
+                // tuple validation
+                errno  = ENOTSUP;
+                status = -1;
+            }
+            else {
+                node.items = ajson_schema_compile_node(compiler, token);
+                status = node.items ? 0 : -1;
+            }
+        }
+        else if (ajson_schema_is_keyword(parser, "enum")) {
+            status = ajson_schema_enum(compiler, &values, &value_count, &value_capacity);
+        }
+        else if (ajson_schema_is_keyword(parser, "minimum")) {
+            status = ajson_schema_number(compiler, &node.minimum);
+        }
+        else if (ajson_schema_is_keyword(parser, "maximum")) {
+            status = ajson_schema_number(compiler, &node.maximum);
+        }
+        else if (ajson_schema_is_keyword(parser, "exclusiveMinimum")) {
+            status = ajson_schema_exclusive(compiler, &node.exclusive_minimum, &draft4_exclusive_minimum);
+        }
+        else if (ajson_schema_is_keyword(parser, "exclusiveMaximum")) {
+            status = ajson_schema_exclusive(compiler, &node.exclusive_maximum, &draft4_exclusive_maximum);
+        }
+        else if (ajson_schema_is_keyword(parser, "minLength")) {
+            status = ajson_schema_size(compiler, &node.min_length);
+        }
+        else if (ajson_schema_is_keyword(parser, "maxLength")) {
+            status = ajson_schema_size(compiler, &node.max_length);
+        }
+        else if (ajson_schema_is_keyword(parser, "minItems")) {
+            status = ajson_schema_size(compiler, &node.min_items);
+        }
+        else if (ajson_schema_is_keyword(parser, "maxItems")) {
+            status = ajson_schema_size(compiler, &node.max_items);
+        }
+        else {
+            bool annotation = false;
+            for (size_t i = 0; i < sizeof(ajson_schema_annotations) / sizeof(ajson_schema_annotations[0]); ++ i) {
+                if (ajson_schema_is_keyword(parser, ajson_schema_annotations[i])) {
+                    annotation = true;
+                    break;
+                }
+            }
+
+            if (!annotation) {
+                errno = ENOTSUP;
+                goto cleanup;
+            }
+
+            ajson_skip_value(parser);
+        }
+
+        if (status != 0) {
+            goto cleanup;
+        }
+    }
+
+    if (draft4_exclusive_minimum) {
+        node.exclusive_minimum = node.minimum;
+        node.minimum = -INFINITY;
+    }
+
+    if (draft4_exclusive_maximum) {
+        node.exclusive_maximum = node.maximum;
+        node.maximum = INFINITY;
+    }
+
+    if (ajson_schema_finish(compiler, &node, &properties, &property_count, &property_capacity, required, required_count) != 0) {
+        goto cleanup;
+    }
+
+    node.values      = ajson_schema_copy(compiler->arena, values, value_count, sizeof(*values));
+    node.value_count = value_count;
+    if (value_count && node.values == NULL) {
+        goto cleanup;
+    }
+
+    if (ajson_schema_is_any(&node)) {
+        result = &ajson_schema_any;
+    }
+    else {
+        result = ajson_schema_copy(compiler->arena, &node, 1, sizeof(node));
+    }
+
+cleanup:
+    free(properties);
+    free(required);
+    free(values);
+
+    return result;
+}
+
+ajson_schema *ajson_schema_compile(const void *buffer, size_t size) {
+    struct ajson_schema_compiler_s compiler;
+    ajson_schema *schema = calloc(1, sizeof(ajson_schema));
+
+    if (schema == NULL) {
+        return NULL;
+    }
+
+    ajson_arena_init(&schema->arena, 0);
+
+    if (ajson_init(&compiler.parser, AJSON_FLAGS_NONE, AJSON_ENC_UTF8) != 0) {
+        free(schema);
+        return NULL;
+    }
+    compiler.arena = &schema->arena;
+    compiler.eof   = false;
+
+    if (ajson_feed(&compiler.parser, buffer, size) != 0) {
+        goto error;
+    }
+
+    schema->root = ajson_schema_compile_node(&compiler, ajson_schema_next(&compiler));
+    if (schema->root == NULL) {
+        goto error;
+    }
+
+    if (ajson_schema_next(&compiler) != AJSON_TOK_END) {
+        errno = EINVAL;
+        goto error;
+    }
+
+    ajson_destroy(&compiler.parser);
+
+    return schema;
+
+error:
+    ajson_destroy(&compiler.parser);
+    ajson_schema_free(schema);
+
+    return NULL;
+}
+
+void ajson_schema_free(ajson_schema *schema) {
+    if (schema) {
+        ajson_arena_destroy(&schema->arena);
+        free(schema);
+    }
+}
+
+// ========== Validator ==========
+
+int ajson_validator_init(ajson_validator *validator, const ajson_schema *schema) {
+    if (schema == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(validator, 0, sizeof(ajson_validator));
+    validator->schema = schema;
+
+    return 0;
+}
+
+void ajson_validator_reset(ajson_validator *validator) {
+    validator->violation     = AJSON_VIOLATION_NONE;
+    validator->next          = NULL;
+    validator->stack_current = 0;
+    validator->ignore_depth  = 0;
+    validator->keys_used     = 0;
+}
+
+void ajson_validator_destroy(ajson_validator *validator) {
+    free(validator->stack);
+    free(validator->keys);
+    free(validator->path);
+
+    validator->stack         = NULL;
+    validator->stack_size    = 0;
+    validator->stack_current = 0;
+    validator->keys          = NULL;
+    validator->keys_size     = 0;
+    validator->keys_used     = 0;
+    validator->path          = NULL;
+    validator->path_size     = 0;
+}
+
+enum ajson_violation ajson_validator_get_violation(const ajson_validator *validator) {
+    return validator->violation;
+}
+
+const char *ajson_validator_get_path(const ajson_validator *validator) {
+    return validator->violation == AJSON_VIOLATION_NONE ? NULL : validator->path;
+}
+
+const char *ajson_violation_str(enum ajson_violation violation) {
+    switch (violation) {
+    case AJSON_VIOLATION_NONE:
+        return "no violation";
+
+    case AJSON_VIOLATION_NOT_ALLOWED:
+        return "value is not allowed";
+
+    case AJSON_VIOLATION_TYPE:
+        return "value has the wrong type";
+
+    case AJSON_VIOLATION_ENUM:
+        return "value is not one of the enumerated values";
+
+    case AJSON_VIOLATION_MINIMUM:
+        return "number is too small";
+
+    case AJSON_VIOLATION_MAXIMUM:
+        return "number is too big";
+
+    case AJSON_VIOLATION_MIN_LENGTH:
+        return "string is too short";
+
+    case AJSON_VIOLATION_MAX_LENGTH:
+        return "string is too long";
+
+    case AJSON_VIOLATION_MIN_ITEMS:
+        return "array has too few items";
+
+    case AJSON_VIOLATION_MAX_ITEMS:
+        return "array has too many items";
+
+    case AJSON_VIOLATION_REQUIRED:
+        return "required property is missing";
+
+    case AJSON_VIOLATION_ADDITIONAL_PROPERTY:
+        return "additional property is not allowed";
+
+    default:
+        return "unknown violation";
+    }
+}
+
+static bool ajson_validator_reserve(char **buffer, size_t *size, size_t needed) {
+    if (needed <= *size) {
+        return true;
+    }
+
+    size_t newsize = *size ? *size : 64;
+    while (newsize < needed) {
+        if (newsize > SIZE_MAX / 2) {
+            newsize = needed;
+            break;
+        }
+        newsize *= 2;
+    }
+
+    char *newbuffer = realloc(*buffer, newsize);
+    if (newbuffer == NULL) {
+        return false;
+    }
+
+    *buffer = newbuffer;
+    *size   = newsize;
+
+    return true;
+}
+
+// Records the violation and its JSON Pointer. The path includes the current
+// key or index of the innermost container if member is true and the escaped
+// key if key is not NULL.
+static int ajson_validator_violation(ajson_validator *validator, enum ajson_violation violation, bool member, const char *key, size_t length) {
+    size_t used = 0;
+    bool   ok   = true;
+
+    validator->violation = violation;
+
+    for (size_t i = 0; ok && i < validator->stack_current; ++ i) {
+        const struct ajson_validator_frame_s *frame = validator->stack + i;
+
+        if (i + 1 == validator->stack_current && !member) {
+            break;
+        }
+
+        if (frame->object) {
+            size_t end = i + 1 < validator->stack_current ? validator->stack[i + 1].key_offset : validator->keys_used;
+            size_t key_length = end - frame->key_offset;
+
+            ok = ajson_validator_reserve(&validator->path, &validator->path_size, used + key_length + 1);
+            if (ok) {
+                validator->path[used ++] = '/';
+                memcpy(validator->path + used, validator->keys + frame->key_offset, key_length);
+                used += key_length;
+            }
+        }
+        else {
+            char buf[24];
+            int  count = snprintf(buf, sizeof(buf), "/%zu", frame->count - 1);
+
+            ok = ajson_validator_reserve(&validator->path, &validator->path_size, used + count);
+            if (ok) {
+                memcpy(validator->path + used, buf, count);
+                used += count;
+            }
+        }
+    }
+
+    if (ok && key) {
+        ok = length < SIZE_MAX / 2 && ajson_validator_reserve(&validator->path, &validator->path_size, used + 2 * length + 1);
+        if (ok) {
+            validator->path[used ++] = '/';
+            used += ajson_schema_escape(validator->path + used, key, length);
+        }
+    }
+
+    if (ok && ajson_validator_reserve(&validator->path, &validator->path_size, used + 1)) {
+        validator->path[used] = 0;
+    }
+    else {
+        free(validator->path);
+        validator->path      = NULL;
+        validator->path_size = 0;
+    }
+
+    return -1;
+}
+
+static int ajson_validator_push(ajson_validator *validator, ajson_parser *parser, const struct ajson_schema_node_s *node, bool object) {
+    if (validator->stack_current == validator->stack_size) {
+        size_t newsize = validator->stack_size ? validator->stack_size * 2 : AJSON_STACK_SIZE;
+        struct ajson_validator_frame_s *newstack = newsize > SIZE_MAX / sizeof(struct ajson_validator_frame_s) ? NULL :
+            realloc(validator->stack, newsize * sizeof(struct ajson_validator_frame_s));
+
+        if (newstack == NULL) {
+            AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+            return -1;
+        }
+
+        validator->stack      = newstack;
+        validator->stack_size = newsize;
+    }
+
+    struct ajson_validator_frame_s *frame = validator->stack + validator->stack_current ++;
+    frame->node       = node;
+    frame->object     = object;
+    frame->want_key   = true;
+    frame->count      = 0;
+    frame->required   = 0;
+    frame->key_offset = validator->keys_used;
+
+    return 0;
+}
+
+static bool ajson_validator_enum(const struct ajson_schema_node_s *node, const ajson_parser *parser, enum ajson_token token, double number) {
+    for (size_t i = 0; i < node->value_count; ++ i) {
+        const struct ajson_schema_value_s *value = node->values + i;
+
+        switch (token) {
+        case AJSON_TOK_NULL:
+            if (value->type == AJSON_TOK_NULL) {
+                return true;
+            }
+            break;
+
+        case AJSON_TOK_BOOLEAN:
+            if (value->type == AJSON_TOK_BOOLEAN && value->boolean == parser->value.boolean) {
+                return true;
+            }
+            break;
+
+        case AJSON_TOK_NUMBER:
+        case AJSON_TOK_INTEGER:
+            if (value->type == AJSON_TOK_NUMBER && value->number == number) {
+                return true;
+            }
+            break;
+
+        case AJSON_TOK_STRING:
+            if (value->type == AJSON_TOK_STRING && value->length == parser->value.string.length &&
+                memcmp(value->string, parser->value.string.value, value->length) == 0) {
+                return true;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return false;
+}
+
+static int ajson_validator_value(ajson_validator *validator, ajson_parser *parser, const struct ajson_schema_node_s *node, enum ajson_token token) {
+    if (node == &ajson_schema_any) {
+        if (token == AJSON_TOK_BEGIN_ARRAY || token == AJSON_TOK_BEGIN_OBJECT) {
+            validator->ignore_depth = 1;
+        }
+        return 0;
+    }
+
+    if (node->types == 0) {
+        return ajson_validator_violation(validator, AJSON_VIOLATION_NOT_ALLOWED, true, NULL, 0);
+    }
+
+    double number = 0;
+
+    switch (token) {
+    case AJSON_TOK_NULL:
+        if (!(node->types & AJSON_SCHEMA_NULL)) {
+            goto type_error;
+        }
+        break;
+
+    case AJSON_TOK_BOOLEAN:
+        if (!(node->types & AJSON_SCHEMA_BOOLEAN)) {
+            goto type_error;
+        }
+        break;
+
+    case AJSON_TOK_NUMBER:
+    case AJSON_TOK_INTEGER:
+        if (token == AJSON_TOK_INTEGER) {
+            number = (double)parser->value.integer;
+        }
+        else {
+            number = parser->value.number;
+
+            // numbers with a fraction of zero are integers too
+            if (!(node->types & AJSON_SCHEMA_NUMBER) && floor(number) != number) {
+                goto type_error;
+            }
+        }
+
+        if (!(node->types & (AJSON_SCHEMA_NUMBER | AJSON_SCHEMA_INTEGER))) {
+            goto type_error;
+        }
+
+        if (number < node->minimum || number <= node->exclusive_minimum) {
+            return ajson_validator_violation(validator, AJSON_VIOLATION_MINIMUM, true, NULL, 0);
+        }
+
+        if (number > node->maximum || number >= node->exclusive_maximum) {
+            return ajson_validator_violation(validator, AJSON_VIOLATION_MAXIMUM, true, NULL, 0);
+        }
+        break;
+
+    case AJSON_TOK_STRING:
+        if (!(node->types & AJSON_SCHEMA_STRING)) {
+            goto type_error;
+        }
+
+        if (node->min_length > 0 || node->max_length < SIZE_MAX) {
+            size_t length = parser->value.string.length;
+
+            // the number of code points is at most the number of bytes and
+            // at least a quarter of it
+            if (length < node->min_length || length / 4 > node->max_length) {
+                return ajson_validator_violation(validator, length < node->min_length ?
+                    AJSON_VIOLATION_MIN_LENGTH : AJSON_VIOLATION_MAX_LENGTH, true, NULL, 0);
+            }
+
+            if (length > node->max_length || length / 4 < node->min_length) {
+                length = ajson_schema_codepoints(parser->value.string.value, length);
+
+                if (length < node->min_length) {
+                    return ajson_validator_violation(validator, AJSON_VIOLATION_MIN_LENGTH, true, NULL, 0);
+                }
+
+                if (length > node->max_length) {
+                    return ajson_validator_violation(validator, AJSON_VIOLATION_MAX_LENGTH, true, NULL, 0);
+                }
+            }
+        }
+        break;
+
+    case AJSON_TOK_BEGIN_ARRAY:
+        if (!(node->types & AJSON_SCHEMA_ARRAY)) {
+            goto type_error;
+        }
+        break;
+
+    case AJSON_TOK_BEGIN_OBJECT:
+        if (!(node->types & AJSON_SCHEMA_OBJECT)) {
+            goto type_error;
+        }
+        break;
+
+    default:
+        return 0;
+    }
+
+    if (node->value_count && !ajson_validator_enum(node, parser, token, number)) {
+        return ajson_validator_violation(validator, AJSON_VIOLATION_ENUM, true, NULL, 0);
+    }
+
+    if (token == AJSON_TOK_BEGIN_ARRAY || token == AJSON_TOK_BEGIN_OBJECT) {
+        return ajson_validator_push(validator, parser, node, token == AJSON_TOK_BEGIN_OBJECT);
+    }
+
+    return 0;
+
+type_error:
+    return ajson_validator_violation(validator, AJSON_VIOLATION_TYPE, true, NULL, 0);
+}
+
+static int ajson_validator_key(ajson_validator *validator, ajson_parser *parser, struct ajson_validator_frame_s *frame) {
+    const struct ajson_schema_node_s     *object   = frame->node;
+    const char                           *key      = parser->value.string.value;
+    const size_t                          length   = parser->value.string.length;
+    const struct ajson_schema_property_s *property = ajson_schema_find(object, key, length);
+    const struct ajson_schema_node_s     *node     = NULL;
+
+    ++ frame->count;
+
+    // keys are only needed to report the path of violations, but by then
+    // the keys of the enclosing objects are long gone
+    if (length >= SIZE_MAX / 2 - frame->key_offset ||
+        !ajson_validator_reserve(&validator->keys, &validator->keys_size, frame->key_offset + 2 * length)) {
+        AJSON_SET_ERROR(parser, AJSON_ERROR_MEMORY);
+        return -1;
+    }
+    validator->keys_used = frame->key_offset + ajson_schema_escape(validator->keys + frame->key_offset, key, length);
+
+    if (property) {
+        frame->required |= property->required;
+        node = property->node;
+    }
+
+    if (node == NULL) {
+        node = object->additional ? object->additional : &ajson_schema_any;
+
+        if (node->types == 0) {
+            return ajson_validator_violation(validator, AJSON_VIOLATION_ADDITIONAL_PROPERTY, true, NULL, 0);
+        }
+    }
+
+    if (node == &ajson_schema_any) {
+        // nothing to check, so don't even tokenize it
+        ajson_skip_value(parser);
+    }
+    else {
+        frame->want_key = false;
+        validator->next = node;
+    }
+
+    return 0;
+}
+
+int ajson_validate_token(ajson_validator *validator, ajson_parser *parser, enum ajson_token token) {
+    if (validator->violation != AJSON_VIOLATION_NONE) {
+        return -1;
+    }
+
+    switch (token) {
+    case AJSON_TOK_NEED_DATA:
+    case AJSON_TOK_END:
+        return 0;
+
+    case AJSON_TOK_ERROR:
+        return -1;
+
+    default:
+        break;
+    }
+
+    if (validator->ignore_depth) {
+        if (token == AJSON_TOK_BEGIN_ARRAY || token == AJSON_TOK_BEGIN_OBJECT) {
+            ++ validator->ignore_depth;
+        }
+        else if (token == AJSON_TOK_END_ARRAY || token == AJSON_TOK_END_OBJECT) {
+            -- validator->ignore_depth;
+        }
+        return 0;
+    }
+
+    const struct ajson_schema_node_s *node;
+
+    if (validator->stack_current == 0) {
+        node = validator->schema->root;
+    }
+    else {
+        struct ajson_validator_frame_s *frame = validator->stack + validator->stack_current - 1;
+
+        if (frame->object) {
+            if (frame->want_key) {
+                if (token != AJSON_TOK_END_OBJECT) {
+                    return ajson_validator_key(validator, parser, frame);
+                }
+
+                uint64_t missing = frame->node->required_mask & ~frame->required;
+                if (missing) {
+                    size_t index = 0;
+                    while (!(missing & 1)) {
+                        missing >>= 1;
+                        ++ index;
+                    }
+                    const struct ajson_schema_property_s *property = frame->node->required[index];
+                    return ajson_validator_violation(validator, AJSON_VIOLATION_REQUIRED, false, property->key, property->length);
+                }
+
+                validator->keys_used = frame->key_offset;
+                -- validator->stack_current;
+                return 0;
+            }
+
+            frame->want_key = true;
+            node = validator->next;
+        }
+        else if (token == AJSON_TOK_END_ARRAY) {
+            if (frame->count < frame->node->min_items) {
+                return ajson_validator_violation(validator, AJSON_VIOLATION_MIN_ITEMS, false, NULL, 0);
+            }
+
+            -- validator->stack_current;
+            return 0;
+        }
+        else {
+            if (++ frame->count > frame->node->max_items) {
+                return ajson_validator_violation(validator, AJSON_VIOLATION_MAX_ITEMS, false, NULL, 0);
+            }
+            node = frame->node->items ? frame->node->items : &ajson_schema_any;
+        }
+    }
+
+    return ajson_validator_value(validator, parser, node, token);
+}
+
+// ========== Input Loops ==========
+
+struct ajson_validate_s {
+    struct ajson_input_s input;
+    ajson_validator     *validator;
+};
+
+static int ajson_validate(struct ajson_validate_s *validate) {
+    ajson_parser *parser = validate->input.parser;
+
+    if (parser->flags & (AJSON_FLAG_NUMBER_AS_STRING | AJSON_FLAG_NUMBER_COMPONENTS) || parser->filter) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ajson_validator_reset(validate->validator);
+
+    if (ajson_input_begin(&validate->input) != 0) {
+        return -1;
+    }
+
+    for (;;) {
+        enum ajson_token token = ajson_next_token(parser);
+
+        if (token == AJSON_TOK_NEED_DATA) {
+            if (ajson_input_read(&validate->input) != 0) {
+                return -1;
+            }
+        }
+        else if (ajson_validate_token(validate->validator, parser, token) != 0) {
+            return -1;
+        }
+        else if (token == AJSON_TOK_END) {
+            return 0;
+        }
+    }
+}
+
+int ajson_validate_fd(ajson_validator *validator, ajson_parser *parser, int fd) {
+    char buf[BUFSIZ];
+    struct ajson_validate_s validate = { { parser, fd, NULL, buf }, validator };
+
+    return ajson_validate(&validate);
+}
+
+int ajson_validate_file(ajson_validator *validator, ajson_parser *parser, FILE* stream) {
+    char buf[BUFSIZ];
+    struct ajson_validate_s validate = { { parser, -1, stream, buf }, validator };
+
+    return ajson_validate(&validate);
+}
+
+int ajson_validate_buf(ajson_validator *validator, ajson_parser *parser, const void* buffer, size_t size) {
+    // the whole document is fed at once, so NEED_DATA means end of input
+    struct ajson_validate_s validate = { { parser, -1, NULL, NULL }, validator };
+
+    if (ajson_feed(parser, buffer, size) != 0) {
+        return -1;
+    }
+
+    return ajson_validate(&validate);
+}
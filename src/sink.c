@@ -0,0 +1,325 @@
+#include "ajson.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+// The writer always gets the free rest of the sink buffer. A value that fills it
+// is continued after the buffer was written out (fd and FILE sinks) or grown.
+
+// string data that belongs at offset in the buffer of an iovec sink
+struct ajson_sink_ref_s {
+    size_t      offset;
+    const char *data;
+    size_t      size;
+};
+
+static int ajson_sink_init(ajson_sink *sink, int flags, const char *indent, int fd, FILE *stream) {
+    if (ajson_writer_init(&sink->writer, flags, indent) != 0) {
+        return -1;
+    }
+
+    sink->buffer = malloc(AJSON_SINK_BUFFER_SIZE);
+    if (!sink->buffer) {
+        int errnum = errno;
+        ajson_writer_destroy(&sink->writer);
+        errno = errnum;
+        return -1;
+    }
+
+    sink->buffer_size = AJSON_SINK_BUFFER_SIZE;
+    sink->used        = 0;
+    sink->flushed     = 0;
+    sink->fd          = fd;
+    sink->stream      = stream;
+    sink->refs        = NULL;
+    sink->refs_size   = 0;
+    sink->refs_count  = 0;
+    sink->iov         = NULL;
+    sink->iov_size    = 0;
+
+    return 0;
+}
+
+int ajson_writer_to_buffer(ajson_sink *sink, int flags, const char *indent) {
+    return ajson_sink_init(sink, flags, indent, -1, NULL);
+}
+
+int ajson_writer_to_fd(ajson_sink *sink, int flags, const char *indent, int fd) {
+    if (fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return ajson_sink_init(sink, flags, indent, fd, NULL);
+}
+
+int ajson_writer_to_file(ajson_sink *sink, int flags, const char *indent, FILE *stream) {
+    if (!stream) {
+        errno = EINVAL;
+        return -1;
+    }
+    return ajson_sink_init(sink, flags, indent, -1, stream);
+}
+
+static int ajson_sink_ref(void *ctx, const unsigned char *position, const char *data, size_t size) {
+    ajson_sink *sink = ctx;
+
+    if (sink->refs_count == sink->refs_size) {
+        size_t refs_size = sink->refs_size ? sink->refs_size * 2 : 16;
+        struct ajson_sink_ref_s *refs = realloc(sink->refs, refs_size * sizeof(struct ajson_sink_ref_s));
+        if (!refs) {
+            return -1;
+        }
+        sink->refs      = refs;
+        sink->refs_size = refs_size;
+    }
+
+    struct ajson_sink_ref_s *ref = &sink->refs[sink->refs_count ++];
+    ref->offset = (size_t)((const char*)position - sink->buffer);
+    ref->data   = data;
+    ref->size   = size;
+
+    return 0;
+}
+
+int ajson_writer_to_iovec(ajson_sink *sink, int flags, const char *indent) {
+    if (ajson_sink_init(sink, flags, indent, -1, NULL) != 0) {
+        return -1;
+    }
+    sink->writer.ref_func = &ajson_sink_ref;
+    sink->writer.ref_ctx  = sink;
+    return 0;
+}
+
+const struct iovec *ajson_sink_get_iovec(ajson_sink *sink, size_t *count) {
+    // buffer data before each reference and after the last one
+    size_t iov_size = 2 * sink->refs_count + 1;
+    if (iov_size > sink->iov_size) {
+        struct iovec *iov = realloc(sink->iov, iov_size * sizeof(struct iovec));
+        if (!iov) {
+            return NULL;
+        }
+        sink->iov      = iov;
+        sink->iov_size = iov_size;
+    }
+
+    size_t index  = 0;
+    size_t offset = 0;
+    for (size_t ref_index = 0; ref_index < sink->refs_count; ++ ref_index) {
+        const struct ajson_sink_ref_s *ref = &sink->refs[ref_index];
+
+        if (ref->offset > offset) {
+            sink->iov[index].iov_base = sink->buffer + offset;
+            sink->iov[index].iov_len  = ref->offset - offset;
+            ++ index;
+            offset = ref->offset;
+        }
+
+        sink->iov[index].iov_base = (void*)ref->data;
+        sink->iov[index].iov_len  = ref->size;
+        ++ index;
+    }
+
+    if (sink->used > offset) {
+        sink->iov[index].iov_base = sink->buffer + offset;
+        sink->iov[index].iov_len  = sink->used - offset;
+        ++ index;
+    }
+
+    *count = index;
+    return sink->iov;
+}
+
+void ajson_sink_reset(ajson_sink *sink) {
+    ajson_writer_reset(&sink->writer);
+    sink->used       = 0;
+    sink->flushed    = 0;
+    sink->refs_count = 0;
+}
+
+void ajson_sink_destroy(ajson_sink *sink) {
+    ajson_writer_destroy(&sink->writer);
+    free(sink->buffer);
+    free(sink->refs);
+    free(sink->iov);
+    sink->buffer      = NULL;
+    sink->buffer_size = 0;
+    sink->used        = 0;
+    sink->flushed     = 0;
+    sink->refs        = NULL;
+    sink->refs_size   = 0;
+    sink->refs_count  = 0;
+    sink->iov         = NULL;
+    sink->iov_size    = 0;
+}
+
+static int ajson_sink_grow(ajson_sink *sink) {
+    if (sink->buffer_size > SSIZE_MAX / 2) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    size_t size   = sink->buffer_size * 2;
+    char  *buffer = realloc(sink->buffer, size);
+    if (!buffer) {
+        return -1;
+    }
+
+    sink->buffer      = buffer;
+    sink->buffer_size = size;
+
+    return 0;
+}
+
+// Writes out the buffered output. If a non-blocking fd is not ready this fails
+// with EAGAIN and the rest stays buffered. The part that was written before an
+// error is counted in flushed, so it isn't written again.
+static int ajson_sink_drain(ajson_sink *sink) {
+    if (sink->stream) {
+        if (sink->flushed < sink->used) {
+            size_t count = fwrite(sink->buffer + sink->flushed, 1, sink->used - sink->flushed, sink->stream);
+            sink->flushed += count;
+            if (sink->flushed < sink->used) {
+                return -1;
+            }
+        }
+        sink->used    = 0;
+        sink->flushed = 0;
+        return 0;
+    }
+
+    while (sink->flushed < sink->used) {
+        ssize_t count = write(sink->fd, sink->buffer + sink->flushed, sink->used - sink->flushed);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        sink->flushed += (size_t)count;
+    }
+
+    sink->used    = 0;
+    sink->flushed = 0;
+
+    return 0;
+}
+
+static int ajson_sink_make_room(ajson_sink *sink) {
+    if (sink->fd >= 0 || sink->stream) {
+        if (ajson_sink_drain(sink) == 0) {
+            return 0;
+        }
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+
+        // keep the output until the fd is ready again
+        if (sink->flushed > 0) {
+            memmove(sink->buffer, sink->buffer + sink->flushed, sink->used - sink->flushed);
+            sink->used   -= sink->flushed;
+            sink->flushed = 0;
+            return 0;
+        }
+    }
+
+    return ajson_sink_grow(sink);
+}
+
+// accounts the output of a write function and continues it until the value is complete
+static int ajson_sink_put(ajson_sink *sink, ssize_t written) {
+    for (;;) {
+        if (written < 0) {
+            return -1;
+        }
+
+        sink->used += (size_t)written;
+        if (sink->used < sink->buffer_size) {
+            return 0;
+        }
+
+        if (ajson_sink_make_room(sink) != 0) {
+            return -1;
+        }
+
+        written = ajson_write_continue(&sink->writer, sink->buffer + sink->used, sink->buffer_size - sink->used);
+    }
+}
+
+int ajson_sink_flush(ajson_sink *sink) {
+    if (sink->fd < 0 && !sink->stream) {
+        return 0;
+    }
+
+    if (ajson_sink_drain(sink) != 0) {
+        return -1;
+    }
+
+    if (sink->stream && fflush(sink->stream) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+#define AJSON_SINK_FREE(SINK) (SINK)->buffer + (SINK)->used, (SINK)->buffer_size - (SINK)->used
+
+int ajson_sink_write_null(ajson_sink *sink) {
+    return ajson_sink_put(sink, ajson_write_null(&sink->writer, AJSON_SINK_FREE(sink)));
+}
+
+int ajson_sink_write_boolean(ajson_sink *sink, bool value) {
+    return ajson_sink_put(sink, ajson_write_boolean(&sink->writer, AJSON_SINK_FREE(sink), value));
+}
+
+int ajson_sink_write_number(ajson_sink *sink, double value) {
+    return ajson_sink_put(sink, ajson_write_number(&sink->writer, AJSON_SINK_FREE(sink), value));
+}
+
+int ajson_sink_write_integer(ajson_sink *sink, int64_t value) {
+    return ajson_sink_put(sink, ajson_write_integer(&sink->writer, AJSON_SINK_FREE(sink), value));
+}
+
+int ajson_sink_write_string(ajson_sink *sink, const char* value, size_t length, enum ajson_encoding encoding) {
+    return ajson_sink_put(sink, ajson_write_string(&sink->writer, AJSON_SINK_FREE(sink), value, length, encoding));
+}
+
+int ajson_sink_write_raw(ajson_sink *sink, const void *fragment, size_t length) {
+    return ajson_sink_put(sink, ajson_write_raw(&sink->writer, AJSON_SINK_FREE(sink), fragment, length));
+}
+
+int ajson_sink_write_key(ajson_sink *sink, size_t key) {
+    return ajson_sink_put(sink, ajson_write_key(&sink->writer, AJSON_SINK_FREE(sink), key));
+}
+
+int ajson_sink_write_number_array(ajson_sink *sink, const double *values, size_t count) {
+    return ajson_sink_put(sink, ajson_write_number_array(&sink->writer, AJSON_SINK_FREE(sink), values, count));
+}
+
+int ajson_sink_write_integer_array(ajson_sink *sink, const int64_t *values, size_t count) {
+    return ajson_sink_put(sink, ajson_write_integer_array(&sink->writer, AJSON_SINK_FREE(sink), values, count));
+}
+
+int ajson_sink_write_string_array(ajson_sink *sink, const char *const *values, const size_t *lengths, size_t count, enum ajson_encoding encoding) {
+    return ajson_sink_put(sink, ajson_write_string_array(&sink->writer, AJSON_SINK_FREE(sink), values, lengths, count, encoding));
+}
+
+int ajson_sink_write_begin_array(ajson_sink *sink) {
+    return ajson_sink_put(sink, ajson_write_begin_array(&sink->writer, AJSON_SINK_FREE(sink)));
+}
+
+int ajson_sink_write_end_array(ajson_sink *sink) {
+    return ajson_sink_put(sink, ajson_write_end_array(&sink->writer, AJSON_SINK_FREE(sink)));
+}
+
+int ajson_sink_write_begin_object(ajson_sink *sink) {
+    return ajson_sink_put(sink, ajson_write_begin_object(&sink->writer, AJSON_SINK_FREE(sink)));
+}
+
+int ajson_sink_write_end_object(ajson_sink *sink) {
+    return ajson_sink_put(sink, ajson_write_end_object(&sink->writer, AJSON_SINK_FREE(sink)));
+}
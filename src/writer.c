@@ -1,4 +1,6 @@
 #include "ajson.h"
+#include "scan.h"
+#include "dtoa.h"
 
 #include <errno.h>
 #include <string.h>
@@ -7,12 +9,21 @@
 #include <ctype.h>
 #include <math.h>
 
-#ifndef HAVE_SNPRINTF
-#	include "snprintf.h"
-#endif
-
 #define NOT_FIRST 32
 
+// character after the backslash of the escape of ASCII characters, 'u' for
+// \u00## escapes or 0 if the character is written as it is
+static const char ajson_escape_table[0x80] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0,   0,   '"', 0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   '\\', 0,  0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   'u'
+};
+
 static int ajson_writer_push(ajson_writer *writer, char type);
 static int ajson_writer_pop( ajson_writer *writer);
 
@@ -23,16 +34,33 @@ static ssize_t _ajson_write_boolean(ajson_writer *writer, unsigned char *buffer,
 static ssize_t _ajson_write_number (ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
 static ssize_t _ajson_write_integer(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
 static ssize_t _ajson_write_string (ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
+static ssize_t _ajson_write_raw    (ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
+static ssize_t _ajson_write_key    (ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
 
 static ssize_t _ajson_write_begin_array(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
 static ssize_t _ajson_write_end_array  (ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
 
+static ssize_t _ajson_write_number_array (ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
+static ssize_t _ajson_write_integer_array(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
+static ssize_t _ajson_write_string_array (ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
+static ssize_t _ajson_write_array_close  (ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
+
 static ssize_t _ajson_write_begin_object(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
 static ssize_t _ajson_write_end_object  (ajson_writer *writer, unsigned char *buffer, size_t size, size_t index);
 
 
-int         ajson_writer_get_flags (ajson_writer *writer) { return writer->flags;  }
-const char *ajson_writer_get_indent(ajson_writer *writer) { return writer->indent; }
+int         ajson_writer_get_flags   (ajson_writer *writer) { return writer->flags;    }
+const char *ajson_writer_get_indent  (ajson_writer *writer) { return writer->indent;   }
+int         ajson_writer_get_decimals(ajson_writer *writer) { return writer->decimals; }
+
+int ajson_writer_set_decimals(ajson_writer *writer, int decimals) {
+    if (decimals < -1 || decimals > AJSON_DECIMALS_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    writer->decimals = decimals;
+    return 0;
+}
 
 int ajson_writer_init(ajson_writer *writer, int flags, const char *indent) {
     if (flags & ~AJSON_WRITER_FLAGS_ALL) {
@@ -52,6 +80,7 @@ int ajson_writer_init(ajson_writer *writer, int flags, const char *indent) {
     memset(writer, 0, sizeof(ajson_writer));
     writer->flags      = flags;
     writer->indent     = indent;
+    writer->decimals   = -1;
     writer->write_func = &_ajson_write_dummy;
     writer->stack      = calloc(AJSON_STACK_SIZE, 1);
 
@@ -76,9 +105,87 @@ void ajson_writer_reset(ajson_writer *writer) {
 
 void ajson_writer_destroy(ajson_writer *writer) {
     free(writer->stack);
-    writer->stack         = NULL;
-    writer->stack_size    = 0;
-    writer->stack_current = 0;
+    free(writer->array.delim);
+    free(writer->keys);
+    free(writer->key_offsets);
+    writer->stack            = NULL;
+    writer->stack_size       = 0;
+    writer->stack_current    = 0;
+    writer->array.delim      = NULL;
+    writer->array.delim_size = 0;
+    writer->keys             = NULL;
+    writer->keys_size        = 0;
+    writer->keys_used        = 0;
+    writer->key_offsets      = NULL;
+    writer->key_count        = 0;
+    writer->key_offsets_size = 0;
+}
+
+// Keys are stored escaped, quoted and followed by the key separator, so writing
+// one is a single copy. Escaping needs at most 6 bytes per input byte.
+ssize_t ajson_writer_register_key(ajson_writer *writer, const char *key, size_t length, enum ajson_encoding encoding) {
+    if (!key || (encoding != AJSON_ENC_LATIN1 && encoding != AJSON_ENC_UTF8)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (length > (SSIZE_MAX - 5) / 6 || writer->keys_used > SSIZE_MAX - 5 - length * 6) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (writer->key_count == writer->key_offsets_size) {
+        size_t offsets_size = writer->key_offsets_size ? writer->key_offsets_size * 2 : 64;
+        size_t *offsets = realloc(writer->key_offsets, offsets_size * sizeof(size_t));
+        if (!offsets) {
+            return -1;
+        }
+        writer->key_offsets      = offsets;
+        writer->key_offsets_size = offsets_size;
+    }
+
+    size_t needed = writer->keys_used + length * 6 + 5;
+    if (needed > writer->keys_size) {
+        size_t keys_size = writer->keys_size ? writer->keys_size : 1024;
+        while (keys_size < needed) {
+            keys_size *= 2;
+        }
+        char *keys = realloc(writer->keys, keys_size);
+        if (!keys) {
+            return -1;
+        }
+        writer->keys      = keys;
+        writer->keys_size = keys_size;
+    }
+
+    ajson_writer encoder;
+    if (ajson_writer_init(&encoder, writer->flags, NULL) != 0) {
+        return -1;
+    }
+
+    // there is always room for the whole string, so it is written in one go
+    char   *out     = writer->keys + writer->keys_used;
+    ssize_t written = ajson_write_string(&encoder, out, needed - writer->keys_used, key, length, encoding);
+    int     errnum  = errno;
+    ajson_writer_destroy(&encoder);
+
+    if (written < 0) {
+        errno = errnum;
+        return -1;
+    }
+
+    if (writer->indent) {
+        memcpy(out + written, ": ", 2);
+        written += 2;
+    }
+    else {
+        out[written ++] = ':';
+    }
+
+    writer->key_offsets[writer->key_count] = writer->keys_used;
+    writer->keys_used += (size_t)written;
+
+    return (ssize_t)writer->key_count ++;
 }
 
 ajson_writer *ajson_writer_alloc(int flags, const char *indent) {
@@ -147,7 +254,7 @@ ssize_t ajson_write_integer(ajson_writer *writer, void *buffer, size_t size, int
 }
 
 ssize_t ajson_write_string(ajson_writer *writer, void *buffer, size_t size, const char* value, size_t length, enum ajson_encoding encoding) {
-    if (size == 0 || size > SSIZE_MAX || !value) {
+    if (size == 0 || size > SSIZE_MAX || !value || (encoding != AJSON_ENC_LATIN1 && encoding != AJSON_ENC_UTF8)) {
         errno = EINVAL;
         return -1;
     }
@@ -168,6 +275,48 @@ ssize_t ajson_write_string_utf8(ajson_writer *writer, void *buffer, size_t size,
     return ajson_write_string(writer, buffer, size, value, strlen(value), AJSON_ENC_UTF8);
 }
 
+ssize_t ajson_write_raw(ajson_writer *writer, void *buffer, size_t size, const void *fragment, size_t length) {
+    if (size == 0 || size > SSIZE_MAX || !fragment || length == 0 || (writer->stack[writer->stack_current] | NOT_FIRST) == 'o') {
+        errno = EINVAL;
+        return -1;
+    }
+    writer->write_func      = &_ajson_write_prelude;
+    writer->next_write_func = &_ajson_write_raw;
+    writer->state           = 0;
+    writer->value.string.value = fragment;
+    writer->value.string.end   = (const char*)fragment + length;
+    return _ajson_write_prelude(writer, buffer, size, 0);
+}
+
+ssize_t ajson_write_key(ajson_writer *writer, void *buffer, size_t size, size_t key) {
+    if (size == 0 || size > SSIZE_MAX || key >= writer->key_count || (writer->stack[writer->stack_current] | NOT_FIRST) != 'o') {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t end    = key + 1 < writer->key_count ? writer->key_offsets[key + 1] : writer->keys_used;
+    size_t length = end - writer->key_offsets[key];
+
+    if (!writer->indent && length < size - 1) {
+        // the comma and the key fit, no need to go through the state machine
+        unsigned char *out   = buffer;
+        size_t         index = 0;
+        if (writer->stack[writer->stack_current] & NOT_FIRST) {
+            out[index ++] = ',';
+        }
+        memcpy(out + index, writer->keys + writer->key_offsets[key], length);
+        writer->stack[writer->stack_current] = 'v';
+        writer->write_func = &_ajson_write_dummy;
+        return index + length;
+    }
+
+    writer->write_func      = &_ajson_write_prelude;
+    writer->next_write_func = &_ajson_write_key;
+    writer->state           = 0;
+    writer->value.string.value = writer->keys + writer->key_offsets[key];
+    writer->value.string.end   = writer->keys + end;
+    return _ajson_write_prelude(writer, buffer, size, 0);
+}
+
 ssize_t ajson_write_begin_array(ajson_writer *writer, void *buffer, size_t size) {
     if (size == 0 || size > SSIZE_MAX || (writer->stack[writer->stack_current] | NOT_FIRST) == 'o') {
         errno = EINVAL;
@@ -190,6 +339,95 @@ ssize_t ajson_write_end_array(ajson_writer *writer, void *buffer, size_t size) {
     return _ajson_write_end_array(writer, buffer, size, 0);
 }
 
+// Prepares writing a whole array at once. The delimiter that comes before every
+// item (comma, line break and indentation of the items) is built only once, the
+// first item skips the comma.
+static int ajson_writer_begin_items(ajson_writer *writer, const void *values, size_t count) {
+    size_t indent_length = writer->indent ? strlen(writer->indent) : 0;
+    size_t depth         = writer->stack_current + 1;
+    size_t length        = 1;
+
+    if (writer->indent) {
+        if (indent_length > 0 && depth > (SSIZE_MAX - 2) / indent_length) {
+            errno = ENOMEM;
+            return -1;
+        }
+        length += 1 + indent_length * depth;
+    }
+
+    if (length >= writer->array.delim_size) {
+        char *delim = realloc(writer->array.delim, length + 1);
+        if (!delim) {
+            return -1;
+        }
+        writer->array.delim      = delim;
+        writer->array.delim_size = length + 1;
+    }
+
+    char *ptr = writer->array.delim;
+    *ptr ++ = ',';
+    if (writer->indent) {
+        *ptr ++ = '\n';
+        for (size_t level = 0; level < depth; ++ level) {
+            memcpy(ptr, writer->indent, indent_length);
+            ptr += indent_length;
+        }
+    }
+    *ptr = 0;
+
+    writer->array.delim_length = length;
+    writer->array.values       = values;
+    writer->array.count        = count;
+    writer->array.index        = 0;
+
+    return 0;
+}
+
+ssize_t ajson_write_number_array(ajson_writer *writer, void *buffer, size_t size, const double *values, size_t count) {
+    if (size == 0 || size > SSIZE_MAX || (count > 0 && !values) || (writer->stack[writer->stack_current] | NOT_FIRST) == 'o') {
+        errno = EINVAL;
+        return -1;
+    }
+    if (ajson_writer_begin_items(writer, values, count) != 0) {
+        return -1;
+    }
+    writer->write_func      = &_ajson_write_prelude;
+    writer->next_write_func = &_ajson_write_number_array;
+    writer->state           = 0;
+    return _ajson_write_prelude(writer, buffer, size, 0);
+}
+
+ssize_t ajson_write_integer_array(ajson_writer *writer, void *buffer, size_t size, const int64_t *values, size_t count) {
+    if (size == 0 || size > SSIZE_MAX || (count > 0 && !values) || (writer->stack[writer->stack_current] | NOT_FIRST) == 'o') {
+        errno = EINVAL;
+        return -1;
+    }
+    if (ajson_writer_begin_items(writer, values, count) != 0) {
+        return -1;
+    }
+    writer->write_func      = &_ajson_write_prelude;
+    writer->next_write_func = &_ajson_write_integer_array;
+    writer->state           = 0;
+    return _ajson_write_prelude(writer, buffer, size, 0);
+}
+
+ssize_t ajson_write_string_array(ajson_writer *writer, void *buffer, size_t size, const char *const *values, const size_t *lengths, size_t count, enum ajson_encoding encoding) {
+    if (size == 0 || size > SSIZE_MAX || (count > 0 && !values) || (encoding != AJSON_ENC_LATIN1 && encoding != AJSON_ENC_UTF8) ||
+        (writer->stack[writer->stack_current] | NOT_FIRST) == 'o') {
+        errno = EINVAL;
+        return -1;
+    }
+    if (ajson_writer_begin_items(writer, values, count) != 0) {
+        return -1;
+    }
+    writer->array.lengths   = lengths;
+    writer->array.encoding  = encoding;
+    writer->write_func      = &_ajson_write_prelude;
+    writer->next_write_func = &_ajson_write_string_array;
+    writer->state           = 0;
+    return _ajson_write_prelude(writer, buffer, size, 0);
+}
+
 ssize_t ajson_write_begin_object(ajson_writer *writer, void *buffer, size_t size) {
     if (size == 0 || size > SSIZE_MAX || (writer->stack[writer->stack_current] | NOT_FIRST) == 'o') {
         errno = EINVAL;
@@ -202,7 +440,7 @@ ssize_t ajson_write_begin_object(ajson_writer *writer, void *buffer, size_t size
 }
 
 ssize_t ajson_write_end_object(ajson_writer *writer, void *buffer, size_t size) {
-    if (size == 0 || size > SSIZE_MAX || writer->stack[writer->stack_current] == 'k') {
+    if (size == 0 || size > SSIZE_MAX || writer->stack[writer->stack_current] == 'k' || writer->stack[writer->stack_current] == 'v') {
         errno = EINVAL;
         return -1;
     }
@@ -278,7 +516,14 @@ enum ajson_named_states {
 #define END_DISPATCH  AUTO_STATE(); writer->state = AUTO_STATE_REF(); } return index;
 #define RAISE_ERROR() AUTO_STATE(); writer->state = AUTO_STATE_REF(); return -1;
 #define CONTINUE(NAME) writer->state = STATE_REF(NAME); return index;
-#define TO_HEX(CH) ((CH) > 9 ? 'a' + (CH) - 10 : '0' + (CH))
+
+// suspends if the buffer is full and resumes here with the next buffer
+#define WAIT_FOR_SPACE() \
+    AUTO_STATE(); \
+    if (index == size) { \
+        writer->state = AUTO_STATE_REF(); \
+        return size; \
+    }
 
 #define WRITE_CHAR(CH) \
     writer->buffer.character = (CH); \
@@ -340,6 +585,10 @@ ssize_t _ajson_write_prelude(ajson_writer *writer, unsigned char *buffer, size_t
             WRITE_CHAR(':');
         }
     }
+    else if (curr == 'v') {
+        // a registered key already wrote the key separator
+        writer->stack[writer->stack_current] = 'o';
+    }
 
     writer->write_func = writer->next_write_func;
     writer->state      = 0;
@@ -375,195 +624,271 @@ ssize_t _ajson_write_boolean(ajson_writer *writer, unsigned char *buffer, size_t
     END_DISPATCH;
 }
 
+// needs AJSON_DTOA_BUFFER_SIZE bytes, there is no JSON for NaN and infinity
+static inline size_t ajson_format_number(char *out, double value, int decimals) {
+    if (!isfinite(value)) {
+        memcpy(out, "null", 4);
+        return 4;
+    }
+    return decimals < 0 ?
+        ajson_format_double(out, value) :
+        ajson_format_fixed(out, value, decimals);
+}
+
 ssize_t _ajson_write_number(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
     BEGIN_DISPATCH;
 
-    if (isfinite(writer->value.number.value)) {
-        size_t nfree = size - index;
+    if (size - index >= AJSON_DTOA_BUFFER_SIZE) {
+        // this code path saves one memcpy
+        index += ajson_format_number((char*)buffer + index, writer->value.number.value, writer->decimals);
+    }
+    else {
+        size_t count = ajson_format_number(writer->value.number.buffer, writer->value.number.value, writer->decimals);
+        writer->value.number.buffer[count] = 0;
 
-        if (nfree >= sizeof(writer->value.number.buffer)) {
-            // this code path saves one memcpy
-            int count = snprintf((char*)buffer + index, nfree, "%.16g", writer->value.number.value);
-            if (count < 0) {
-                RAISE_ERROR();
-            }
-            else if ((size_t)count > nfree) {
-                errno = ENOBUFS;
-                RAISE_ERROR();
-            }
+        WRITE_STR(writer->value.number.buffer);
+    }
 
-            index += (size_t)count;
-        }
-        else {
-            writer->value.number.written = 0;
+    END_DISPATCH;
+}
 
-            int count = snprintf(writer->value.number.buffer, sizeof(writer->value.number.buffer), "%.16g", writer->value.number.value);
-            if (count < 0) {
-                RAISE_ERROR();
-            }
-            else if ((size_t)count > sizeof(writer->value.number.buffer)) {
-                errno = ENOBUFS;
-                RAISE_ERROR();
-            }
+// "00" ... "99"
+static const char ajson_digit_pairs[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
 
-            WRITE_STR(writer->value.number.buffer);
-        }
+static inline size_t ajson_count_digits(uint64_t value) {
+    size_t count = 1;
+    for (;;) {
+        if (value < 10)    return count;
+        if (value < 100)   return count + 1;
+        if (value < 1000)  return count + 2;
+        if (value < 10000) return count + 3;
+        value /= 10000;
+        count += 4;
+    }
+}
+
+// Writes the decimal representation of value to out, two digits per division.
+// Returns the number of written characters (at most 20).
+static size_t ajson_format_integer(char *out, int64_t value) {
+    uint64_t magnitude = (uint64_t)value;
+    size_t   sign      = 0;
+
+    if (value < 0) {
+        magnitude = 0 - magnitude;
+        out[0] = '-';
+        sign = 1;
+    }
+
+    size_t count = sign + ajson_count_digits(magnitude);
+    char  *ptr   = out + count;
+
+    while (magnitude >= 100) {
+        const char *pair = ajson_digit_pairs + (magnitude % 100) * 2;
+        magnitude /= 100;
+        *-- ptr = pair[1];
+        *-- ptr = pair[0];
+    }
+
+    if (magnitude >= 10) {
+        const char *pair = ajson_digit_pairs + magnitude * 2;
+        *-- ptr = pair[1];
+        *-- ptr = pair[0];
     }
     else {
-        WRITE_STR("null");
+        *-- ptr = '0' + magnitude;
     }
 
-    END_DISPATCH;
+    return count;
 }
 
 ssize_t _ajson_write_integer(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
     BEGIN_DISPATCH;
 
-    if (writer->value.integer.value.sval == 0) {
-        WRITE_CHAR('0');
+    if (size - index >= 20) {
+        // this code path saves one memcpy
+        index += ajson_format_integer((char*)buffer + index, writer->value.integer.value.sval);
     }
     else {
-        uint64_t integer;
-        if (writer->value.integer.value.sval < 0) {
-            WRITE_CHAR('-');
-            integer = -writer->value.integer.value.sval;
-        }
-        else {
-            integer = writer->value.integer.value.sval;
-        }
+        size_t count = ajson_format_integer(writer->value.integer.buffer, writer->value.integer.value.sval);
+        writer->value.integer.buffer[count] = 0;
 
-        uint64_t div = 10000000000000000000LU;
-        while ((integer / div) == 0) {
-            div /= 10;
-        }
-
-        writer->value.integer.value.uval = integer;
-        writer->value.integer.div        = div;
-
-        while (writer->value.integer.div > 0) {
-            WRITE_CHAR('0' + (writer->value.integer.value.uval / writer->value.integer.div) % 10);
-            writer->value.integer.div /= 10;
-        }
+        WRITE_STR(writer->value.integer.buffer);
     }
 
     END_DISPATCH;
 }
 
-ssize_t _ajson_write_string(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
-    BEGIN_DISPATCH;
+// escapes of one character up to \uXXXX\uXXXX
+static inline char *ajson_format_unicode_escape(char *out, unsigned int unit) {
+    static const char hex[] = "0123456789abcdef";
 
-    WRITE_CHAR('"');
+    out[0] = '\\';
+    out[1] = 'u';
+    out[2] = hex[(unit >> 12) & 0x0F];
+    out[3] = hex[(unit >>  8) & 0x0F];
+    out[4] = hex[(unit >>  4) & 0x0F];
+    out[5] = hex[ unit        & 0x0F];
 
-    while (writer->value.string.value != writer->value.string.end) {
-        unsigned char ch = *writer->value.string.value;
+    return out + 6;
+}
 
-        if (ch == '"') {
-            WRITE_STR("\\\"");
-            writer->value.string.value += 1;
+static void ajson_format_codepoint_escape(char *out, uint32_t codepoint) {
+    if (codepoint < 0x10000) {
+        out = ajson_format_unicode_escape(out, codepoint);
+    }
+    else {
+        // UTF-16 surrogate pair
+        out = ajson_format_unicode_escape(out, (codepoint >> 10)   + 0xD7C0);
+        out = ajson_format_unicode_escape(out, (codepoint & 0x3FF) + 0xDC00);
+    }
+    *out = 0;
+}
+
+// Writes the run of plain characters at the current string position. Returns
+// the new index or -1 on error.
+static inline ssize_t ajson_write_plain(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index, size_t plain) {
+    if (plain >= AJSON_SINK_REF_MIN && writer->ref_func) {
+        // the output refers to the data where it is
+        if (writer->ref_func(writer->ref_ctx, buffer + index, writer->value.string.value, plain) != 0) {
+            return -1;
         }
-        else if (ch == '\\') {
-            WRITE_STR("\\\\");
-            writer->value.string.value += 1;
+    }
+    else {
+        // copy as much of the run of plain characters as fits at once
+        if (plain > size - index) {
+            plain = size - index;
         }
-        else if (ch == '\b') {
-            WRITE_STR("\\b");
-            writer->value.string.value += 1;
+        memcpy(buffer + index, writer->value.string.value, plain);
+        index += plain;
+    }
+    writer->value.string.value += plain;
+    return index;
+}
+
+// Formats the escape of the character at the current string position (or its
+// UTF-8 sequence) into writer->value.string.esc and skips the character.
+static int ajson_format_escape(ajson_writer *writer) {
+    unsigned char ch  = *writer->value.string.value;
+    char         *esc = writer->value.string.esc;
+
+    if (ch < 0x80) {
+        char escape = ajson_escape_table[ch];
+        if (escape == 'u') {
+            ajson_format_codepoint_escape(esc, ch);
         }
-        else if (ch == '\f') {
-            WRITE_STR("\\f");
-            writer->value.string.value += 1;
+        else {
+            esc[0] = '\\';
+            esc[1] = escape;
+            esc[2] = 0;
         }
-        else if (ch == '\n') {
-            WRITE_STR("\\n");
-            writer->value.string.value += 1;
+        writer->value.string.value += 1;
+    }
+    else if (writer->value.string.encoding == AJSON_ENC_LATIN1) {
+        if (ch <= 0x9F) {
+            ajson_format_codepoint_escape(esc, ch);
         }
-        else if (ch == '\r') {
-            WRITE_STR("\\r");
-            writer->value.string.value += 1;
+        else {
+            esc[0] = ch;
+            esc[1] = 0;
         }
-        else if (ch == '\t') {
-            WRITE_STR("\\t");
-            writer->value.string.value += 1;
+        writer->value.string.value += 1;
+    }
+    else {
+        uint32_t codepoint = 0;
+        int count = ajson_decode_utf8((const unsigned char*)writer->value.string.value, writer->value.string.end - writer->value.string.value, &codepoint);
+        if (count <= 0) {
+            return -1;
         }
-        else if (ch <= 0x1F || ch == 0x7F || (writer->value.string.encoding == AJSON_ENC_LATIN1 && ch >= 0x80 && ch <= 0x9F)) {
-            WRITE_STR("\\u00");
-
-            ch = *writer->value.string.value >> 4;
-            WRITE_CHAR(TO_HEX(ch));
-
-            ch = *writer->value.string.value & 0x0F;
-            WRITE_CHAR(TO_HEX(ch));
 
-            writer->value.string.value += 1;
-        }
-        else if (ch < 0x7F || writer->value.string.encoding == AJSON_ENC_LATIN1) {
-            WRITE_CHAR(ch);
-            writer->value.string.value += 1;
+        if (writer->flags & AJSON_WRITER_FLAG_ASCII || (codepoint >= 0x80 && codepoint <= 0x9F)) {
+            // encode as \u####(\u####), i.e. ASCII encoded UTF-16
+            ajson_format_codepoint_escape(esc, codepoint);
         }
         else {
-            uint32_t codepoint = 0;
-            int count = ajson_decode_utf8((const unsigned char*)writer->value.string.value, writer->value.string.end - writer->value.string.value, &codepoint);
-            if (count <= 0) {
+            // copy input because it is already UTF-8
+            memcpy(esc, writer->value.string.value, count);
+            esc[count] = 0;
+        }
+        writer->value.string.value += count;
+    }
+
+    return 0;
+}
+
+ssize_t _ajson_write_string(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
+    BEGIN_DISPATCH;
+
+    WRITE_CHAR('"');
+
+    while (writer->value.string.value != writer->value.string.end) {
+        WAIT_FOR_SPACE();
+
+        size_t plain = ajson_scan_escape(writer->value.string.value, 0, writer->value.string.end - writer->value.string.value);
+        if (plain > 0) {
+            ssize_t next = ajson_write_plain(writer, buffer, size, index, plain);
+            if (next < 0) {
                 RAISE_ERROR();
             }
+            index = next;
+            continue;
+        }
 
-            if (writer->flags & AJSON_WRITER_FLAG_ASCII || (codepoint >= 0x80 && codepoint <= 0x9F)) {
-                // encode as \u####(\u####), i.e. ASCII encoded UTF-16
-                writer->value.string.value += count;
+        if (ajson_format_escape(writer) != 0) {
+            RAISE_ERROR();
+        }
 
-                if (codepoint < 0x10000) {
-                    writer->value.string.buffer.utf16.unit1 = codepoint;
-                    writer->value.string.buffer.utf16.unit2 = 0;
-                }
-                else {
-                    writer->value.string.buffer.utf16.unit1 = (codepoint >> 10)   + 0xD7C0;
-                    writer->value.string.buffer.utf16.unit2 = (codepoint & 0x3FF) + 0xDC00;
-                }
+        WRITE_STR(writer->value.string.esc);
+    }
 
-                WRITE_STR("\\u");
+    WRITE_CHAR('"');
 
-                ch = (writer->value.string.buffer.utf16.unit1 >> 12) & 0x0F;
-                WRITE_CHAR(TO_HEX(ch));
+    END_DISPATCH;
+}
 
-                ch = (writer->value.string.buffer.utf16.unit1 >> 8) & 0x0F;
-                WRITE_CHAR(TO_HEX(ch));
+ssize_t _ajson_write_raw(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
+    BEGIN_DISPATCH;
 
-                ch = (writer->value.string.buffer.utf16.unit1 >> 4) & 0x0F;
-                WRITE_CHAR(TO_HEX(ch));
+    while (writer->value.string.value != writer->value.string.end) {
+        WAIT_FOR_SPACE();
 
-                ch = writer->value.string.buffer.utf16.unit1 & 0x0F;
-                WRITE_CHAR(TO_HEX(ch));
+        ssize_t next = ajson_write_plain(writer, buffer, size, index, writer->value.string.end - writer->value.string.value);
+        if (next < 0) {
+            RAISE_ERROR();
+        }
+        index = next;
+    }
 
-                if (writer->value.string.buffer.utf16.unit2) {
-                    WRITE_STR("\\u");
+    END_DISPATCH;
+}
 
-                    ch = (writer->value.string.buffer.utf16.unit2 >> 12) & 0x0F;
-                    WRITE_CHAR(TO_HEX(ch));
+ssize_t _ajson_write_key(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
+    BEGIN_DISPATCH;
 
-                    ch = (writer->value.string.buffer.utf16.unit2 >> 8) & 0x0F;
-                    WRITE_CHAR(TO_HEX(ch));
+    writer->stack[writer->stack_current] = 'v';
 
-                    ch = (writer->value.string.buffer.utf16.unit2 >> 4) & 0x0F;
-                    WRITE_CHAR(TO_HEX(ch));
+    while (writer->value.string.value != writer->value.string.end) {
+        WAIT_FOR_SPACE();
 
-                    ch = writer->value.string.buffer.utf16.unit2 & 0x0F;
-                    WRITE_CHAR(TO_HEX(ch));
-                }
-            }
-            else {
-                // copy input because it is already UTF-8
-                for (writer->value.string.buffer.count = count;
-                     writer->value.string.buffer.count > 0;
-                     -- writer->value.string.buffer.count) {
-                    WRITE_CHAR(*writer->value.string.value);
-                    writer->value.string.value += 1;
-                }
-            }
+        size_t count = writer->value.string.end - writer->value.string.value;
+        if (count > size - index) {
+            count = size - index;
         }
+        memcpy(buffer + index, writer->value.string.value, count);
+        writer->value.string.value += count;
+        index += count;
     }
 
-    WRITE_CHAR('"');
-
     END_DISPATCH;
 }
 
@@ -602,6 +927,184 @@ ssize_t _ajson_write_end_array(ajson_writer *writer, unsigned char *buffer, size
     END_DISPATCH;
 }
 
+// The items of arrays written at once are formatted in place while the longest
+// possible item and its delimiter fit into the buffer, the rest goes through
+// the resumable path.
+
+ssize_t _ajson_write_number_array(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
+    BEGIN_DISPATCH;
+
+    WRITE_CHAR('[');
+
+    while (writer->array.index < writer->array.count) {
+        if (size - index >= writer->array.delim_length + AJSON_DTOA_BUFFER_SIZE) {
+            const double *values   = writer->array.values;
+            const char   *delim    = writer->array.delim;
+            size_t        length   = writer->array.delim_length;
+            size_t        count    = writer->array.count;
+            size_t        item     = writer->array.index;
+            size_t        limit    = size - length - AJSON_DTOA_BUFFER_SIZE;
+            int           decimals = writer->decimals;
+            size_t        skip     = item == 0;
+
+            do {
+                memcpy(buffer + index, delim + skip, length - skip);
+                index += length - skip;
+                index += ajson_format_number((char*)buffer + index, values[item], decimals);
+                skip = 0;
+                ++ item;
+            } while (item < count && index <= limit);
+
+            writer->array.index = item;
+        }
+        else {
+            const double *values = writer->array.values;
+            size_t count = ajson_format_number(writer->value.number.buffer, values[writer->array.index], writer->decimals);
+            writer->value.number.buffer[count] = 0;
+
+            WRITE_STR(writer->array.delim + (writer->array.index == 0));
+            WRITE_STR(writer->value.number.buffer);
+            ++ writer->array.index;
+        }
+    }
+
+    writer->write_func = &_ajson_write_array_close;
+    writer->state      = 0;
+
+    return _ajson_write_array_close(writer, buffer, size, index);
+
+    END_DISPATCH;
+}
+
+ssize_t _ajson_write_integer_array(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
+    BEGIN_DISPATCH;
+
+    WRITE_CHAR('[');
+
+    while (writer->array.index < writer->array.count) {
+        if (size - index >= writer->array.delim_length + 20) {
+            const int64_t *values = writer->array.values;
+            const char    *delim  = writer->array.delim;
+            size_t         length = writer->array.delim_length;
+            size_t         count  = writer->array.count;
+            size_t         item   = writer->array.index;
+            size_t         limit  = size - length - 20;
+            size_t         skip   = item == 0;
+
+            do {
+                memcpy(buffer + index, delim + skip, length - skip);
+                index += length - skip;
+                index += ajson_format_integer((char*)buffer + index, values[item]);
+                skip = 0;
+                ++ item;
+            } while (item < count && index <= limit);
+
+            writer->array.index = item;
+        }
+        else {
+            const int64_t *values = writer->array.values;
+            size_t count = ajson_format_integer(writer->value.integer.buffer, values[writer->array.index]);
+            writer->value.integer.buffer[count] = 0;
+
+            WRITE_STR(writer->array.delim + (writer->array.index == 0));
+            WRITE_STR(writer->value.integer.buffer);
+            ++ writer->array.index;
+        }
+    }
+
+    writer->write_func = &_ajson_write_array_close;
+    writer->state      = 0;
+
+    return _ajson_write_array_close(writer, buffer, size, index);
+
+    END_DISPATCH;
+}
+
+ssize_t _ajson_write_string_array(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
+    BEGIN_DISPATCH;
+
+    WRITE_CHAR('[');
+
+    for (; writer->array.index < writer->array.count; ++ writer->array.index) {
+        {
+            const char *const *values = writer->array.values;
+            const char        *value  = values[writer->array.index];
+            size_t             length = 0;
+
+            if (value) {
+                length = writer->array.lengths ? writer->array.lengths[writer->array.index] : strlen(value);
+            }
+
+            writer->value.string.value    = value;
+            writer->value.string.end      = value ? value + length : NULL;
+            writer->value.string.encoding = writer->array.encoding;
+
+            size_t skip = writer->array.index == 0;
+            if (size - index >= writer->array.delim_length - skip) {
+                memcpy(buffer + index, writer->array.delim + skip, writer->array.delim_length - skip);
+                index += writer->array.delim_length - skip;
+            }
+            else {
+                WRITE_STR(writer->array.delim + skip);
+            }
+        }
+
+        if (!writer->value.string.value) {
+            WRITE_STR("null");
+            continue;
+        }
+
+        WRITE_CHAR('"');
+
+        while (writer->value.string.value != writer->value.string.end) {
+            WAIT_FOR_SPACE();
+
+            size_t plain = ajson_scan_escape(writer->value.string.value, 0, writer->value.string.end - writer->value.string.value);
+            if (plain > 0) {
+                ssize_t next = ajson_write_plain(writer, buffer, size, index, plain);
+                if (next < 0) {
+                    RAISE_ERROR();
+                }
+                index = next;
+                continue;
+            }
+
+            if (ajson_format_escape(writer) != 0) {
+                RAISE_ERROR();
+            }
+
+            WRITE_STR(writer->value.string.esc);
+        }
+
+        WRITE_CHAR('"');
+    }
+
+    writer->write_func = &_ajson_write_array_close;
+    writer->state      = 0;
+
+    return _ajson_write_array_close(writer, buffer, size, index);
+
+    END_DISPATCH;
+}
+
+// the items were one level deeper than the array
+ssize_t _ajson_write_array_close(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
+    BEGIN_DISPATCH;
+
+    if (writer->array.count > 0 && writer->indent) {
+        WRITE_CHAR('\n');
+        if (*writer->indent) {
+            for (writer->nesting_written = 0; writer->nesting_written < writer->stack_current; ++ writer->nesting_written) {
+                WRITE_STR(writer->indent);
+            }
+        }
+    }
+
+    WRITE_CHAR(']');
+
+    END_DISPATCH;
+}
+
 ssize_t _ajson_write_begin_object(ajson_writer *writer, unsigned char *buffer, size_t size, size_t index) {
     BEGIN_DISPATCH;
 
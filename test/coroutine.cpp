@@ -0,0 +1,196 @@
+// Copies a JSON document with the coroutine adapters of ajson.hpp: a coroutine
+// pulls tokens from a token_stream and writes them to a writer_sink with a
+// 7 byte buffer, so most tokens wait for input and most writes wait for the
+// output buffer to be drained.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <getopt.h>
+#include <vector>
+
+#include "ajson.hpp"
+
+#ifdef AJSON_HAS_COROUTINES
+
+namespace {
+
+enum copy_status {
+    COPY_RUNNING,
+    COPY_DONE,
+    COPY_FAILED
+};
+
+// runs until the first co_await that waits and frees itself at the end
+struct task {
+    struct promise_type {
+        task get_return_object() { return task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+task copy(ajson::token_stream& tokens, ajson::writer_sink& sink, enum copy_status& status) {
+    ajson::parser& parser = tokens.parser();
+
+    for (;;) {
+        int result = 0;
+
+        switch (co_await tokens.next()) {
+        case AJSON_TOK_NULL:         result = co_await sink.write_null(); break;
+        case AJSON_TOK_BOOLEAN:      result = co_await sink.write_boolean(parser.boolean()); break;
+        case AJSON_TOK_NUMBER:       result = co_await sink.write_number(parser.number()); break;
+        case AJSON_TOK_INTEGER:      result = co_await sink.write_integer(parser.integer()); break;
+        case AJSON_TOK_STRING:       result = co_await sink.write_string(parser.string()); break;
+        case AJSON_TOK_BEGIN_ARRAY:  result = co_await sink.write_begin_array(); break;
+        case AJSON_TOK_END_ARRAY:    result = co_await sink.write_end_array(); break;
+        case AJSON_TOK_BEGIN_OBJECT: result = co_await sink.write_begin_object(); break;
+        case AJSON_TOK_END_OBJECT:   result = co_await sink.write_end_object(); break;
+
+        case AJSON_TOK_END:
+            result = co_await sink.flush();
+            status = result == 0 ? COPY_DONE : COPY_FAILED;
+            co_return;
+
+        case AJSON_TOK_ERROR:
+        case AJSON_TOK_NEED_DATA:
+            status = COPY_FAILED;
+            co_return;
+        }
+
+        if (result != 0) {
+            perror("ajson::writer_sink");
+            status = COPY_FAILED;
+            co_return;
+        }
+    }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"help",        no_argument,       0, 'h'},
+        {"integers",    no_argument,       0, 'i'},
+        {"indent",      no_argument,       0, 'I'},
+        {"buffer-size", required_argument, 0, 'b'},
+        {0,             0,                 0,  0 }
+    };
+
+    int         flags       = AJSON_FLAGS_NONE;
+    const char *indent      = nullptr;
+    size_t      buffer_size = BUFSIZ;
+
+    for (;;) {
+        int opt = getopt_long(argc, argv, "hiIb:", long_options, nullptr);
+
+        if (opt == -1)
+            break;
+
+        switch (opt) {
+        case 'h':
+            printf(
+                        "usage: %s [options] input-file\n"
+                        "\n"
+                        "OPTIONS:\n"
+                        "\t-h, --help                 print this help message\n"
+                        "\t-i, --integer              parse numbers without decimals or exponent as 64bit integers\n"
+                        "\t-I, --indent               indent the output by two spaces\n"
+                        "\t-b, --buffer-size=SIZE     size of the chunks fed to the parser (default: %d)\n",
+                        argc > 0 ? argv[0] : "coroutine", BUFSIZ);
+            return 0;
+
+        case 'i':
+            flags |= AJSON_FLAG_INTEGER;
+            break;
+
+        case 'I':
+            indent = "  ";
+            break;
+
+        case 'b':
+        {
+            char *endptr = nullptr;
+            buffer_size = strtoul(optarg, &endptr, 10);
+            if (*endptr || buffer_size == 0) {
+                fprintf(stderr, "*** invalid buffer size: %s\n", optarg);
+                return 1;
+            }
+            break;
+        }
+        default:
+            return 1;
+        }
+    }
+
+    if (optind + 1 != argc) {
+        fprintf(stderr, "*** expected one input file\n");
+        return 1;
+    }
+
+    FILE *fp = fopen(argv[optind], "rb");
+    if (!fp) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    std::vector<char> data;
+    char   buf[BUFSIZ];
+    size_t count;
+    while ((count = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        data.insert(data.end(), buf, buf + count);
+    }
+    fclose(fp);
+
+    ajson::parser       parser(flags);
+    ajson::writer       writer(AJSON_WRITER_FLAG_ASCII, indent);
+    ajson::token_stream tokens(parser);
+    char                output[7];
+    ajson::writer_sink  sink(writer, output, sizeof(output));
+    enum copy_status    status = COPY_RUNNING;
+
+    copy(tokens, sink, status);
+
+    // the I/O loop: feeds chunks of the buffer size and drains the output
+    size_t offset = 0;
+    while (status == COPY_RUNNING) {
+        if (sink.waiting()) {
+            fwrite(sink.data(), 1, sink.size(), stdout);
+            sink.drained();
+        }
+        else if (tokens.waiting()) {
+            size_t size = std::min(buffer_size, data.size() - offset);
+            if ((size ? tokens.feed(data.data() + offset, size) : tokens.feed_eof()) != 0) {
+                perror("ajson::token_stream::feed");
+                return 1;
+            }
+            offset += size;
+        }
+        else {
+            fprintf(stderr, "*** coroutine waits for nothing\n");
+            return 1;
+        }
+    }
+    fwrite(sink.data(), 1, sink.size(), stdout);
+    printf("\n");
+
+    if (status == COPY_FAILED) {
+        printf("error: %s\n", ajson_error_str(parser.error()));
+        return 1;
+    }
+
+    printf("end\n");
+    return 0;
+}
+
+#else
+
+int main() {
+    fprintf(stderr, "*** compiled without coroutine support\n");
+    return 1;
+}
+
+#endif
@@ -8,10 +8,10 @@ OK="[   ${GREEN}OK${NORMAL}   ]"
 FAILED="[ ${RED}FAILED${NORMAL} ]"
 
 if [ $1 = --memcheck ]; then
-	TOKENS="valgrind -q --leak-check=full ./tokens --read=fread"
+	RUNNER="valgrind -q --leak-check=full"
 	shift
 else
-	TOKENS="./tokens --read=fread"
+	RUNNER=
 fi
 
 SRC_DIR=`dirname $0`
@@ -20,20 +20,50 @@ BIN_DIR=$1
 exit_status=0
 tests=0
 success=0
-for cases in positive negative; do
+for cases in positive negative latin1 latin1_raw utf16 utf16le utf16be filter stream schema dom ondemand binary cbor msgpack cbor_input msgpack_input bind pipelined callback callback_path callback_filter callback_cbor visitor coroutine query writer; do
 	echo
 	echo "========== $cases ==========="
 	dir_tests=0
 	dir_success=0
+	# the program that prints the tokens can be replaced per directory
+	driver=tokens
+	if [ -f "$SRC_DIR/data/$cases/driver" ]; then
+		driver=`cat "$SRC_DIR/data/$cases/driver"`
+	fi
+	if [ ! -x "$BIN_DIR/$driver" ]; then
+		echo "$driver was not built, skipped"
+		continue
+	fi
+	if [ $driver = tokens ]; then
+		program="./tokens --read=fread"
+	else
+		program="./$driver"
+	fi
 	mkdir -p "$BIN_DIR/data/$cases"
-	for json in "$SRC_DIR/data/$cases"/*.json; do
-		test_case=`basename "$json" .json`
+	options=
+	if [ -f "$SRC_DIR/data/$cases/options" ]; then
+		options=`cat "$SRC_DIR/data/$cases/options"`
+	fi
+	if [ -f "$SRC_DIR/data/$cases/schema" ]; then
+		options="$options --schema=$SRC_DIR/data/$cases/schema"
+	fi
+	# writer scripts are *.in files
+	for json in "$SRC_DIR/data/$cases"/*.json "$SRC_DIR/data/$cases"/*.in; do
+		if [ ! -f "$json" ]; then
+			continue
+		fi
+		test_case=`basename "$json"`
+		test_case="${test_case%.*}"
 		tokens="$SRC_DIR/data/$cases/${test_case}.tokens"
+		case_options=
+		if [ -f "$SRC_DIR/data/$cases/${test_case}.options" ]; then
+			case_options=`cat "$SRC_DIR/data/$cases/${test_case}.options"`
+		fi
 		out="$BIN_DIR/data/$cases/${test_case}.out"
 		printf "[        ] %s" "$test_case"
 		test_ok=true
 		for size in 1 8192; do
-			$TOKENS --buffer-size=$size "$json" > "$out" 2>/dev/null
+			$RUNNER $program $options --buffer-size=$size $case_options "$json" > "$out" 2>/dev/null
 			
 			if ! cmp -s "$tokens" "$out"; then
 				test_ok=false
@@ -1,8 +1,12 @@
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
 #include <getopt.h>
 #include <inttypes.h>
 #include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "ajson.h"
 
@@ -11,7 +15,7 @@ enum ajson_read {
     AJSON_READ_FREAD
 };
 
-int print_string(const char *string, size_t length) {
+int print_string(const char *string, size_t length, enum ajson_encoding encoding) {
     ajson_writer writer;
     if (ajson_writer_init(&writer, AJSON_WRITER_FLAG_ASCII, NULL) != 0) {
         return 1;
@@ -19,7 +23,7 @@ int print_string(const char *string, size_t length) {
 
     char buf[BUFSIZ];
 
-    ssize_t written = ajson_write_string(&writer, buf, sizeof(buf), string, length, AJSON_ENC_UTF8);
+    ssize_t written = ajson_write_string(&writer, buf, sizeof(buf), string, length, encoding);
 
     while (written > 0) {
         if (fwrite(buf, 1, written, stdout) < (size_t)written) {
@@ -41,8 +45,898 @@ int print_string(const char *string, size_t length) {
     return 0;
 }
 
-int tokenize(FILE* fp, ajson_parser *parser, char *buffer, size_t buffer_size, int flags, enum ajson_read read, bool debug) {
+char *read_all(FILE *fp, size_t *sizeptr) {
+    char  *data = NULL;
+    size_t size = 0;
+    for (;;) {
+        char *newdata = realloc(data, size + BUFSIZ);
+        if (!newdata) {
+            perror("realloc");
+            free(data);
+            return NULL;
+        }
+        data = newdata;
+
+        size_t count = fread(data + size, 1, BUFSIZ, fp);
+        size += count;
+        if (count < BUFSIZ) break;
+    }
+
+    if (ferror(fp)) {
+        perror("fread");
+        free(data);
+        return NULL;
+    }
+
+    *sizeptr = size;
+    return data;
+}
+
+ajson_schema *load_schema(const char *filename) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        perror(filename);
+        return NULL;
+    }
+
+    size_t size = 0;
+    char  *data = read_all(fp, &size);
+    fclose(fp);
+
+    if (!data) {
+        return NULL;
+    }
+
+    ajson_schema *schema = ajson_schema_compile(data, size);
+    if (!schema) {
+        perror(filename);
+    }
+    free(data);
+
+    return schema;
+}
+
+// prints a DOM like the tokens it was built from and checks key lookups
+int print_value(const ajson_value *value, enum ajson_encoding string_encoding) {
+    switch (value->type) {
+    case AJSON_TOK_NULL:
+        printf("null\n");
+        break;
+
+    case AJSON_TOK_BOOLEAN:
+        printf("boolean: %s\n", value->value.boolean ? "true" : "false");
+        break;
+
+    case AJSON_TOK_NUMBER:
+        printf("number: %.16g\n", value->value.number);
+        break;
+
+    case AJSON_TOK_INTEGER:
+        printf("integer: %ld\n", value->value.integer);
+        break;
+
+    case AJSON_TOK_STRING:
+        printf("string: ");
+        if (print_string(value->value.string.value, value->value.string.length, string_encoding) != 0) {
+            return 1;
+        }
+        printf("\n");
+        break;
+
+    case AJSON_TOK_BEGIN_ARRAY:
+        printf("[\n");
+        for (size_t i = 0; i < ajson_value_size(value); ++ i) {
+            if (print_value(ajson_value_at(value, i), string_encoding) != 0) {
+                return 1;
+            }
+        }
+        printf("]\n");
+        break;
+
+    case AJSON_TOK_BEGIN_OBJECT:
+        printf("{\n");
+        for (size_t i = 0; i < value->value.object.count; ++ i) {
+            const ajson_member *member = value->value.object.members + i;
+            const ajson_member *first  = value->value.object.members;
+
+            while (first->key_length != member->key_length || memcmp(first->key, member->key, member->key_length) != 0) {
+                ++ first;
+            }
+
+            printf("string: ");
+            if (print_string(member->key, member->key_length, string_encoding) != 0) {
+                return 1;
+            }
+            printf("\n");
+
+            if (ajson_value_get_key(value, member->key, member->key_length) != &first->value) {
+                printf("lookup failed\n");
+            }
+
+            if (print_value(&member->value, string_encoding) != 0) {
+                return 1;
+            }
+        }
+        printf("}\n");
+        break;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+// prints the key of an object member and checks that looking it up finds the
+// first member with this key
+int print_binary_key(const ajson_binary_value *object, size_t index) {
+    size_t length;
+    const char *key = ajson_binary_key_at(object, index, &length);
+
+    size_t first = 0;
+    for (;;) {
+        size_t first_length;
+        const char *first_key = ajson_binary_key_at(object, first, &first_length);
+        if (first_length == length && memcmp(first_key, key, length) == 0) break;
+        ++ first;
+    }
+
+    printf("string: ");
+    if (print_string(key, length, AJSON_ENC_UTF8) != 0) {
+        return 1;
+    }
+    printf("\n");
+
+    if (ajson_binary_get_key(object, key, length) != ajson_binary_at(object, first)) {
+        printf("lookup failed\n");
+    }
+
+    return 0;
+}
+
+struct binary_frame {
+    const ajson_binary_value *container;
+    size_t                    index;
+};
+
+// prints a binary document like the tokens it was converted from and checks key
+// lookups, without recursion because the test documents may be nested deeply
+int print_binary(const ajson_binary_value *value) {
+    struct binary_frame *stack = NULL;
+    size_t stack_size = 0;
+    size_t stack_used = 0;
+    int    status     = 0;
+
+    for (;;) {
+        switch (value->type) {
+        case AJSON_TOK_NULL:
+            printf("null\n");
+            break;
+
+        case AJSON_TOK_BOOLEAN:
+            printf("boolean: %s\n", value->value.boolean ? "true" : "false");
+            break;
+
+        case AJSON_TOK_NUMBER:
+            printf("number: %.16g\n", value->value.number);
+            break;
+
+        case AJSON_TOK_INTEGER:
+            printf("integer: %" PRId64 "\n", value->value.integer);
+            break;
+
+        case AJSON_TOK_STRING:
+            printf("string: ");
+            if (print_string(ajson_binary_string(value), ajson_binary_size(value), AJSON_ENC_UTF8) != 0) {
+                status = 1;
+                goto done;
+            }
+            printf("\n");
+            break;
+
+        case AJSON_TOK_BEGIN_ARRAY:
+        case AJSON_TOK_BEGIN_OBJECT:
+            printf(value->type == AJSON_TOK_BEGIN_ARRAY ? "[\n" : "{\n");
+            if (stack_used == stack_size) {
+                stack_size = stack_size ? stack_size * 2 : 64;
+                struct binary_frame *newstack = realloc(stack, stack_size * sizeof(struct binary_frame));
+                if (!newstack) {
+                    perror("realloc");
+                    status = 1;
+                    goto done;
+                }
+                stack = newstack;
+            }
+            stack[stack_used].container = value;
+            stack[stack_used].index     = 0;
+            ++ stack_used;
+            break;
+
+        default:
+            break;
+        }
+
+        // the next item, closing every container that has none left
+        value = NULL;
+        while (stack_used > 0) {
+            struct binary_frame *frame = stack + stack_used - 1;
+
+            if (frame->index < ajson_binary_size(frame->container)) {
+                if (frame->container->type == AJSON_TOK_BEGIN_OBJECT && print_binary_key(frame->container, frame->index) != 0) {
+                    status = 1;
+                    goto done;
+                }
+                value = ajson_binary_at(frame->container, frame->index ++);
+                break;
+            }
+
+            printf(frame->container->type == AJSON_TOK_BEGIN_ARRAY ? "]\n" : "}\n");
+            -- stack_used;
+        }
+
+        if (!value) {
+            break;
+        }
+    }
+
+done:
+    free(stack);
+    return status;
+}
+
+// converts a DOM into a temporary binary file and prints the mapped file
+int print_binary_file(const ajson_value *root) {
+    FILE *fp = tmpfile();
+    if (!fp) {
+        perror("tmpfile");
+        return 1;
+    }
+
+    ajson_binary bin;
+    if (ajson_binary_write_fd(root, fileno(fp)) != 0 || ajson_binary_open_fd(&bin, fileno(fp)) != 0) {
+        perror("ajson_binary_*");
+        fclose(fp);
+        return 1;
+    }
+    fclose(fp);
+
+    int status = print_binary(ajson_binary_root(&bin));
+    ajson_binary_close(&bin);
+
+    return status;
+}
+
+// prints an on-demand document like its tokens and checks key and index lookups
+int print_cursor(const ajson_cursor *cursor) {
+    ajson_ondemand *doc = cursor->doc;
+    ajson_cursor    child;
+    const char     *string;
+    size_t          length;
+
+    switch (ajson_cursor_type(cursor)) {
+    case AJSON_TOK_NULL:
+        printf("null\n");
+        break;
+
+    case AJSON_TOK_BOOLEAN:
+    {
+        bool value;
+        if (ajson_cursor_get_boolean(cursor, &value) != 0) {
+            return -1;
+        }
+        printf("boolean: %s\n", value ? "true" : "false");
+        break;
+    }
+    case AJSON_TOK_NUMBER:
+    {
+        double value;
+        if (ajson_cursor_get_number(cursor, &value) != 0) {
+            return -1;
+        }
+        printf("number: %.16g\n", value);
+        break;
+    }
+    case AJSON_TOK_INTEGER:
+    {
+        int64_t value;
+        if (ajson_cursor_get_integer(cursor, &value) != 0) {
+            return -1;
+        }
+        printf("integer: %" PRId64 "\n", value);
+        break;
+    }
+    case AJSON_TOK_STRING:
+        if (ajson_cursor_get_string(cursor, &string, &length) != 0) {
+            return -1;
+        }
+        printf("string: ");
+        if (print_string(string, length, AJSON_ENC_UTF8) != 0) {
+            return 1;
+        }
+        printf("\n");
+        break;
+
+    case AJSON_TOK_BEGIN_ARRAY:
+        printf("[\n");
+        for (int status = ajson_cursor_first(cursor, &child), index = 0; status == 0; status = ajson_cursor_next(&child), ++ index) {
+            ajson_cursor item;
+            if (ajson_cursor_at(cursor, index, &item) != 0 || item.value != child.value) {
+                printf("lookup failed\n");
+            }
+
+            int print_status = print_cursor(&child);
+            if (print_status != 0) {
+                return print_status;
+            }
+        }
+        if (ajson_ondemand_get_error(doc) != AJSON_ERROR_NONE) {
+            return -1;
+        }
+        printf("]\n");
+        break;
+
+    case AJSON_TOK_BEGIN_OBJECT:
+        printf("{\n");
+        for (int status = ajson_cursor_first(cursor, &child); status == 0; status = ajson_cursor_next(&child)) {
+            if (ajson_cursor_get_key(&child, &string, &length) != 0) {
+                return -1;
+            }
+            printf("string: ");
+            if (print_string(string, length, AJSON_ENC_UTF8) != 0) {
+                return 1;
+            }
+            printf("\n");
+
+            // string is only valid until the next read
+            char *key = malloc(length ? length : 1);
+            if (!key) {
+                perror("malloc");
+                return 1;
+            }
+            memcpy(key, string, length);
+
+            // duplicate keys find the first member
+            ajson_cursor other;
+            int found = ajson_cursor_first(cursor, &other);
+            while (found == 0) {
+                const char *other_key;
+                size_t      other_length;
+                if (ajson_cursor_get_key(&other, &other_key, &other_length) == 0 &&
+                    other_length == length && memcmp(other_key, key, length) == 0) {
+                    break;
+                }
+                found = ajson_cursor_next(&other);
+            }
+
+            ajson_cursor member;
+            if (found != 0 || ajson_cursor_find_key(cursor, key, length, &member) != 0 || member.value != other.value) {
+                printf("lookup failed\n");
+            }
+            free(key);
+
+            int print_status = print_cursor(&child);
+            if (print_status != 0) {
+                return print_status;
+            }
+        }
+        if (ajson_ondemand_get_error(doc) != AJSON_ERROR_NONE) {
+            return -1;
+        }
+        printf("}\n");
+        break;
+
+    default:
+        return -1;
+    }
+
+    return 0;
+}
+
+int print_ondemand(FILE *fp) {
+    ajson_ondemand doc;
+    ajson_cursor   root;
+    size_t         size = 0;
+    char          *data = read_all(fp, &size);
+    int            status = 0;
+
+    if (!data) {
+        return 1;
+    }
+
+    if (ajson_ondemand_init(&doc, data, size) != 0) {
+        perror("ajson_ondemand_init");
+        free(data);
+        return 1;
+    }
+
+    if (ajson_ondemand_root(&doc, &root) != 0 || (status = print_cursor(&root)) < 0) {
+        printf("error: %s\n", ajson_error_str(ajson_ondemand_get_error(&doc)));
+        status = 1;
+    }
+    else if (status == 0) {
+        printf("end\n");
+    }
+
+    ajson_ondemand_destroy(&doc);
+    free(data);
+
+    return status;
+}
+
+struct bind_item {
+    int         id;
+    const char *name;
+};
+
+struct bind_record {
+    bool              flag;
+    int               id;
+    int64_t           big;
+    double            ratio;
+    const char       *name;
+    struct bind_item  item;
+    int              *values;
+    size_t            value_count;
+    const char      **tags;
+    size_t            tag_count;
+    struct bind_item *items;
+    size_t            item_count;
+};
+
+static const ajson_field bind_item_fields[] = {
+    AJSON_FIELD(struct bind_item, id,   "id",   AJSON_TYPE_INT),
+    AJSON_FIELD(struct bind_item, name, "name", AJSON_TYPE_STRING),
+};
+
+static const ajson_struct bind_item_struct = AJSON_STRUCT(struct bind_item, bind_item_fields);
+
+static const ajson_field bind_record_fields[] = {
+    AJSON_FIELD(struct bind_record, flag,  "flag",  AJSON_TYPE_BOOLEAN),
+    AJSON_FIELD(struct bind_record, id,    "id",    AJSON_TYPE_INT),
+    AJSON_FIELD(struct bind_record, big,   "big",   AJSON_TYPE_INT64),
+    AJSON_FIELD(struct bind_record, ratio, "ratio", AJSON_TYPE_DOUBLE),
+    AJSON_FIELD(struct bind_record, name,  "name",  AJSON_TYPE_STRING),
+    AJSON_FIELD_OBJECT(struct bind_record, item, "item", &bind_item_struct),
+    AJSON_FIELD_ARRAY(struct bind_record, values, value_count, "values", AJSON_TYPE_INT,    NULL),
+    AJSON_FIELD_ARRAY(struct bind_record, tags,   tag_count,   "tags",   AJSON_TYPE_STRING, NULL),
+    AJSON_FIELD_ARRAY(struct bind_record, items,  item_count,  "items",  AJSON_TYPE_OBJECT, &bind_item_struct),
+};
+
+static const ajson_struct bind_record_struct = AJSON_STRUCT(struct bind_record, bind_record_fields);
+
+int print_bind_string(const char *key, const char *value) {
+    printf("%s: ", key);
+    if (value == NULL) {
+        printf("null\n");
+        return 0;
+    }
+    if (print_string(value, strlen(value), AJSON_ENC_UTF8) != 0) {
+        return 1;
+    }
+    printf("\n");
+    return 0;
+}
+
+int print_bind_item(const char *key, const struct bind_item *item) {
+    printf("%s: %d, ", key, item->id);
+    return print_bind_string("name", item->name);
+}
+
+int print_bind_record(const struct bind_record *record) {
+    printf("flag: %s\n", record->flag ? "true" : "false");
+    printf("id: %d\n", record->id);
+    printf("big: %" PRId64 "\n", record->big);
+    printf("ratio: %.16g\n", record->ratio);
+    if (print_bind_string("name", record->name) != 0 || print_bind_item("item", &record->item) != 0) {
+        return 1;
+    }
+    printf("values: %zu\n", record->value_count);
+    for (size_t i = 0; i < record->value_count; ++ i) {
+        printf("  %d\n", record->values[i]);
+    }
+    printf("tags: %zu\n", record->tag_count);
+    for (size_t i = 0; i < record->tag_count; ++ i) {
+        if (print_bind_string("  tag", record->tags[i]) != 0) {
+            return 1;
+        }
+    }
+    printf("items: %zu\n", record->item_count);
+    for (size_t i = 0; i < record->item_count; ++ i) {
+        if (print_bind_item("  item", record->items + i) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// binds the input twice, from a stream and from memory, reusing the arena
+int print_bind(FILE *fp, ajson_parser *parser) {
+    struct bind_record record;
+    ajson_arena arena;
+    size_t      size = 0;
+    char       *data = read_all(fp, &size);
+    int         status = 0;
+
+    if (!data) {
+        return 1;
+    }
+
+    ajson_arena_init(&arena, 64);
+
+    for (int pass = 0; pass < 2 && status == 0; ++ pass) {
+        ajson_reset(parser);
+        ajson_arena_clear(&arena);
+
+        int result;
+        if (pass == 0) {
+            FILE *stream = fmemopen(data, size, "rb");
+            if (!stream) {
+                perror("fmemopen");
+                status = 1;
+                break;
+            }
+            result = ajson_bind_file(parser, &bind_record_struct, &record, &arena, stream);
+            fclose(stream);
+        }
+        else {
+            result = ajson_bind_buf(parser, &bind_record_struct, &record, &arena, data, size);
+        }
+
+        if (result != 0) {
+            printf("error: %s\n", parser->value.error.error != AJSON_ERROR_NONE ?
+                   ajson_error_str(parser->value.error.error) : strerror(errno));
+            status = 1;
+        }
+        else if (print_bind_record(&record) != 0) {
+            status = 1;
+        }
+        else {
+            printf("end\n");
+        }
+    }
+
+    ajson_arena_destroy(&arena);
+    free(data);
+
+    return status;
+}
+
+#define CALLBACK_SKIP_MAX 16
+
+struct callbacks {
+    ajson_cb_parser *parser;
+    size_t           count;                      // callbacks so far
+    size_t           skip_at[CALLBACK_SKIP_MAX]; // return AJSON_CB_SKIP from these callbacks
+    size_t           skip_count;
+    size_t           stop_at;                    // return AJSON_CB_STOP from this callback or 0
+};
+
+static int callback_result(void *ctx) {
+    struct callbacks *callbacks = ctx;
+    uint64_t matches = ajson_get_filter_matches(&callbacks->parser->parser);
+    if (matches) {
+        printf("matches: 0x%" PRIx64 "\n", matches);
+    }
+
+    ++ callbacks->count;
+    if (callbacks->count == callbacks->stop_at) {
+        printf("stop\n");
+        return AJSON_CB_STOP;
+    }
+    for (size_t i = 0; i < callbacks->skip_count; ++ i) {
+        if (callbacks->count == callbacks->skip_at[i]) {
+            printf("skip\n");
+            return AJSON_CB_SKIP;
+        }
+    }
+    return AJSON_CB_CONTINUE;
+}
+
+static int callback_null(void *ctx) {
+    printf("null\n");
+    return callback_result(ctx);
+}
+
+static int callback_boolean(void *ctx, bool value) {
+    printf("boolean: %s\n", value ? "true" : "false");
+    return callback_result(ctx);
+}
+
+static int callback_number(void *ctx, double value) {
+    printf("number: %.16g\n", value);
+    return callback_result(ctx);
+}
+
+static int callback_integer(void *ctx, int64_t value) {
+    printf("integer: %" PRId64 "\n", value);
+    return callback_result(ctx);
+}
+
+static int callback_string(void *ctx, const char *value, size_t length) {
+    printf("string: ");
+    if (print_string(value, length, AJSON_ENC_UTF8) != 0) {
+        return AJSON_CB_STOP;
+    }
+    printf("\n");
+    return callback_result(ctx);
+}
+
+static int callback_begin_array(void *ctx) {
+    printf("[\n");
+    return callback_result(ctx);
+}
+
+static int callback_end_array(void *ctx) {
+    printf("]\n");
+    return callback_result(ctx);
+}
+
+static int callback_begin_object(void *ctx) {
+    printf("{\n");
+    return callback_result(ctx);
+}
+
+static int callback_end_object(void *ctx) {
+    printf("}\n");
+    return callback_result(ctx);
+}
+
+static int callback_end(void *ctx) {
+    (void)ctx;
+    printf("end\n");
+    return AJSON_CB_CONTINUE;
+}
+
+static int callback_error(void *ctx, enum ajson_error error) {
+    (void)ctx;
+    printf("error: %s\n", ajson_error_str(error));
+    return AJSON_CB_CONTINUE;
+}
+
+// how print_callbacks() passes the input to the callback parser
+enum callback_input {
+    CALLBACK_INPUT_FD,        // ajson_cb_parse_fd_size()
+    CALLBACK_INPUT_FILE,      // ajson_cb_parse_file_size()
+    CALLBACK_INPUT_PATH,      // ajson_cb_parse_path() on the input file
+    CALLBACK_INPUT_PIPE,      // ajson_cb_parse_path() on a pipe filled by a child process
+    CALLBACK_INPUT_PIPELINED  // ajson_cb_parse_fd_pipelined() on a pipe filled by a child process
+};
+
+// Forks a child process that writes fp to a pipe and keeps the pipe open
+// afterwards if keep_open is set. Returns the read end of the pipe or -1.
+static int start_pipe_writer(FILE *fp, bool keep_open, pid_t *child) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    fflush(stdout);
+    *child = fork();
+    if (*child < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    if (*child == 0) {
+        close(fds[0]);
+        alarm(10);
+        char buf[BUFSIZ];
+        size_t count;
+        while ((count = fread(buf, 1, sizeof(buf), fp)) > 0) {
+            if (write(fds[1], buf, count) != (ssize_t)count) {
+                _exit(1);
+            }
+        }
+        if (keep_open) {
+            pause();
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    return fds[0];
+}
+
+// Parses the input with the callback parser. The input is read from fp or
+// opened again by its path, which is NULL for stdin. The pipelined variant
+// reads the input from a pipe that is filled by a child process, which keeps
+// it open if keep_open is set, so only parsing that stops early can return.
+int print_callbacks(FILE *fp, const char *path, struct callbacks *callbacks, size_t buffer_size, enum callback_input input, bool keep_open) {
+    ajson_cb_parser *parser = callbacks->parser;
+    int   status;
+    pid_t child = -1;
+    int   fd    = -1;
+
+    parser->ctx                   = callbacks;
+    parser->null_func             = callback_null;
+    parser->boolean_func          = callback_boolean;
+    parser->number_func           = callback_number;
+    parser->integer_func          = callback_integer;
+    parser->string_func           = callback_string;
+    parser->begin_array_func      = callback_begin_array;
+    parser->end_array_func        = callback_end_array;
+    parser->begin_object_func     = callback_begin_object;
+    parser->end_object_func       = callback_end_object;
+    parser->end_func              = callback_end;
+    parser->error_func            = callback_error;
+    callbacks->count              = 0;
+
+    ajson_reset(&parser->parser);
+
+    if (input == CALLBACK_INPUT_PIPE || input == CALLBACK_INPUT_PIPELINED) {
+        fd = start_pipe_writer(fp, keep_open, &child);
+        if (fd < 0) {
+            return 1;
+        }
+    }
+
+    // fails the test instead of hanging
+    alarm(10);
+
+    switch (input) {
+    case CALLBACK_INPUT_FILE:
+        status = ajson_cb_parse_file_size(parser, fp, buffer_size);
+        break;
+
+    case CALLBACK_INPUT_PATH:
+        status = ajson_cb_parse_path(parser, path ? path : "/dev/stdin");
+        break;
+
+    case CALLBACK_INPUT_PIPE:
+    {
+        char pipe_path[32];
+        snprintf(pipe_path, sizeof(pipe_path), "/dev/fd/%d", fd);
+        status = ajson_cb_parse_path(parser, pipe_path);
+        break;
+    }
+    case CALLBACK_INPUT_PIPELINED:
+        status = ajson_cb_parse_fd_pipelined(parser, fd, buffer_size, 2);
+        break;
+
+    default:
+        status = ajson_cb_parse_fd_size(parser, fileno(fp), buffer_size);
+        break;
+    }
+
+    alarm(0);
+
+    if (child > 0) {
+        close(fd);
+        kill(child, SIGTERM);
+        waitpid(child, NULL, 0);
+    }
+
+    if (status == 1) {
+        printf("stopped\n");
+        return 0;
+    }
+    else if (status < 0 && ajson_get_error(&parser->parser) == AJSON_ERROR_NONE) {
+        perror("ajson_cb_parse");
+    }
+
+    return status < 0 ? 1 : 0;
+}
+
+// feeds the input to a query in chunks of the buffer size and prints the groups
+int print_query(FILE *fp, enum ajson_encoding encoding, const char *select, const char *value, const char *group_by, char *buffer, size_t buffer_size) {
+    ajson_query query;
+
+    if (ajson_query_init(&query, encoding, select, value, group_by) != 0) {
+        perror("ajson_query_init");
+        return 1;
+    }
+
+    int status = 0;
+    for (;;) {
+        size_t size = fread(buffer, 1, buffer_size, fp);
+
+        if (ferror(fp)) {
+            perror("fread");
+            status = 1;
+            break;
+        }
+
+        if (ajson_feed(&query.parser, buffer, size) != 0 || ajson_query_dispatch(&query) != 0) {
+            if (ajson_get_error(&query.parser) != AJSON_ERROR_NONE) {
+                printf("error: %s\n", ajson_error_str(ajson_get_error(&query.parser)));
+            }
+            else {
+                perror("ajson_query_dispatch");
+            }
+            status = 1;
+            break;
+        }
+
+        if (size == 0)
+            break;
+    }
+
+    for (size_t i = 0; status == 0 && i < ajson_query_get_group_count(&query); ++ i) {
+        const ajson_query_group *group = ajson_query_get_group(&query, i);
+
+        printf("group: ");
+        if (!group->key) {
+            printf("-");
+        }
+        else if (group->key_type == AJSON_TOK_STRING) {
+            if (print_string(group->key, group->key_length, AJSON_ENC_UTF8) != 0) {
+                status = 1;
+                break;
+            }
+        }
+        else {
+            fwrite(group->key, 1, group->key_length, stdout);
+        }
+
+        printf(", count: %" PRIu64 ", values: %" PRIu64, group->count, group->values);
+        if (group->values) {
+            printf(", sum: %.16g, min: %.16g, max: %.16g", group->sum, group->min, group->max);
+        }
+        printf("\n");
+    }
+
+    if (status == 0) {
+        printf("end\n");
+    }
+
+    ajson_query_destroy(&query);
+
+    return status;
+}
+
+enum ajson_transcode {
+    AJSON_TRANSCODE_NONE,
+    AJSON_TRANSCODE_CBOR,
+    AJSON_TRANSCODE_MSGPACK
+};
+
+struct transcoder {
+    enum ajson_transcode format;
+    ajson_cbor_writer    cbor;
+    ajson_msgpack_writer msgpack;
+    unsigned char       *buffer;
+    size_t               size;
+    bool                 written;
+};
+
+// prints the binary encoding of the token as hex
+int transcode(struct transcoder *transcoder, ajson_parser *parser, enum ajson_token token) {
+    ssize_t written = transcoder->format == AJSON_TRANSCODE_CBOR ?
+        ajson_cbor_write_token(&transcoder->cbor, transcoder->buffer, transcoder->size, parser, token) :
+        ajson_msgpack_write_token(&transcoder->msgpack, transcoder->buffer, transcoder->size, parser, token);
+
+    while (written > 0) {
+        for (ssize_t i = 0; i < written; ++ i) {
+            printf("%02x", transcoder->buffer[i]);
+        }
+        transcoder->written = true;
+        if ((size_t)written < transcoder->size) break;
+        written = transcoder->format == AJSON_TRANSCODE_CBOR ?
+            ajson_cbor_write_continue(&transcoder->cbor, transcoder->buffer, transcoder->size) :
+            ajson_msgpack_write_continue(&transcoder->msgpack, transcoder->buffer, transcoder->size);
+    }
+
+    if (written < 0) {
+        perror("ajson_*_write_token");
+        return 1;
+    }
+
+    return 0;
+}
+
+int tokenize(FILE* fp, ajson_parser *parser, ajson_validator *validator, ajson_dom *dom, bool binary, struct transcoder *transcoder, char *buffer, size_t buffer_size, int flags, enum ajson_read read, bool debug) {
+    enum ajson_encoding string_encoding = flags & AJSON_FLAG_RAW_LATIN1 ? AJSON_ENC_LATIN1 : AJSON_ENC_UTF8;
     ajson_reset(parser);
+    if (validator) {
+        ajson_validator_reset(validator);
+    }
+    if (dom) {
+        ajson_dom_reset(dom);
+    }
 
     for (;;) {
         size_t size = read == AJSON_READ_FGETS ?
@@ -58,6 +952,36 @@ int tokenize(FILE* fp, ajson_parser *parser, char *buffer, size_t buffer_size, i
         while (has_tokens) {
             enum ajson_token token = ajson_next_token(parser);
 
+            if (transcoder && token != AJSON_TOK_END && token != AJSON_TOK_NEED_DATA && token != AJSON_TOK_ERROR) {
+                if (transcode(transcoder, parser, token) != 0) {
+                    return 1;
+                }
+                continue;
+            }
+
+            if (transcoder && transcoder->written && (token == AJSON_TOK_END || token == AJSON_TOK_ERROR)) {
+                printf("\n");
+                transcoder->written = false;
+            }
+
+            if (dom && token != AJSON_TOK_END && token != AJSON_TOK_NEED_DATA && token != AJSON_TOK_ERROR) {
+                if (ajson_dom_add_token(dom, parser, token) != 0) {
+                    printf("error: %s\n", ajson_error_str(parser->value.error.error));
+                    return 1;
+                }
+
+                const ajson_value *root = ajson_dom_get_root(dom);
+                if (root && (binary ? print_binary_file(root) : print_value(root, string_encoding)) != 0) {
+                    return 1;
+                }
+
+                // the root stays until the next value begins
+                if (root) {
+                    ajson_dom_reset(dom);
+                }
+                continue;
+            }
+
             switch (token) {
             case AJSON_TOK_NULL:
                 printf("null\n");
@@ -80,7 +1004,7 @@ int tokenize(FILE* fp, ajson_parser *parser, char *buffer, size_t buffer_size, i
                 }
                 else if (flags & AJSON_FLAG_NUMBER_AS_STRING) {
                     printf("number: ");
-                    if (print_string(parser->value.string.value, parser->value.string.length) != 0) {
+                    if (print_string(parser->value.string.value, parser->value.string.length, AJSON_ENC_UTF8) != 0) {
                         return 1;
                     }
                     printf("\n");
@@ -96,7 +1020,7 @@ int tokenize(FILE* fp, ajson_parser *parser, char *buffer, size_t buffer_size, i
 
             case AJSON_TOK_STRING:
                 printf("string: ");
-                if (print_string(parser->value.string.value, parser->value.string.length) != 0) {
+                if (print_string(parser->value.string.value, parser->value.string.length, string_encoding) != 0) {
                     return 1;
                 }
                 printf("\n");
@@ -137,6 +1061,24 @@ int tokenize(FILE* fp, ajson_parser *parser, char *buffer, size_t buffer_size, i
                 has_tokens = false;
                 break;
             }
+
+            uint64_t matches = ajson_get_filter_matches(parser);
+            if (matches) {
+                printf("matches: 0x%" PRIx64 "\n", matches);
+            }
+
+            if (validator && ajson_validate_token(validator, parser, token) != 0) {
+                if (ajson_validator_get_violation(validator) != AJSON_VIOLATION_NONE) {
+                    const char *path = ajson_validator_get_path(validator);
+                    printf("violation: %s at \"%s\"\n",
+                           ajson_violation_str(ajson_validator_get_violation(validator)),
+                           path ? path : "?");
+                }
+                else {
+                    printf("error: %s\n", ajson_error_str(parser->value.error.error));
+                }
+                return 1;
+            }
         }
 
         if (size == 0)
@@ -158,9 +1100,28 @@ int main(int argc, char *argv[]) {
         {"number-components", no_argument,       0, 'c'},
         {"numbers-as-string", no_argument,       0, 's'},
         {"encoding",          required_argument, 0, 'e'},
+        {"raw-latin1",        no_argument,       0, 'l'},
+        {"stream",            no_argument,       0, 'S'},
         {"buffer-size",       required_argument, 0, 'b'},
         {"read",              required_argument, 0, 'r'},
         {"debug",             no_argument,       0, 'd'},
+        {"filter",            required_argument, 0, 'f'},
+        {"schema",            required_argument, 0, 'j'},
+        {"dom",               no_argument,       0, 'D'},
+        {"ondemand",          no_argument,       0, 'O'},
+        {"binary",            no_argument,       0, 'B'},
+        {"cbor",              no_argument,       0, 'C'},
+        {"msgpack",           no_argument,       0, 'M'},
+        {"bind",              no_argument,       0, 'y'},
+        {"callback",          no_argument,       0, 'k'},
+        {"pipelined",         no_argument,       0, 'P'},
+        {"keep-open",         no_argument,       0, 'K'},
+        {"input",             required_argument, 0, 'u'},
+        {"skip-at",           required_argument, 0, 'x'},
+        {"stop-at",           required_argument, 0, 'X'},
+        {"query",             required_argument, 0, 'q'},
+        {"query-value",       required_argument, 0, 'v'},
+        {"query-group-by",    required_argument, 0, 'g'},
         {0,                   0,                 0,  0 }
     };
 
@@ -168,14 +1129,34 @@ int main(int argc, char *argv[]) {
     int  flags  = AJSON_FLAGS_NONE;
     bool debug  = false;
     enum ajson_encoding encoding = AJSON_ENC_UTF8;
-    ajson_parser        parser;
+    ajson_cb_parser     cb_parser;
     bool                parser_needs_freeing = false;
     size_t              buffer_size = BUFSIZ;
     char*               buffer      = NULL;
     enum ajson_read     read        = AJSON_READ_FREAD;
+    const char*         filters[AJSON_FILTER_MAX];
+    size_t              filter_count = 0;
+    const char*         schema_file  = NULL;
+    ajson_schema*       schema       = NULL;
+    ajson_validator     validator;
+    bool                use_dom      = false;
+    bool                use_ondemand = false;
+    bool                use_binary   = false;
+    bool                use_bind     = false;
+    bool                use_callbacks = false;
+    enum callback_input callback_input = CALLBACK_INPUT_FD;
+    bool                keep_open    = false;
+    struct callbacks    callbacks    = { NULL };
+    const char*         query_select   = NULL;
+    const char*         query_value    = NULL;
+    const char*         query_group_by = NULL;
+    struct transcoder   transcoder   = { AJSON_TRANSCODE_NONE };
+    enum ajson_transcode transcode_format = AJSON_TRANSCODE_NONE;
+    ajson_arena         arena;
+    ajson_dom           dom;
 
     for (;;) {
-        int opt = getopt_long(argc, argv, "hie:aI:nb:r:d", long_options, NULL);
+        int opt = getopt_long(argc, argv, "hie:aI:nb:r:dlf:Sj:DOBCMykPKu:x:X:q:v:g:", long_options, NULL);
 
         if (opt == -1)
             break;
@@ -190,10 +1171,37 @@ int main(int argc, char *argv[]) {
                         "\t-i, --integer              parse numbers without decimals or exponent as 64bit integers\n"
                         "\t-c, --number-components    print parsed number components instead of constructed floating point number\n"
                         "\t-s, --numbers-as-string    parse numbers as string\n"
-                        "\t-e, --encoding=ENCODING    input encoding: 'UTF-8' (default) or 'LATIN-1'\n"
+                        "\t-e, --encoding=ENCODING    input encoding: 'UTF-8' (default), 'LATIN-1',\n"
+                        "\t                           'UTF-16', 'UTF-16LE', 'UTF-16BE', or the binary\n"
+                        "\t                           formats 'CBOR' and 'MessagePack'\n"
+                        "\t-l, --raw-latin1           don't transcode Latin-1 strings to UTF-8\n"
+                        "\t-S, --stream               parse a sequence of values (e.g. NDJSON)\n"
                         "\t-b, --buffer-size=SIZE     size of read buffer in bytes (default: %d)\n"
                         "\t-r, --read=METHOD          read method: 'fread' (default) or 'fgets'\n"
-                        "\t-d, --debug                print C source line of error\n",
+                        "\t-d, --debug                print C source line of error\n"
+                        "\t-f, --filter=POINTER       only print values matching this JSON Pointer, where\n"
+                        "\t                           \"*\" matches any key or index (can be repeated)\n"
+                        "\t-j, --schema=FILE          validate input against this JSON Schema\n"
+                        "\t-D, --dom                  build a DOM and print it instead of the tokens\n"
+                        "\t-O, --ondemand             read the whole input and print it using the on-demand API\n"
+                        "\t-B, --binary               like --dom, but convert the DOM to a binary file and print that\n"
+                        "\t-C, --cbor                 print input transcoded to CBOR as hex\n"
+                        "\t-M, --msgpack              print input transcoded to MessagePack as hex\n"
+                        "\t-y, --bind                 bind the input to a test struct and print that\n"
+                        "\t-k, --callback             parse with the callback parser\n"
+                        "\t-P, --pipelined            like --callback, but read ahead from a pipe in another thread\n"
+                        "\t-K, --keep-open            with --pipelined, keep the pipe open after the input\n"
+                        "\t-u, --input=METHOD         with --callback, pass the input as 'fd' (default), 'file'\n"
+                        "\t                           (FILE stream), 'path' (the path of the input file) or\n"
+                        "\t                           'pipe' (the path of a pipe that the input is written to)\n"
+                        "\t-x, --skip-at=N            with --callback, return AJSON_CB_SKIP from the Nth callback\n"
+                        "\t                           (can be repeated)\n"
+                        "\t-X, --stop-at=N            with --callback, return AJSON_CB_STOP from the Nth callback\n"
+                        "\t-q, --query=POINTER        run a query selecting the records at this JSON Pointer\n"
+                        "\t                           and print its groups\n"
+                        "\t-v, --query-value=POINTER  aggregate numbers at this JSON Pointer relative to the records\n"
+                        "\t-g, --query-group-by=POINTER\n"
+                        "\t                           group records by the value at this JSON Pointer\n",
                         argc > 0 ? argv[0] : "tokens", BUFSIZ);
             return 0;
 
@@ -209,6 +1217,14 @@ int main(int argc, char *argv[]) {
             flags |= AJSON_FLAG_NUMBER_AS_STRING;
             break;
 
+        case 'l':
+            flags |= AJSON_FLAG_RAW_LATIN1;
+            break;
+
+        case 'S':
+            flags |= AJSON_FLAG_STREAM;
+            break;
+
         case 'e':
             if (strcasecmp(optarg, "UTF-8") == 0 || strcasecmp(optarg, "UTF8") == 0) {
                 encoding = AJSON_ENC_UTF8;
@@ -216,6 +1232,21 @@ int main(int argc, char *argv[]) {
             else if (strcasecmp(optarg, "LATIN-1") == 0 || strcasecmp(optarg, "LATIN1") == 0 || strcasecmp(optarg, "ISO-8859-1") == 0 || strcasecmp(optarg, "ISO_8859-1") == 0) {
                 encoding = AJSON_ENC_LATIN1;
             }
+            else if (strcasecmp(optarg, "UTF-16") == 0 || strcasecmp(optarg, "UTF16") == 0) {
+                encoding = AJSON_ENC_UTF16;
+            }
+            else if (strcasecmp(optarg, "UTF-16LE") == 0 || strcasecmp(optarg, "UTF16LE") == 0) {
+                encoding = AJSON_ENC_UTF16LE;
+            }
+            else if (strcasecmp(optarg, "UTF-16BE") == 0 || strcasecmp(optarg, "UTF16BE") == 0) {
+                encoding = AJSON_ENC_UTF16BE;
+            }
+            else if (strcasecmp(optarg, "CBOR") == 0) {
+                encoding = AJSON_ENC_CBOR;
+            }
+            else if (strcasecmp(optarg, "MessagePack") == 0 || strcasecmp(optarg, "MSGPACK") == 0) {
+                encoding = AJSON_ENC_MSGPACK;
+            }
             else {
                 fprintf(stderr, "*** unsupported encoding: %s\n", optarg);
                 return 1;
@@ -249,6 +1280,109 @@ int main(int argc, char *argv[]) {
             debug = true;
             break;
 
+        case 'f':
+            if (filter_count == AJSON_FILTER_MAX) {
+                fprintf(stderr, "*** too many filters\n");
+                return 1;
+            }
+            filters[filter_count ++] = optarg;
+            break;
+
+        case 'j':
+            schema_file = optarg;
+            break;
+
+        case 'D':
+            use_dom = true;
+            break;
+
+        case 'O':
+            use_ondemand = true;
+            break;
+
+        case 'B':
+            use_dom    = true;
+            use_binary = true;
+            break;
+
+        case 'C':
+            transcode_format = AJSON_TRANSCODE_CBOR;
+            break;
+
+        case 'M':
+            transcode_format = AJSON_TRANSCODE_MSGPACK;
+            break;
+
+        case 'y':
+            use_bind = true;
+            break;
+
+        case 'k':
+            use_callbacks = true;
+            break;
+
+        case 'P':
+            use_callbacks  = true;
+            callback_input = CALLBACK_INPUT_PIPELINED;
+            break;
+
+        case 'K':
+            keep_open = true;
+            break;
+
+        case 'u':
+            if (strcasecmp(optarg, "fd") == 0) {
+                callback_input = CALLBACK_INPUT_FD;
+            }
+            else if (strcasecmp(optarg, "file") == 0) {
+                callback_input = CALLBACK_INPUT_FILE;
+            }
+            else if (strcasecmp(optarg, "path") == 0) {
+                callback_input = CALLBACK_INPUT_PATH;
+            }
+            else if (strcasecmp(optarg, "pipe") == 0) {
+                callback_input = CALLBACK_INPUT_PIPE;
+            }
+            else {
+                fprintf(stderr, "*** invalid input method: %s\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'q':
+            query_select = optarg;
+            break;
+
+        case 'v':
+            query_value = optarg;
+            break;
+
+        case 'g':
+            query_group_by = optarg;
+            break;
+
+        case 'x':
+        case 'X':
+        {
+            char *endptr = NULL;
+            size_t index = strtoul(optarg, &endptr, 10);
+            if (*endptr || index == 0) {
+                fprintf(stderr, "*** invalid callback index: %s\n", optarg);
+                return 1;
+            }
+            if (opt == 'X') {
+                callbacks.stop_at = index;
+            }
+            else if (callbacks.skip_count == CALLBACK_SKIP_MAX) {
+                fprintf(stderr, "*** too many skips\n");
+                return 1;
+            }
+            else {
+                callbacks.skip_at[callbacks.skip_count ++] = index;
+            }
+            break;
+        }
+
         case '?':
             fprintf(stderr, "*** unknown option: -%s\n", optarg);
             return 1;
@@ -265,6 +1399,11 @@ int main(int argc, char *argv[]) {
     }
 
 
+    if (use_dom) {
+        ajson_arena_init(&arena, 0);
+        ajson_dom_init(&dom, &arena);
+    }
+
     buffer = malloc(buffer_size);
     if (!buffer) {
         perror("malloc");
@@ -272,13 +1411,51 @@ int main(int argc, char *argv[]) {
         goto cleanup;
     }
 
-    if (ajson_init(&parser, flags, encoding) != 0) {
+    // the output buffer has the same size as the input buffer to test resuming
+    if (transcode_format) {
+        transcoder.buffer = malloc(buffer_size);
+        transcoder.size   = buffer_size;
+        if (!transcoder.buffer) {
+            perror("malloc");
+            status = 1;
+            goto cleanup;
+        }
+
+        if ((transcode_format == AJSON_TRANSCODE_CBOR ?
+             ajson_cbor_writer_init(&transcoder.cbor) :
+             ajson_msgpack_writer_init(&transcoder.msgpack)) != 0) {
+            perror("ajson_*_writer_init");
+            status = 1;
+            goto cleanup;
+        }
+        transcoder.format = transcode_format;
+    }
+
+    memset(&cb_parser, 0, sizeof(cb_parser));
+    callbacks.parser = &cb_parser;
+    if (ajson_init(&cb_parser.parser, flags, encoding) != 0) {
         perror("ajson_init");
         status = 1;
         goto cleanup;
     }
     parser_needs_freeing = true;
 
+    for (size_t i = 0; i < filter_count; ++ i) {
+        if (ajson_add_filter(&cb_parser.parser, filters[i]) < 0) {
+            perror(filters[i]);
+            status = 1;
+            goto cleanup;
+        }
+    }
+
+    if (schema_file) {
+        schema = load_schema(schema_file);
+        if (!schema || ajson_validator_init(&validator, schema) != 0) {
+            status = 1;
+            goto cleanup;
+        }
+    }
+
     if (optind < argc) {
         for (; optind < argc; ++ optind) {
             FILE *fp = fopen(argv[optind], "rb");
@@ -289,7 +1466,11 @@ int main(int argc, char *argv[]) {
                 goto cleanup;
             }
 
-            status = tokenize(fp, &parser, buffer, buffer_size, flags, read, debug);
+            status = use_ondemand ? print_ondemand(fp) :
+                use_bind ? print_bind(fp, &cb_parser.parser) :
+                use_callbacks ? print_callbacks(fp, argv[optind], &callbacks, buffer_size, callback_input, keep_open) :
+                query_select ? print_query(fp, encoding, query_select, query_value, query_group_by, buffer, buffer_size) :
+                tokenize(fp, &cb_parser.parser, schema ? &validator : NULL, use_dom ? &dom : NULL, use_binary, transcoder.format ? &transcoder : NULL, buffer, buffer_size, flags, read, debug);
 
             fclose(fp);
 
@@ -298,7 +1479,11 @@ int main(int argc, char *argv[]) {
         }
     }
     else {
-        status = tokenize(stdin, &parser, buffer, buffer_size, flags, read, debug);
+        status = use_ondemand ? print_ondemand(stdin) :
+            use_bind ? print_bind(stdin, &cb_parser.parser) :
+            use_callbacks ? print_callbacks(stdin, NULL, &callbacks, buffer_size, callback_input, keep_open) :
+            query_select ? print_query(stdin, encoding, query_select, query_value, query_group_by, buffer, buffer_size) :
+            tokenize(stdin, &cb_parser.parser, schema ? &validator : NULL, use_dom ? &dom : NULL, use_binary, transcoder.format ? &transcoder : NULL, buffer, buffer_size, flags, read, debug);
     }
 
 cleanup:
@@ -306,8 +1491,26 @@ cleanup:
         free(buffer);
     }
 
+    if (transcoder.format == AJSON_TRANSCODE_CBOR) {
+        ajson_cbor_writer_destroy(&transcoder.cbor);
+    }
+    else if (transcoder.format == AJSON_TRANSCODE_MSGPACK) {
+        ajson_msgpack_writer_destroy(&transcoder.msgpack);
+    }
+    free(transcoder.buffer);
+
     if (parser_needs_freeing) {
-        ajson_destroy(&parser);
+        ajson_destroy(&cb_parser.parser);
+    }
+
+    if (use_dom) {
+        ajson_dom_destroy(&dom);
+        ajson_arena_destroy(&arena);
+    }
+
+    if (schema) {
+        ajson_validator_destroy(&validator);
+        ajson_schema_free(schema);
     }
 
     return status;
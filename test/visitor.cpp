@@ -0,0 +1,303 @@
+// Prints the tokens of a JSON document like tokens --callback, but parses it
+// with ajson::parse() and a static visitor from ajson.hpp.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <vector>
+
+#include "ajson.hpp"
+
+namespace {
+
+bool print_string(std::string_view value) {
+    ajson::writer writer(AJSON_WRITER_FLAG_ASCII);
+    char buf[BUFSIZ];
+
+    ssize_t written = writer.write_string(buf, sizeof(buf), value);
+    while (written > 0) {
+        fwrite(buf, 1, static_cast<size_t>(written), stdout);
+        if (static_cast<size_t>(written) < sizeof(buf)) break;
+        written = writer.write_continue(buf, sizeof(buf));
+    }
+
+    if (written < 0) {
+        perror("ajson::writer::write_string");
+        return false;
+    }
+    return true;
+}
+
+// Methods return int, void or are inherited from ajson::visitor, so every way
+// of dispatching is used.
+struct printer : ajson::visitor {
+    ajson::parser&      parser;
+    size_t              count = 0;
+    std::vector<size_t> skip_at;
+    size_t              stop_at = 0;
+
+    explicit printer(ajson::parser& parser) : parser(parser) {}
+
+    int result() {
+        uint64_t matches = parser.filter_matches();
+        if (matches) {
+            printf("matches: 0x%" PRIx64 "\n", matches);
+        }
+
+        ++ count;
+        if (count == stop_at) {
+            printf("stop\n");
+            return AJSON_CB_STOP;
+        }
+        for (size_t index : skip_at) {
+            if (count == index) {
+                printf("skip\n");
+                return AJSON_CB_SKIP;
+            }
+        }
+        return AJSON_CB_CONTINUE;
+    }
+
+    int null() {
+        printf("null\n");
+        return result();
+    }
+
+    int boolean(bool value) {
+        printf("boolean: %s\n", value ? "true" : "false");
+        return result();
+    }
+
+    int number(double value) {
+        printf("number: %.16g\n", value);
+        return result();
+    }
+
+    int number_string(std::string_view value) {
+        printf("number: ");
+        if (!print_string(value)) {
+            return AJSON_CB_STOP;
+        }
+        printf("\n");
+        return result();
+    }
+
+    int number_components(const ajson::components& components) {
+        printf("number: isinteger: %s, positive: %s, integer: %" PRIu64 ", decimal: %" PRIu64 ", decimal_places: %" PRIu64 ", exponent_positive: %s, exponent: %" PRIu64 "\n",
+               components.isinteger ? "true" : "false",
+               components.positive  ? "true" : "false",
+               components.integer,
+               components.decimal,
+               components.decimal_places,
+               components.exponent_positive ? "true" : "false",
+               components.exponent);
+        return result();
+    }
+
+    int integer(int64_t value) {
+        printf("integer: %" PRId64 "\n", value);
+        return result();
+    }
+
+    int string(std::string_view value) {
+        printf("string: ");
+        if (!print_string(value)) {
+            return AJSON_CB_STOP;
+        }
+        printf("\n");
+        return result();
+    }
+
+    int begin_array() {
+        printf("[\n");
+        return result();
+    }
+
+    // can't skip or stop
+    void end_array() {
+        printf("]\n");
+        result();
+    }
+
+    int begin_object() {
+        printf("{\n");
+        return result();
+    }
+
+    int end_object() {
+        printf("}\n");
+        return result();
+    }
+
+    void end() {
+        printf("end\n");
+    }
+
+    void error(enum ajson_error error) {
+        printf("error: %s\n", ajson_error_str(error));
+    }
+};
+
+// only counts values, everything else is inherited
+struct counter : ajson::visitor {
+    size_t values = 0;
+
+    void null()                     { ++ values; }
+    void boolean(bool)              { ++ values; }
+    void number(double)             { ++ values; }
+    void integer(int64_t)           { ++ values; }
+    void string(std::string_view)   { ++ values; }
+};
+
+size_t parse_index(const char *arg) {
+    char *endptr = nullptr;
+    size_t index = strtoul(arg, &endptr, 10);
+    if (*endptr || index == 0) {
+        fprintf(stderr, "*** invalid callback index: %s\n", arg);
+        exit(1);
+    }
+    return index;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"help",              no_argument,       0, 'h'},
+        {"integers",          no_argument,       0, 'i'},
+        {"number-components", no_argument,       0, 'c'},
+        {"numbers-as-string", no_argument,       0, 's'},
+        {"buffer-size",       required_argument, 0, 'b'},
+        {"filter",            required_argument, 0, 'f'},
+        {"skip-at",           required_argument, 0, 'x'},
+        {"stop-at",           required_argument, 0, 'X'},
+        {0,                   0,                 0,  0 }
+    };
+
+    int    flags       = AJSON_FLAGS_NONE;
+    size_t buffer_size = BUFSIZ;
+    std::vector<const char*> filters;
+    std::vector<size_t>      skip_at;
+    size_t                   stop_at = 0;
+
+    for (;;) {
+        int opt = getopt_long(argc, argv, "hicsb:f:x:X:", long_options, nullptr);
+
+        if (opt == -1)
+            break;
+
+        switch (opt) {
+        case 'h':
+            printf(
+                        "usage: %s [options] input-file\n"
+                        "\n"
+                        "OPTIONS:\n"
+                        "\t-h, --help                 print this help message\n"
+                        "\t-i, --integer              parse numbers without decimals or exponent as 64bit integers\n"
+                        "\t-c, --number-components    print parsed number components instead of constructed floating point number\n"
+                        "\t-s, --numbers-as-string    parse numbers as string\n"
+                        "\t-b, --buffer-size=SIZE     size of read buffer in bytes (default: %d)\n"
+                        "\t-f, --filter=POINTER       only print values matching this JSON Pointer (can be repeated)\n"
+                        "\t-x, --skip-at=N            return AJSON_CB_SKIP from the Nth method (can be repeated)\n"
+                        "\t-X, --stop-at=N            return AJSON_CB_STOP from the Nth method\n",
+                        argc > 0 ? argv[0] : "visitor", BUFSIZ);
+            return 0;
+
+        case 'i':
+            flags |= AJSON_FLAG_INTEGER;
+            break;
+
+        case 'c':
+            flags |= AJSON_FLAG_NUMBER_COMPONENTS;
+            break;
+
+        case 's':
+            flags |= AJSON_FLAG_NUMBER_AS_STRING;
+            break;
+
+        case 'b':
+            buffer_size = parse_index(optarg);
+            break;
+
+        case 'f':
+            filters.push_back(optarg);
+            break;
+
+        case 'x':
+            skip_at.push_back(parse_index(optarg));
+            break;
+
+        case 'X':
+            stop_at = parse_index(optarg);
+            break;
+
+        default:
+            return 1;
+        }
+    }
+
+    if (optind + 1 != argc) {
+        fprintf(stderr, "*** expected one input file\n");
+        return 1;
+    }
+
+    FILE *fp = fopen(argv[optind], "rb");
+    if (!fp) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    std::vector<char> data;
+    std::vector<char> buffer(buffer_size);
+    size_t count;
+    while ((count = fread(buffer.data(), 1, buffer_size, fp)) > 0) {
+        data.insert(data.end(), buffer.data(), buffer.data() + count);
+    }
+    fclose(fp);
+
+    ajson::parser parser(flags);
+    for (const char *filter : filters) {
+        if (parser.add_filter(filter) < 0) {
+            perror(filter);
+            return 1;
+        }
+    }
+
+    printer printer(parser);
+    printer.skip_at = skip_at;
+    printer.stop_at = stop_at;
+
+    // feeds the input in chunks of the buffer size
+    int status = 0;
+    for (size_t offset = 0; status == 0; offset += buffer_size) {
+        offset = std::min(offset, data.size());
+        size_t size = std::min(buffer_size, data.size() - offset);
+        if (parser.feed(data.data() + offset, size) != 0) {
+            perror("ajson::parser::feed");
+            return 1;
+        }
+        status = ajson::parse(parser, printer);
+        if (size == 0) {
+            break;
+        }
+    }
+
+    if (status == 1) {
+        printf("stopped\n");
+    }
+    else if (status < 0) {
+        return 1;
+    }
+
+    // parses the whole document at once with a visitor that inherits most methods
+    parser.reset();
+    counter counter;
+    if (ajson::parse(parser, counter, std::string_view(data.data(), data.size())) == 0) {
+        printf("values: %zu\n", counter.values);
+    }
+
+    return 0;
+}
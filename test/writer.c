@@ -0,0 +1,771 @@
+// F_SETPIPE_SZ
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "ajson.h"
+
+// Runs a script of writer calls, one per line, and prints what was written.
+//
+//     # comment
+//     null | true | false
+//     integer -12
+//     number 1.5e300
+//     string "JSON string literal"
+//     string_latin1 "JSON string literal of characters up to U+00FF"
+//     raw {"fragment": "as it is"}
+//     decimals 3
+//     number_array 1.5 -2 ...
+//     integer_array 1 -2 ...
+//     string_array ["JSON", null, ...]
+//     register "key"
+//     key 0
+//     begin_array | end_array | begin_object | end_object
+//     reset
+//     repeat 1000 integer 1
+//
+// Failing calls print "error: <line>: <message>" on a line of their own and the
+// script goes on. With --sink the calls go through a sink, whose output has to
+// be the same for every kind of sink.
+
+enum command {
+    CMD_NULL,
+    CMD_TRUE,
+    CMD_FALSE,
+    CMD_INTEGER,
+    CMD_NUMBER,
+    CMD_STRING,
+    CMD_STRING_LATIN1,
+    CMD_RAW,
+    CMD_DECIMALS,
+    CMD_NUMBER_ARRAY,
+    CMD_INTEGER_ARRAY,
+    CMD_STRING_ARRAY,
+    CMD_REGISTER,
+    CMD_KEY,
+    CMD_BEGIN_ARRAY,
+    CMD_END_ARRAY,
+    CMD_BEGIN_OBJECT,
+    CMD_END_OBJECT,
+    CMD_RESET
+};
+
+struct script_line {
+    enum command command;
+    int64_t      integer;
+    double       number;
+    char        *string;
+    size_t       length;
+    double      *numbers;
+    int64_t     *integers;
+    char       **strings;
+    size_t      *lengths;
+    size_t       count;
+};
+
+static const struct {
+    const char  *name;
+    enum command command;
+} commands[] = {
+    { "null",          CMD_NULL          },
+    { "true",          CMD_TRUE          },
+    { "false",         CMD_FALSE         },
+    { "integer",       CMD_INTEGER       },
+    { "number",        CMD_NUMBER        },
+    { "string",        CMD_STRING        },
+    { "string_latin1", CMD_STRING_LATIN1 },
+    { "raw",           CMD_RAW           },
+    { "decimals",      CMD_DECIMALS      },
+    { "number_array",  CMD_NUMBER_ARRAY  },
+    { "integer_array", CMD_INTEGER_ARRAY },
+    { "string_array",  CMD_STRING_ARRAY  },
+    { "register",      CMD_REGISTER      },
+    { "key",           CMD_KEY           },
+    { "begin_array",   CMD_BEGIN_ARRAY   },
+    { "end_array",     CMD_END_ARRAY     },
+    { "begin_object",  CMD_BEGIN_OBJECT  },
+    { "end_object",    CMD_END_OBJECT    },
+    { "reset",         CMD_RESET         },
+};
+
+static void free_line(struct script_line *line) {
+    free(line->string);
+    free(line->numbers);
+    free(line->integers);
+    for (size_t index = 0; index < line->count && line->strings; ++ index) {
+        free(line->strings[index]);
+    }
+    free(line->strings);
+    free(line->lengths);
+}
+
+enum sink_type {
+    SINK_NONE,
+    SINK_BUFFER,
+    SINK_FD,
+    SINK_FILE,
+    SINK_IOVEC
+};
+
+// output buffer of the writer calls, written to stdout when full, or the sink
+// the calls go through
+struct output {
+    char               *buffer;
+    size_t              size;
+    size_t              used;
+    enum sink_type      sink_type;
+    ajson_sink          sink;
+    size_t              printed;    // output of buffer and iovec sinks that was printed
+    int                 pipe[2];    // fd sinks write into a small non-blocking pipe
+    struct script_line *kept;       // lines an iovec sink refers to until they are printed
+    size_t              kept_count;
+    size_t              kept_size;
+};
+
+// Frees the line, or keeps it until it was printed if an iovec sink may refer
+// to its strings.
+static void done_line(struct output *output, struct script_line *line) {
+    if (output->sink_type != SINK_IOVEC) {
+        free_line(line);
+        return;
+    }
+
+    if (output->kept_count == output->kept_size) {
+        size_t kept_size = output->kept_size ? output->kept_size * 2 : 16;
+        struct script_line *kept = realloc(output->kept, kept_size * sizeof(struct script_line));
+        if (!kept) {
+            perror("realloc");
+            exit(1);
+        }
+        output->kept      = kept;
+        output->kept_size = kept_size;
+    }
+    output->kept[output->kept_count ++] = *line;
+}
+
+static void drain_pipe(struct output *output) {
+    char    data[BUFSIZ];
+    ssize_t count;
+
+    if (output->sink_type != SINK_FD) {
+        return;
+    }
+
+    while ((count = read(output->pipe[0], data, sizeof(data))) > 0) {
+        fwrite(data, 1, (size_t)count, stdout);
+    }
+}
+
+// prints the part of the iovec list that wasn't printed yet
+static void print_iovec(struct output *output) {
+    size_t count = 0;
+    const struct iovec *iov = ajson_sink_get_iovec(&output->sink, &count);
+
+    if (!iov) {
+        perror("ajson_sink_get_iovec");
+        return;
+    }
+
+    size_t offset = 0;
+    for (size_t index = 0; index < count; ++ index) {
+        size_t length = iov[index].iov_len;
+        if (offset + length > output->printed) {
+            size_t skip = output->printed > offset ? output->printed - offset : 0;
+            fwrite((const char*)iov[index].iov_base + skip, 1, length - skip, stdout);
+        }
+        offset += length;
+    }
+    output->printed = offset;
+}
+
+static void flush_output(struct output *output) {
+    switch (output->sink_type) {
+    case SINK_NONE:
+        fwrite(output->buffer, 1, output->used, stdout);
+        output->used = 0;
+        break;
+
+    case SINK_BUFFER:
+        fwrite(output->sink.buffer + output->printed, 1, output->sink.used - output->printed, stdout);
+        output->printed = output->sink.used;
+        break;
+
+    case SINK_IOVEC:
+        print_iovec(output);
+        for (size_t index = 0; index < output->kept_count; ++ index) {
+            free_line(&output->kept[index]);
+        }
+        output->kept_count = 0;
+        break;
+
+    case SINK_FD:
+    case SINK_FILE:
+        // the pipe gets full before the sink buffer does
+        while (ajson_sink_flush(&output->sink) != 0) {
+            if (errno != EAGAIN) {
+                perror("ajson_sink_flush");
+                break;
+            }
+            drain_pipe(output);
+        }
+        drain_pipe(output);
+        break;
+    }
+}
+
+static int open_sink(struct output *output, int flags, const char *indent) {
+    switch (output->sink_type) {
+    case SINK_BUFFER:
+        return ajson_writer_to_buffer(&output->sink, flags, indent);
+
+    case SINK_IOVEC:
+        return ajson_writer_to_iovec(&output->sink, flags, indent);
+
+    case SINK_FD:
+        if (pipe(output->pipe) != 0) {
+            return -1;
+        }
+        if (fcntl(output->pipe[0], F_SETFL, O_NONBLOCK) != 0 || fcntl(output->pipe[1], F_SETFL, O_NONBLOCK) != 0) {
+            return -1;
+        }
+#ifdef F_SETPIPE_SZ
+        fcntl(output->pipe[1], F_SETPIPE_SZ, 4096);
+#endif
+        return ajson_writer_to_fd(&output->sink, flags, indent, output->pipe[1]);
+
+    case SINK_FILE:
+        return ajson_writer_to_file(&output->sink, flags, indent, stdout);
+
+    case SINK_NONE:
+        break;
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+static void close_sink(struct output *output) {
+    ajson_sink_destroy(&output->sink);
+    free(output->kept);
+    if (output->sink_type == SINK_FD) {
+        close(output->pipe[0]);
+        close(output->pipe[1]);
+    }
+}
+
+// Returns the next token of an argument that was fed completely.
+static enum ajson_token next_arg_token(ajson_parser *parser) {
+    enum ajson_token token = ajson_next_token(parser);
+
+    if (token == AJSON_TOK_NEED_DATA) {
+        if (ajson_feed(parser, "", 0) != 0) {
+            return AJSON_TOK_ERROR;
+        }
+        token = ajson_next_token(parser);
+    }
+
+    return token == AJSON_TOK_NEED_DATA ? AJSON_TOK_ERROR : token;
+}
+
+// Decodes the JSON string literal in text. The string stays valid until the
+// line is freed, because the writer refers to it until it is written.
+static int parse_string(ajson_parser *parser, const char *text, struct script_line *line) {
+    ajson_reset(parser);
+    if (ajson_feed(parser, text, strlen(text)) != 0 || next_arg_token(parser) != AJSON_TOK_STRING) {
+        return -1;
+    }
+
+    line->length = parser->value.string.length;
+    line->string = malloc(line->length ? line->length : 1);
+    if (!line->string) {
+        return -1;
+    }
+    memcpy(line->string, parser->value.string.value, line->length);
+
+    return next_arg_token(parser) == AJSON_TOK_END ? 0 : -1;
+}
+
+// Decodes a JSON array of strings and nulls, nulls become NULL entries.
+static int parse_strings(ajson_parser *parser, const char *text, struct script_line *line) {
+    ajson_reset(parser);
+    if (ajson_feed(parser, text, strlen(text)) != 0 || next_arg_token(parser) != AJSON_TOK_BEGIN_ARRAY) {
+        return -1;
+    }
+
+    size_t size = 0;
+    for (;;) {
+        enum ajson_token token = next_arg_token(parser);
+
+        if (token == AJSON_TOK_END_ARRAY) {
+            break;
+        }
+        else if (token != AJSON_TOK_STRING && token != AJSON_TOK_NULL) {
+            return -1;
+        }
+
+        if (line->count == size) {
+            size = size ? size * 2 : 8;
+            char  **strings = realloc(line->strings, size * sizeof(char*));
+            if (!strings) {
+                return -1;
+            }
+            line->strings = strings;
+            size_t *lengths = realloc(line->lengths, size * sizeof(size_t));
+            if (!lengths) {
+                return -1;
+            }
+            line->lengths = lengths;
+        }
+
+        char  *string = NULL;
+        size_t length = 0;
+        if (token == AJSON_TOK_STRING) {
+            length = parser->value.string.length;
+            string = malloc(length ? length : 1);
+            if (!string) {
+                return -1;
+            }
+            memcpy(string, parser->value.string.value, length);
+        }
+        line->strings[line->count] = string;
+        line->lengths[line->count] = length;
+        ++ line->count;
+    }
+
+    return next_arg_token(parser) == AJSON_TOK_END ? 0 : -1;
+}
+
+// Space separated numbers (integer is false) or integers, none for an empty array.
+static int parse_values(char *text, struct script_line *line, bool integer) {
+    size_t size = 0;
+
+    while (text && *text) {
+        char *endptr = NULL;
+
+        if (line->count == size) {
+            size = size ? size * 2 : 8;
+            void *values = integer ?
+                realloc(line->integers, size * sizeof(int64_t)) :
+                realloc(line->numbers,  size * sizeof(double));
+            if (!values) {
+                return -1;
+            }
+            if (integer) {
+                line->integers = values;
+            }
+            else {
+                line->numbers = values;
+            }
+        }
+
+        // strtod() reports subnormal numbers as ERANGE
+        errno = 0;
+        if (integer) {
+            line->integers[line->count] = strtoll(text, &endptr, 10);
+        }
+        else {
+            line->numbers[line->count] = strtod(text, &endptr);
+        }
+        if ((integer && errno) || endptr == text || (*endptr && *endptr != ' ')) {
+            return -1;
+        }
+        ++ line->count;
+
+        text = endptr;
+        while (*text == ' ') {
+            ++ text;
+        }
+    }
+
+    return 0;
+}
+
+// Converts the decoded UTF-8 string of the line to Latin-1 in place.
+static int to_latin1(struct script_line *line) {
+    size_t length = 0;
+    for (size_t index = 0; index < line->length; ++ index) {
+        unsigned char ch = line->string[index];
+        if (ch >= 0x80) {
+            // only two byte sequences starting with 0xC2 or 0xC3 are up to U+00FF
+            if (ch < 0xC2 || ch > 0xC3 || index + 1 == line->length) {
+                return -1;
+            }
+            ch = (unsigned char)((ch & 0x1F) << 6 | (line->string[++ index] & 0x3F));
+        }
+        line->string[length ++] = (char)ch;
+    }
+    line->length = length;
+    return 0;
+}
+
+static int parse_line(ajson_parser *parser, char *text, struct script_line *line) {
+    memset(line, 0, sizeof(*line));
+
+    char *arg = strchr(text, ' ');
+    if (arg) {
+        *arg ++ = 0;
+    }
+
+    size_t i = 0;
+    for (; i < sizeof(commands) / sizeof(commands[0]); ++ i) {
+        if (strcmp(commands[i].name, text) == 0) {
+            line->command = commands[i].command;
+            break;
+        }
+    }
+
+    if (i == sizeof(commands) / sizeof(commands[0])) {
+        fprintf(stderr, "*** unknown command: %s\n", text);
+        return -1;
+    }
+
+    char *endptr = NULL;
+    switch (line->command) {
+    case CMD_INTEGER:
+    case CMD_DECIMALS:
+    case CMD_KEY:
+        if (!arg) return -1;
+        errno = 0;
+        line->integer = strtoll(arg, &endptr, 10);
+        return errno || *endptr ? -1 : 0;
+
+    case CMD_NUMBER:
+        if (!arg) return -1;
+        line->number = strtod(arg, &endptr);
+        return *endptr ? -1 : 0;
+
+    case CMD_STRING:
+    case CMD_REGISTER:
+        return arg ? parse_string(parser, arg, line) : -1;
+
+    case CMD_STRING_LATIN1: return arg && parse_string(parser, arg, line) == 0 ? to_latin1(line) : -1;
+
+    case CMD_RAW:
+        if (!arg) return -1;
+        line->length = strlen(arg);
+        line->string = strdup(arg);
+        return line->string ? 0 : -1;
+
+    case CMD_NUMBER_ARRAY:
+    case CMD_INTEGER_ARRAY:
+        return parse_values(arg, line, line->command == CMD_INTEGER_ARRAY);
+
+    case CMD_STRING_ARRAY:
+        return arg ? parse_strings(parser, arg, line) : -1;
+
+    default:
+        return arg ? -1 : 0;
+    }
+}
+
+static ssize_t write_line(ajson_writer *writer, void *buffer, size_t size, const struct script_line *line) {
+    switch (line->command) {
+    case CMD_NULL:          return ajson_write_null(writer, buffer, size);
+    case CMD_TRUE:          return ajson_write_boolean(writer, buffer, size, true);
+    case CMD_FALSE:         return ajson_write_boolean(writer, buffer, size, false);
+    case CMD_INTEGER:       return ajson_write_integer(writer, buffer, size, line->integer);
+    case CMD_NUMBER:        return ajson_write_number(writer, buffer, size, line->number);
+    case CMD_STRING:        return ajson_write_string(writer, buffer, size, line->string, line->length, AJSON_ENC_UTF8);
+    case CMD_STRING_LATIN1: return ajson_write_string(writer, buffer, size, line->string, line->length, AJSON_ENC_LATIN1);
+    case CMD_RAW:           return ajson_write_raw(writer, buffer, size, line->string, line->length);
+    case CMD_NUMBER_ARRAY:  return ajson_write_number_array(writer, buffer, size, line->numbers, line->count);
+    case CMD_INTEGER_ARRAY: return ajson_write_integer_array(writer, buffer, size, line->integers, line->count);
+    case CMD_STRING_ARRAY:  return ajson_write_string_array(writer, buffer, size, (const char *const *)line->strings, line->lengths, line->count, AJSON_ENC_UTF8);
+    case CMD_KEY:           return ajson_write_key(writer, buffer, size, (size_t)line->integer);
+    case CMD_BEGIN_ARRAY:   return ajson_write_begin_array(writer, buffer, size);
+    case CMD_END_ARRAY:     return ajson_write_end_array(writer, buffer, size);
+    case CMD_BEGIN_OBJECT:  return ajson_write_begin_object(writer, buffer, size);
+    case CMD_END_OBJECT:    return ajson_write_end_object(writer, buffer, size);
+    case CMD_DECIMALS:
+    case CMD_REGISTER:
+    case CMD_RESET:         break;
+    }
+    return 0;
+}
+
+static int sink_line(ajson_sink *sink, const struct script_line *line) {
+    switch (line->command) {
+    case CMD_NULL:          return ajson_sink_write_null(sink);
+    case CMD_TRUE:          return ajson_sink_write_boolean(sink, true);
+    case CMD_FALSE:         return ajson_sink_write_boolean(sink, false);
+    case CMD_INTEGER:       return ajson_sink_write_integer(sink, line->integer);
+    case CMD_NUMBER:        return ajson_sink_write_number(sink, line->number);
+    case CMD_STRING:        return ajson_sink_write_string(sink, line->string, line->length, AJSON_ENC_UTF8);
+    case CMD_STRING_LATIN1: return ajson_sink_write_string(sink, line->string, line->length, AJSON_ENC_LATIN1);
+    case CMD_RAW:           return ajson_sink_write_raw(sink, line->string, line->length);
+    case CMD_NUMBER_ARRAY:  return ajson_sink_write_number_array(sink, line->numbers, line->count);
+    case CMD_INTEGER_ARRAY: return ajson_sink_write_integer_array(sink, line->integers, line->count);
+    case CMD_STRING_ARRAY:  return ajson_sink_write_string_array(sink, (const char *const *)line->strings, line->lengths, line->count, AJSON_ENC_UTF8);
+    case CMD_KEY:           return ajson_sink_write_key(sink, (size_t)line->integer);
+    case CMD_BEGIN_ARRAY:   return ajson_sink_write_begin_array(sink);
+    case CMD_END_ARRAY:     return ajson_sink_write_end_array(sink);
+    case CMD_BEGIN_OBJECT:  return ajson_sink_write_begin_object(sink);
+    case CMD_END_OBJECT:    return ajson_sink_write_end_object(sink);
+    case CMD_DECIMALS:
+    case CMD_REGISTER:
+    case CMD_RESET:         break;
+    }
+    return 0;
+}
+
+// Writes into the free part of the output buffer and continues the write
+// whenever the buffer got full, so writes start at any offset of the buffer.
+static int run_line(ajson_writer *writer, struct output *output, const struct script_line *line) {
+    if (line->command == CMD_RESET) {
+        flush_output(output);
+        if (output->sink_type == SINK_NONE) {
+            ajson_writer_reset(writer);
+        }
+        else {
+            ajson_sink_reset(&output->sink);
+            output->printed = 0;
+        }
+        printf("\n");
+        return 0;
+    }
+
+    if (line->command == CMD_DECIMALS) {
+        return ajson_writer_set_decimals(writer, (int)line->integer);
+    }
+
+    // handles count up from 0 in the order of the register lines
+    if (line->command == CMD_REGISTER) {
+        return ajson_writer_register_key(writer, line->string, line->length, AJSON_ENC_UTF8) < 0 ? -1 : 0;
+    }
+
+    if (output->sink_type != SINK_NONE) {
+        int result = sink_line(&output->sink, line);
+        int errnum = errno;
+        drain_pipe(output);
+        errno = errnum;
+        return result;
+    }
+
+    ssize_t written = write_line(writer, output->buffer + output->used, output->size - output->used, line);
+
+    while (written >= 0) {
+        output->used += (size_t)written;
+        if (output->used < output->size) {
+            return 0;
+        }
+        flush_output(output);
+        written = ajson_write_continue(writer, output->buffer, output->size);
+    }
+
+    return -1;
+}
+
+int run_script(FILE *fp, ajson_writer *writer, struct output *output) {
+    ajson_parser parser;
+    char         text[65536];
+    size_t       lineno = 0;
+    int          status = 0;
+
+    if (ajson_init(&parser, AJSON_FLAGS_NONE, AJSON_ENC_UTF8) != 0) {
+        perror("ajson_init");
+        return 1;
+    }
+
+    while (fgets(text, sizeof(text), fp)) {
+        ++ lineno;
+
+        size_t length = strlen(text);
+        if (length && text[length - 1] == '\n') {
+            text[-- length] = 0;
+        }
+
+        if (length == 0 || text[0] == '#') {
+            continue;
+        }
+
+        // "repeat N" runs the rest of the line N times
+        char         *command = text;
+        unsigned long repeat  = 1;
+        if (strncmp(text, "repeat ", 7) == 0) {
+            repeat = strtoul(text + 7, &command, 10);
+            while (*command == ' ') {
+                ++ command;
+            }
+        }
+
+        struct script_line line;
+        if (parse_line(&parser, command, &line) != 0) {
+            fprintf(stderr, "*** syntax error in line %zu\n", lineno);
+            free_line(&line);
+            status = 1;
+            break;
+        }
+
+        for (; repeat > 0; -- repeat) {
+            errno = 0;
+            if (run_line(writer, output, &line) != 0) {
+                int errnum = errno;
+                flush_output(output);
+                printf("\nerror: %zu: %s\n", lineno, strerror(errnum));
+                break;
+            }
+        }
+
+        done_line(output, &line);
+    }
+
+    flush_output(output);
+    printf("\n");
+
+    ajson_destroy(&parser);
+
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    struct option long_options[] = {
+        {"help",        no_argument,       0, 'h'},
+        {"ascii",       no_argument,       0, 'a'},
+        {"indent",      required_argument, 0, 'I'},
+        {"buffer-size", required_argument, 0, 'b'},
+        {"sink",        required_argument, 0, 's'},
+        {0,             0,                 0,  0 }
+    };
+
+    int            flags  = AJSON_WRITER_FLAGS_NONE;
+    char           indent[64];
+    bool           use_indent  = false;
+    size_t         buffer_size = BUFSIZ;
+    enum sink_type sink_type   = SINK_NONE;
+    struct output  output;
+    ajson_writer   writer;
+    ajson_writer  *writer_ptr  = &writer;
+    int            status = 0;
+
+    for (;;) {
+        int opt = getopt_long(argc, argv, "haI:b:s:", long_options, NULL);
+
+        if (opt == -1)
+            break;
+
+        switch (opt) {
+        case 'h':
+            printf(
+                        "usage: %s [options] [script-file]\n"
+                        "\n"
+                        "OPTIONS:\n"
+                        "\t-h, --help                 print this help message\n"
+                        "\t-a, --ascii                escape non-ASCII characters\n"
+                        "\t-I, --indent=N             indent by N spaces\n"
+                        "\t-b, --buffer-size=SIZE     size of the output buffer in bytes (default: %d)\n"
+                        "\t-s, --sink=TYPE            write through a sink, TYPE is one of:\n"
+                        "\t                           buffer, fd (non-blocking pipe), file (stdout), iovec\n"
+                        "\t                           the buffer size is ignored\n",
+                        argc > 0 ? argv[0] : "writer", BUFSIZ);
+            return 0;
+
+        case 'a':
+            flags |= AJSON_WRITER_FLAG_ASCII;
+            break;
+
+        case 'I':
+        {
+            char *endptr = NULL;
+            size_t count = strtoul(optarg, &endptr, 10);
+            if (*endptr || count >= sizeof(indent)) {
+                fprintf(stderr, "*** invalid indent: %s\n", optarg);
+                return 1;
+            }
+            memset(indent, ' ', count);
+            indent[count] = 0;
+            use_indent = true;
+            break;
+        }
+        case 'b':
+        {
+            char *endptr = NULL;
+            buffer_size = strtoul(optarg, &endptr, 10);
+            if (*endptr || buffer_size == 0) {
+                fprintf(stderr, "*** invalid buffer size: %s\n", optarg);
+                return 1;
+            }
+            break;
+        }
+        case 's':
+            if (strcmp(optarg, "buffer") == 0) {
+                sink_type = SINK_BUFFER;
+            }
+            else if (strcmp(optarg, "fd") == 0) {
+                sink_type = SINK_FD;
+            }
+            else if (strcmp(optarg, "file") == 0) {
+                sink_type = SINK_FILE;
+            }
+            else if (strcmp(optarg, "iovec") == 0) {
+                sink_type = SINK_IOVEC;
+            }
+            else {
+                fprintf(stderr, "*** invalid sink: %s\n", optarg);
+                return 1;
+            }
+            break;
+
+        case '?':
+            fprintf(stderr, "*** unknown option: -%s\n", optarg);
+            return 1;
+        }
+    }
+
+    memset(&output, 0, sizeof(output));
+    output.sink_type = sink_type;
+
+    if (sink_type != SINK_NONE) {
+        if (open_sink(&output, flags, use_indent ? indent : NULL) != 0) {
+            perror("open_sink");
+            return 1;
+        }
+        writer_ptr = &output.sink.writer;
+    }
+    else {
+        if (ajson_writer_init(&writer, flags, use_indent ? indent : NULL) != 0) {
+            perror("ajson_writer_init");
+            return 1;
+        }
+
+        output.buffer = malloc(buffer_size);
+        output.size   = buffer_size;
+        if (!output.buffer) {
+            perror("malloc");
+            ajson_writer_destroy(&writer);
+            return 1;
+        }
+    }
+
+    if (optind < argc) {
+        FILE *fp = fopen(argv[optind], "rb");
+        if (!fp) {
+            perror(argv[optind]);
+            status = 1;
+        }
+        else {
+            status = run_script(fp, writer_ptr, &output);
+            fclose(fp);
+        }
+    }
+    else {
+        status = run_script(stdin, writer_ptr, &output);
+    }
+
+    if (sink_type != SINK_NONE) {
+        close_sink(&output);
+    }
+    else {
+        free(output.buffer);
+        ajson_writer_destroy(&writer);
+    }
+
+    return status;
+}